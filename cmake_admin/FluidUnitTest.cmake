@@ -18,3 +18,21 @@ macro ( ADD_FLUID_TEST _test )
     add_dependencies(check ${_test})
 
 endmacro ( ADD_FLUID_TEST )
+
+macro ( ADD_FLUID_BENCHMARK _bench )
+    ADD_EXECUTABLE(${_bench} ${_bench}.c)
+    TARGET_LINK_LIBRARIES(${_bench} libfluidsynth)
+
+    target_include_directories(${_bench}
+    PUBLIC
+    $<BUILD_INTERFACE:${CMAKE_BINARY_DIR}/include> # include auto generated headers
+    $<BUILD_INTERFACE:${CMAKE_SOURCE_DIR}/include> # include "normal" public (sub-)headers
+    $<BUILD_INTERFACE:${CMAKE_SOURCE_DIR}/src> # include private headers
+    $<TARGET_PROPERTY:libfluidsynth,INCLUDE_DIRECTORIES> # include all other header search paths needed by libfluidsynth (esp. glib)
+    )
+
+    # benchmarks are not part of ctest, run them via the benchmark-target
+    add_custom_command(TARGET benchmark POST_BUILD COMMAND ${_bench} VERBATIM)
+    add_dependencies(benchmark ${_bench})
+
+endmacro ( ADD_FLUID_BENCHMARK )
@@ -232,6 +232,7 @@ FLUIDSYNTH_API int fluid_synth_tuning_dump(fluid_synth_t *synth, int bank, int p
 /* Misc */
 
 FLUIDSYNTH_API double fluid_synth_get_cpu_load(fluid_synth_t *synth);
+FLUIDSYNTH_API int fluid_synth_get_stream_underruns(fluid_synth_t *synth);
 FLUIDSYNTH_API const char *fluid_synth_error(fluid_synth_t *synth);
 
 
@@ -270,6 +271,10 @@ FLUIDSYNTH_API int fluid_synth_nwrite_float(fluid_synth_t *synth, int len,
 FLUIDSYNTH_API int fluid_synth_process(fluid_synth_t *synth, int len,
                                        int nfx, float *fx[],
                                        int nout, float *out[]);
+FLUIDSYNTH_API int fluid_synth_process_events(fluid_synth_t *synth, int len,
+        int nevents, fluid_midi_event_t *events[], const int frames[],
+        int nfx, float *fx[],
+        int nout, float *out[]);
 
 
 /* Synthesizer's interface to handle SoundFont loaders */
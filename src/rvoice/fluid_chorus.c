@@ -93,11 +93,25 @@
  * => MAX_SAMPLES=pow(2,12)=4096
  * => MAX_SAMPLES_ANDMASK=4095
  */
-#define MAX_SAMPLES_LN2 12
+#define MAX_SAMPLES_LN2 13
 
 #define MAX_SAMPLES (1 << (MAX_SAMPLES_LN2-1))
 #define MAX_SAMPLES_ANDMASK (MAX_SAMPLES-1)
 
+/* Maximum modulation depth in samples. Only half of the delay line may be
+ * used by the modulation, so that the interpolation taps never reach the
+ * samples of a chunk which are written ahead of them.
+ */
+#define MAX_DEPTH_SAMPLES (MAX_SAMPLES / 2)
+
+/* Number of samples processed at once */
+#define CHORUS_CHUNK FLUID_BUFSIZE
+
+/* The delay line is preceded by a copy of its last samples, so that the
+ * interpolation taps can be read without wrapping around at every tap.
+ */
+#define CHORUS_GUARD (INTERPOLATION_SAMPLES - 1)
+
 
 /* Interpolate how many steps between samples? Must be power of two
    For example: 8 => use a resolution of 256 steps between any two
@@ -111,6 +125,7 @@
    relatively clean, when listening to the modulated delay signal
    alone.  For a demo on aliasing try '1' With '3', the aliasing is
    still quite pronounced for some input frequencies
+   Note that the taps are written out in fluid_chorus_process_chunk().
 */
 #define INTERPOLATION_SAMPLES 5
 
@@ -130,8 +145,8 @@ struct _fluid_chorus_t
     int *lookup_tab;
     fluid_real_t sample_rate;
 
-    /* sinc lookup table */
-    fluid_real_t sinc_table[INTERPOLATION_SAMPLES][INTERPOLATION_SUBSAMPLES];
+    /* sinc lookup table, the taps of one subsample position are adjacent */
+    fluid_real_t sinc_table[INTERPOLATION_SUBSAMPLES][INTERPOLATION_SAMPLES];
 };
 
 static void fluid_chorus_triangle(int *buf, int len, int depth);
@@ -174,14 +189,14 @@ new_fluid_chorus(fluid_real_t sample_rate)
             {
                 /* sinc(0) cannot be calculated straightforward (limit needed
                    for 0/0) */
-                chorus->sinc_table[i][ii] = (fluid_real_t)1.;
+                chorus->sinc_table[ii][i] = (fluid_real_t)1.;
 
             }
             else
             {
-                chorus->sinc_table[i][ii] = (fluid_real_t)sin(i_shifted * M_PI) / (M_PI * i_shifted);
+                chorus->sinc_table[ii][i] = (fluid_real_t)sin(i_shifted * M_PI) / (M_PI * i_shifted);
                 /* Hamming window */
-                chorus->sinc_table[i][ii] *= (fluid_real_t)0.5 * (1.0 + cos(2.0 * M_PI * i_shifted / (fluid_real_t)INTERPOLATION_SAMPLES));
+                chorus->sinc_table[ii][i] *= (fluid_real_t)0.5 * (1.0 + cos(2.0 * M_PI * i_shifted / (fluid_real_t)INTERPOLATION_SAMPLES));
             };
         };
     };
@@ -197,7 +212,7 @@ new_fluid_chorus(fluid_real_t sample_rate)
 
     /* allocate sample buffer */
 
-    chorus->chorusbuf = FLUID_ARRAY(fluid_real_t, MAX_SAMPLES);
+    chorus->chorusbuf = FLUID_ARRAY(fluid_real_t, CHORUS_GUARD + MAX_SAMPLES);
 
     if(chorus->chorusbuf == NULL)
     {
@@ -233,7 +248,7 @@ fluid_chorus_init(fluid_chorus_t *chorus)
 {
     int i;
 
-    for(i = 0; i < MAX_SAMPLES; i++)
+    for(i = 0; i < CHORUS_GUARD + MAX_SAMPLES; i++)
     {
         chorus->chorusbuf[i] = 0.0;
     }
@@ -344,10 +359,10 @@ fluid_chorus_set(fluid_chorus_t *chorus, int set, int nr, fluid_real_t level,
                                (chorus->depth_ms / 1000.0  /* convert modulation depth in ms to s*/
                                 * chorus->sample_rate);
 
-    if(modulation_depth_samples > MAX_SAMPLES)
+    if(modulation_depth_samples > MAX_DEPTH_SAMPLES)
     {
-        fluid_log(FLUID_WARN, "chorus: Too high depth. Setting it to max (%d).", MAX_SAMPLES);
-        modulation_depth_samples = MAX_SAMPLES;
+        fluid_log(FLUID_WARN, "chorus: Too high depth. Setting it to max (%d).", MAX_DEPTH_SAMPLES);
+        modulation_depth_samples = MAX_DEPTH_SAMPLES;
     }
 
     /* initialize LFO table */
@@ -381,149 +396,198 @@ fluid_chorus_set(fluid_chorus_t *chorus, int set, int nr, fluid_real_t level,
 }
 
 
-void fluid_chorus_processmix(fluid_chorus_t *chorus, fluid_real_t *in,
-                             fluid_real_t *left_out, fluid_real_t *right_out)
+/* Calculates the read positions of one chorus block for count samples.
+ *
+ * The value in the lookup table is so, that the position will always be
+ * positive.  It will always include a number of full periods of
+ * MAX_SAMPLES*INTERPOLATION_SUBSAMPLES to remain positive at all times.
+ */
+static FLUID_INLINE void
+fluid_chorus_get_positions(int *pos_samples, int *pos_subsamples,
+                           const int *lookup, int counter, int count)
 {
-    int sample_index;
-    int i;
-    fluid_real_t d_in, d_out;
+    int k;
 
-    for(sample_index = 0; sample_index < FLUID_BUFSIZE; sample_index++)
+    #pragma omp simd
+    for(k = 0; k < count; k++)
     {
+        int pos = INTERPOLATION_SUBSAMPLES * (counter + k) - lookup[k];
 
-        d_in = in[sample_index];
-        d_out = 0.0f;
+        /* The & is equivalent to a division modulo MAX_SAMPLES, only
+           faster. */
+        pos_samples[k] = (pos / INTERPOLATION_SUBSAMPLES) & MAX_SAMPLES_ANDMASK;
 
-# if 0
-        /* Debug: Listen to the chorus signal only */
-        left_out[sample_index] = 0;
-        right_out[sample_index] = 0;
-#endif
-
-        /* Write the current sample into the circular buffer */
-        chorus->chorusbuf[chorus->counter] = d_in;
-
-        for(i = 0; i < chorus->number_blocks; i++)
-        {
-            int ii;
-            /* Calculate the delay in subsamples for the delay line of chorus block nr. */
+        /* modulo divide by INTERPOLATION_SUBSAMPLES */
+        pos_subsamples[k] = pos & INTERPOLATION_SUBSAMPLES_ANDMASK;
+    }
+}
 
-            /* The value in the lookup table is so, that this expression
-             * will always be positive.  It will always include a number of
-             * full periods of MAX_SAMPLES*INTERPOLATION_SUBSAMPLES to
-             * remain positive at all times. */
-            int pos_subsamples = (INTERPOLATION_SUBSAMPLES * chorus->counter
-                                  - chorus->lookup_tab[chorus->phase[i]]);
+/* Computes the chorus of one chunk of at most CHORUS_CHUNK samples.
+ *
+ * The input of the whole chunk is written into the delay line first. This
+ * is safe because the delay of a chorus block never drops below zero and
+ * never exceeds MAX_DEPTH_SAMPLES, so none of the interpolation taps reads
+ * a position that is overwritten by a later sample of the same chunk.
+ *
+ * Then the read positions of a chorus block are computed for the whole
+ * chunk at once, and its interpolation taps run over all samples of the
+ * chunk. This replaces the modulo operations per sample and chorus block.
+ * Summing the chorus blocks and taps in the same order as before keeps the
+ * result identical to processing sample by sample.
+ */
+static FLUID_INLINE void
+fluid_chorus_process_chunk(fluid_chorus_t *chorus, const fluid_real_t *in,
+                           fluid_real_t *left_out, fluid_real_t *right_out,
+                           int count, int mix)
+{
+    fluid_real_t d_out[CHORUS_CHUNK];
+    int pos_samples[CHORUS_CHUNK];
+    int pos_subsamples[CHORUS_CHUNK];
+    fluid_real_t *line = chorus->chorusbuf + CHORUS_GUARD;
+    const int *lookup_tab = chorus->lookup_tab;
+    long period = chorus->modulation_period_samples;
+    int counter = chorus->counter;
+    int i, k;
+
+    /* Write the current samples into the circular buffer */
+    for(k = 0; k < count; k++)
+    {
+        int index = (counter + k) & MAX_SAMPLES_ANDMASK;
 
-            int pos_samples = pos_subsamples / INTERPOLATION_SUBSAMPLES;
+        line[index] = in[k];
 
-            /* modulo divide by INTERPOLATION_SUBSAMPLES */
-            pos_subsamples &= INTERPOLATION_SUBSAMPLES_ANDMASK;
+        /* Keep the guard in front of the delay line up to date */
+        if(index >= MAX_SAMPLES - CHORUS_GUARD)
+        {
+            line[index - MAX_SAMPLES] = in[k];
+        }
+    }
 
-            for(ii = 0; ii < INTERPOLATION_SAMPLES; ii++)
-            {
-                /* Add the delayed signal to the chorus sum d_out Note: The
-                 * delay in the delay line moves backwards for increasing
-                 * delay!*/
+    #pragma omp simd
+    for(k = 0; k < count; k++)
+    {
+        d_out[k] = 0.0f;
+    }
 
-                /* The & in chorusbuf[...] is equivalent to a division modulo
-                   MAX_SAMPLES, only faster. */
-                d_out += chorus->chorusbuf[pos_samples & MAX_SAMPLES_ANDMASK]
-                         * chorus->sinc_table[ii][pos_subsamples];
+    for(i = 0; i < chorus->number_blocks; i++)
+    {
+        long phase = chorus->phase[i];
+        int wrap = count;
 
-                pos_samples--;
-            };
+        /* The LFO period is much longer than a chunk, so the phase wraps
+         * around at most once. Split the chunk there, so that the lookup
+         * table is read in one piece on both sides. */
+        if(period - phase < count)
+        {
+            wrap = (int)(period - phase);
+        }
 
-            /* Cycle the phase of the modulating LFO */
-            chorus->phase[i]++;
+        fluid_chorus_get_positions(pos_samples, pos_subsamples,
+                                   &lookup_tab[phase], counter, wrap);
+        fluid_chorus_get_positions(&pos_samples[wrap], &pos_subsamples[wrap],
+                                   lookup_tab, counter + wrap, count - wrap);
 
-            chorus->phase[i] %= (chorus->modulation_period_samples);
-        } /* foreach chorus block */
+        for(k = 0; k < count; k++)
+        {
+            const fluid_real_t *delayed = &line[pos_samples[k]];
+            const fluid_real_t *sinc = chorus->sinc_table[pos_subsamples[k]];
+            fluid_real_t sum = d_out[k];
+
+            /* Add the delayed signal to the chorus sum d_out Note: The
+             * delay in the delay line moves backwards for increasing
+             * delay!*/
+            sum += delayed[0] * sinc[0];
+            sum += delayed[-1] * sinc[1];
+            sum += delayed[-2] * sinc[2];
+            sum += delayed[-3] * sinc[3];
+            sum += delayed[-4] * sinc[4];
+
+            d_out[k] = sum;
+        }
+
+        /* Cycle the phase of the modulating LFO */
+        phase += count;
+
+        if(phase >= period)
+        {
+            phase -= period;
+        }
 
-        d_out *= chorus->level;
+        chorus->phase[i] = phase;
+    } /* foreach chorus block */
 
+    if(mix)
+    {
         /* Add the chorus sum d_out to output */
-        left_out[sample_index] += d_out;
-        right_out[sample_index] += d_out;
+        #pragma omp simd
+        for(k = 0; k < count; k++)
+        {
+            fluid_real_t out = d_out[k] * chorus->level;
+
+            left_out[k] += out;
+            right_out[k] += out;
+        }
+    }
+    else
+    {
+        /* Store the chorus sum d_out to output */
+        #pragma omp simd
+        for(k = 0; k < count; k++)
+        {
+            fluid_real_t out = d_out[k] * chorus->level;
 
-        /* Move forward in circular buffer */
-        chorus->counter++;
-        chorus->counter %= MAX_SAMPLES;
+            left_out[k] = out;
+            right_out[k] = out;
+        }
+    }
 
-    } /* foreach sample */
+    /* Move forward in circular buffer */
+    chorus->counter = (counter + count) & MAX_SAMPLES_ANDMASK;
 }
 
-/* Duplication of code ... (replaces sample data instead of mixing) */
-void fluid_chorus_processreplace(fluid_chorus_t *chorus, fluid_real_t *in,
-                                 fluid_real_t *left_out, fluid_real_t *right_out)
+static FLUID_INLINE void
+fluid_chorus_process(fluid_chorus_t *chorus, const fluid_real_t *in,
+                     fluid_real_t *left_out, fluid_real_t *right_out,
+                     int count, int mix)
 {
-    int sample_index;
-    int i;
-    fluid_real_t d_in, d_out;
+    int k, n;
 
-    for(sample_index = 0; sample_index < FLUID_BUFSIZE; sample_index++)
+    for(k = 0; k < count; k += n)
     {
+        n = count - k;
 
-        d_in = in[sample_index];
-        d_out = 0.0f;
-
-# if 0
-        /* Debug: Listen to the chorus signal only */
-        left_out[sample_index] = 0;
-        right_out[sample_index] = 0;
-#endif
-
-        /* Write the current sample into the circular buffer */
-        chorus->chorusbuf[chorus->counter] = d_in;
-
-        for(i = 0; i < chorus->number_blocks; i++)
+        if(n > CHORUS_CHUNK)
         {
-            int ii;
-            /* Calculate the delay in subsamples for the delay line of chorus block nr. */
-
-            /* The value in the lookup table is so, that this expression
-             * will always be positive.  It will always include a number of
-             * full periods of MAX_SAMPLES*INTERPOLATION_SUBSAMPLES to
-             * remain positive at all times. */
-            int pos_subsamples = (INTERPOLATION_SUBSAMPLES * chorus->counter
-                                  - chorus->lookup_tab[chorus->phase[i]]);
-
-            int pos_samples = pos_subsamples / INTERPOLATION_SUBSAMPLES;
-
-            /* modulo divide by INTERPOLATION_SUBSAMPLES */
-            pos_subsamples &= INTERPOLATION_SUBSAMPLES_ANDMASK;
-
-            for(ii = 0; ii < INTERPOLATION_SAMPLES; ii++)
-            {
-                /* Add the delayed signal to the chorus sum d_out Note: The
-                 * delay in the delay line moves backwards for increasing
-                 * delay!*/
-
-                /* The & in chorusbuf[...] is equivalent to a division modulo
-                   MAX_SAMPLES, only faster. */
-                d_out += chorus->chorusbuf[pos_samples & MAX_SAMPLES_ANDMASK]
-                         * chorus->sinc_table[ii][pos_subsamples];
-
-                pos_samples--;
-            };
-
-            /* Cycle the phase of the modulating LFO */
-            chorus->phase[i]++;
-
-            chorus->phase[i] %= (chorus->modulation_period_samples);
-        } /* foreach chorus block */
+            n = CHORUS_CHUNK;
+        }
 
-        d_out *= chorus->level;
+        fluid_chorus_process_chunk(chorus, &in[k], &left_out[k], &right_out[k], n, mix);
+    }
+}
 
-        /* Store the chorus sum d_out to output */
-        left_out[sample_index] = d_out;
-        right_out[sample_index] = d_out;
+void fluid_chorus_processmix(fluid_chorus_t *chorus, fluid_real_t *in,
+                             fluid_real_t *left_out, fluid_real_t *right_out, int count)
+{
+    fluid_chorus_process(chorus, in, left_out, right_out, count, TRUE);
+}
 
-        /* Move forward in circular buffer */
-        chorus->counter++;
-        chorus->counter %= MAX_SAMPLES;
+void fluid_chorus_processreplace(fluid_chorus_t *chorus, fluid_real_t *in,
+                                 fluid_real_t *left_out, fluid_real_t *right_out, int count)
+{
+    fluid_chorus_process(chorus, in, left_out, right_out, count, FALSE);
+}
 
-    } /* foreach sample */
+/**
+ * Get the length of the chorus tail, i.e. the number of samples after which
+ * the output has died away once the input has become silent.
+ * @param chorus Chorus instance
+ * @return Length of the tail in samples
+ */
+int
+fluid_chorus_get_tail(fluid_chorus_t *chorus)
+{
+    /* There is no feedback, the output is made of the delayed signal only */
+    return MAX_DEPTH_SAMPLES + INTERPOLATION_SAMPLES;
 }
 
 /* Purpose:
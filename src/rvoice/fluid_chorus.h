@@ -56,9 +56,11 @@ void fluid_chorus_set(fluid_chorus_t *chorus, int set, int nr, fluid_real_t leve
                       fluid_real_t speed, fluid_real_t depth_ms, int type);
 
 void fluid_chorus_processmix(fluid_chorus_t *chorus, fluid_real_t *in,
-                             fluid_real_t *left_out, fluid_real_t *right_out);
+                             fluid_real_t *left_out, fluid_real_t *right_out, int count);
 void fluid_chorus_processreplace(fluid_chorus_t *chorus, fluid_real_t *in,
-                                 fluid_real_t *left_out, fluid_real_t *right_out);
+                                 fluid_real_t *left_out, fluid_real_t *right_out, int count);
+
+int fluid_chorus_get_tail(fluid_chorus_t *chorus);
 
 
 
@@ -142,6 +142,195 @@ fluid_iir_filter_apply(fluid_iir_filter_t *iir_filter,
     }
 }
 
+/**
+ * Applies up to #FLUID_IIR_FILTER_BATCH filters to one block of
+ * \c dsp_buf_count samples each.
+ *
+ * The filters run in lockstep: their coefficients and history are gathered
+ * into one lane per filter, so that the Direct-II recursion of all filters
+ * is vectorized across voices rather than along the (recursive) time axis.
+ * The arithmetic is the same as fluid_iir_filter_apply(), so is the result.
+ *
+ * @param iir_filters Array of \c count filters
+ * @param dsp_bufs Array of \c count sample buffers, one for each filter
+ * @param count Number of filters, at most #FLUID_IIR_FILTER_BATCH
+ * @param dsp_buf_count Number of samples in each buffer
+ */
+void
+fluid_iir_filter_apply_batch(fluid_iir_filter_t **iir_filters,
+                             fluid_real_t **dsp_bufs, int count, int dsp_buf_count)
+{
+    /* filter lanes, unused ones stay zero and produce silence */
+    fluid_real_t dsp_a1[FLUID_IIR_FILTER_BATCH] = {0}, dsp_a2[FLUID_IIR_FILTER_BATCH] = {0};
+    fluid_real_t dsp_b02[FLUID_IIR_FILTER_BATCH] = {0}, dsp_b1[FLUID_IIR_FILTER_BATCH] = {0};
+    fluid_real_t dsp_a1_incr[FLUID_IIR_FILTER_BATCH] = {0}, dsp_a2_incr[FLUID_IIR_FILTER_BATCH] = {0};
+    fluid_real_t dsp_b02_incr[FLUID_IIR_FILTER_BATCH] = {0}, dsp_b1_incr[FLUID_IIR_FILTER_BATCH] = {0};
+    fluid_real_t dsp_hist1[FLUID_IIR_FILTER_BATCH] = {0}, dsp_hist2[FLUID_IIR_FILTER_BATCH] = {0};
+    int compensate[FLUID_IIR_FILTER_BATCH] = {0};
+
+    /* the samples of all lanes, interleaved, in chunks of FLUID_BUFSIZE */
+    fluid_real_t dsp_lanes[FLUID_BUFSIZE * FLUID_IIR_FILTER_BATCH];
+
+    fluid_iir_filter_t *lane_filter[FLUID_IIR_FILTER_BATCH];
+    fluid_real_t *lane_buf[FLUID_IIR_FILTER_BATCH];
+    int i, l, start, chunk, lanes = 0, ramp = FALSE, any_compensate = FALSE;
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_iir_filter_t *iir_filter = iir_filters[i];
+
+        if(iir_filter->type == FLUID_IIR_DISABLED || iir_filter->q_lin == 0)
+        {
+            continue;
+        }
+
+        /* a coefficient ramp not aligned to this block cannot share the lanes' loop */
+        if(iir_filter->filter_coeff_incr_count != 0
+                && iir_filter->filter_coeff_incr_count != dsp_buf_count)
+        {
+            fluid_iir_filter_apply(iir_filter, dsp_bufs[i], dsp_buf_count);
+            continue;
+        }
+
+        lane_filter[lanes] = iir_filter;
+        lane_buf[lanes] = dsp_bufs[i];
+        lanes++;
+    }
+
+    if(lanes <= 1)
+    {
+        if(lanes == 1)
+        {
+            fluid_iir_filter_apply(lane_filter[0], lane_buf[0], dsp_buf_count);
+        }
+
+        return;
+    }
+
+    for(l = 0; l < lanes; l++)
+    {
+        fluid_iir_filter_t *iir_filter = lane_filter[l];
+
+        dsp_a1[l] = iir_filter->a1;
+        dsp_a2[l] = iir_filter->a2;
+        dsp_b02[l] = iir_filter->b02;
+        dsp_b1[l] = iir_filter->b1;
+        dsp_hist1[l] = iir_filter->hist1;
+        dsp_hist2[l] = iir_filter->hist2;
+
+        /* Check for denormal number (too close to zero). */
+        if(fabs(dsp_hist1[l]) < 1e-20)
+        {
+            dsp_hist1[l] = 0.0f;
+        }
+
+        if(iir_filter->filter_coeff_incr_count > 0)
+        {
+            dsp_a1_incr[l] = iir_filter->a1_incr;
+            dsp_a2_incr[l] = iir_filter->a2_incr;
+            dsp_b02_incr[l] = iir_filter->b02_incr;
+            dsp_b1_incr[l] = iir_filter->b1_incr;
+            compensate[l] = iir_filter->compensate_incr;
+
+            ramp = TRUE;
+            any_compensate |= compensate[l];
+        }
+    }
+
+    for(start = 0; start < dsp_buf_count; start += chunk)
+    {
+        chunk = dsp_buf_count - start;
+
+        if(chunk > FLUID_BUFSIZE)
+        {
+            chunk = FLUID_BUFSIZE;
+        }
+
+        for(l = 0; l < lanes; l++)
+        {
+            fluid_real_t *dsp_buf = &lane_buf[l][start];
+
+            for(i = 0; i < chunk; i++)
+            {
+                dsp_lanes[i * FLUID_IIR_FILTER_BATCH + l] = dsp_buf[i];
+            }
+        }
+
+        /* the unused lanes are filtered as well, keep them silent */
+        for(; l < FLUID_IIR_FILTER_BATCH; l++)
+        {
+            for(i = 0; i < chunk; i++)
+            {
+                dsp_lanes[i * FLUID_IIR_FILTER_BATCH + l] = 0;
+            }
+        }
+
+        for(i = 0; i < chunk; i++)
+        {
+            fluid_real_t *dsp_frame = &dsp_lanes[i * FLUID_IIR_FILTER_BATCH];
+
+            #pragma omp simd
+
+            for(l = 0; l < FLUID_IIR_FILTER_BATCH; l++)
+            {
+                /* The filter is implemented in Direct-II form. */
+                fluid_real_t dsp_centernode = dsp_frame[l] - dsp_a1[l] * dsp_hist1[l] - dsp_a2[l] * dsp_hist2[l];
+                dsp_frame[l] = dsp_b02[l] * (dsp_centernode + dsp_hist2[l]) + dsp_b1[l] * dsp_hist1[l];
+                dsp_hist2[l] = dsp_hist1[l];
+                dsp_hist1[l] = dsp_centernode;
+            }
+
+            /* Lanes without a ramp have zero increments, which leaves their coefficients as they are. */
+            if(ramp)
+            {
+                #pragma omp simd
+
+                for(l = 0; l < FLUID_IIR_FILTER_BATCH; l++)
+                {
+                    fluid_real_t old_b02 = dsp_b02[l];
+                    dsp_a1[l] += dsp_a1_incr[l];
+                    dsp_a2[l] += dsp_a2_incr[l];
+                    dsp_b02[l] += dsp_b02_incr[l];
+                    dsp_b1[l] += dsp_b1_incr[l];
+
+                    /* Compensate history to avoid the filter going havoc with large frequency changes */
+                    if(any_compensate)
+                    {
+                        fluid_real_t factor = (compensate[l] && fabs(dsp_b02[l]) > 0.001) ? old_b02 / dsp_b02[l] : 1.0f;
+                        dsp_hist1[l] *= factor;
+                        dsp_hist2[l] *= factor;
+                    }
+                }
+            }
+        }
+
+        for(l = 0; l < lanes; l++)
+        {
+            fluid_real_t *dsp_buf = &lane_buf[l][start];
+
+            for(i = 0; i < chunk; i++)
+            {
+                dsp_buf[i] = dsp_lanes[i * FLUID_IIR_FILTER_BATCH + l];
+            }
+        }
+    }
+
+    for(l = 0; l < lanes; l++)
+    {
+        fluid_iir_filter_t *iir_filter = lane_filter[l];
+
+        iir_filter->hist1 = dsp_hist1[l];
+        iir_filter->hist2 = dsp_hist2[l];
+        iir_filter->a1 = dsp_a1[l];
+        iir_filter->a2 = dsp_a2[l];
+        iir_filter->b02 = dsp_b02[l];
+        iir_filter->b1 = dsp_b1[l];
+        iir_filter->filter_coeff_incr_count = 0;
+    }
+
+    fluid_check_fpe("voice_filter");
+}
+
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_iir_filter_init)
 {
@@ -173,7 +362,14 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_iir_filter_set_fres)
     fluid_iir_filter_t *iir_filter = obj;
     fluid_real_t fres = param[0].real;
 
-    iir_filter->fres = fres;
+    /* fluid_iir_filter_calc() glides to the new cutoff, unless the voice is starting */
+    if(iir_filter->filter_startup)
+    {
+        iir_filter->fres = fres;
+    }
+
+    iir_filter->fres_target = fres;
+    iir_filter->fres_ramp_count = 0;
     iir_filter->last_fres = -1.;
 }
 
@@ -340,7 +536,7 @@ fluid_iir_filter_calculate_coefficients(fluid_iir_filter_t *iir_filter,
 
             /* The filter frequency is changed.  Calculate an increment
              * factor, so that the new setting is reached after one buffer
-             * length. x_incr is added to the current value FLUID_BUFSIZE
+             * length. x_incr is added to the current value transition_samples
              * times. The length is arbitrarily chosen. Longer than one
              * buffer will sacrifice some performance, though.  Note: If
              * the filter is still too 'grainy', then increase this number
@@ -367,12 +563,55 @@ fluid_iir_filter_calculate_coefficients(fluid_iir_filter_t *iir_filter,
 }
 
 
+/*
+ * Moves the cutoff set by fluid_iir_filter_set_fres() on to its new value,
+ * reaching it after fres_ramp samples, one call per transition_samples.
+ */
+static FLUID_INLINE void
+fluid_iir_filter_ramp_fres(fluid_iir_filter_t *iir_filter, int transition_samples, int fres_ramp)
+{
+    if(iir_filter->filter_startup || fres_ramp <= transition_samples)
+    {
+        iir_filter->fres = iir_filter->fres_target;
+        return;
+    }
+
+    if(iir_filter->fres_ramp_count == 0)
+    {
+        iir_filter->fres_incr = (iir_filter->fres_target - iir_filter->fres) / fres_ramp;
+        iir_filter->fres_ramp_count = fres_ramp;
+    }
+
+    if(iir_filter->fres_ramp_count > transition_samples)
+    {
+        iir_filter->fres += iir_filter->fres_incr * transition_samples;
+        iir_filter->fres_ramp_count -= transition_samples;
+    }
+    else
+    {
+        iir_filter->fres = iir_filter->fres_target;
+    }
+}
+
+/*
+ * Recalculates the filter coefficients once per block. fres_mod, the
+ * modulation by the envelope and the LFO, is followed within
+ * transition_samples. A change of the cutoff itself, e.g. by a MIDI CC,
+ * glides over fres_ramp samples (see synth.parameter-ramp).
+ */
 void fluid_iir_filter_calc(fluid_iir_filter_t *iir_filter,
                            fluid_real_t output_rate,
-                           fluid_real_t fres_mod)
+                           fluid_real_t fres_mod,
+                           int transition_samples,
+                           int fres_ramp)
 {
     fluid_real_t fres;
 
+    if(iir_filter->fres != iir_filter->fres_target)
+    {
+        fluid_iir_filter_ramp_fres(iir_filter, transition_samples, fres_ramp);
+    }
+
     /* calculate the frequency of the resonant filter in Hz */
     fres = fluid_ct2hz(iir_filter->fres + fres_mod);
 
@@ -408,7 +647,7 @@ void fluid_iir_filter_calc(fluid_iir_filter_t *iir_filter,
          * case, the filter is set directly, instead of smoothly fading
          * between old and new settings. */
         iir_filter->last_fres = fres;
-        fluid_iir_filter_calculate_coefficients(iir_filter, FLUID_BUFSIZE,
+        fluid_iir_filter_calculate_coefficients(iir_filter, transition_samples,
                                                 output_rate);
     }
 
@@ -25,6 +25,9 @@
 
 typedef struct _fluid_iir_filter_t fluid_iir_filter_t;
 
+/* Number of filters fluid_iir_filter_apply_batch() runs in lockstep */
+#define FLUID_IIR_FILTER_BATCH 4
+
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_iir_filter_init);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_iir_filter_set_fres);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_iir_filter_set_q);
@@ -32,11 +35,16 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_iir_filter_set_q);
 void fluid_iir_filter_apply(fluid_iir_filter_t *iir_filter,
                             fluid_real_t *dsp_buf, int dsp_buf_count);
 
+void fluid_iir_filter_apply_batch(fluid_iir_filter_t **iir_filters,
+                                  fluid_real_t **dsp_bufs, int count, int dsp_buf_count);
+
 void fluid_iir_filter_reset(fluid_iir_filter_t *iir_filter);
 
 void fluid_iir_filter_calc(fluid_iir_filter_t *iir_filter,
                            fluid_real_t output_rate,
-                           fluid_real_t fres_mod);
+                           fluid_real_t fres_mod,
+                           int transition_samples,
+                           int fres_ramp);
 
 /* We can't do information hiding here, as fluid_voice_t includes the struct
    without a pointer. */
@@ -64,6 +72,9 @@ struct _fluid_iir_filter_t
 					   Else it changes smoothly. */
 
     fluid_real_t fres;              /* the resonance frequency, in cents (not absolute cents) */
+    fluid_real_t fres_target;       /* fres at the end of a ramp started by fluid_iir_filter_set_fres() */
+    fluid_real_t fres_incr;         /* fres increment for each sample of the ramp */
+    int fres_ramp_count;            /* samples left until fres_target is reached, 0 if the ramp has to be set up */
     fluid_real_t last_fres;         /* Current resonance frequency of the IIR filter */
     /* Serves as a flag: A deviation between fres and last_fres */
     /* indicates, that the filter has to be recalculated. */
@@ -36,9 +36,13 @@
  */
 #define DC_OFFSET 1e-8
 
+/* Attenuation after which the reverb tail is considered to have died away (-120 dB) */
+#define TAIL_ATTENUATION 1e-6
+
 typedef struct _fluid_allpass fluid_allpass;
 typedef struct _fluid_comb fluid_comb;
 
+/* A delay line within the arena of the reverb, see fluid_set_revmodel_buffers() */
 struct _fluid_allpass
 {
     fluid_real_t feedback;
@@ -47,145 +51,15 @@ struct _fluid_allpass
     int bufidx;
 };
 
-void fluid_allpass_init(fluid_allpass *allpass);
-void fluid_allpass_setfeedback(fluid_allpass *allpass, fluid_real_t val);
-fluid_real_t fluid_allpass_getfeedback(fluid_allpass *allpass);
-
-void
-fluid_allpass_setbuffer(fluid_allpass *allpass, int size)
-{
-    allpass->bufidx = 0;
-    allpass->buffer = FLUID_ARRAY(fluid_real_t, size);
-    allpass->bufsize = size;
-}
-
-void
-fluid_allpass_release(fluid_allpass *allpass)
-{
-    FLUID_FREE(allpass->buffer);
-}
-
-void
-fluid_allpass_init(fluid_allpass *allpass)
-{
-    int i;
-    int len = allpass->bufsize;
-    fluid_real_t *buf = allpass->buffer;
-
-    for(i = 0; i < len; i++)
-    {
-        buf[i] = DC_OFFSET; /* this is not 100 % correct. */
-    }
-}
-
-void
-fluid_allpass_setfeedback(fluid_allpass *allpass, fluid_real_t val)
-{
-    allpass->feedback = val;
-}
-
-fluid_real_t
-fluid_allpass_getfeedback(fluid_allpass *allpass)
-{
-    return allpass->feedback;
-}
-
-#define fluid_allpass_process(_allpass, _input) \
-{ \
-  fluid_real_t output; \
-  fluid_real_t bufout; \
-  bufout = _allpass.buffer[_allpass.bufidx]; \
-  output = bufout-_input; \
-  _allpass.buffer[_allpass.bufidx] = _input + (bufout * _allpass.feedback); \
-  if (++_allpass.bufidx >= _allpass.bufsize) { \
-    _allpass.bufidx = 0; \
-  } \
-  _input = output; \
-}
-
+/* The damping and feedback values are the same for all combs, they are
+ * stored in fluid_revmodel_t, as well as the filter state of each comb. */
 struct _fluid_comb
 {
-    fluid_real_t feedback;
-    fluid_real_t filterstore;
-    fluid_real_t damp1;
-    fluid_real_t damp2;
     fluid_real_t *buffer;
     int bufsize;
     int bufidx;
 };
 
-void fluid_comb_setbuffer(fluid_comb *comb, int size);
-void fluid_comb_release(fluid_comb *comb);
-void fluid_comb_init(fluid_comb *comb);
-void fluid_comb_setdamp(fluid_comb *comb, fluid_real_t val);
-fluid_real_t fluid_comb_getdamp(fluid_comb *comb);
-void fluid_comb_setfeedback(fluid_comb *comb, fluid_real_t val);
-fluid_real_t fluid_comb_getfeedback(fluid_comb *comb);
-
-void
-fluid_comb_setbuffer(fluid_comb *comb, int size)
-{
-    comb->filterstore = 0;
-    comb->bufidx = 0;
-    comb->buffer = FLUID_ARRAY(fluid_real_t, size);
-    comb->bufsize = size;
-}
-
-void
-fluid_comb_release(fluid_comb *comb)
-{
-    FLUID_FREE(comb->buffer);
-}
-
-void
-fluid_comb_init(fluid_comb *comb)
-{
-    int i;
-    fluid_real_t *buf = comb->buffer;
-    int len = comb->bufsize;
-
-    for(i = 0; i < len; i++)
-    {
-        buf[i] = DC_OFFSET; /* This is not 100 % correct. */
-    }
-}
-
-void
-fluid_comb_setdamp(fluid_comb *comb, fluid_real_t val)
-{
-    comb->damp1 = val;
-    comb->damp2 = 1 - val;
-}
-
-fluid_real_t
-fluid_comb_getdamp(fluid_comb *comb)
-{
-    return comb->damp1;
-}
-
-void
-fluid_comb_setfeedback(fluid_comb *comb, fluid_real_t val)
-{
-    comb->feedback = val;
-}
-
-fluid_real_t
-fluid_comb_getfeedback(fluid_comb *comb)
-{
-    return comb->feedback;
-}
-
-#define fluid_comb_process(_comb, _input, _output) \
-{ \
-  fluid_real_t _tmp = _comb.buffer[_comb.bufidx]; \
-  _comb.filterstore = (_tmp * _comb.damp2) + (_comb.filterstore * _comb.damp1); \
-  _comb.buffer[_comb.bufidx] = _input + (_comb.filterstore * _comb.feedback); \
-  if (++_comb.bufidx >= _comb.bufsize) { \
-    _comb.bufidx = 0; \
-  } \
-  _output += _tmp; \
-}
-
 #define numcombs 8
 #define numallpasses 4
 #define	fixedgain 0.015f
@@ -234,6 +108,28 @@ fluid_comb_getfeedback(fluid_comb *comb)
 #define allpasstuningL4 225
 #define allpasstuningR4 (225 + stereospread)
 
+/* The combs of both channels run side by side in SIMD lanes: the left combs
+ * in lanes 0 .. numcombs-1, the right ones in lanes numcombs .. numlanes-1 */
+#define numlanes (2 * numcombs)
+
+static const int combtuning[numlanes] =
+{
+    combtuningL1, combtuningL2, combtuningL3, combtuningL4,
+    combtuningL5, combtuningL6, combtuningL7, combtuningL8,
+    combtuningR1, combtuningR2, combtuningR3, combtuningR4,
+    combtuningR5, combtuningR6, combtuningR7, combtuningR8
+};
+
+static const int allpasstuningL[numallpasses] =
+{
+    allpasstuningL1, allpasstuningL2, allpasstuningL3, allpasstuningL4
+};
+
+static const int allpasstuningR[numallpasses] =
+{
+    allpasstuningR1, allpasstuningR2, allpasstuningR3, allpasstuningR4
+};
+
 struct _fluid_revmodel_t
 {
     fluid_real_t roomsize;
@@ -241,14 +137,19 @@ struct _fluid_revmodel_t
     fluid_real_t level, wet1, wet2;
     fluid_real_t width;
     fluid_real_t gain;
-    /*
-     The following are all declared inline
-     to remove the need for dynamic allocation
-     with its subsequent error-checking messiness
-    */
+
+    /* One allocation holding the delay lines of all comb and allpass filters */
+    fluid_real_t *arena;
+    int arena_size;
+    /* Number of samples processed at once, never more than the shortest delay line */
+    int chunk;
+
     /* Comb filters */
-    fluid_comb combL[numcombs];
-    fluid_comb combR[numcombs];
+    fluid_comb comb[numlanes];
+    fluid_real_t comb_filterstore[numlanes];
+    fluid_real_t comb_feedback;
+    fluid_real_t comb_damp1;
+    fluid_real_t comb_damp2;
     /* Allpass filters */
     fluid_allpass allpassL[numallpasses];
     fluid_allpass allpassR[numallpasses];
@@ -256,12 +157,14 @@ struct _fluid_revmodel_t
 
 static void fluid_revmodel_update(fluid_revmodel_t *rev);
 static void fluid_revmodel_init(fluid_revmodel_t *rev);
-void fluid_set_revmodel_buffers(fluid_revmodel_t *rev, fluid_real_t sample_rate);
+static int fluid_set_revmodel_buffers(fluid_revmodel_t *rev, fluid_real_t sample_rate);
 
 fluid_revmodel_t *
 new_fluid_revmodel(fluid_real_t sample_rate)
 {
     fluid_revmodel_t *rev;
+    int i;
+
     rev = FLUID_NEW(fluid_revmodel_t);
 
     if(rev == NULL)
@@ -269,17 +172,20 @@ new_fluid_revmodel(fluid_real_t sample_rate)
         return NULL;
     }
 
-    fluid_set_revmodel_buffers(rev, sample_rate);
+    FLUID_MEMSET(rev, 0, sizeof(fluid_revmodel_t));
+
+    if(fluid_set_revmodel_buffers(rev, sample_rate) != FLUID_OK)
+    {
+        delete_fluid_revmodel(rev);
+        return NULL;
+    }
 
     /* Set default values */
-    fluid_allpass_setfeedback(&rev->allpassL[0], 0.5f);
-    fluid_allpass_setfeedback(&rev->allpassR[0], 0.5f);
-    fluid_allpass_setfeedback(&rev->allpassL[1], 0.5f);
-    fluid_allpass_setfeedback(&rev->allpassR[1], 0.5f);
-    fluid_allpass_setfeedback(&rev->allpassL[2], 0.5f);
-    fluid_allpass_setfeedback(&rev->allpassR[2], 0.5f);
-    fluid_allpass_setfeedback(&rev->allpassL[3], 0.5f);
-    fluid_allpass_setfeedback(&rev->allpassR[3], 0.5f);
+    for(i = 0; i < numallpasses; i++)
+    {
+        rev->allpassL[i].feedback = 0.5f;
+        rev->allpassR[i].feedback = 0.5f;
+    }
 
     rev->gain = fixedgain;
 
@@ -289,57 +195,84 @@ new_fluid_revmodel(fluid_real_t sample_rate)
 void
 delete_fluid_revmodel(fluid_revmodel_t *rev)
 {
-    int i;
     fluid_return_if_fail(rev != NULL);
 
-    for(i = 0; i < numcombs; i++)
-    {
-        fluid_comb_release(&rev->combL[i]);
-        fluid_comb_release(&rev->combR[i]);
-    }
+    FLUID_FREE(rev->arena);
+    FLUID_FREE(rev);
+}
 
-    for(i = 0; i < numallpasses; i++)
+/* Carve a delay line of the given size out of the arena */
+static fluid_real_t *
+fluid_revmodel_take_buffer(fluid_revmodel_t *rev, fluid_real_t **arena, int size)
+{
+    fluid_real_t *buffer = *arena;
+
+    *arena += size;
+
+    if(size < rev->chunk)
     {
-        fluid_allpass_release(&rev->allpassL[i]);
-        fluid_allpass_release(&rev->allpassR[i]);
+        rev->chunk = size;
     }
 
-    FLUID_FREE(rev);
+    return buffer;
 }
 
-void
+static int
 fluid_set_revmodel_buffers(fluid_revmodel_t *rev, fluid_real_t sample_rate)
 {
-
     float srfactor = sample_rate / 44100.0f;
+    int comb_size[numlanes], allpass_size_L[numallpasses], allpass_size_R[numallpasses];
+    int i, total = 0;
+    fluid_real_t *arena;
+
+    for(i = 0; i < numlanes; i++)
+    {
+        comb_size[i] = combtuning[i] * srfactor;
+        total += comb_size[i];
+    }
 
-    fluid_comb_setbuffer(&rev->combL[0], combtuningL1 * srfactor);
-    fluid_comb_setbuffer(&rev->combR[0], combtuningR1 * srfactor);
-    fluid_comb_setbuffer(&rev->combL[1], combtuningL2 * srfactor);
-    fluid_comb_setbuffer(&rev->combR[1], combtuningR2 * srfactor);
-    fluid_comb_setbuffer(&rev->combL[2], combtuningL3 * srfactor);
-    fluid_comb_setbuffer(&rev->combR[2], combtuningR3 * srfactor);
-    fluid_comb_setbuffer(&rev->combL[3], combtuningL4 * srfactor);
-    fluid_comb_setbuffer(&rev->combR[3], combtuningR4 * srfactor);
-    fluid_comb_setbuffer(&rev->combL[4], combtuningL5 * srfactor);
-    fluid_comb_setbuffer(&rev->combR[4], combtuningR5 * srfactor);
-    fluid_comb_setbuffer(&rev->combL[5], combtuningL6 * srfactor);
-    fluid_comb_setbuffer(&rev->combR[5], combtuningR6 * srfactor);
-    fluid_comb_setbuffer(&rev->combL[6], combtuningL7 * srfactor);
-    fluid_comb_setbuffer(&rev->combR[6], combtuningR7 * srfactor);
-    fluid_comb_setbuffer(&rev->combL[7], combtuningL8 * srfactor);
-    fluid_comb_setbuffer(&rev->combR[7], combtuningR8 * srfactor);
-    fluid_allpass_setbuffer(&rev->allpassL[0], allpasstuningL1 * srfactor);
-    fluid_allpass_setbuffer(&rev->allpassR[0], allpasstuningR1 * srfactor);
-    fluid_allpass_setbuffer(&rev->allpassL[1], allpasstuningL2 * srfactor);
-    fluid_allpass_setbuffer(&rev->allpassR[1], allpasstuningR2 * srfactor);
-    fluid_allpass_setbuffer(&rev->allpassL[2], allpasstuningL3 * srfactor);
-    fluid_allpass_setbuffer(&rev->allpassR[2], allpasstuningR3 * srfactor);
-    fluid_allpass_setbuffer(&rev->allpassL[3], allpasstuningL4 * srfactor);
-    fluid_allpass_setbuffer(&rev->allpassR[3], allpasstuningR4 * srfactor);
+    for(i = 0; i < numallpasses; i++)
+    {
+        allpass_size_L[i] = allpasstuningL[i] * srfactor;
+        allpass_size_R[i] = allpasstuningR[i] * srfactor;
+        total += allpass_size_L[i] + allpass_size_R[i];
+    }
+
+    arena = FLUID_ARRAY(fluid_real_t, total);
+
+    if(arena == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    FLUID_FREE(rev->arena);
+    rev->arena = arena;
+    rev->arena_size = total;
+    rev->chunk = FLUID_BUFSIZE;
+
+    for(i = 0; i < numlanes; i++)
+    {
+        rev->comb[i].buffer = fluid_revmodel_take_buffer(rev, &arena, comb_size[i]);
+        rev->comb[i].bufsize = comb_size[i];
+        rev->comb[i].bufidx = 0;
+    }
+
+    for(i = 0; i < numallpasses; i++)
+    {
+        rev->allpassL[i].buffer = fluid_revmodel_take_buffer(rev, &arena, allpass_size_L[i]);
+        rev->allpassL[i].bufsize = allpass_size_L[i];
+        rev->allpassL[i].bufidx = 0;
+
+        rev->allpassR[i].buffer = fluid_revmodel_take_buffer(rev, &arena, allpass_size_R[i]);
+        rev->allpassR[i].bufsize = allpass_size_R[i];
+        rev->allpassR[i].bufidx = 0;
+    }
 
     /* Clear all buffers */
     fluid_revmodel_init(rev);
+
+    return FLUID_OK;
 }
 
 
@@ -348,16 +281,14 @@ fluid_revmodel_init(fluid_revmodel_t *rev)
 {
     int i;
 
-    for(i = 0; i < numcombs; i++)
+    for(i = 0; i < rev->arena_size; i++)
     {
-        fluid_comb_init(&rev->combL[i]);
-        fluid_comb_init(&rev->combR[i]);
+        rev->arena[i] = DC_OFFSET; /* this is not 100 % correct. */
     }
 
-    for(i = 0; i < numallpasses; i++)
+    for(i = 0; i < numlanes; i++)
     {
-        fluid_allpass_init(&rev->allpassL[i]);
-        fluid_allpass_init(&rev->allpassR[i]);
+        rev->comb_filterstore[i] = 0;
     }
 }
 
@@ -367,95 +298,251 @@ fluid_revmodel_reset(fluid_revmodel_t *rev)
     fluid_revmodel_init(rev);
 }
 
-void
-fluid_revmodel_processreplace(fluid_revmodel_t *rev, fluid_real_t *in,
-                              fluid_real_t *left_out, fluid_real_t *right_out)
+/* Purpose:
+ * Move count samples between a delay line and the lane of a block, which
+ * interleaves the samples of numlanes delay lines. Starting at the current
+ * position, the delay line wraps around at its end.
+ */
+static FLUID_INLINE void
+fluid_comb_read(const fluid_comb *comb, fluid_real_t *FLUID_RESTRICT lanes, int count)
 {
-    int i, k = 0;
-    fluid_real_t outL, outR, input;
+    int i, n = comb->bufsize - comb->bufidx;
+    const fluid_real_t *FLUID_RESTRICT buf = &comb->buffer[comb->bufidx];
 
-    for(k = 0; k < FLUID_BUFSIZE; k++)
+    if(n > count)
     {
+        n = count;
+    }
 
-        outL = outR = 0;
+    for(i = 0; i < n; i++)
+    {
+        lanes[i * numlanes] = buf[i];
+    }
 
-        /* The original Freeverb code expects a stereo signal and 'input'
-         * is set to the sum of the left and right input sample. Since
-         * this code works on a mono signal, 'input' is set to twice the
-         * input sample. */
-        input = (2.0f * in[k] + DC_OFFSET) * rev->gain;
+    for(; i < count; i++)
+    {
+        lanes[i * numlanes] = comb->buffer[i - n];
+    }
+}
 
-        /* Accumulate comb filters in parallel */
-        for(i = 0; i < numcombs; i++)
-        {
-            fluid_comb_process(rev->combL[i], input, outL);
-            fluid_comb_process(rev->combR[i], input, outR);
-        }
+static FLUID_INLINE void
+fluid_comb_write(fluid_comb *comb, const fluid_real_t *FLUID_RESTRICT lanes, int count)
+{
+    int i, n = comb->bufsize - comb->bufidx;
+    fluid_real_t *FLUID_RESTRICT buf = &comb->buffer[comb->bufidx];
 
-        /* Feed through allpasses in series */
-        for(i = 0; i < numallpasses; i++)
-        {
-            fluid_allpass_process(rev->allpassL[i], outL);
-            fluid_allpass_process(rev->allpassR[i], outR);
-        }
+    if(n > count)
+    {
+        n = count;
+    }
 
-        /* Remove the DC offset */
-        outL -= DC_OFFSET;
-        outR -= DC_OFFSET;
+    for(i = 0; i < n; i++)
+    {
+        buf[i] = lanes[i * numlanes];
+    }
 
-        /* Calculate output REPLACING anything already there */
-        left_out[k] = outL * rev->wet1 + outR * rev->wet2;
-        right_out[k] = outR * rev->wet1 + outL * rev->wet2;
+    for(; i < count; i++)
+    {
+        comb->buffer[i - n] = lanes[i * numlanes];
+    }
+
+    comb->bufidx += count;
+
+    if(comb->bufidx >= comb->bufsize)
+    {
+        comb->bufidx -= comb->bufsize;
     }
 }
 
-void
-fluid_revmodel_processmix(fluid_revmodel_t *rev, fluid_real_t *in,
-                          fluid_real_t *left_out, fluid_real_t *right_out)
+/* Purpose:
+ * Runs an allpass over count samples, in place. As count never exceeds the
+ * delay, no sample written here is read again within the same run, so there
+ * is no loop carried dependency and the loop can be vectorized.
+ */
+static FLUID_INLINE void
+fluid_allpass_process_run(fluid_allpass *allpass, fluid_real_t *FLUID_RESTRICT io, int count)
 {
-    int i, k = 0;
-    fluid_real_t outL, outR, input;
+    fluid_real_t feedback = allpass->feedback;
+    fluid_real_t *FLUID_RESTRICT buf = &allpass->buffer[allpass->bufidx];
+    int i, n = allpass->bufsize - allpass->bufidx;
+
+    if(n > count)
+    {
+        n = count;
+    }
 
-    for(k = 0; k < FLUID_BUFSIZE; k++)
+    #pragma omp simd
+
+    for(i = 0; i < n; i++)
     {
+        fluid_real_t bufout = buf[i];
+        fluid_real_t output = bufout - io[i];
+        buf[i] = io[i] + (bufout * feedback);
+        io[i] = output;
+    }
 
-        outL = outR = 0;
+    buf = allpass->buffer;
+    io += n;
+    count -= n;
+
+    #pragma omp simd
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_real_t bufout = buf[i];
+        fluid_real_t output = bufout - io[i];
+        buf[i] = io[i] + (bufout * feedback);
+        io[i] = output;
+    }
+
+    allpass->bufidx += n + count;
+
+    if(allpass->bufidx >= allpass->bufsize)
+    {
+        allpass->bufidx -= allpass->bufsize;
+    }
+}
+
+/* Purpose:
+ * Runs the reverb over count samples, at most rev->chunk of them.
+ *
+ * Within such a run no comb reads a sample it has written itself, so the
+ * samples leaving the delay lines are fetched upfront, interleaved by comb.
+ * That leaves only the damping lowpass recursive in time, which is computed
+ * for all combs side by side. The arithmetic (and the order of summation)
+ * is the same as in the original Freeverb, sample by sample.
+ */
+static FLUID_INLINE void
+fluid_revmodel_process_chunk(fluid_revmodel_t *rev, const fluid_real_t *in,
+                             fluid_real_t *left_out, fluid_real_t *right_out,
+                             int count, int mix)
+{
+    fluid_real_t lanes[FLUID_BUFSIZE * numlanes];
+    fluid_real_t input[FLUID_BUFSIZE], outL[FLUID_BUFSIZE], outR[FLUID_BUFSIZE];
+    fluid_real_t filterstore[numlanes];
+    fluid_real_t damp1 = rev->comb_damp1, damp2 = rev->comb_damp2, feedback = rev->comb_feedback;
+    int i, k;
 
+    for(k = 0; k < count; k++)
+    {
         /* The original Freeverb code expects a stereo signal and 'input'
          * is set to the sum of the left and right input sample. Since
          * this code works on a mono signal, 'input' is set to twice the
          * input sample. */
-        input = (2.0f * in[k] + DC_OFFSET) * rev->gain;
+        input[k] = (2.0f * in[k] + DC_OFFSET) * rev->gain;
+    }
+
+    for(i = 0; i < numlanes; i++)
+    {
+        fluid_comb_read(&rev->comb[i], &lanes[i], count);
+        filterstore[i] = rev->comb_filterstore[i];
+    }
+
+    /* Accumulate comb filters in parallel */
+    #pragma omp simd
+
+    for(k = 0; k < count; k++)
+    {
+        const fluid_real_t *frame = &lanes[k * numlanes];
+        fluid_real_t sumL = 0, sumR = 0;
 
-        /* Accumulate comb filters in parallel */
         for(i = 0; i < numcombs; i++)
         {
-            fluid_comb_process(rev->combL[i], input, outL);
-            fluid_comb_process(rev->combR[i], input, outR);
+            sumL += frame[i];
+            sumR += frame[numcombs + i];
         }
 
-        /* Feed through allpasses in series */
-        for(i = 0; i < numallpasses; i++)
+        outL[k] = sumL;
+        outR[k] = sumR;
+    }
+
+    for(k = 0; k < count; k++)
+    {
+        fluid_real_t *frame = &lanes[k * numlanes];
+
+        #pragma omp simd
+
+        for(i = 0; i < numlanes; i++)
         {
-            fluid_allpass_process(rev->allpassL[i], outL);
-            fluid_allpass_process(rev->allpassR[i], outR);
+            filterstore[i] = (frame[i] * damp2) + (filterstore[i] * damp1);
+            frame[i] = input[k] + (filterstore[i] * feedback);
         }
+    }
+
+    for(i = 0; i < numlanes; i++)
+    {
+        fluid_comb_write(&rev->comb[i], &lanes[i], count);
+        rev->comb_filterstore[i] = filterstore[i];
+    }
+
+    /* Feed through allpasses in series */
+    for(i = 0; i < numallpasses; i++)
+    {
+        fluid_allpass_process_run(&rev->allpassL[i], outL, count);
+        fluid_allpass_process_run(&rev->allpassR[i], outR, count);
+    }
 
+    #pragma omp simd
+
+    for(k = 0; k < count; k++)
+    {
         /* Remove the DC offset */
-        outL -= DC_OFFSET;
-        outR -= DC_OFFSET;
+        fluid_real_t l = outL[k] - DC_OFFSET;
+        fluid_real_t r = outR[k] - DC_OFFSET;
+
+        if(mix)
+        {
+            /* Calculate output MIXING with anything already there */
+            left_out[k] += l * rev->wet1 + r * rev->wet2;
+            right_out[k] += r * rev->wet1 + l * rev->wet2;
+        }
+        else
+        {
+            /* Calculate output REPLACING anything already there */
+            left_out[k] = l * rev->wet1 + r * rev->wet2;
+            right_out[k] = r * rev->wet1 + l * rev->wet2;
+        }
+    }
+}
+
+static FLUID_INLINE void
+fluid_revmodel_process(fluid_revmodel_t *rev, const fluid_real_t *in,
+                       fluid_real_t *left_out, fluid_real_t *right_out,
+                       int count, int mix)
+{
+    int k, n;
 
-        /* Calculate output MIXING with anything already there */
-        left_out[k] += outL * rev->wet1 + outR * rev->wet2;
-        right_out[k] += outR * rev->wet1 + outL * rev->wet2;
+    for(k = 0; k < count; k += n)
+    {
+        n = count - k;
+
+        if(n > rev->chunk)
+        {
+            n = rev->chunk;
+        }
+
+        fluid_revmodel_process_chunk(rev, &in[k], &left_out[k], &right_out[k], n, mix);
     }
 }
 
+void
+fluid_revmodel_processreplace(fluid_revmodel_t *rev, fluid_real_t *in,
+                              fluid_real_t *left_out, fluid_real_t *right_out, int count)
+{
+    fluid_revmodel_process(rev, in, left_out, right_out, count, FALSE);
+}
+
+void
+fluid_revmodel_processmix(fluid_revmodel_t *rev, fluid_real_t *in,
+                          fluid_real_t *left_out, fluid_real_t *right_out, int count)
+{
+    fluid_revmodel_process(rev, in, left_out, right_out, count, TRUE);
+}
+
 static void
 fluid_revmodel_update(fluid_revmodel_t *rev)
 {
     /* Recalculate internal values after parameter change */
-    int i;
 
     /* The stereo amplitude equation (wet1 and wet2 below) have a
     tendency to produce high amplitude with high width values ( 1 < width < 100).
@@ -472,17 +559,9 @@ fluid_revmodel_update(fluid_revmodel_t *rev)
     rev->wet1 = wet * (rev->width / 2.0f + 0.5f);
     rev->wet2 = wet * ((1.0f - rev->width) / 2.0f);
 
-    for(i = 0; i < numcombs; i++)
-    {
-        fluid_comb_setfeedback(&rev->combL[i], rev->roomsize);
-        fluid_comb_setfeedback(&rev->combR[i], rev->roomsize);
-    }
-
-    for(i = 0; i < numcombs; i++)
-    {
-        fluid_comb_setdamp(&rev->combL[i], rev->damp);
-        fluid_comb_setdamp(&rev->combR[i], rev->damp);
-    }
+    rev->comb_feedback = rev->roomsize;
+    rev->comb_damp1 = rev->damp;
+    rev->comb_damp2 = 1 - rev->damp;
 }
 
 /**
@@ -530,19 +609,53 @@ fluid_revmodel_set(fluid_revmodel_t *rev, int set, fluid_real_t roomsize,
 void
 fluid_revmodel_samplerate_change(fluid_revmodel_t *rev, fluid_real_t sample_rate)
 {
-    int i;
+    /* keeps the buffers of the previous sample rate if out of memory */
+    fluid_set_revmodel_buffers(rev, sample_rate);
+}
+
+/* Calculate the number of round trips through a delay line with the given
+ * loop gain until a signal has decayed by TAIL_ATTENUATION */
+static int
+fluid_revmodel_decay_trips(fluid_real_t feedback)
+{
+    fluid_real_t trips;
 
-    for(i = 0; i < numcombs; i++)
+    if(feedback <= 0.0f)
     {
-        fluid_comb_release(&rev->combL[i]);
-        fluid_comb_release(&rev->combR[i]);
+        return 1;
+    }
+
+    trips = log(TAIL_ATTENUATION) / log(feedback);
+
+    return (int)trips + 1;
+}
+
+/**
+ * Get the length of the reverb tail, i.e. the number of samples after which
+ * the output has died away once the input has become silent.
+ * @param rev Reverb instance
+ * @return Length of the tail in samples
+ */
+int
+fluid_revmodel_get_tail(fluid_revmodel_t *rev)
+{
+    int i, comb_size = 0, allpass_size = 0;
+
+    /* The combs run in parallel, at DC and with damping their loop gain is
+     * the feedback. The allpasses follow each other. */
+    for(i = 0; i < numlanes; i++)
+    {
+        if(rev->comb[i].bufsize > comb_size)
+        {
+            comb_size = rev->comb[i].bufsize;
+        }
     }
 
     for(i = 0; i < numallpasses; i++)
     {
-        fluid_allpass_release(&rev->allpassL[i]);
-        fluid_allpass_release(&rev->allpassR[i]);
+        allpass_size += rev->allpassR[i].bufsize;
     }
 
-    fluid_set_revmodel_buffers(rev, sample_rate);
+    return comb_size * fluid_revmodel_decay_trips(rev->comb_feedback)
+           + allpass_size * fluid_revmodel_decay_trips(rev->allpassR[0].feedback);
 }
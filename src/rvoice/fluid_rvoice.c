@@ -19,12 +19,54 @@
  */
 
 #include "fluid_rvoice.h"
+#include "fluid_sample_streamer.h"
 #include "fluid_conv.h"
 #include "fluid_sys.h"
 
 
 static void fluid_rvoice_noteoff_LOCAL(fluid_rvoice_t *voice, unsigned int min_ticks);
 
+/**
+ * Allocates \c count zeroed rvoices in one piece, each aligned to a cache line.
+ * @return The arena, or NULL when out of memory
+ */
+fluid_rvoice_arena_t *
+new_fluid_rvoice_arena(int count)
+{
+    fluid_rvoice_arena_t *arena = FLUID_NEW(fluid_rvoice_arena_t);
+
+    if(arena == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    arena->count = count;
+    arena->stride = (sizeof(fluid_rvoice_t) + FLUID_DEFAULT_ALIGNMENT - 1) & ~(size_t)(FLUID_DEFAULT_ALIGNMENT - 1);
+    arena->mem = FLUID_MALLOC(count * arena->stride + FLUID_DEFAULT_ALIGNMENT - 1);
+
+    if(arena->mem == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(arena);
+        return NULL;
+    }
+
+    arena->rvoices = fluid_align_ptr(arena->mem, FLUID_DEFAULT_ALIGNMENT);
+    FLUID_MEMSET(arena->rvoices, 0, count * arena->stride);
+
+    return arena;
+}
+
+void
+delete_fluid_rvoice_arena(fluid_rvoice_arena_t *arena)
+{
+    fluid_return_if_fail(arena != NULL);
+
+    FLUID_FREE(arena->mem);
+    FLUID_FREE(arena);
+}
+
 /**
  * @return -1 if voice has finished, 0 if it's currently quiet, 1 otherwise
  */
@@ -95,8 +137,8 @@ fluid_rvoice_calc_amp(fluid_rvoice_t *voice)
         }
     }
 
-    /* Volume increment to go from voice->amp to target_amp in FLUID_BUFSIZE steps */
-    voice->dsp.amp_incr = (target_amp - voice->dsp.amp) / FLUID_BUFSIZE;
+    /* Volume increment to go from voice->amp to target_amp in block_size steps */
+    voice->dsp.amp_incr = (target_amp - voice->dsp.amp) / voice->dsp.block_size;
 
     fluid_check_fpe("voice_write amplitude calculation");
 
@@ -289,16 +331,130 @@ fluid_rvoice_check_sample_sanity(fluid_rvoice_t *voice)
 }
 
 
+static int
+fluid_rvoice_interpolate(fluid_rvoice_dsp_t *dsp, fluid_real_t *dsp_buf, int is_looping)
+{
+    switch(dsp->interp_method)
+    {
+    case FLUID_INTERP_NONE:
+        return fluid_rvoice_dsp_interpolate_none(dsp, dsp_buf, is_looping);
+
+    case FLUID_INTERP_LINEAR:
+        return fluid_rvoice_dsp_interpolate_linear(dsp, dsp_buf, is_looping);
+
+    case FLUID_INTERP_4THORDER:
+    default:
+        return fluid_rvoice_dsp_interpolate_4th_order(dsp, dsp_buf, is_looping);
+
+    case FLUID_INTERP_7THORDER:
+        return fluid_rvoice_dsp_interpolate_7th_order(dsp, dsp_buf, is_looping);
+    }
+}
+
+/*
+ * Synthesize the next block of a voice playing a streamed sample, see
+ * fluid_sample_streamer.c. The block is interpolated from the part of the
+ * sample in memory which holds all the sample points it reads, with the
+ * indices of the voice made relative to that part. If there is none, the
+ * block is silent and an underrun is counted, the voice moves on nonetheless.
+ */
+static int
+fluid_rvoice_write_streamed(fluid_rvoice_t *voice, fluid_real_t *dsp_buf, int is_looping)
+{
+    fluid_rvoice_dsp_t *dsp = &voice->dsp;
+    fluid_sample_t *sample = dsp->sample;
+    fluid_sample_t part;
+    fluid_phase_t offset;
+    unsigned int part_start, part_end;
+    int start = dsp->start, end = dsp->end;
+    int loopstart = dsp->loopstart, loopend = dsp->loopend;
+    int has_looped = dsp->has_looped;
+    int count;
+
+    if(!fluid_sample_stream_get_data(dsp, is_looping, &part.data, &part.data24, &part_start, &part_end))
+    {
+        unsigned int frames = dsp->block_size - dsp->start_delay;
+        fluid_phase_t phase_incr;
+
+        if(!dsp->stream_dry)
+        {
+            dsp->stream_underruns++;
+            dsp->stream_dry = TRUE;
+        }
+
+        FLUID_MEMSET(&dsp_buf[dsp->start_delay], 0, frames * sizeof(fluid_real_t));
+
+        fluid_phase_set_float(phase_incr, dsp->phase_incr);
+        fluid_phase_incr(dsp->phase, phase_incr * frames);
+        dsp->amp += frames * dsp->amp_incr;
+
+        if(is_looping)
+        {
+            while(fluid_phase_index(dsp->phase) >= (unsigned int)dsp->loopend)
+            {
+                fluid_phase_sub_int(dsp->phase, dsp->loopend - dsp->loopstart);
+                dsp->has_looped = 1;
+            }
+        }
+        else if(fluid_phase_index(dsp->phase) > (unsigned int)dsp->end)
+        {
+            return 0;
+        }
+
+        return dsp->block_size;
+    }
+
+    dsp->stream_dry = FALSE;
+
+    fluid_phase_set_int(offset, part_start);
+    fluid_phase_decr(dsp->phase, offset);
+    dsp->sample = &part;
+
+    /* The start and end points are read up front, but only used within reach
+     * of the block. Out of reach, any point of the part does. */
+    dsp->start = ((unsigned int)start >= part_start && (unsigned int)start < part_end) ? start - part_start : 0;
+    dsp->end = ((unsigned int)end < part_end) ? end - part_start : part_end - part_start - 1;
+
+    if(is_looping || (has_looped && (unsigned int)loopstart >= part_start && (unsigned int)loopend <= part_end))
+    {
+        dsp->loopstart = loopstart - part_start;
+        dsp->loopend = loopend - part_start;
+    }
+    else
+    {
+        /* only matters right at the loop start, which is out of reach */
+        dsp->has_looped = 0;
+    }
+
+    count = fluid_rvoice_interpolate(dsp, dsp_buf, is_looping);
+
+    fluid_phase_incr(dsp->phase, offset);
+    dsp->sample = sample;
+    dsp->start = start;
+    dsp->end = end;
+    dsp->loopstart = loopstart;
+    dsp->loopend = loopend;
+
+    if(!is_looping)
+    {
+        dsp->has_looped = has_looped;
+    }
+
+    return count;
+}
+
 /**
  * Synthesize a voice to a buffer.
  *
  * @param voice rvoice to synthesize
- * @param dsp_buf Audio buffer to synthesize to (#FLUID_BUFSIZE in length)
+ * @param dsp_buf Audio buffer to synthesize to (block_size in length)
  * @return Count of samples written to dsp_buf. (-1 means voice is currently
- * quiet, 0 .. #FLUID_BUFSIZE-1 means voice finished.)
+ * quiet, 0 .. block_size-1 means voice finished.)
  *
- * Panning, reverb and chorus are processed separately. The dsp interpolation
- * routine is in (fluid_rvoice_dsp.c).
+ * The samples are not filtered yet, the caller has to pass a positive count
+ * on to fluid_rvoice_filter() or fluid_rvoice_filter_batch() before writing
+ * the next block. Panning, reverb and chorus are processed separately. The
+ * dsp interpolation routine is in (fluid_rvoice_dsp.c).
  */
 int
 fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
@@ -326,7 +482,8 @@ fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
         fluid_rvoice_noteoff_LOCAL(voice, 0);
     }
 
-    voice->envlfo.ticks += FLUID_BUFSIZE;
+    /* a voice setting in within the block only counts the samples it plays */
+    voice->envlfo.ticks += voice->dsp.block_size - voice->dsp.start_delay;
 
     /******************* vol env **********************/
 
@@ -356,6 +513,7 @@ fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
 
     if(count <= 0)
     {
+        voice->dsp.start_delay = 0;
         return count;
     }
 
@@ -420,50 +578,97 @@ fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
 
     /*********************** run the dsp chain ************************
      * The sample is mixed with the output buffer.
-     * The buffer has to be filled from 0 to FLUID_BUFSIZE-1.
+     * The buffer has to be filled from 0 to block_size-1.
      * Depending on the position in the loop and the loop size, this
-     * may require several runs. */
+     * may require several runs. A voice which sets in within the block
+     * is silent up to its start_delay, the interpolation starts there. */
 
-    switch(voice->dsp.interp_method)
+    if(voice->dsp.start_delay > 0)
     {
-    case FLUID_INTERP_NONE:
-        count = fluid_rvoice_dsp_interpolate_none(&voice->dsp, dsp_buf, is_looping);
-        break;
-
-    case FLUID_INTERP_LINEAR:
-        count = fluid_rvoice_dsp_interpolate_linear(&voice->dsp, dsp_buf, is_looping);
-        break;
-
-    case FLUID_INTERP_4THORDER:
-    default:
-        count = fluid_rvoice_dsp_interpolate_4th_order(&voice->dsp, dsp_buf, is_looping);
-        break;
+        FLUID_MEMSET(dsp_buf, 0, voice->dsp.start_delay * sizeof(fluid_real_t));
+    }
 
-    case FLUID_INTERP_7THORDER:
-        count = fluid_rvoice_dsp_interpolate_7th_order(&voice->dsp, dsp_buf, is_looping);
-        break;
+    if(voice->dsp.sample->preload != 0)
+    {
+        count = fluid_rvoice_write_streamed(voice, dsp_buf, is_looping);
+    }
+    else
+    {
+        count = fluid_rvoice_interpolate(&voice->dsp, dsp_buf, is_looping);
     }
 
     fluid_check_fpe("voice_write interpolation");
 
-    if(count == 0)
-    {
-        return count;
-    }
+    voice->dsp.start_delay = 0;
 
-    /*************** resonant filter ******************/
+    return count;
+}
 
+static FLUID_INLINE void
+fluid_rvoice_calc_resonant_filter(fluid_rvoice_t *voice)
+{
     fluid_iir_filter_calc(&voice->resonant_filter, voice->dsp.output_rate,
                           fluid_lfo_get_val(&voice->envlfo.modlfo) * voice->envlfo.modlfo_to_fc +
-                          fluid_adsr_env_get_val(&voice->envlfo.modenv) * voice->envlfo.modenv_to_fc);
+                          fluid_adsr_env_get_val(&voice->envlfo.modenv) * voice->envlfo.modenv_to_fc,
+                          voice->dsp.block_size, voice->buffers.ramp_length);
+}
+
+static FLUID_INLINE void
+fluid_rvoice_custom_filter(fluid_rvoice_t *voice, fluid_real_t *dsp_buf, int count)
+{
+    /* additional custom filter - only uses the fixed modulator, no lfos...
+     * Usually it is disabled, which saves the cutoff calculation as well. */
+    if(voice->resonant_custom_filter.type != FLUID_IIR_DISABLED)
+    {
+        fluid_iir_filter_calc(&voice->resonant_custom_filter, voice->dsp.output_rate, 0,
+                              voice->dsp.block_size, voice->buffers.ramp_length);
+        fluid_iir_filter_apply(&voice->resonant_custom_filter, dsp_buf, count);
+    }
+}
 
+/**
+ * Filter the block of samples just synthesized by fluid_rvoice_write().
+ *
+ * @param voice rvoice the samples belong to
+ * @param dsp_buf Audio buffer passed to fluid_rvoice_write()
+ * @param count Count of samples returned by fluid_rvoice_write(), must be positive
+ */
+void
+fluid_rvoice_filter(fluid_rvoice_t *voice, fluid_real_t *dsp_buf, int count)
+{
+    fluid_rvoice_calc_resonant_filter(voice);
     fluid_iir_filter_apply(&voice->resonant_filter, dsp_buf, count);
 
-    /* additional custom filter - only uses the fixed modulator, no lfos... */
-    fluid_iir_filter_calc(&voice->resonant_custom_filter, voice->dsp.output_rate, 0);
-    fluid_iir_filter_apply(&voice->resonant_custom_filter, dsp_buf, count);
+    fluid_rvoice_custom_filter(voice, dsp_buf, count);
+}
 
-    return count;
+/**
+ * Same as fluid_rvoice_filter() for several voices, each of which has
+ * synthesized a full block of block_size samples. The resonant filters
+ * of up to #FLUID_IIR_FILTER_BATCH voices are processed side by side.
+ *
+ * @param voices Array of \c count rvoices
+ * @param dsp_bufs Array of \c count audio buffers, one for each voice
+ * @param count Number of voices, at most #FLUID_IIR_FILTER_BATCH
+ */
+void
+fluid_rvoice_filter_batch(fluid_rvoice_t **voices, fluid_real_t **dsp_bufs, int count)
+{
+    fluid_iir_filter_t *filters[FLUID_IIR_FILTER_BATCH];
+    int i;
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_rvoice_calc_resonant_filter(voices[i]);
+        filters[i] = &voices[i]->resonant_filter;
+    }
+
+    fluid_iir_filter_apply_batch(filters, dsp_bufs, count, voices[0]->dsp.block_size);
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_rvoice_custom_filter(voices[i], dsp_bufs[i], voices[i]->dsp.block_size);
+    }
 }
 
 /**
@@ -487,6 +692,7 @@ fluid_rvoice_buffers_check_bufnum(fluid_rvoice_buffers_t *buffers, unsigned int
     for(i = buffers->count; i <= bufnum; i++)
     {
         buffers->bufs[i].amp = 0.0f;
+        buffers->bufs[i].ramp_count = 0;
     }
 
     buffers->count = bufnum + 1;
@@ -505,7 +711,17 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_amp)
         return;
     }
 
-    buffers->bufs[bufnum].amp = value;
+    if(buffers->ramp_length == 0 || buffers->ramp_startup || value == buffers->bufs[bufnum].amp)
+    {
+        buffers->bufs[bufnum].amp = value;
+        buffers->bufs[bufnum].ramp_count = 0;
+        return;
+    }
+
+    /* the mixer ramps to the new value, to avoid zipper noise */
+    buffers->bufs[bufnum].target_amp = value;
+    buffers->bufs[bufnum].amp_incr = (value - buffers->bufs[bufnum].amp) / buffers->ramp_length;
+    buffers->bufs[bufnum].ramp_count = buffers->ramp_length;
 }
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_mapping)
@@ -526,10 +742,22 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_mapping)
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_reset)
 {
     fluid_rvoice_t *voice = obj;
+    unsigned int i;
 
     voice->dsp.has_looped = 0;
+    voice->dsp.stream_dry = 0;
     voice->envlfo.ticks = 0;
     voice->envlfo.noteoff_ticks = 0;
+    voice->dsp.start_delay = 0;
+
+    /* the amps of a new note don't ramp from the ones of the previous note */
+    voice->buffers.ramp_startup = 1;
+
+    for(i = 0; i < voice->buffers.count; i++)
+    {
+        voice->buffers.bufs[i].ramp_count = 0;
+    }
+
     voice->dsp.amp = 0.0f; /* The last value of the volume envelope, used to
                             calculate the volume increment during
                             processing */
@@ -728,6 +956,16 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_interp_method)
     voice->dsp.interp_method = value;
 }
 
+/* Delays the start of a voice by a number of samples within its first block */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_start_delay)
+{
+    fluid_rvoice_t *voice = obj;
+    int value = param[0].i;
+
+    fluid_clip(value, 0, voice->dsp.block_size - 1);
+    voice->dsp.start_delay = value;
+}
+
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_root_pitch_hz)
 {
     fluid_rvoice_t *voice = obj;
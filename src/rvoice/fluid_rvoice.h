@@ -33,6 +33,8 @@ typedef struct _fluid_rvoice_envlfo_t fluid_rvoice_envlfo_t;
 typedef struct _fluid_rvoice_dsp_t fluid_rvoice_dsp_t;
 typedef struct _fluid_rvoice_buffers_t fluid_rvoice_buffers_t;
 typedef struct _fluid_rvoice_t fluid_rvoice_t;
+typedef struct _fluid_rvoice_arena_t fluid_rvoice_arena_t;
+typedef struct _fluid_sample_stream_t fluid_sample_stream_t;
 
 /* Smallest amplitude that can be perceived (full scale is +/- 0.5)
  * 16 bits => 96+4=100 dB dynamic range => 0.00001
@@ -110,6 +112,8 @@ struct _fluid_rvoice_dsp_t
     fluid_real_t pitch;              /* the pitch in midicents */
     fluid_real_t root_pitch_hz;
     fluid_real_t output_rate;
+    int block_size;                  /* number of samples synthesized at once */
+    int start_delay;                 /* samples of the next block before the voice sets in */
 
     /* Stuff needed for amplitude calculations */
 
@@ -125,10 +129,15 @@ struct _fluid_rvoice_dsp_t
     /* Dynamic input to the interpolator below */
 
     fluid_real_t amp;                /* current linear amplitude */
-    fluid_real_t amp_incr;		/* amplitude increment value for the next FLUID_BUFSIZE samples */
+    fluid_real_t amp_incr;		/* amplitude increment value for the next block_size samples */
 
     fluid_phase_t phase;             /* the phase (current sample offset) of the sample wave */
-    fluid_real_t phase_incr;	/* the phase increment for the next FLUID_BUFSIZE samples */
+    fluid_real_t phase_incr;	/* the phase increment for the next block_size samples */
+
+    /* Sample streaming, see fluid_sample_streamer.c */
+    fluid_sample_stream_t *stream;   /* the buffers of the voice, NULL until the streamer has seen it */
+    unsigned int stream_underruns;   /* underruns not counted by the streamer yet */
+    int stream_dry;                  /* the last block was silent for lack of sample data in memory */
 };
 
 /* Currently left, right, reverb, chorus. To be changed if we
@@ -141,9 +150,14 @@ struct _fluid_rvoice_dsp_t
 struct _fluid_rvoice_buffers_t
 {
     unsigned int count; /* Number of records in "bufs" */
+    int ramp_length;    /* samples over which the amps follow a change, 0 changes them at once */
+    char ramp_startup;  /* Flag: the voice hasn't been mixed yet, so the amps are set at once */
     struct
     {
         fluid_real_t amp;
+        fluid_real_t target_amp; /* amp at the end of the ramp */
+        fluid_real_t amp_incr;   /* amp increment for each sample of the ramp */
+        int ramp_count;          /* samples left until target_amp is reached */
         int mapping; /* Mapping to mixdown buffer index */
     } bufs[FLUID_RVOICE_MAX_BUFS];
 };
@@ -161,8 +175,31 @@ struct _fluid_rvoice_t
     fluid_rvoice_buffers_t buffers;
 };
 
+/*
+ * A number of rvoices allocated in one piece, each starting at a cache line.
+ * So the mixer walks over densely packed rvoices, instead of rvoices scattered
+ * between the much larger fluid_voice_t.
+ */
+struct _fluid_rvoice_arena_t
+{
+    char *mem;      /* the allocation, not aligned */
+    char *rvoices;  /* the first rvoice, aligned to FLUID_DEFAULT_ALIGNMENT */
+    size_t stride;  /* distance between the rvoices, a multiple of FLUID_DEFAULT_ALIGNMENT */
+    int count;
+};
+
+fluid_rvoice_arena_t *new_fluid_rvoice_arena(int count);
+void delete_fluid_rvoice_arena(fluid_rvoice_arena_t *arena);
+
+static FLUID_INLINE fluid_rvoice_t *
+fluid_rvoice_arena_get(fluid_rvoice_arena_t *arena, int index)
+{
+    return (fluid_rvoice_t *)(arena->rvoices + index * arena->stride);
+}
 
 int fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf);
+void fluid_rvoice_filter(fluid_rvoice_t *voice, fluid_real_t *dsp_buf, int count);
+void fluid_rvoice_filter_batch(fluid_rvoice_t **voices, fluid_real_t **dsp_bufs, int count);
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_amp);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_mapping);
@@ -174,6 +211,7 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_multi_retrigger_attack);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_portamento);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_output_rate);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_interp_method);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_start_delay);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_root_pitch_hz);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_pitch);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_attenuation);
@@ -41,8 +41,9 @@
  * - dsp_amp_incr: The changing rate of the amplitude envelope.
  *
  * A couple of variables are used internally, their results are discarded:
- * - dsp_i: Index through the output buffer
- * - dsp_buf: Output buffer of floating point values (FLUID_BUFSIZE in length)
+ * - dsp_i: Index through the output buffer, starts behind the start_delay
+ *          samples of a voice that sets in within the block
+ * - dsp_buf: Output buffer of floating point values (block_size in length)
  */
 
 /* Interpolation (find a value between two samples of the original waveform) */
@@ -132,6 +133,348 @@ fluid_rvoice_get_float_sample(const short int *dsp_msb, const char *dsp_lsb, uns
     return (fluid_real_t)sample;
 }
 
+/* Purpose:
+ * Returns the number of output samples (at most max_count) that can be
+ * interpolated from dsp_phase on, before the phase index passes end_index.
+ *
+ * Within that range none of the interpolation points touch the loop or sample
+ * boundaries, so the interpolation loops don't need any per-sample checks and
+ * can be vectorized. The boundaries themselves remain the (rare) slow path.
+ */
+static FLUID_INLINE unsigned int
+fluid_rvoice_dsp_count_until(fluid_phase_t dsp_phase, fluid_phase_t dsp_phase_incr,
+                             unsigned int end_index, unsigned int max_count)
+{
+    fluid_phase_t end_phase, count;
+
+    if(fluid_phase_index(dsp_phase) > end_index)
+    {
+        return 0;
+    }
+
+    /* phase_incr may be too small to be represented, index never advances */
+    if(dsp_phase_incr == 0)
+    {
+        return max_count;
+    }
+
+    /* last phase value that still maps to end_index */
+    end_phase = fluid_phase_from_index_fract(end_index, 0xFFFFFFFF);
+    count = (end_phase - dsp_phase) / dsp_phase_incr + 1;
+
+    return (count < max_count) ? (unsigned int)count : max_count;
+}
+
+/* Size of the scratch buffer holding the source samples of one boundary free
+ * run, sufficient for playing back samples up to 2 octaves above their root
+ * pitch. Runs spanning more source samples use the direct (scalar) path. */
+#define FLUID_DSP_SCRATCH_SIZE (4 * FLUID_BUFSIZE + SINC_INTERP_ORDER)
+
+/* Purpose:
+ * Prepares the interpolation of a boundary free run of count output samples
+ * (see fluid_rvoice_dsp_count_until()), so that the actual interpolation loop
+ * only consists of table lookups and can be vectorized by the compiler:
+ * - src receives the source samples (converted to fluid_real_t) starting
+ *   at taps_before points before the first phase index up to taps_after
+ *   points after the last phase index,
+ * - index receives for each output sample the position of its phase index
+ *   within src,
+ * - row receives for each output sample the offset of the coefficient row
+ *   (of width row_size) within the interpolation table.
+ *
+ * Returns FALSE if the source range doesn't fit into the scratch buffer.
+ */
+static FLUID_INLINE int
+fluid_rvoice_dsp_block_prepare(const short int *dsp_msb, const char *dsp_lsb,
+                               fluid_phase_t dsp_phase, fluid_phase_t dsp_phase_incr,
+                               unsigned int count, unsigned int taps_before,
+                               unsigned int taps_after, unsigned int row_size,
+                               fluid_real_t *FLUID_RESTRICT src,
+                               int *FLUID_RESTRICT index, int *FLUID_RESTRICT row)
+{
+    unsigned int i, src_count;
+    unsigned int first_index = fluid_phase_index(dsp_phase) - taps_before;
+    fluid_phase_t last_phase = dsp_phase + (count - 1) * dsp_phase_incr;
+
+    src_count = fluid_phase_index(last_phase) + taps_after - first_index + 1;
+
+    if(src_count > FLUID_DSP_SCRATCH_SIZE)
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        index[i] = fluid_phase_index(dsp_phase) - first_index;
+        row[i] = fluid_phase_fract_to_tablerow(dsp_phase) * row_size;
+        fluid_phase_incr(dsp_phase, dsp_phase_incr);
+    }
+
+    dsp_msb += first_index;
+
+    if(dsp_lsb == NULL)
+    {
+        #pragma omp simd
+
+        for(i = 0; i < src_count; i++)
+        {
+            src[i] = (fluid_real_t)(int32_t)((uint32_t)dsp_msb[i] << 8);
+        }
+    }
+    else
+    {
+        dsp_lsb += first_index;
+
+        #pragma omp simd
+
+        for(i = 0; i < src_count; i++)
+        {
+            src[i] = (fluid_real_t)(int32_t)(((uint32_t)dsp_msb[i] << 8) | (uint8_t)dsp_lsb[i]);
+        }
+    }
+
+    return TRUE;
+}
+
+/* Purpose:
+ * Fills amp with the amplitudes of count output samples and advances dsp_amp
+ * past them. The amplitude is accumulated one increment at a time, like the
+ * scalar paths do, so that the kernels below round exactly like them.
+ */
+static FLUID_INLINE void
+fluid_rvoice_dsp_block_amp(fluid_real_t *FLUID_RESTRICT amp, fluid_real_t *dsp_amp,
+                           fluid_real_t dsp_amp_incr, unsigned int count)
+{
+    fluid_real_t cur_amp = *dsp_amp;
+    unsigned int i;
+
+    for(i = 0; i < count; i++)
+    {
+        amp[i] = cur_amp;
+        cur_amp += dsp_amp_incr;
+    }
+
+    *dsp_amp = cur_amp;
+}
+
+/* Purpose:
+ * Interpolation kernels for a boundary free run of count output samples.
+ * Each output sample is computed from its own phase and its precomputed
+ * amplitude, so there are no loop carried dependencies and the loops can be
+ * vectorized. If the run spans too many source samples, fall back to scalar
+ * interpolation directly from the sample data. dsp_amp is advanced past the
+ * run.
+ */
+static void
+fluid_rvoice_dsp_none_block(fluid_real_t *FLUID_RESTRICT dsp_buf,
+                            const short int *dsp_msb, const char *dsp_lsb,
+                            fluid_phase_t dsp_phase, fluid_phase_t dsp_phase_incr,
+                            fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                            unsigned int count)
+{
+    fluid_real_t cur_amp = *dsp_amp;
+    unsigned int i;
+
+    /* a single tap doesn't pay off the scratch buffer, read the sample data directly */
+    for(i = 0; i < count; i++)
+    {
+        dsp_buf[i] = cur_amp
+                     * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, fluid_phase_index_round(dsp_phase));
+        fluid_phase_incr(dsp_phase, dsp_phase_incr);
+        cur_amp += dsp_amp_incr;
+    }
+
+    *dsp_amp = cur_amp;
+}
+
+static void
+fluid_rvoice_dsp_linear_block(fluid_real_t *FLUID_RESTRICT dsp_buf,
+                              const short int *dsp_msb, const char *dsp_lsb,
+                              fluid_phase_t dsp_phase, fluid_phase_t dsp_phase_incr,
+                              fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                              unsigned int count)
+{
+    fluid_real_t src_buf[FLUID_DSP_SCRATCH_SIZE], amp_buf[FLUID_BUFSIZE];
+    int index_buf[FLUID_BUFSIZE], row_buf[FLUID_BUFSIZE];
+    const fluid_real_t *FLUID_RESTRICT src = src_buf;
+    const fluid_real_t *FLUID_RESTRICT amp = amp_buf;
+    const int *FLUID_RESTRICT index = index_buf;
+    const int *FLUID_RESTRICT row = row_buf;
+    const fluid_real_t *FLUID_RESTRICT coeffs = &interp_coeff_linear[0][0];
+    unsigned int i;
+
+    fluid_rvoice_dsp_block_amp(amp_buf, dsp_amp, dsp_amp_incr, count);
+
+    if(!fluid_rvoice_dsp_block_prepare(dsp_msb, dsp_lsb, dsp_phase, dsp_phase_incr,
+                                       count, 0, 1, 2, src_buf, index_buf, row_buf))
+    {
+        for(i = 0; i < count; i++)
+        {
+            unsigned int x = fluid_phase_index(dsp_phase);
+            const fluid_real_t *c = interp_coeff_linear[fluid_phase_fract_to_tablerow(dsp_phase)];
+
+            dsp_buf[i] = amp[i]
+                         * (c[0] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x)
+                            + c[1] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x + 1));
+            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+        }
+
+        return;
+    }
+
+    #pragma omp simd
+
+    for(i = 0; i < count; i++)
+    {
+        int x = index[i], r = row[i];
+
+        dsp_buf[i] = amp[i]
+                     * (coeffs[r] * src[x]
+                        + coeffs[r + 1] * src[x + 1]);
+    }
+}
+
+static void
+fluid_rvoice_dsp_4th_order_block(fluid_real_t *FLUID_RESTRICT dsp_buf,
+                                 const short int *dsp_msb, const char *dsp_lsb,
+                                 fluid_phase_t dsp_phase, fluid_phase_t dsp_phase_incr,
+                                 fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                                 unsigned int count)
+{
+    fluid_real_t src_buf[FLUID_DSP_SCRATCH_SIZE], amp_buf[FLUID_BUFSIZE];
+    int index_buf[FLUID_BUFSIZE], row_buf[FLUID_BUFSIZE];
+    const fluid_real_t *FLUID_RESTRICT src = src_buf;
+    const fluid_real_t *FLUID_RESTRICT amp = amp_buf;
+    const int *FLUID_RESTRICT index = index_buf;
+    const int *FLUID_RESTRICT row = row_buf;
+    const fluid_real_t *FLUID_RESTRICT coeffs = &interp_coeff[0][0];
+    unsigned int i;
+
+    fluid_rvoice_dsp_block_amp(amp_buf, dsp_amp, dsp_amp_incr, count);
+
+    if(!fluid_rvoice_dsp_block_prepare(dsp_msb, dsp_lsb, dsp_phase, dsp_phase_incr,
+                                       count, 1, 2, 4, src_buf, index_buf, row_buf))
+    {
+        for(i = 0; i < count; i++)
+        {
+            unsigned int x = fluid_phase_index(dsp_phase);
+            const fluid_real_t *c = interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase)];
+
+            dsp_buf[i] = amp[i]
+                         * (c[0] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x - 1)
+                            + c[1] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x)
+                            + c[2] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x + 1)
+                            + c[3] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x + 2));
+            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+        }
+
+        return;
+    }
+
+    #pragma omp simd
+
+    for(i = 0; i < count; i++)
+    {
+        int x = index[i], r = row[i];
+
+        dsp_buf[i] = amp[i]
+                     * (coeffs[r] * src[x - 1]
+                        + coeffs[r + 1] * src[x]
+                        + coeffs[r + 2] * src[x + 1]
+                        + coeffs[r + 3] * src[x + 2]);
+    }
+}
+
+static void
+fluid_rvoice_dsp_7th_order_block(fluid_real_t *FLUID_RESTRICT dsp_buf,
+                                 const short int *dsp_msb, const char *dsp_lsb,
+                                 fluid_phase_t dsp_phase, fluid_phase_t dsp_phase_incr,
+                                 fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                                 unsigned int count)
+{
+    fluid_real_t src_buf[FLUID_DSP_SCRATCH_SIZE], amp_buf[FLUID_BUFSIZE];
+    int index_buf[FLUID_BUFSIZE], row_buf[FLUID_BUFSIZE];
+    const fluid_real_t *FLUID_RESTRICT src = src_buf;
+    const fluid_real_t *FLUID_RESTRICT amp = amp_buf;
+    const int *FLUID_RESTRICT index = index_buf;
+    const int *FLUID_RESTRICT row = row_buf;
+    const fluid_real_t *FLUID_RESTRICT coeffs = &sinc_table7[0][0];
+    unsigned int i;
+
+    fluid_rvoice_dsp_block_amp(amp_buf, dsp_amp, dsp_amp_incr, count);
+
+    if(!fluid_rvoice_dsp_block_prepare(dsp_msb, dsp_lsb, dsp_phase, dsp_phase_incr,
+                                       count, 3, 3, SINC_INTERP_ORDER, src_buf, index_buf, row_buf))
+    {
+        for(i = 0; i < count; i++)
+        {
+            unsigned int x = fluid_phase_index(dsp_phase);
+            const fluid_real_t *c = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
+
+            dsp_buf[i] = amp[i]
+                         * (c[0] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x - 3)
+                            + c[1] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x - 2)
+                            + c[2] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x - 1)
+                            + c[3] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x)
+                            + c[4] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x + 1)
+                            + c[5] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x + 2)
+                            + c[6] * fluid_rvoice_get_float_sample(dsp_msb, dsp_lsb, x + 3));
+            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+        }
+
+        return;
+    }
+
+    #pragma omp simd
+
+    for(i = 0; i < count; i++)
+    {
+        int x = index[i], r = row[i];
+
+        dsp_buf[i] = amp[i]
+                     * (coeffs[r] * src[x - 3]
+                        + coeffs[r + 1] * src[x - 2]
+                        + coeffs[r + 2] * src[x - 1]
+                        + coeffs[r + 3] * src[x]
+                        + coeffs[r + 4] * src[x + 1]
+                        + coeffs[r + 5] * src[x + 2]
+                        + coeffs[r + 6] * src[x + 3]);
+    }
+}
+
+typedef void (*fluid_rvoice_dsp_block_func_t)(fluid_real_t *FLUID_RESTRICT dsp_buf,
+        const short int *dsp_msb, const char *dsp_lsb,
+        fluid_phase_t dsp_phase, fluid_phase_t dsp_phase_incr,
+        fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+        unsigned int count);
+
+/* Purpose:
+ * Runs one of the interpolation kernels above on a boundary free run, which
+ * may be longer than their index buffers when synth.block-size exceeds
+ * FLUID_BUFSIZE. The run is split into chunks of FLUID_BUFSIZE samples.
+ */
+static FLUID_INLINE void
+fluid_rvoice_dsp_run_block(fluid_rvoice_dsp_block_func_t block_func,
+                           fluid_real_t *FLUID_RESTRICT dsp_buf,
+                           const short int *dsp_msb, const char *dsp_lsb,
+                           fluid_phase_t dsp_phase, fluid_phase_t dsp_phase_incr,
+                           fluid_real_t *dsp_amp, fluid_real_t dsp_amp_incr,
+                           unsigned int count)
+{
+    while(count > FLUID_BUFSIZE)
+    {
+        block_func(dsp_buf, dsp_msb, dsp_lsb, dsp_phase, dsp_phase_incr,
+                   dsp_amp, dsp_amp_incr, FLUID_BUFSIZE);
+
+        dsp_buf += FLUID_BUFSIZE;
+        fluid_phase_incr(dsp_phase, FLUID_BUFSIZE * dsp_phase_incr);
+        count -= FLUID_BUFSIZE;
+    }
+
+    block_func(dsp_buf, dsp_msb, dsp_lsb, dsp_phase, dsp_phase_incr,
+               dsp_amp, dsp_amp_incr, count);
+}
+
 /* No interpolation. Just take the sample, which is closest to
   * the playback pointer.  Questionable quality, but very
   * efficient. */
@@ -144,7 +487,9 @@ fluid_rvoice_dsp_interpolate_none(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID
     char *dsp_data24 = voice->sample->data24;
     fluid_real_t dsp_amp = voice->amp;
     fluid_real_t dsp_amp_incr = voice->amp_incr;
-    unsigned int dsp_i = 0;
+    unsigned int dsp_i = voice->start_delay;
+    unsigned int block_size = voice->block_size;
+    unsigned int count;
     unsigned int dsp_phase_index;
     unsigned int end_index;
 
@@ -155,19 +500,21 @@ fluid_rvoice_dsp_interpolate_none(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID
 
     while(1)
     {
-        dsp_phase_index = fluid_phase_index_round(dsp_phase);	/* round to nearest point */
+        /* interpolate sequence of sample points (rounded to nearest point) */
+        count = fluid_rvoice_dsp_count_until(dsp_phase + 0x80000000, dsp_phase_incr,
+                                             end_index, block_size - dsp_i);
 
-        /* interpolate sequence of sample points */
-        for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
+        if(count > 0)
         {
-            dsp_buf[dsp_i] = dsp_amp * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index);
-
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index_round(dsp_phase);	/* round to nearest point */
-            dsp_amp += dsp_amp_incr;
+            fluid_rvoice_dsp_none_block(&dsp_buf[dsp_i], dsp_data, dsp_data24, dsp_phase, dsp_phase_incr,
+                                        &dsp_amp, dsp_amp_incr, count);
         }
 
+        /* advance the phase by the samples just written, the kernel has advanced the amplitude */
+        dsp_i += count;
+        fluid_phase_incr(dsp_phase, count * dsp_phase_incr);
+        dsp_phase_index = fluid_phase_index_round(dsp_phase);	/* round to nearest point */
+
         /* break out if not looping (buffer may not be full) */
         if(!looping)
         {
@@ -182,7 +529,7 @@ fluid_rvoice_dsp_interpolate_none(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID
         }
 
         /* break out if filled buffer */
-        if(dsp_i >= FLUID_BUFSIZE)
+        if(dsp_i >= block_size)
         {
             break;
         }
@@ -195,7 +542,7 @@ fluid_rvoice_dsp_interpolate_none(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID
 }
 
 /* Straight line interpolation.
- * Returns number of samples processed (usually FLUID_BUFSIZE but could be
+ * Returns number of samples processed (usually block_size but could be
  * smaller if end of sample occurs).
  */
 int
@@ -207,7 +554,9 @@ fluid_rvoice_dsp_interpolate_linear(fluid_rvoice_dsp_t *voice, fluid_real_t *FLU
     char *dsp_data24 = voice->sample->data24;
     fluid_real_t dsp_amp = voice->amp;
     fluid_real_t dsp_amp_incr = voice->amp_incr;
-    unsigned int dsp_i = 0;
+    unsigned int dsp_i = voice->start_delay;
+    unsigned int block_size = voice->block_size;
+    unsigned int count;
     unsigned int dsp_phase_index;
     unsigned int end_index;
     fluid_real_t point;
@@ -231,23 +580,22 @@ fluid_rvoice_dsp_interpolate_linear(fluid_rvoice_dsp_t *voice, fluid_real_t *FLU
 
     while(1)
     {
-        dsp_phase_index = fluid_phase_index(dsp_phase);
-
         /* interpolate the sequence of sample points */
-        for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
-        {
-            coeffs = interp_coeff_linear[fluid_phase_fract_to_tablerow(dsp_phase)];
-            dsp_buf[dsp_i] = dsp_amp * (coeffs[0] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index)
-                                        + coeffs[1] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index + 1));
+        count = fluid_rvoice_dsp_count_until(dsp_phase, dsp_phase_incr, end_index, block_size - dsp_i);
 
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index(dsp_phase);
-            dsp_amp += dsp_amp_incr;
+        if(count > 0)
+        {
+            fluid_rvoice_dsp_run_block(fluid_rvoice_dsp_linear_block, &dsp_buf[dsp_i], dsp_data, dsp_data24, dsp_phase, dsp_phase_incr,
+                                          &dsp_amp, dsp_amp_incr, count);
         }
 
+        /* advance the phase by the samples just written, the kernel has advanced the amplitude */
+        dsp_i += count;
+        fluid_phase_incr(dsp_phase, count * dsp_phase_incr);
+        dsp_phase_index = fluid_phase_index(dsp_phase);
+
         /* break out if buffer filled */
-        if(dsp_i >= FLUID_BUFSIZE)
+        if(dsp_i >= block_size)
         {
             break;
         }
@@ -255,7 +603,7 @@ fluid_rvoice_dsp_interpolate_linear(fluid_rvoice_dsp_t *voice, fluid_real_t *FLU
         end_index++;	/* we're now interpolating the last point */
 
         /* interpolate within last point */
-        for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        for(; dsp_phase_index <= end_index && dsp_i < block_size; dsp_i++)
         {
             coeffs = interp_coeff_linear[fluid_phase_fract_to_tablerow(dsp_phase)];
             dsp_buf[dsp_i] = dsp_amp * (coeffs[0] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index)
@@ -280,7 +628,7 @@ fluid_rvoice_dsp_interpolate_linear(fluid_rvoice_dsp_t *voice, fluid_real_t *FLU
         }
 
         /* break out if filled buffer */
-        if(dsp_i >= FLUID_BUFSIZE)
+        if(dsp_i >= block_size)
         {
             break;
         }
@@ -295,7 +643,7 @@ fluid_rvoice_dsp_interpolate_linear(fluid_rvoice_dsp_t *voice, fluid_real_t *FLU
 }
 
 /* 4th order (cubic) interpolation.
- * Returns number of samples processed (usually FLUID_BUFSIZE but could be
+ * Returns number of samples processed (usually block_size but could be
  * smaller if end of sample occurs).
  */
 int
@@ -307,7 +655,9 @@ fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
     char *dsp_data24 = voice->sample->data24;
     fluid_real_t dsp_amp = voice->amp;
     fluid_real_t dsp_amp_incr = voice->amp_incr;
-    unsigned int dsp_i = 0;
+    unsigned int dsp_i = voice->start_delay;
+    unsigned int block_size = voice->block_size;
+    unsigned int count;
     unsigned int dsp_phase_index;
     unsigned int start_index, end_index;
     fluid_real_t start_point, end_point1, end_point2;
@@ -347,7 +697,7 @@ fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         dsp_phase_index = fluid_phase_index(dsp_phase);
 
         /* interpolate first sample point (start or loop start) if needed */
-        for(; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        for(; dsp_phase_index == start_index && dsp_i < block_size; dsp_i++)
         {
             coeffs = interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase)];
             dsp_buf[dsp_i] = dsp_amp *
@@ -363,23 +713,21 @@ fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         }
 
         /* interpolate the sequence of sample points */
-        for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
-        {
-            coeffs = interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase)];
-            dsp_buf[dsp_i] = dsp_amp *
-                             (coeffs[0] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index - 1)
-                              + coeffs[1] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index)
-                              + coeffs[2] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index + 1)
-                              + coeffs[3] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index + 2));
+        count = fluid_rvoice_dsp_count_until(dsp_phase, dsp_phase_incr, end_index, block_size - dsp_i);
 
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index(dsp_phase);
-            dsp_amp += dsp_amp_incr;
+        if(count > 0)
+        {
+            fluid_rvoice_dsp_run_block(fluid_rvoice_dsp_4th_order_block, &dsp_buf[dsp_i], dsp_data, dsp_data24, dsp_phase, dsp_phase_incr,
+                                             &dsp_amp, dsp_amp_incr, count);
         }
 
+        /* advance the phase by the samples just written, the kernel has advanced the amplitude */
+        dsp_i += count;
+        fluid_phase_incr(dsp_phase, count * dsp_phase_incr);
+        dsp_phase_index = fluid_phase_index(dsp_phase);
+
         /* break out if buffer filled */
-        if(dsp_i >= FLUID_BUFSIZE)
+        if(dsp_i >= block_size)
         {
             break;
         }
@@ -387,7 +735,7 @@ fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         end_index++;	/* we're now interpolating the 2nd to last point */
 
         /* interpolate within 2nd to last point */
-        for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        for(; dsp_phase_index <= end_index && dsp_i < block_size; dsp_i++)
         {
             coeffs = interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase)];
             dsp_buf[dsp_i] = dsp_amp *
@@ -405,7 +753,7 @@ fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         end_index++;	/* we're now interpolating the last point */
 
         /* interpolate within the last point */
-        for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        for(; dsp_phase_index <= end_index && dsp_i < block_size; dsp_i++)
         {
             coeffs = interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase)];
             dsp_buf[dsp_i] = dsp_amp *
@@ -439,7 +787,7 @@ fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         }
 
         /* break out if filled buffer */
-        if(dsp_i >= FLUID_BUFSIZE)
+        if(dsp_i >= block_size)
         {
             break;
         }
@@ -454,7 +802,7 @@ fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
 }
 
 /* 7th order interpolation.
- * Returns number of samples processed (usually FLUID_BUFSIZE but could be
+ * Returns number of samples processed (usually block_size but could be
  * smaller if end of sample occurs).
  */
 int
@@ -466,7 +814,9 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
     char *dsp_data24 = voice->sample->data24;
     fluid_real_t dsp_amp = voice->amp;
     fluid_real_t dsp_amp_incr = voice->amp_incr;
-    unsigned int dsp_i = 0;
+    unsigned int dsp_i = voice->start_delay;
+    unsigned int block_size = voice->block_size;
+    unsigned int count;
     unsigned int dsp_phase_index;
     unsigned int start_index, end_index;
     fluid_real_t start_points[3], end_points[3];
@@ -516,7 +866,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         dsp_phase_index = fluid_phase_index(dsp_phase);
 
         /* interpolate first sample point (start or loop start) if needed */
-        for(; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        for(; dsp_phase_index == start_index && dsp_i < block_size; dsp_i++)
         {
             coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
 
@@ -538,7 +888,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         start_index++;
 
         /* interpolate 2nd to first sample point (start or loop start) if needed */
-        for(; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        for(; dsp_phase_index == start_index && dsp_i < block_size; dsp_i++)
         {
             coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
 
@@ -560,7 +910,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         start_index++;
 
         /* interpolate 3rd to first sample point (start or loop start) if needed */
-        for(; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        for(; dsp_phase_index == start_index && dsp_i < block_size; dsp_i++)
         {
             coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
 
@@ -583,27 +933,21 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
 
 
         /* interpolate the sequence of sample points */
-        for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
-        {
-            coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
-
-            dsp_buf[dsp_i] = dsp_amp
-                             * (coeffs[0] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index - 3)
-                                + coeffs[1] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index - 2)
-                                + coeffs[2] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index - 1)
-                                + coeffs[3] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index)
-                                + coeffs[4] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index + 1)
-                                + coeffs[5] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index + 2)
-                                + coeffs[6] * fluid_rvoice_get_float_sample(dsp_data, dsp_data24, dsp_phase_index + 3));
+        count = fluid_rvoice_dsp_count_until(dsp_phase, dsp_phase_incr, end_index, block_size - dsp_i);
 
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index(dsp_phase);
-            dsp_amp += dsp_amp_incr;
+        if(count > 0)
+        {
+            fluid_rvoice_dsp_run_block(fluid_rvoice_dsp_7th_order_block, &dsp_buf[dsp_i], dsp_data, dsp_data24, dsp_phase, dsp_phase_incr,
+                                             &dsp_amp, dsp_amp_incr, count);
         }
 
+        /* advance the phase by the samples just written, the kernel has advanced the amplitude */
+        dsp_i += count;
+        fluid_phase_incr(dsp_phase, count * dsp_phase_incr);
+        dsp_phase_index = fluid_phase_index(dsp_phase);
+
         /* break out if buffer filled */
-        if(dsp_i >= FLUID_BUFSIZE)
+        if(dsp_i >= block_size)
         {
             break;
         }
@@ -611,7 +955,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         end_index++;	/* we're now interpolating the 3rd to last point */
 
         /* interpolate within 3rd to last point */
-        for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        for(; dsp_phase_index <= end_index && dsp_i < block_size; dsp_i++)
         {
             coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
 
@@ -633,7 +977,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         end_index++;	/* we're now interpolating the 2nd to last point */
 
         /* interpolate within 2nd to last point */
-        for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        for(; dsp_phase_index <= end_index && dsp_i < block_size; dsp_i++)
         {
             coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
 
@@ -655,7 +999,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         end_index++;	/* we're now interpolating the last point */
 
         /* interpolate within last point */
-        for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        for(; dsp_phase_index <= end_index && dsp_i < block_size; dsp_i++)
         {
             coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
 
@@ -695,7 +1039,7 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
         }
 
         /* break out if filled buffer */
-        if(dsp_i >= FLUID_BUFSIZE)
+        if(dsp_i >= block_size)
         {
             break;
         }
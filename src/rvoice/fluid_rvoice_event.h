@@ -50,7 +50,7 @@ struct _fluid_rvoice_eventhandler_t
 
 fluid_rvoice_eventhandler_t *new_fluid_rvoice_eventhandler(
     int queuesize, int finished_voices_size, int bufs,
-    int fx_bufs, fluid_real_t sample_rate, int, int);
+    int fx_bufs, fluid_real_t sample_rate, int block_size, int, int);
 
 void delete_fluid_rvoice_eventhandler(fluid_rvoice_eventhandler_t *);
 
@@ -23,6 +23,7 @@
 #include "fluid_sys.h"
 #include "fluid_rev.h"
 #include "fluid_chorus.h"
+#include "fluid_sample_streamer.h"
 #include "fluidsynth_priv.h"
 #include "fluid_ladspa.h"
 #include "fluid_synth.h"
@@ -34,6 +35,25 @@
 // so don't activate the thread(s).
 #define VOICES_PER_THREAD 8
 
+// Estimated rendering cost of a voice, in units of a non-interpolated voice.
+// The threshold above refers to voices using the default interpolation.
+#define RVOICE_COST_NONE 1
+#define RVOICE_COST_LINEAR 2
+#define RVOICE_COST_4THORDER 3
+#define RVOICE_COST_7THORDER 6
+#define RVOICE_COST_CUSTOM_FILTER 2
+#define COST_PER_THREAD (VOICES_PER_THREAD * RVOICE_COST_4THORDER)
+
+// Number of polls a thread does before going to sleep on a condition
+// variable when waiting for work or for other threads to finish.
+#define MIXER_SPIN_COUNT 2048
+
+// Level below which the input of an effects unit is considered silent (-120 dB).
+#define MIXER_SILENCE_LEVEL 1e-6
+
+// Seconds of silence after which the LADSPA effects unit is skipped.
+#define MIXER_LADSPA_TAIL 1.0
+
 typedef struct _fluid_mixer_buffers_t fluid_mixer_buffers_t;
 
 struct _fluid_mixer_buffers_t
@@ -48,6 +68,18 @@ struct _fluid_mixer_buffers_t
 
     fluid_atomic_int_t ready;             /**< Atomic: buffers are ready for mixing */
 
+#if ENABLE_MIXER_THREADS
+    /** Atomic: next voice to render from this thread's voice queue. Other
+     * threads advance it as well when stealing voices. */
+    fluid_atomic_int_t queue_next;
+    int queue_end;                        /**< End (exclusive) of this thread's voice queue */
+
+    /** With pipelined effects: the voices of this thread's queue, which it
+     * renders block by block. Finished voices are set to NULL. */
+    fluid_rvoice_t **pipeline_voices;
+    fluid_atomic_int_t blocks_done;       /**< Atomic: with pipelined effects, number of blocks rendered */
+#endif
+
     fluid_real_t *local_buf;
 
     int buf_count;
@@ -74,6 +106,21 @@ struct _fluid_mixer_buffers_t
      */
     fluid_real_t *fx_left_buf;
     fluid_real_t *fx_right_buf;
+
+    /** Dirty mask: one flag for each of the 2 * (buf_count + fx_buf_count)
+     * sample buffers, indexed like the outbufs of fluid_mixer_buffers_prepare().
+     * A buffer whose flag is cleared has not been written to in the current
+     * render call and contains garbage, it will be zeroed when a voice
+     * mixes into it the first time.
+     */
+    char *dirty;
+
+    /** For each sample buffer (indexed like \c dirty), the number of
+     * samples at its beginning which are known to be zero. Such buffers
+     * need not be cleared again. Only maintained for the buffers of the
+     * mixer itself, it stays 0 for the buffers of the extra threads.
+     */
+    int *zero_count;
 };
 
 typedef struct _fluid_mixer_fx_t fluid_mixer_fx_t;
@@ -85,6 +132,13 @@ struct _fluid_mixer_fx_t
     int with_reverb;        /**< Should the synth use the built-in reverb unit? */
     int with_chorus;        /**< Should the synth use the built-in chorus unit? */
     int mix_fx_to_out;      /**< Should the effects be mixed in with the primary output? */
+
+    int reverb_silence;     /**< Number of samples the reverb input has been silent for */
+    int chorus_silence;     /**< Number of samples the chorus input has been silent for */
+#ifdef LADSPA
+    int ladspa_silence;     /**< Number of samples the LADSPA input and output have been silent for */
+    int ladspa_tail;        /**< Number of silent samples after which the LADSPA unit is skipped */
+#endif
 };
 
 struct _fluid_rvoice_mixer_t
@@ -98,6 +152,9 @@ struct _fluid_rvoice_mixer_t
     int polyphony; /**< Read-only: Length of voices array */
     int active_voices; /**< Read-only: Number of non-null voices */
     int current_blockcount;      /**< Read-only: how many blocks to process this time */
+    int block_size;              /**< Read-only: number of samples per block */
+    int pipelined_fx;            /**< Read-only: process the effects of a block while the extra threads render the next one */
+    fluid_sample_streamer_t *streamer; /**< Used by mixer only: streams sample data to the voices, NULL if sample streaming is off */
 
 #ifdef LADSPA
     fluid_ladspa_fx_t *ladspa_fx; /**< Used by mixer only: Effects unit for LADSPA support. Never created or freed */
@@ -107,7 +164,10 @@ struct _fluid_rvoice_mixer_t
 //  int sleeping_threads;        /**< Atomic: number of threads currently asleep */
 //  int active_threads;          /**< Atomic: number of threads in the thread loop */
     fluid_atomic_int_t threads_should_terminate; /**< Atomic: Set to TRUE when threads should terminate */
-    fluid_atomic_int_t current_rvoice;           /**< Atomic: for the threads to know next voice to  */
+    fluid_atomic_int_t parked_threads;  /**< Atomic: number of threads sleeping on wakeup_threads */
+    fluid_atomic_int_t mixer_parked;    /**< Atomic: Set to TRUE while the mixer sleeps on thread_ready */
+    int queue_count;             /**< Read-only: number of voice queues for this render call (extra threads + mixer) */
+    fluid_atomic_int_t current_mix_buf; /**< Atomic: next sample buffer to sum up after rendering */
     fluid_cond_t *wakeup_threads; /**< Signalled when the threads should wake up */
     fluid_cond_mutex_t *wakeup_threads_m; /**< wakeup_threads mutex companion */
     fluid_cond_t *thread_ready; /**< Signalled from thread, when the thread has a buffer ready for mixing */
@@ -123,13 +183,103 @@ static void delete_rvoice_mixer_threads(fluid_rvoice_mixer_t *mixer);
 static int fluid_rvoice_mixer_set_threads(fluid_rvoice_mixer_t *mixer, int thread_count, int prio_level);
 #endif
 
-static FLUID_INLINE void
-fluid_rvoice_mixer_process_fx(fluid_rvoice_mixer_t *mixer, int current_blockcount)
+/**
+ * Returns the sample buffer with the given dirty mask index, i.e. the
+ * buffer fluid_mixer_buffers_prepare() would put at that index.
+ */
+static FLUID_INLINE fluid_real_t *
+fluid_mixer_buffers_get_buf(fluid_mixer_buffers_t *buffers, int index)
+{
+    fluid_real_t *base_ptr;
+
+    if(index < buffers->buf_count * 2)
+    {
+        base_ptr = (index & 1) ? buffers->right_buf : buffers->left_buf;
+        index /= 2;
+    }
+    else
+    {
+        index -= buffers->buf_count * 2;
+        base_ptr = buffers->fx_left_buf;
+
+        if(index >= buffers->fx_buf_count)
+        {
+            index -= buffers->fx_buf_count;
+            base_ptr = buffers->fx_right_buf;
+        }
+    }
+
+    base_ptr = fluid_align_ptr(base_ptr, FLUID_DEFAULT_ALIGNMENT);
+    return &base_ptr[index * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
+}
+
+/**
+ * Check if a sample buffer is silent, i.e. none of its samples reaches
+ * #MIXER_SILENCE_LEVEL.
+ */
+static FLUID_INLINE int
+fluid_mixer_buf_is_silent(const fluid_real_t *FLUID_RESTRICT buf, int sample_count)
 {
+    fluid_real_t peak = 0;
     int i;
 
-    void (*reverb_process_func)(fluid_revmodel_t *rev, fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out);
-    void (*chorus_process_func)(fluid_chorus_t *chorus, fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out);
+    #pragma omp simd aligned(buf:FLUID_DEFAULT_ALIGNMENT) reduction(max:peak)
+
+    for(i = 0; i < sample_count; i++)
+    {
+        fluid_real_t level = fabs(buf[i]);
+        peak = (level > peak) ? level : peak;
+    }
+
+    return peak < MIXER_SILENCE_LEVEL;
+}
+
+/**
+ * Decide whether an effects unit has to run for the given samples.
+ *
+ * Once the input of the unit, i.e. \c buf being the sample buffer with the
+ * given dirty mask index, has been silent for longer than the tail of the unit, the unit
+ * is skipped until the input becomes audible again. As the unit then runs
+ * for the whole render call, it resumes at the very sample the input starts.
+ *
+ * @param silence Number of samples the input has been silent for, updated
+ * @param tail Length of the tail of the unit in samples
+ * @return TRUE if the unit has to run
+ */
+static FLUID_INLINE int
+fluid_mixer_fx_needs_run(fluid_mixer_buffers_t *buffers, int index, const fluid_real_t *buf,
+                         int *silence, int tail, int sample_count)
+{
+    if(buffers->dirty[index] && !fluid_mixer_buf_is_silent(buf, sample_count))
+    {
+        *silence = 0;
+        return TRUE;
+    }
+
+    if(*silence >= tail)
+    {
+        return FALSE;
+    }
+
+    *silence += sample_count;
+    return TRUE;
+}
+
+/**
+ * Run the reverb and the chorus for the given blocks of the sample buffers.
+ */
+static FLUID_INLINE void
+fluid_rvoice_mixer_process_fx(fluid_rvoice_mixer_t *mixer, int first_block, int current_blockcount)
+{
+    int start = first_block * mixer->block_size;
+    int sample_count = current_blockcount * mixer->block_size;
+    fluid_mixer_buffers_t *buffers = &mixer->buffers;
+    int in_rev_index = buffers->buf_count * 2 + SYNTH_REVERB_CHANNEL;
+    int in_ch_index = buffers->buf_count * 2 + SYNTH_CHORUS_CHANNEL;
+    int out_rev_index[2], out_ch_index[2], tail;
+
+    void (*reverb_process_func)(fluid_revmodel_t *rev, fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out, int count);
+    void (*chorus_process_func)(fluid_chorus_t *chorus, fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out, int count);
 
     fluid_real_t *out_rev_l, *out_rev_r, *out_ch_l, *out_ch_r;
 
@@ -149,6 +299,9 @@ fluid_rvoice_mixer_process_fx(fluid_rvoice_mixer_t *mixer, int current_blockcoun
         out_ch_l = &out_rev_l[0 * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
         out_ch_r = &out_rev_r[0 * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
 
+        out_rev_index[0] = out_ch_index[0] = 0;
+        out_rev_index[1] = out_ch_index[1] = 1;
+
         reverb_process_func = fluid_revmodel_processmix;
         chorus_process_func = fluid_chorus_processmix;
 
@@ -164,45 +317,111 @@ fluid_rvoice_mixer_process_fx(fluid_rvoice_mixer_t *mixer, int current_blockcoun
         out_ch_l = &out_ch_l[SYNTH_CHORUS_CHANNEL * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
         out_ch_r = &out_ch_r[SYNTH_CHORUS_CHANNEL * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
 
+        out_rev_index[0] = in_rev_index;
+        out_rev_index[1] = in_rev_index + buffers->fx_buf_count;
+        out_ch_index[0] = in_ch_index;
+        out_ch_index[1] = in_ch_index + buffers->fx_buf_count;
+
         reverb_process_func = fluid_revmodel_processreplace;
         chorus_process_func = fluid_chorus_processreplace;
     }
 
+    in_rev += start;
+    in_ch += start;
+    out_rev_l += start;
+    out_rev_r += start;
+    out_ch_l += start;
+    out_ch_r += start;
 
+    /* Idle effects units are skipped. When replacing, their output buffer
+     * is the input buffer, which then holds inaudible leftovers at most. */
     if(mixer->fx.with_reverb)
     {
-        for(i = 0; i < current_blockcount * FLUID_BUFSIZE; i += FLUID_BUFSIZE)
+        tail = fluid_revmodel_get_tail(mixer->fx.reverb);
+
+        if(fluid_mixer_fx_needs_run(buffers, in_rev_index, in_rev, &mixer->fx.reverb_silence, tail, sample_count))
         {
-            reverb_process_func(mixer->fx.reverb, &in_rev[i], &out_rev_l[i], &out_rev_r[i]);
-        }
+            reverb_process_func(mixer->fx.reverb, in_rev, out_rev_l, out_rev_r, sample_count);
+            buffers->zero_count[out_rev_index[0]] = buffers->zero_count[out_rev_index[1]] = 0;
 
-        fluid_profile(FLUID_PROF_ONE_BLOCK_REVERB, prof_ref, 0,
-                      current_blockcount * FLUID_BUFSIZE);
+            /* The tail has died away, start from scratch when the input returns */
+            if(mixer->fx.reverb_silence >= tail)
+            {
+                fluid_revmodel_reset(mixer->fx.reverb);
+            }
+
+            fluid_profile(FLUID_PROF_ONE_BLOCK_REVERB, prof_ref, 0, sample_count);
+        }
+        else if(!mixer->fx.mix_fx_to_out && buffers->dirty[in_rev_index])
+        {
+            FLUID_MEMSET(out_rev_l, 0, sample_count * sizeof(fluid_real_t));
+        }
     }
 
     if(mixer->fx.with_chorus)
     {
-        for(i = 0; i < current_blockcount * FLUID_BUFSIZE; i += FLUID_BUFSIZE)
+        tail = fluid_chorus_get_tail(mixer->fx.chorus);
+
+        if(fluid_mixer_fx_needs_run(buffers, in_ch_index, in_ch, &mixer->fx.chorus_silence, tail, sample_count))
         {
-            chorus_process_func(mixer->fx.chorus, &in_ch[i], &out_ch_l[i], &out_ch_r[i]);
-        }
+            chorus_process_func(mixer->fx.chorus, in_ch, out_ch_l, out_ch_r, sample_count);
+            buffers->zero_count[out_ch_index[0]] = buffers->zero_count[out_ch_index[1]] = 0;
 
-        fluid_profile(FLUID_PROF_ONE_BLOCK_CHORUS, prof_ref, 0,
-                      current_blockcount * FLUID_BUFSIZE);
+            if(mixer->fx.chorus_silence >= tail)
+            {
+                fluid_chorus_reset(mixer->fx.chorus);
+            }
+
+            fluid_profile(FLUID_PROF_ONE_BLOCK_CHORUS, prof_ref, 0, sample_count);
+        }
+        else if(!mixer->fx.mix_fx_to_out && buffers->dirty[in_ch_index])
+        {
+            FLUID_MEMSET(out_ch_l, 0, sample_count * sizeof(fluid_real_t));
+        }
     }
+}
 
 #ifdef LADSPA
+/**
+ * Run the signal through the LADSPA Fx unit. The buffers have already been
+ * set up in fluid_rvoice_mixer_set_ladspa.
+ * LADSPA plugins don't tell about the length of their tail, so the unit
+ * is skipped once both its input and its output have been silent for
+ * ladspa_tail samples.
+ */
+static FLUID_INLINE void
+fluid_rvoice_mixer_process_ladspa(fluid_rvoice_mixer_t *mixer, int current_blockcount)
+{
+    int sample_count = current_blockcount * mixer->block_size;
+    fluid_mixer_buffers_t *buffers = &mixer->buffers;
 
-    /* Run the signal through the LADSPA Fx unit. The buffers have already been
-     * set up in fluid_rvoice_mixer_set_ladspa. */
     if(mixer->ladspa_fx)
     {
-        fluid_ladspa_run(mixer->ladspa_fx, current_blockcount, FLUID_BUFSIZE);
-        fluid_check_fpe("LADSPA");
-    }
+        int i, buf_count = (buffers->buf_count + buffers->fx_buf_count) * 2;
+        int silent = TRUE;
 
-#endif
+        for(i = 0; i < buf_count && silent; i++)
+        {
+            silent = (buffers->zero_count[i] >= sample_count);
+        }
+
+        if(!silent || mixer->fx.ladspa_silence < mixer->fx.ladspa_tail)
+        {
+            fluid_ladspa_run(mixer->ladspa_fx, current_blockcount, mixer->block_size);
+            fluid_check_fpe("LADSPA");
+
+            /* The plugins may have written to any of the buffers */
+            for(i = 0; i < buf_count; i++)
+            {
+                silent = silent && fluid_mixer_buf_is_silent(fluid_mixer_buffers_get_buf(buffers, i), sample_count);
+                buffers->zero_count[i] = 0;
+            }
+
+            mixer->fx.ladspa_silence = silent ? mixer->fx.ladspa_silence + sample_count : 0;
+        }
+    }
 }
+#endif
 
 /**
  * Glue to get fluid_rvoice_buffers_mix what it wants
@@ -299,6 +518,11 @@ fluid_mixer_buffer_process_finished_voices(fluid_mixer_buffers_t *buffers)
 
         buffers->mixer->active_voices = av;
 
+        if(buffers->mixer->streamer != NULL)
+        {
+            fluid_sample_streamer_release(buffers->mixer->streamer, v);
+        }
+
         fluid_rvoice_eventhandler_finished_voice_callback(buffers->mixer->eventhandler, v);
     }
 
@@ -339,15 +563,15 @@ get_dest_buf(fluid_rvoice_buffers_t *buffers, int index,
  *
  * @param buffers Destination buffer(s)
  * @param dsp_buf Mono sample source
- * @param start_block Block to start mixing at
- * @param sample_count number of samples to mix following \c start_block
+ * @param start Sample of the destination buffers to start mixing at
+ * @param sample_count number of samples to mix from \c dsp_buf
  * @param dest_bufs Array of buffers to mixdown to
  * @param dest_bufcount Length of dest_bufs
  */
 static void
 fluid_rvoice_buffers_mix(fluid_rvoice_buffers_t *buffers,
                          fluid_real_t *FLUID_RESTRICT dsp_buf,
-                         int start_block, int sample_count,
+                         int start, int sample_count,
                          fluid_real_t **dest_bufs, int dest_bufcount)
 {
     int bufcount = buffers->count;
@@ -359,23 +583,60 @@ fluid_rvoice_buffers_mix(fluid_rvoice_buffers_t *buffers,
     }
 
     FLUID_ASSERT((uintptr_t)dsp_buf % FLUID_DEFAULT_ALIGNMENT == 0);
-    FLUID_ASSERT((uintptr_t)(&dsp_buf[start_block * FLUID_BUFSIZE]) % FLUID_DEFAULT_ALIGNMENT == 0);
+
+    /* from now on changes of the amps are ramped */
+    buffers->ramp_startup = 0;
 
     for(i = 0; i < bufcount; i++)
     {
         fluid_real_t *FLUID_RESTRICT buf = get_dest_buf(buffers, i, dest_bufs, dest_bufcount);
         fluid_real_t amp = buffers->bufs[i].amp;
+        int ramp = 0;
+
+        if(buf != NULL)
+        {
+            buf = &buf[start];
+            FLUID_ASSERT((uintptr_t)buf % FLUID_DEFAULT_ALIGNMENT == 0);
+        }
+
+        /* the first samples follow a changed amp, see synth.parameter-ramp */
+        if(buffers->bufs[i].ramp_count > 0)
+        {
+            fluid_real_t amp_incr = buffers->bufs[i].amp_incr;
+
+            ramp = (buffers->bufs[i].ramp_count < sample_count) ? buffers->bufs[i].ramp_count : sample_count;
+
+            if(buf != NULL)
+            {
+                for(dsp_i = 0; dsp_i < ramp; dsp_i++)
+                {
+                    amp += amp_incr;
+                    buf[dsp_i] += amp * dsp_buf[dsp_i];
+                }
+            }
+            else
+            {
+                amp += ramp * amp_incr;
+            }
+
+            buffers->bufs[i].ramp_count -= ramp;
+
+            if(buffers->bufs[i].ramp_count == 0)
+            {
+                amp = buffers->bufs[i].target_amp;
+            }
+
+            buffers->bufs[i].amp = amp;
+        }
 
         if(buf == NULL || amp == 0.0f)
         {
             continue;
         }
 
-        FLUID_ASSERT((uintptr_t)buf % FLUID_DEFAULT_ALIGNMENT == 0);
-
         #pragma omp simd aligned(dsp_buf,buf:FLUID_DEFAULT_ALIGNMENT)
 
-        for(dsp_i = (start_block * FLUID_BUFSIZE); dsp_i < sample_count; dsp_i++)
+        for(dsp_i = ramp; dsp_i < sample_count; dsp_i++)
         {
             buf[dsp_i] += amp * dsp_buf[dsp_i];
         }
@@ -383,40 +644,133 @@ fluid_rvoice_buffers_mix(fluid_rvoice_buffers_t *buffers,
 }
 
 /**
- * Synthesize one voice and add to buffer.
- * NOTE: If return value is less than blockcount*FLUID_BUFSIZE, that means
- * voice has been finished, removed and possibly replaced with another voice.
+ * Zero the sample buffer with the given dirty mask index before it is
+ * written to the first time in the current render call, unless it is known
+ * to be zero already.
  */
 static FLUID_INLINE void
-fluid_mixer_buffers_render_one(fluid_mixer_buffers_t *buffers,
-                               fluid_rvoice_t *rvoice, fluid_real_t **dest_bufs,
-                               unsigned int dest_bufcount, fluid_real_t *src_buf, int blockcount)
+fluid_mixer_buffers_claim(fluid_mixer_buffers_t *buffers, int index, fluid_real_t *buf, int sample_count)
 {
-    int i, total_samples = 0, start_block = 0;
+    if(buffers->dirty[index])
+    {
+        return;
+    }
 
-    for(i = 0; i < blockcount; i++)
+    if(buffers->zero_count[index] < sample_count)
+    {
+        FLUID_MEMSET(buf, 0, sample_count * sizeof(fluid_real_t));
+    }
+
+    buffers->dirty[index] = TRUE;
+}
+
+/**
+ * Zero the buffers the voice is about to mix into, unless they already hold
+ * data of the current render call.
+ */
+static FLUID_INLINE void
+fluid_mixer_buffers_touch(fluid_mixer_buffers_t *buffers, fluid_rvoice_buffers_t *rvoice_buffers,
+                          fluid_real_t **dest_bufs, int dest_bufcount, int blockcount)
+{
+    unsigned int i;
+
+    for(i = 0; i < rvoice_buffers->count; i++)
     {
-        int s = fluid_rvoice_write(rvoice, &src_buf[FLUID_BUFSIZE * i]);
+        int j = rvoice_buffers->bufs[i].mapping;
 
-        if(s == -1)
+        if(j >= dest_bufcount || j < 0 || dest_bufs[j] == NULL)
         {
-            start_block += s;
-            s = FLUID_BUFSIZE;
+            continue;
         }
 
-        total_samples += s;
+        fluid_mixer_buffers_claim(buffers, j, dest_bufs[j], blockcount * buffers->mixer->block_size);
+    }
+}
+
+/**
+ * Synthesize up to #FLUID_IIR_FILTER_BATCH voices and add them to the given
+ * blocks of the buffers.
+ *
+ * The voices are rendered block by block side by side, so that their
+ * filters can be processed in one go. Each voice gets its own block of
+ * \c src_buf.
+ * NOTE: Voices which finish during this call are set to NULL in \c rvoices,
+ * NULL entries are skipped.
+ */
+static void
+fluid_mixer_buffers_render_group(fluid_mixer_buffers_t *buffers,
+                                 fluid_rvoice_t **rvoices, int voice_count,
+                                 fluid_real_t **dest_bufs, unsigned int dest_bufcount,
+                                 fluid_real_t *src_buf, int first_block, int blockcount)
+{
+    fluid_rvoice_t *batch_voices[FLUID_IIR_FILTER_BATCH];
+    fluid_real_t *batch_bufs[FLUID_IIR_FILTER_BATCH];
+    int count[FLUID_IIR_FILTER_BATCH];
+    int i, v, batch, playing = voice_count;
+    int block_size = buffers->mixer->block_size;
 
-        if(s < FLUID_BUFSIZE)
+    for(v = 0; v < voice_count; v++)
+    {
+        if(rvoices[v] == NULL)
         {
-            break;
+            playing--;
+            continue;
         }
-    }
 
-    fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, -start_block, total_samples - ((-start_block)*FLUID_BUFSIZE), dest_bufs, dest_bufcount);
+        fluid_mixer_buffers_touch(buffers, &rvoices[v]->buffers, dest_bufs, dest_bufcount,
+                                  buffers->mixer->current_blockcount);
+    }
 
-    if(total_samples < blockcount * FLUID_BUFSIZE)
+    for(i = first_block; i < first_block + blockcount && playing > 0; i++)
     {
-        fluid_finish_rvoice(buffers, rvoice);
+        batch = 0;
+
+        for(v = 0; v < voice_count; v++)
+        {
+            fluid_real_t *dsp_buf = &src_buf[block_size * v];
+
+            if(rvoices[v] == NULL)
+            {
+                continue;
+            }
+
+            count[v] = fluid_rvoice_write(rvoices[v], dsp_buf);
+
+            if(count[v] == block_size)
+            {
+                batch_voices[batch] = rvoices[v];
+                batch_bufs[batch] = dsp_buf;
+                batch++;
+            }
+            else if(count[v] > 0)
+            {
+                fluid_rvoice_filter(rvoices[v], dsp_buf, count[v]);
+            }
+        }
+
+        if(batch > 0)
+        {
+            fluid_rvoice_filter_batch(batch_voices, batch_bufs, batch);
+        }
+
+        for(v = 0; v < voice_count; v++)
+        {
+            if(rvoices[v] == NULL)
+            {
+                continue;
+            }
+
+            fluid_rvoice_buffers_mix(&rvoices[v]->buffers, &src_buf[block_size * v], i * block_size, count[v],
+                                     dest_bufs, dest_bufcount);
+
+            /* -1 means quiet for this block, anything else short of a full block finished the voice */
+            if(count[v] != -1 && count[v] < block_size)
+            {
+                fluid_finish_rvoice(buffers, rvoices[v]);
+                rvoices[v] = NULL;
+                playing--;
+            }
+        }
     }
 }
 
@@ -473,6 +827,17 @@ fluid_mixer_buffers_update_polyphony(fluid_mixer_buffers_t *buffers, int value)
     }
 
     buffers->finished_voices = newptr;
+
+#if ENABLE_MIXER_THREADS
+    newptr = FLUID_REALLOC(buffers->pipeline_voices, value * sizeof(fluid_rvoice_t *));
+
+    if(newptr == NULL && value > 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    buffers->pipeline_voices = newptr;
+#endif
     return FLUID_OK;
 }
 
@@ -521,6 +886,12 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_polyphony)
     }
 #endif
 
+    if(handler->streamer != NULL
+            && fluid_sample_streamer_set_polyphony(handler->streamer, value) != FLUID_OK)
+    {
+        return /*FLUID_FAILED*/;
+    }
+
     handler->polyphony = value;
     return /*FLUID_OK*/;
 }
@@ -538,39 +909,50 @@ fluid_render_loop_singlethread(fluid_rvoice_mixer_t *mixer, int blockcount)
 
     fluid_profile_ref_var(prof_ref);
 
-    for(i = 0; i < mixer->active_voices; i++)
+    for(i = 0; i < mixer->active_voices; i += FLUID_IIR_FILTER_BATCH)
     {
-        fluid_mixer_buffers_render_one(&mixer->buffers, mixer->rvoices[i], bufs,
-                                       bufcount, local_buf, blockcount);
-        fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, 1,
-                      blockcount * FLUID_BUFSIZE);
+        fluid_rvoice_t *rvoices[FLUID_IIR_FILTER_BATCH];
+        int v, voice_count = mixer->active_voices - i;
+
+        if(voice_count > FLUID_IIR_FILTER_BATCH)
+        {
+            voice_count = FLUID_IIR_FILTER_BATCH;
+        }
+
+        for(v = 0; v < voice_count; v++)
+        {
+            rvoices[v] = mixer->rvoices[i + v];
+        }
+
+        fluid_mixer_buffers_render_group(&mixer->buffers, rvoices, voice_count, bufs,
+                                         bufcount, local_buf, 0, blockcount);
+        fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, voice_count,
+                      blockcount * mixer->block_size);
     }
 }
 
+/**
+ * Zero the sample buffers no voice has been mixed into in the current render
+ * call. Buffers still known to be zero from an earlier call are left alone,
+ * so that an idle mixer doesn't clear its buffers over and over again.
+ */
 static FLUID_INLINE void
 fluid_mixer_buffers_zero(fluid_mixer_buffers_t *buffers, int current_blockcount)
 {
-    int i, size = current_blockcount * FLUID_BUFSIZE * sizeof(fluid_real_t);
-
-    /* TODO: Optimize by only zero out the buffers we actually use later on. */
-    int buf_count = buffers->buf_count, fx_buf_count = buffers->fx_buf_count;
-
-    fluid_real_t *FLUID_RESTRICT buf_l = fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
-    fluid_real_t *FLUID_RESTRICT buf_r = fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT);
+    int i, sample_count = current_blockcount * buffers->mixer->block_size;
+    int buf_count = (buffers->buf_count + buffers->fx_buf_count) * 2;
 
     for(i = 0; i < buf_count; i++)
     {
-        FLUID_MEMSET(&buf_l[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
-        FLUID_MEMSET(&buf_r[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
-    }
-
-    buf_l = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-    buf_r = fluid_align_ptr(buffers->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
-
-    for(i = 0; i < fx_buf_count; i++)
-    {
-        FLUID_MEMSET(&buf_l[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
-        FLUID_MEMSET(&buf_r[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
+        if(buffers->dirty[i])
+        {
+            buffers->zero_count[i] = 0;
+        }
+        else if(buffers->zero_count[i] < sample_count)
+        {
+            FLUID_MEMSET(fluid_mixer_buffers_get_buf(buffers, i), 0, sample_count * sizeof(fluid_real_t));
+            buffers->zero_count[i] = sample_count;
+        }
     }
 }
 
@@ -608,7 +990,22 @@ fluid_mixer_buffers_init(fluid_mixer_buffers_t *buffers, fluid_rvoice_mixer_t *m
         return 0;
     }
 
+    buffers->dirty = FLUID_ARRAY(char, (buffers->buf_count + buffers->fx_buf_count) * 2);
+    buffers->zero_count = FLUID_ARRAY(int, (buffers->buf_count + buffers->fx_buf_count) * 2);
+
+    if(buffers->dirty == NULL || buffers->zero_count == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return 0;
+    }
+
+    FLUID_MEMSET(buffers->dirty, 0, (buffers->buf_count + buffers->fx_buf_count) * 2 * sizeof(*buffers->dirty));
+    FLUID_MEMSET(buffers->zero_count, 0, (buffers->buf_count + buffers->fx_buf_count) * 2 * sizeof(*buffers->zero_count));
+
     buffers->finished_voices = NULL;
+#if ENABLE_MIXER_THREADS
+    buffers->pipeline_voices = NULL;
+#endif
 
     if(fluid_mixer_buffers_update_polyphony(buffers, mixer->polyphony)
             == FLUID_FAILED)
@@ -641,6 +1038,7 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_samplerate)
     }
 
 #if LADSPA
+    mixer->fx.ladspa_tail = (int)(samplerate * MIXER_LADSPA_TAIL);
 
     if(mixer->ladspa_fx != NULL)
     {
@@ -654,9 +1052,11 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_samplerate)
 /**
  * @param buf_count number of primary stereo buffers
  * @param fx_buf_count number of stereo effect buffers
+ * @param block_size number of samples per block, a power of two up to #FLUID_BUFSIZE_MAX
  */
 fluid_rvoice_mixer_t *
-new_fluid_rvoice_mixer(int buf_count, int fx_buf_count, fluid_real_t sample_rate, fluid_rvoice_eventhandler_t *evthandler, int extra_threads, int prio)
+new_fluid_rvoice_mixer(int buf_count, int fx_buf_count, fluid_real_t sample_rate, int block_size,
+                       fluid_rvoice_eventhandler_t *evthandler, int extra_threads, int prio)
 {
     fluid_rvoice_mixer_t *mixer = FLUID_NEW(fluid_rvoice_mixer_t);
 
@@ -668,12 +1068,16 @@ new_fluid_rvoice_mixer(int buf_count, int fx_buf_count, fluid_real_t sample_rate
 
     FLUID_MEMSET(mixer, 0, sizeof(fluid_rvoice_mixer_t));
     mixer->eventhandler = evthandler;
+    mixer->block_size = block_size;
     mixer->buffers.buf_count = buf_count;
     mixer->buffers.fx_buf_count = fx_buf_count;
 
     /* allocate the reverb module */
     mixer->fx.reverb = new_fluid_revmodel(sample_rate);
     mixer->fx.chorus = new_fluid_chorus(sample_rate);
+#ifdef LADSPA
+    mixer->fx.ladspa_tail = (int)(sample_rate * MIXER_LADSPA_TAIL);
+#endif
 
     if(mixer->fx.reverb == NULL || mixer->fx.chorus == NULL)
     {
@@ -716,6 +1120,9 @@ static void
 fluid_mixer_buffers_free(fluid_mixer_buffers_t *buffers)
 {
     FLUID_FREE(buffers->finished_voices);
+#if ENABLE_MIXER_THREADS
+    FLUID_FREE(buffers->pipeline_voices);
+#endif
 
     /* free all the sample buffers */
     FLUID_FREE(buffers->local_buf);
@@ -723,6 +1130,8 @@ fluid_mixer_buffers_free(fluid_mixer_buffers_t *buffers)
     FLUID_FREE(buffers->right_buf);
     FLUID_FREE(buffers->fx_left_buf);
     FLUID_FREE(buffers->fx_right_buf);
+    FLUID_FREE(buffers->dirty);
+    FLUID_FREE(buffers->zero_count);
 }
 
 void delete_fluid_rvoice_mixer(fluid_rvoice_mixer_t *mixer)
@@ -765,6 +1174,8 @@ void delete_fluid_rvoice_mixer(fluid_rvoice_mixer_t *mixer)
         delete_fluid_chorus(mixer->fx.chorus);
     }
 
+    delete_fluid_sample_streamer(mixer->streamer);
+
     FLUID_FREE(mixer->rvoices);
     FLUID_FREE(mixer);
 }
@@ -833,6 +1244,50 @@ void fluid_rvoice_mixer_set_mix_fx(fluid_rvoice_mixer_t *mixer, int on)
     mixer->fx.mix_fx_to_out = on;
 }
 
+/**
+ * Enable or disable pipelined effects processing (NOTE: not thread safe,
+ * only to be called before rendering starts)
+ */
+void fluid_rvoice_mixer_set_pipelined_fx(fluid_rvoice_mixer_t *mixer, int on)
+{
+    mixer->pipelined_fx = on;
+}
+
+/**
+ * Enable or disable streaming sample data into buffers ahead of the voices
+ * (NOTE: not thread safe, only to be called before rendering starts)
+ * @param polyphony Maximum number of voices
+ */
+int fluid_rvoice_mixer_set_sample_streaming(fluid_rvoice_mixer_t *mixer, int on, int polyphony)
+{
+    if(mixer->streamer != NULL)
+    {
+        delete_fluid_sample_streamer(mixer->streamer);
+        mixer->streamer = NULL;
+    }
+
+    if(on)
+    {
+        mixer->streamer = new_fluid_sample_streamer(polyphony);
+
+        if(mixer->streamer == NULL)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/**
+ * Get the number of times a voice ran out of streamed sample data, 0 if
+ * sample streaming is off.
+ */
+int fluid_rvoice_mixer_get_stream_underruns(fluid_rvoice_mixer_t *mixer)
+{
+    return (mixer->streamer != NULL) ? fluid_sample_streamer_get_underruns(mixer->streamer) : 0;
+}
+
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_params)
 {
     fluid_rvoice_mixer_t *mixer = obj;
@@ -888,7 +1343,7 @@ int fluid_rvoice_mixer_get_fx_bufs(fluid_rvoice_mixer_t *mixer,
 
 int fluid_rvoice_mixer_get_bufcount(fluid_rvoice_mixer_t *mixer)
 {
-    return FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+    return FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE / mixer->block_size;
 }
 
 #if WITH_PROFILING
@@ -900,213 +1355,562 @@ int fluid_rvoice_mixer_get_active_voices(fluid_rvoice_mixer_t *mixer)
 
 #if ENABLE_MIXER_THREADS
 
-static FLUID_INLINE fluid_rvoice_t *
-fluid_mixer_get_mt_rvoice(fluid_rvoice_mixer_t *mixer)
-{
-    int i = fluid_atomic_int_exchange_and_add(&mixer->current_rvoice, 1);
-
-    if(i >= mixer->active_voices)
-    {
-        return NULL;
-    }
-
-    return mixer->rvoices[i];
-}
-
 #define THREAD_BUF_PROCESSING 0
 #define THREAD_BUF_VALID 1
 #define THREAD_BUF_NODATA 2
 #define THREAD_BUF_TERMINATE 3
+#define THREAD_BUF_MIXING 4
 
-/* Core thread function (processes voices in parallel to primary synthesis thread) */
-static fluid_thread_return_t
-fluid_mixer_thread_func(void *data)
+/**
+ * Returns the voice queue with the given index. Queue 0 belongs to the
+ * mixer itself, the others to the extra mixer threads.
+ */
+static FLUID_INLINE fluid_mixer_buffers_t *
+fluid_mixer_get_queue(fluid_rvoice_mixer_t *mixer, int queue)
 {
-    fluid_mixer_buffers_t *buffers = data;
-    fluid_rvoice_mixer_t *mixer = buffers->mixer;
-    int hasValidData = 0;
-    FLUID_DECLARE_VLA(fluid_real_t *, bufs, buffers->buf_count * 2 + buffers->fx_buf_count * 2);
-    int bufcount = 0;
-    int current_blockcount = 0;
-    fluid_real_t *local_buf = fluid_align_ptr(buffers->local_buf, FLUID_DEFAULT_ALIGNMENT);
+    return queue == 0 ? &mixer->buffers : &mixer->threads[queue - 1];
+}
 
-    while(!fluid_atomic_int_get(&mixer->threads_should_terminate))
+static FLUID_INLINE int
+fluid_mixer_rvoice_cost(const fluid_rvoice_t *rvoice)
+{
+    int cost;
+
+    switch(rvoice->dsp.interp_method)
     {
-        fluid_rvoice_t *rvoice = fluid_mixer_get_mt_rvoice(mixer);
+    case FLUID_INTERP_NONE:
+        cost = RVOICE_COST_NONE;
+        break;
+
+    case FLUID_INTERP_LINEAR:
+        cost = RVOICE_COST_LINEAR;
+        break;
+
+    case FLUID_INTERP_7THORDER:
+        cost = RVOICE_COST_7THORDER;
+        break;
+
+    default:
+        cost = RVOICE_COST_4THORDER;
+        break;
+    }
+
+    if(rvoice->resonant_custom_filter.type != FLUID_IIR_DISABLED)
+    {
+        cost += RVOICE_COST_CUSTOM_FILTER;
+    }
 
-        if(rvoice == NULL)
+    return cost;
+}
+
+/**
+ * Split the active voices into contiguous queues of about the same rendering
+ * cost. The queues before \c first_queue stay empty.
+ */
+static void
+fluid_mixer_distribute_voices(fluid_rvoice_mixer_t *mixer, int total_cost, int first_queue, int queue_count)
+{
+    int i, q, cost = 0;
+    int shares = queue_count - first_queue;
+    fluid_mixer_buffers_t *queue;
+
+    for(q = 0; q < first_queue; q++)
+    {
+        queue = fluid_mixer_get_queue(mixer, q);
+        fluid_atomic_int_set(&queue->queue_next, 0);
+        queue->queue_end = 0;
+    }
+
+    queue = fluid_mixer_get_queue(mixer, q);
+    fluid_atomic_int_set(&queue->queue_next, 0);
+
+    for(i = 0; i < mixer->active_voices; i++)
+    {
+        cost += fluid_mixer_rvoice_cost(mixer->rvoices[i]);
+
+        // close this queue once it got its share of the total cost
+        if(q < queue_count - 1 && cost * shares >= total_cost * (q - first_queue + 1))
         {
-            // if no voices: signal rendered buffers, sleep
-            fluid_atomic_int_set(&buffers->ready, hasValidData ? THREAD_BUF_VALID : THREAD_BUF_NODATA);
-            fluid_cond_mutex_lock(mixer->thread_ready_m);
-            fluid_cond_signal(mixer->thread_ready);
-            fluid_cond_mutex_unlock(mixer->thread_ready_m);
+            queue->queue_end = i + 1;
+            queue = fluid_mixer_get_queue(mixer, ++q);
+            fluid_atomic_int_set(&queue->queue_next, i + 1);
+        }
+    }
 
-            fluid_cond_mutex_lock(mixer->wakeup_threads_m);
+    queue->queue_end = mixer->active_voices;
 
-            while(1)
-            {
-                int j = fluid_atomic_int_get(&buffers->ready);
+    // fewer voices than queues: the remaining ones stay empty
+    while(++q < queue_count)
+    {
+        queue = fluid_mixer_get_queue(mixer, q);
+        fluid_atomic_int_set(&queue->queue_next, mixer->active_voices);
+        queue->queue_end = mixer->active_voices;
+    }
 
-                if(j == THREAD_BUF_PROCESSING || j == THREAD_BUF_TERMINATE)
-                {
-                    break;
-                }
+    mixer->queue_count = queue_count;
+}
 
-                fluid_cond_wait(mixer->wakeup_threads, mixer->wakeup_threads_m);
+/**
+ * Get the next voice to render. Takes voices from the own queue first and
+ * steals from the other queues once that one is empty.
+ */
+static FLUID_INLINE fluid_rvoice_t *
+fluid_mixer_get_mt_rvoice(fluid_rvoice_mixer_t *mixer, int queue)
+{
+    int i;
+
+    for(i = 0; i < mixer->queue_count; i++)
+    {
+        fluid_mixer_buffers_t *q = fluid_mixer_get_queue(mixer, (queue + i) % mixer->queue_count);
+
+        // don't touch the counter of an exhausted queue, to keep it off the other threads' cache
+        if(fluid_atomic_int_get(&q->queue_next) < q->queue_end)
+        {
+            int next = fluid_atomic_int_exchange_and_add(&q->queue_next, 1);
+
+            if(next < q->queue_end)
+            {
+                return mixer->rvoices[next];
             }
+        }
+    }
+
+    return NULL;
+}
 
-            fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+/**
+ * Get up to #FLUID_IIR_FILTER_BATCH voices to render side by side.
+ * @return the number of voices put into \c rvoices, 0 if all are taken
+ */
+static FLUID_INLINE int
+fluid_mixer_get_mt_rvoices(fluid_rvoice_mixer_t *mixer, int queue, fluid_rvoice_t **rvoices)
+{
+    int voice_count;
+
+    for(voice_count = 0; voice_count < FLUID_IIR_FILTER_BATCH; voice_count++)
+    {
+        rvoices[voice_count] = fluid_mixer_get_mt_rvoice(mixer, queue);
 
-            hasValidData = 0;
+        if(rvoices[voice_count] == NULL)
+        {
+            break;
         }
-        else
+    }
+
+    return voice_count;
+}
+
+/**
+ * Sum the sample buffers of the extra threads into the buffers of the mixer.
+ * The buffers are handed out one by one, so that all threads can take part
+ * in the reduction. Buffers no thread has written to are skipped.
+ */
+static void
+fluid_mixer_reduce_buffers(fluid_rvoice_mixer_t *mixer)
+{
+    int i, j, buf;
+    int buf_count = (mixer->buffers.buf_count + mixer->buffers.fx_buf_count) * 2;
+    int scount = mixer->current_blockcount * mixer->block_size;
+
+    while((buf = fluid_atomic_int_exchange_and_add(&mixer->current_mix_buf, 1)) < buf_count)
+    {
+        fluid_real_t *FLUID_RESTRICT base_dst = fluid_mixer_buffers_get_buf(&mixer->buffers, buf);
+
+        for(i = 0; i < mixer->queue_count - 1; i++)
         {
-            // else: if buffer is not zeroed, zero buffers
-            if(!hasValidData)
+            fluid_real_t *FLUID_RESTRICT base_src;
+
+            if(!mixer->threads[i].dirty[buf])
             {
-                // blockcount may have changed, since thread was put to sleep
-                current_blockcount = mixer->current_blockcount;
-                fluid_mixer_buffers_zero(buffers, current_blockcount);
-                bufcount = fluid_mixer_buffers_prepare(buffers, bufs);
-                hasValidData = 1;
+                continue;
             }
 
-            // then render voice to buffers
-            fluid_mixer_buffers_render_one(buffers, rvoice, bufs, bufcount, local_buf, current_blockcount);
+            fluid_mixer_buffers_claim(&mixer->buffers, buf, base_dst, scount);
+            base_src = fluid_mixer_buffers_get_buf(&mixer->threads[i], buf);
+
+            #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+
+            for(j = 0; j < scount; j++)
+            {
+                base_dst[j] += base_src[j];
+            }
         }
     }
-
-    return FLUID_THREAD_RETURN_VALUE;
 }
 
+/**
+ * Wait until the mixer hands out work (or asks to terminate). Polls for a
+ * while before going to sleep, so that the mixer only needs to signal the
+ * condition variable if the thread actually sleeps.
+ */
 static void
-fluid_mixer_buffers_mix(fluid_mixer_buffers_t *dst, fluid_mixer_buffers_t *src, int current_blockcount)
+fluid_mixer_thread_wait(fluid_mixer_buffers_t *buffers)
 {
+    fluid_rvoice_mixer_t *mixer = buffers->mixer;
     int i, j;
-    int scount = current_blockcount * FLUID_BUFSIZE;
-    int minbuf;
-    fluid_real_t *FLUID_RESTRICT base_src;
-    fluid_real_t *FLUID_RESTRICT base_dst;
-
-    minbuf = dst->buf_count;
 
-    if(minbuf > src->buf_count)
+    for(i = 0; i < MIXER_SPIN_COUNT; i++)
     {
-        minbuf = src->buf_count;
+        j = fluid_atomic_int_get(&buffers->ready);
+
+        if(j == THREAD_BUF_PROCESSING || j == THREAD_BUF_MIXING || j == THREAD_BUF_TERMINATE)
+        {
+            return;
+        }
     }
 
-    base_src = fluid_align_ptr(src->left_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->left_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_cond_mutex_lock(mixer->wakeup_threads_m);
+    fluid_atomic_int_inc(&mixer->parked_threads);
 
-    for(i = 0; i < minbuf; i++)
+    while(1)
     {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+        j = fluid_atomic_int_get(&buffers->ready);
 
-        for(j = 0; j < scount; j++)
+        if(j == THREAD_BUF_PROCESSING || j == THREAD_BUF_MIXING || j == THREAD_BUF_TERMINATE)
         {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
+            break;
         }
+
+        fluid_cond_wait(mixer->wakeup_threads, mixer->wakeup_threads_m);
     }
 
-    base_src = fluid_align_ptr(src->right_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->right_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_atomic_int_add(&mixer->parked_threads, -1);
+    fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+}
+
+/**
+ * Set the state of a thread's buffers and wake up the mixer, if it went to
+ * sleep waiting for that.
+ */
+static void
+fluid_mixer_thread_set_ready(fluid_mixer_buffers_t *buffers, int ready)
+{
+    fluid_rvoice_mixer_t *mixer = buffers->mixer;
+
+    fluid_atomic_int_set(&buffers->ready, ready);
 
-    for(i = 0; i < minbuf; i++)
+    if(fluid_atomic_int_get(&mixer->mixer_parked))
     {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+        fluid_cond_mutex_lock(mixer->thread_ready_m);
+        fluid_cond_signal(mixer->thread_ready);
+        fluid_cond_mutex_unlock(mixer->thread_ready_m);
+    }
+}
 
-        for(j = 0; j < scount; j++)
+/**
+ * Render the voices of the own queue block by block, without stealing any
+ * voices of other queues. After each block, the mixer is told that it can
+ * process the block, while the next one is rendered.
+ */
+static void
+fluid_mixer_thread_render_pipelined(fluid_mixer_buffers_t *buffers, fluid_real_t **bufs, int bufcount,
+                                    fluid_real_t *local_buf, int blockcount)
+{
+    fluid_rvoice_mixer_t *mixer = buffers->mixer;
+    int i, v, voice_count, start = fluid_atomic_int_get(&buffers->queue_next);
+    int count = buffers->queue_end - start;
+
+    for(v = 0; v < count; v++)
+    {
+        buffers->pipeline_voices[v] = mixer->rvoices[start + v];
+    }
+
+    for(i = 0; i < blockcount; i++)
+    {
+        for(v = 0; v < count; v += FLUID_IIR_FILTER_BATCH)
+        {
+            voice_count = count - v;
+
+            if(voice_count > FLUID_IIR_FILTER_BATCH)
+            {
+                voice_count = FLUID_IIR_FILTER_BATCH;
+            }
+
+            fluid_mixer_buffers_render_group(buffers, &buffers->pipeline_voices[v], voice_count,
+                                             bufs, bufcount, local_buf, i, 1);
+        }
+
+        fluid_atomic_int_set(&buffers->blocks_done, i + 1);
+
+        if(fluid_atomic_int_get(&mixer->mixer_parked))
         {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
+            fluid_cond_mutex_lock(mixer->thread_ready_m);
+            fluid_cond_signal(mixer->thread_ready);
+            fluid_cond_mutex_unlock(mixer->thread_ready_m);
         }
     }
+}
 
-    minbuf = dst->fx_buf_count;
+/* Core thread function (processes voices in parallel to primary synthesis thread) */
+static fluid_thread_return_t
+fluid_mixer_thread_func(void *data)
+{
+    fluid_mixer_buffers_t *buffers = data;
+    fluid_rvoice_mixer_t *mixer = buffers->mixer;
+    FLUID_DECLARE_VLA(fluid_real_t *, bufs, buffers->buf_count * 2 + buffers->fx_buf_count * 2);
+    int queue = (int)(buffers - mixer->threads) + 1;
+    fluid_real_t *local_buf = fluid_align_ptr(buffers->local_buf, FLUID_DEFAULT_ALIGNMENT);
 
-    if(minbuf > src->fx_buf_count)
+    while(!fluid_atomic_int_get(&mixer->threads_should_terminate))
     {
-        minbuf = src->fx_buf_count;
+        switch(fluid_atomic_int_get(&buffers->ready))
+        {
+        case THREAD_BUF_PROCESSING:
+        {
+            // blockcount may have changed, since thread was put to sleep
+            int current_blockcount = mixer->current_blockcount;
+            int bufcount = fluid_mixer_buffers_prepare(buffers, bufs);
+            fluid_rvoice_t *rvoices[FLUID_IIR_FILTER_BATCH];
+            int voice_count;
+
+            // buffers are zeroed when they are rendered to the first time
+            FLUID_MEMSET(buffers->dirty, 0, (buffers->buf_count + buffers->fx_buf_count) * 2 * sizeof(*buffers->dirty));
+
+            if(mixer->pipelined_fx)
+            {
+                fluid_mixer_thread_render_pipelined(buffers, bufs, bufcount, local_buf, current_blockcount);
+            }
+            else
+            {
+                while((voice_count = fluid_mixer_get_mt_rvoices(mixer, queue, rvoices)) > 0)
+                {
+                    fluid_mixer_buffers_render_group(buffers, rvoices, voice_count, bufs, bufcount, local_buf, 0, current_blockcount);
+                }
+            }
+
+            // no voices left: signal rendered buffers
+            fluid_mixer_thread_set_ready(buffers, THREAD_BUF_VALID);
+            break;
+        }
+
+        case THREAD_BUF_MIXING:
+            fluid_mixer_reduce_buffers(mixer);
+            fluid_mixer_thread_set_ready(buffers, THREAD_BUF_NODATA);
+            break;
+        }
+
+        // sleep until there is something to do
+        fluid_mixer_thread_wait(buffers);
     }
 
-    base_src = fluid_align_ptr(src->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    return FLUID_THREAD_RETURN_VALUE;
+}
 
-    for(i = 0; i < minbuf; i++)
+/**
+ * Wait until none of the extra threads is in the given state anymore.
+ * Polls for a while before going to sleep.
+ */
+static void
+fluid_mixer_wait_threads(fluid_rvoice_mixer_t *mixer, int extra_threads, int state)
+{
+    int i, spin, is_busy;
+
+    for(spin = 0; spin < MIXER_SPIN_COUNT; spin++)
     {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+        for(i = 0; i < extra_threads; i++)
+        {
+            if(fluid_atomic_int_get(&mixer->threads[i].ready) == state)
+            {
+                break;
+            }
+        }
 
-        for(j = 0; j < scount; j++)
+        if(i == extra_threads)
         {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
+            return;
         }
     }
 
-    base_src = fluid_align_ptr(src->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_cond_mutex_lock(mixer->thread_ready_m);
+    fluid_atomic_int_set(&mixer->mixer_parked, TRUE);
 
-    for(i = 0; i < minbuf; i++)
+    do
     {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+        is_busy = 0;
 
-        for(j = 0; j < scount; j++)
+        for(i = 0; i < extra_threads; i++)
         {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
+            if(fluid_atomic_int_get(&mixer->threads[i].ready) == state)
+            {
+                is_busy = 1;
+                fluid_cond_wait(mixer->thread_ready, mixer->thread_ready_m);
+                break;
+            }
         }
     }
-}
+    while(is_busy);
 
+    fluid_atomic_int_set(&mixer->mixer_parked, FALSE);
+    fluid_cond_mutex_unlock(mixer->thread_ready_m);
+}
 
 /**
- * Go through all threads and see if someone is finished for mixing
+ * Signal the extra threads to enter the given state, waking up sleeping ones.
  */
-static int
-fluid_mixer_mix_in(fluid_rvoice_mixer_t *mixer, int extra_threads, int current_blockcount)
+static void
+fluid_mixer_wakeup_threads(fluid_rvoice_mixer_t *mixer, int extra_threads, int state)
 {
-    int i, result, hasmixed;
+    int i;
 
-    do
+    for(i = 0; i < extra_threads; i++)
+    {
+        fluid_atomic_int_set(&mixer->threads[i].ready, state);
+    }
+
+    // no need to bother the condition variable if all threads are still polling
+    if(fluid_atomic_int_get(&mixer->parked_threads) > 0)
     {
-        hasmixed = 0;
-        result = 0;
+        fluid_cond_mutex_lock(mixer->wakeup_threads_m);
+        fluid_cond_broadcast(mixer->wakeup_threads);
+        fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+    }
+}
+
+/**
+ * Wait until all extra threads have rendered more than the given number of
+ * blocks. Polls for a while before going to sleep.
+ */
+static void
+fluid_mixer_wait_blocks(fluid_rvoice_mixer_t *mixer, int extra_threads, int blocks)
+{
+    int i, spin, is_busy;
 
+    for(spin = 0; spin < MIXER_SPIN_COUNT; spin++)
+    {
         for(i = 0; i < extra_threads; i++)
         {
-            int j = fluid_atomic_int_get(&mixer->threads[i].ready);
-
-            switch(j)
+            if(fluid_atomic_int_get(&mixer->threads[i].blocks_done) <= blocks)
             {
-            case THREAD_BUF_PROCESSING:
-                result = 1;
                 break;
+            }
+        }
+
+        if(i == extra_threads)
+        {
+            return;
+        }
+    }
+
+    fluid_cond_mutex_lock(mixer->thread_ready_m);
+    fluid_atomic_int_set(&mixer->mixer_parked, TRUE);
 
-            case THREAD_BUF_VALID:
-                fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_NODATA);
-                fluid_mixer_buffers_mix(&mixer->buffers, &mixer->threads[i], current_blockcount);
-                hasmixed = 1;
+    do
+    {
+        is_busy = 0;
+
+        for(i = 0; i < extra_threads; i++)
+        {
+            if(fluid_atomic_int_get(&mixer->threads[i].blocks_done) <= blocks)
+            {
+                is_busy = 1;
+                fluid_cond_wait(mixer->thread_ready, mixer->thread_ready_m);
                 break;
             }
         }
     }
-    while(hasmixed);
+    while(is_busy);
 
-    return result;
+    fluid_atomic_int_set(&mixer->mixer_parked, FALSE);
+    fluid_cond_mutex_unlock(mixer->thread_ready_m);
 }
 
+/**
+ * Sum the given block of the sample buffers of the extra threads into the
+ * buffers of the mixer.
+ */
 static void
+fluid_mixer_reduce_block(fluid_rvoice_mixer_t *mixer, int extra_threads, int block)
+{
+    int i, j, buf;
+    int buf_count = (mixer->buffers.buf_count + mixer->buffers.fx_buf_count) * 2;
+    int start = block * mixer->block_size;
+
+    for(buf = 0; buf < buf_count; buf++)
+    {
+        fluid_real_t *FLUID_RESTRICT base_dst = fluid_mixer_buffers_get_buf(&mixer->buffers, buf);
+
+        for(i = 0; i < extra_threads; i++)
+        {
+            fluid_real_t *FLUID_RESTRICT base_src;
+
+            if(!mixer->threads[i].dirty[buf])
+            {
+                continue;
+            }
+
+            fluid_mixer_buffers_claim(&mixer->buffers, buf, base_dst,
+                                      mixer->current_blockcount * mixer->block_size);
+            base_src = fluid_mixer_buffers_get_buf(&mixer->threads[i], buf);
+
+            #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+
+            for(j = start; j < start + mixer->block_size; j++)
+            {
+                base_dst[j] += base_src[j];
+            }
+        }
+    }
+}
+
+/**
+ * Let the extra threads render the voices, while the mixer sums up and
+ * processes the effects of each block as soon as it is complete. As the
+ * effects are causal, they run for one block while the next one is rendered.
+ */
+static void
+fluid_render_loop_pipelined(fluid_rvoice_mixer_t *mixer, int current_blockcount, int extra_threads,
+                            int total_cost)
+{
+    int i;
+
+    for(i = 0; i < extra_threads; i++)
+    {
+        fluid_atomic_int_set(&mixer->threads[i].blocks_done, 0);
+    }
+
+    fluid_mixer_distribute_voices(mixer, total_cost, 1, extra_threads + 1);
+    fluid_mixer_wakeup_threads(mixer, extra_threads, THREAD_BUF_PROCESSING);
+
+    for(i = 0; i < current_blockcount; i++)
+    {
+        fluid_mixer_wait_blocks(mixer, extra_threads, i);
+        fluid_mixer_reduce_block(mixer, extra_threads, i);
+
+        // after the first block, all buffers the voices render to are known
+        if(i == 0)
+        {
+            fluid_mixer_buffers_zero(&mixer->buffers, current_blockcount);
+        }
+
+        fluid_rvoice_mixer_process_fx(mixer, i, 1);
+    }
+
+    fluid_mixer_wait_threads(mixer, extra_threads, THREAD_BUF_PROCESSING);
+}
+
+/**
+ * Render the voices with the help of the extra threads.
+ * @return TRUE if the effects have been processed as well
+ */
+static int
 fluid_render_loop_multithread(fluid_rvoice_mixer_t *mixer, int current_blockcount)
 {
-    int i, bufcount;
+    int i, bufcount, total_cost = 0;
     fluid_real_t *local_buf = fluid_align_ptr(mixer->buffers.local_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_rvoice_t *rvoices[FLUID_IIR_FILTER_BATCH];
+    int voice_count;
 
     FLUID_DECLARE_VLA(fluid_real_t *, bufs,
                       mixer->buffers.buf_count * 2 + mixer->buffers.fx_buf_count * 2);
+    int extra_threads;
+
+    for(i = 0; i < mixer->active_voices; i++)
+    {
+        total_cost += fluid_mixer_rvoice_cost(mixer->rvoices[i]);
+    }
+
     // How many threads should we start this time?
-    int extra_threads = mixer->active_voices / VOICES_PER_THREAD;
+    extra_threads = total_cost / COST_PER_THREAD;
 
     if(extra_threads > mixer->thread_count)
     {
@@ -1117,65 +1921,40 @@ fluid_render_loop_multithread(fluid_rvoice_mixer_t *mixer, int current_blockcoun
     {
         // No extra threads? No thread overhead!
         fluid_render_loop_singlethread(mixer, current_blockcount);
-        return;
+        return FALSE;
     }
 
-    bufcount = fluid_mixer_buffers_prepare(&mixer->buffers, bufs);
-
-    // Prepare voice list
-    fluid_cond_mutex_lock(mixer->wakeup_threads_m);
-    fluid_atomic_int_set(&mixer->current_rvoice, 0);
-
-    for(i = 0; i < extra_threads; i++)
+    if(mixer->pipelined_fx)
     {
-        fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_PROCESSING);
+        fluid_render_loop_pipelined(mixer, current_blockcount, extra_threads, total_cost);
+        return TRUE;
     }
 
-    // Signal threads to wake up
-    fluid_cond_broadcast(mixer->wakeup_threads);
-    fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
-
-    // If thread is finished, mix it in
-    while(fluid_mixer_mix_in(mixer, extra_threads, current_blockcount))
-    {
-        // Otherwise get a voice and render it
-        fluid_rvoice_t *rvoice = fluid_mixer_get_mt_rvoice(mixer);
+    bufcount = fluid_mixer_buffers_prepare(&mixer->buffers, bufs);
 
-        if(rvoice != NULL)
-        {
-            fluid_profile_ref_var(prof_ref);
-            fluid_mixer_buffers_render_one(&mixer->buffers, rvoice, bufs, bufcount, local_buf, current_blockcount);
-            fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, 1,
-                          current_blockcount * FLUID_BUFSIZE);
-            //test++;
-        }
-        else
-        {
-            // If no voices, wait for mixes. Make sure one is still processing to avoid deadlock
-            int is_processing = 0;
-            //waits++;
-            fluid_cond_mutex_lock(mixer->thread_ready_m);
+    // Prepare voice queues and wake up the threads
+    fluid_mixer_distribute_voices(mixer, total_cost, 0, extra_threads + 1);
+    fluid_mixer_wakeup_threads(mixer, extra_threads, THREAD_BUF_PROCESSING);
 
-            for(i = 0; i < extra_threads; i++)
-            {
-                if(fluid_atomic_int_get(&mixer->threads[i].ready) ==
-                        THREAD_BUF_PROCESSING)
-                {
-                    is_processing = 1;
-                }
-            }
+    // Render voices along with the threads
+    while((voice_count = fluid_mixer_get_mt_rvoices(mixer, 0, rvoices)) > 0)
+    {
+        fluid_profile_ref_var(prof_ref);
+        fluid_mixer_buffers_render_group(&mixer->buffers, rvoices, voice_count, bufs, bufcount, local_buf, 0, current_blockcount);
+        fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, voice_count,
+                      current_blockcount * mixer->block_size);
+    }
 
-            if(is_processing)
-            {
-                fluid_cond_wait(mixer->thread_ready, mixer->thread_ready_m);
-            }
+    // All voices are taken, wait for the threads to finish rendering them
+    fluid_mixer_wait_threads(mixer, extra_threads, THREAD_BUF_PROCESSING);
 
-            fluid_cond_mutex_unlock(mixer->thread_ready_m);
-        }
-    }
+    // Then sum up the thread buffers, again with the help of the threads
+    fluid_atomic_int_set(&mixer->current_mix_buf, 0);
+    fluid_mixer_wakeup_threads(mixer, extra_threads, THREAD_BUF_MIXING);
+    fluid_mixer_reduce_buffers(mixer);
+    fluid_mixer_wait_threads(mixer, extra_threads, THREAD_BUF_MIXING);
 
-    //FLUID_LOG(FLUID_DBG, "Blockcount: %d, mixed %d of %d voices myself, waits = %d",
-    //	    current_blockcount, test, mixer->active_voices, waits);
+    return FALSE;
 }
 
 static void delete_rvoice_mixer_threads(fluid_rvoice_mixer_t *mixer)
@@ -1268,26 +2047,26 @@ static int fluid_rvoice_mixer_set_threads(fluid_rvoice_mixer_t *mixer, int threa
 
 /**
  * Synthesize audio into buffers
- * @param blockcount number of blocks to render, each having FLUID_BUFSIZE samples
+ * @param blockcount number of blocks to render, each having block_size samples
  * @return number of blocks rendered
  */
 int
 fluid_rvoice_mixer_render(fluid_rvoice_mixer_t *mixer, int blockcount)
 {
+    int fx_done = FALSE;
     fluid_profile_ref_var(prof_ref);
 
     mixer->current_blockcount = blockcount;
 
-    // Zero buffers
-    fluid_mixer_buffers_zero(&mixer->buffers, blockcount);
-    fluid_profile(FLUID_PROF_ONE_BLOCK_CLEAR, prof_ref, mixer->active_voices,
-                  blockcount * FLUID_BUFSIZE);
+    // Buffers are zeroed when they are rendered to the first time
+    FLUID_MEMSET(mixer->buffers.dirty, 0,
+                 (mixer->buffers.buf_count + mixer->buffers.fx_buf_count) * 2 * sizeof(*mixer->buffers.dirty));
 
 #if ENABLE_MIXER_THREADS
 
     if(mixer->thread_count > 0)
     {
-        fluid_render_loop_multithread(mixer, blockcount);
+        fx_done = fluid_render_loop_multithread(mixer, blockcount);
     }
     else
     {
@@ -1296,14 +2075,30 @@ fluid_rvoice_mixer_render(fluid_rvoice_mixer_t *mixer, int blockcount)
     }
 
     fluid_profile(FLUID_PROF_ONE_BLOCK_VOICES, prof_ref, mixer->active_voices,
-                  blockcount * FLUID_BUFSIZE);
+                  blockcount * mixer->block_size);
 
+    if(!fx_done)
+    {
+        // Zero the buffers no voice has rendered to
+        fluid_mixer_buffers_zero(&mixer->buffers, blockcount);
+        fluid_profile(FLUID_PROF_ONE_BLOCK_CLEAR, prof_ref, mixer->active_voices,
+                      blockcount * mixer->block_size);
 
-    // Process reverb & chorus
-    fluid_rvoice_mixer_process_fx(mixer, blockcount);
+        // Process reverb & chorus
+        fluid_rvoice_mixer_process_fx(mixer, 0, blockcount);
+    }
+
+#ifdef LADSPA
+    fluid_rvoice_mixer_process_ladspa(mixer, blockcount);
+#endif
 
     // Call the callback and pack active voice array
     fluid_rvoice_mixer_process_finished_voices(mixer);
 
+    if(mixer->streamer != NULL)
+    {
+        fluid_sample_streamer_update(mixer->streamer, mixer->rvoices, mixer->active_voices);
+    }
+
     return blockcount;
 }
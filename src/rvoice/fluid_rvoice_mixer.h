@@ -38,7 +38,7 @@ int fluid_rvoice_mixer_get_bufcount(fluid_rvoice_mixer_t *mixer);
 int fluid_rvoice_mixer_get_active_voices(fluid_rvoice_mixer_t *mixer);
 #endif
 fluid_rvoice_mixer_t *new_fluid_rvoice_mixer(int buf_count, int fx_buf_count,
-        fluid_real_t sample_rate, fluid_rvoice_eventhandler_t *, int, int);
+        fluid_real_t sample_rate, int block_size, fluid_rvoice_eventhandler_t *, int, int);
 
 void delete_fluid_rvoice_mixer(fluid_rvoice_mixer_t *);
 
@@ -57,6 +57,9 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_chorus);
 
 
 void fluid_rvoice_mixer_set_mix_fx(fluid_rvoice_mixer_t *mixer, int on);
+void fluid_rvoice_mixer_set_pipelined_fx(fluid_rvoice_mixer_t *mixer, int on);
+int fluid_rvoice_mixer_set_sample_streaming(fluid_rvoice_mixer_t *mixer, int on, int polyphony);
+int fluid_rvoice_mixer_get_stream_underruns(fluid_rvoice_mixer_t *mixer);
 #ifdef LADSPA
 void fluid_rvoice_mixer_set_ladspa(fluid_rvoice_mixer_t *mixer,
                                    fluid_ladspa_fx_t *ladspa_fx, int audio_groups);
@@ -0,0 +1,599 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+/* SAMPLE STREAMING
+ *
+ * Streamed samples only keep their beginning in memory, see
+ * synth.sample-streaming. The rest of their data is mapped from the
+ * Soundfont file, which the synthesis thread must not touch: reading it may
+ * have to wait for the disk.
+ *
+ * Instead, each voice playing a streamed sample gets a stream with
+ * FLUID_SAMPLE_STREAM_WINDOWS windows. The mixer passes the playing voices to
+ * fluid_sample_streamer_update() after each rendering call. Whenever a window
+ * of a voice is free, the next part of the sample, as long as the preloaded
+ * beginning, is requested for it. A dedicated thread copies the requested
+ * parts into the windows in order. Consecutive parts overlap by a quarter, so
+ * that each block of the voice finds all the sample points it reads within a
+ * single window.
+ *
+ * fluid_rvoice_write() renders a streamed voice from the preloaded beginning
+ * or a window which has arrived. If neither holds the sample points of the
+ * next block, the block is silent and an underrun is counted.
+ */
+
+#include "fluid_sample_streamer.h"
+#include "fluid_samplecache.h"
+#include "fluid_ringbuffer.h"
+#include "fluid_sys.h"
+
+typedef struct
+{
+    const short *data;
+    int has_data24;
+    fluid_sample_stream_window_t *window;
+    unsigned int start;
+    unsigned int count;
+    unsigned int seq;
+} fluid_sample_stream_request_t;
+
+struct _fluid_sample_streamer_t
+{
+    fluid_ringbuffer_t *queue;          /**< Requests from the mixer to the streaming thread */
+    unsigned int next_seq;              /**< Used by the mixer only: sequence number of the next request */
+    fluid_atomic_int_t done_seq;        /**< Atomic: sequence number of the last completed request */
+    fluid_atomic_int_t underruns;       /**< Atomic: number of times a voice ran out of sample data */
+    fluid_atomic_int_t should_terminate; /**< Atomic: Set to TRUE when the thread should terminate */
+
+    fluid_sample_stream_t **streams;    /**< Used by the mixer only: one stream per voice */
+    int stream_count;
+
+    fluid_cond_t *wakeup;               /**< Signalled when requests have been queued */
+    fluid_cond_mutex_t *wakeup_m;       /**< wakeup mutex companion */
+    fluid_thread_t *thread;
+};
+
+static fluid_thread_return_t fluid_sample_streamer_thread_func(void *data);
+
+
+/**
+ * Create a sample streamer along with its thread.
+ * @param polyphony Maximum number of voices, which may all play streamed samples
+ */
+fluid_sample_streamer_t *
+new_fluid_sample_streamer(int polyphony)
+{
+    fluid_sample_streamer_t *streamer = FLUID_NEW(fluid_sample_streamer_t);
+
+    if(streamer == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(streamer, 0, sizeof(*streamer));
+    streamer->next_seq = 1;
+
+    streamer->queue = new_fluid_ringbuffer(polyphony, sizeof(fluid_sample_stream_request_t));
+    streamer->wakeup = new_fluid_cond();
+    streamer->wakeup_m = new_fluid_cond_mutex();
+
+    if(streamer->queue == NULL || streamer->wakeup == NULL || streamer->wakeup_m == NULL
+            || fluid_sample_streamer_set_polyphony(streamer, polyphony) != FLUID_OK)
+    {
+        delete_fluid_sample_streamer(streamer);
+        return NULL;
+    }
+
+    streamer->thread = new_fluid_thread("sample-streamer", fluid_sample_streamer_thread_func,
+                                        streamer, 0, FALSE);
+
+    if(streamer->thread == NULL)
+    {
+        delete_fluid_sample_streamer(streamer);
+        return NULL;
+    }
+
+    return streamer;
+}
+
+void
+delete_fluid_sample_streamer(fluid_sample_streamer_t *streamer)
+{
+    int i, w;
+
+    fluid_return_if_fail(streamer != NULL);
+
+    if(streamer->thread != NULL)
+    {
+        fluid_cond_mutex_lock(streamer->wakeup_m);
+        fluid_atomic_int_set(&streamer->should_terminate, TRUE);
+        fluid_cond_signal(streamer->wakeup);
+        fluid_cond_mutex_unlock(streamer->wakeup_m);
+
+        fluid_thread_join(streamer->thread);
+        delete_fluid_thread(streamer->thread);
+    }
+
+    if(streamer->wakeup != NULL)
+    {
+        delete_fluid_cond(streamer->wakeup);
+    }
+
+    if(streamer->wakeup_m != NULL)
+    {
+        delete_fluid_cond_mutex(streamer->wakeup_m);
+    }
+
+    if(streamer->queue != NULL)
+    {
+        delete_fluid_ringbuffer(streamer->queue);
+    }
+
+    for(i = 0; i < streamer->stream_count; i++)
+    {
+        for(w = 0; w < FLUID_SAMPLE_STREAM_WINDOWS; w++)
+        {
+            FLUID_FREE(streamer->streams[i]->window[w].data);
+            FLUID_FREE(streamer->streams[i]->window[w].data24);
+        }
+
+        FLUID_FREE(streamer->streams[i]);
+    }
+
+    FLUID_FREE(streamer->streams);
+    FLUID_FREE(streamer);
+}
+
+/**
+ * Provide a stream for each voice, when the polyphony has been raised.
+ * (NOTE: not hard real-time capable, the streams are only ever added)
+ */
+int
+fluid_sample_streamer_set_polyphony(fluid_sample_streamer_t *streamer, int polyphony)
+{
+    fluid_sample_stream_t **streams;
+
+    if(polyphony <= streamer->stream_count)
+    {
+        return FLUID_OK;
+    }
+
+    streams = FLUID_REALLOC(streamer->streams, polyphony * sizeof(*streams));
+
+    if(streams == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    streamer->streams = streams;
+
+    /* The windows stay where they are, requests queued for them point to them */
+    for(; streamer->stream_count < polyphony; streamer->stream_count++)
+    {
+        streams[streamer->stream_count] = FLUID_NEW(fluid_sample_stream_t);
+
+        if(streams[streamer->stream_count] == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMSET(streams[streamer->stream_count], 0, sizeof(fluid_sample_stream_t));
+    }
+
+    return FLUID_OK;
+}
+
+/* Get the range of sample points which a voice reads in its next frames,
+ * the whole loop while it is looping. */
+static void
+fluid_sample_stream_get_range(const fluid_rvoice_dsp_t *dsp, int is_looping, unsigned int frames,
+                              unsigned int *lo, unsigned int *hi)
+{
+    unsigned int pos = fluid_phase_index(dsp->phase);
+    unsigned int last = dsp->sample->end + 1;
+    fluid_real_t reach = frames * dsp->phase_incr;
+
+    if(is_looping)
+    {
+        *lo = (pos < (unsigned int)dsp->loopstart) ? pos : (unsigned int)dsp->loopstart;
+        *hi = (pos > (unsigned int)dsp->loopend) ? pos : (unsigned int)dsp->loopend;
+    }
+    else
+    {
+        *lo = pos;
+        *hi = (reach < last) ? pos + (unsigned int)reach + 1 : last;
+    }
+
+    *lo = (*lo > FLUID_SAMPLE_STREAM_MARGIN) ? *lo - FLUID_SAMPLE_STREAM_MARGIN : 0;
+    *hi += FLUID_SAMPLE_STREAM_MARGIN;
+
+    if(*hi > last)
+    {
+        *hi = last;
+    }
+
+    if(*hi < *lo)
+    {
+        *hi = *lo;
+    }
+}
+
+/**
+ * Find the sample data in memory which holds all the sample points a streamed
+ * voice reads in its next block.
+ * @param data Returns the sample data
+ * @param data24 Returns the least significant bytes of 24 bit sample data
+ * @param start Returns the index of the first sample point of the data
+ * @param end Returns the index following the last sample point of the data
+ * @return TRUE if such data is in memory, FALSE otherwise
+ */
+int
+fluid_sample_stream_get_data(const fluid_rvoice_dsp_t *dsp, int is_looping,
+                             short **data, char **data24,
+                             unsigned int *start, unsigned int *end)
+{
+    const fluid_sample_stream_window_t *window;
+    unsigned int lo, hi;
+    int i;
+
+    fluid_sample_stream_get_range(dsp, is_looping, dsp->block_size - dsp->start_delay, &lo, &hi);
+
+    if(hi <= dsp->sample->preload)
+    {
+        *data = dsp->sample->data;
+        *data24 = dsp->sample->data24;
+        *start = 0;
+        *end = dsp->sample->preload;
+        return TRUE;
+    }
+
+    if(dsp->stream == NULL)
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < FLUID_SAMPLE_STREAM_WINDOWS; i++)
+    {
+        window = &dsp->stream->window[i];
+
+        if(window->ready && window->start <= lo && hi <= window->start + window->count)
+        {
+            *data = window->data;
+            *data24 = window->data24;
+            *start = window->start;
+            *end = window->start + window->count;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static fluid_sample_stream_t *
+fluid_sample_streamer_get_stream(fluid_sample_streamer_t *streamer)
+{
+    int i, w;
+
+    for(i = 0; i < streamer->stream_count; i++)
+    {
+        fluid_sample_stream_t *stream = streamer->streams[i];
+
+        if(!stream->in_use)
+        {
+            /* Requests still queued for the windows can't make them ready anymore */
+            for(w = 0; w < FLUID_SAMPLE_STREAM_WINDOWS; w++)
+            {
+                stream->window[w].seq = 0;
+                stream->window[w].ready = FALSE;
+            }
+
+            stream->in_use = TRUE;
+            return stream;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Request the sample data the given voices will play next.
+ * Called by the mixer after each rendering call, with the voices still playing.
+ * @param rvoices Array of voices
+ * @param count Number of voices in the array
+ */
+void
+fluid_sample_streamer_update(fluid_sample_streamer_t *streamer,
+                             fluid_rvoice_t **rvoices, int count)
+{
+    fluid_sample_stream_request_t *request;
+    fluid_sample_stream_window_t *window, *free_window;
+    unsigned int done_seq = (unsigned int)fluid_atomic_int_get(&streamer->done_seq);
+    int i, w, pass, queued = FALSE;
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_rvoice_dsp_t *dsp = &rvoices[i]->dsp;
+        fluid_sample_t *sample = dsp->sample;
+        unsigned int lo, hi, limit, end, start, length;
+        int is_looping;
+
+        if(sample == NULL || sample->preload == 0)
+        {
+            continue;
+        }
+
+        if(dsp->stream_underruns > 0)
+        {
+            fluid_atomic_int_add(&streamer->underruns, dsp->stream_underruns);
+            dsp->stream_underruns = 0;
+        }
+
+        if(dsp->stream == NULL)
+        {
+            dsp->stream = fluid_sample_streamer_get_stream(streamer);
+
+            if(dsp->stream == NULL)
+            {
+                /* More streamed voices than voices, they will run dry */
+                continue;
+            }
+        }
+
+        /* While looping, the voice never gets past the end of the loop */
+        is_looping = dsp->samplemode == FLUID_LOOP_DURING_RELEASE
+                     || (dsp->samplemode == FLUID_LOOP_UNTIL_RELEASE
+                         && fluid_adsr_env_get_section(&rvoices[i]->envlfo.volenv) < FLUID_VOICE_ENVRELEASE);
+
+        fluid_sample_stream_get_range(dsp, is_looping, 0, &lo, &hi);
+        limit = is_looping ? hi : sample->end + 1;
+
+        /* Give up the windows the voice has left behind, see which ones have arrived */
+        free_window = NULL;
+
+        for(w = 0; w < FLUID_SAMPLE_STREAM_WINDOWS; w++)
+        {
+            window = &dsp->stream->window[w];
+
+            if(window->seq != 0 && window->start + window->count <= lo)
+            {
+                window->seq = 0;
+                window->ready = FALSE;
+            }
+
+            if(window->seq == 0)
+            {
+                free_window = window;
+                continue;
+            }
+
+            window->ready = (int)(window->seq - done_seq) <= 0
+                            && (unsigned int)fluid_atomic_int_get(&window->filled_seq) == window->seq;
+        }
+
+        /* End of the sample data in memory or requested, without a gap after lo */
+        end = (lo < sample->preload) ? sample->preload : lo;
+
+        for(pass = 0; pass < FLUID_SAMPLE_STREAM_WINDOWS; pass++)
+        {
+            for(w = 0; w < FLUID_SAMPLE_STREAM_WINDOWS; w++)
+            {
+                window = &dsp->stream->window[w];
+
+                if(window->seq != 0 && window->start <= ((end > lo) ? end - 1 : lo)
+                        && window->start + window->count > end)
+                {
+                    end = window->start + window->count;
+                }
+            }
+        }
+
+        if(is_looping && end >= limit && dsp->samplemode == FLUID_LOOP_UNTIL_RELEASE)
+        {
+            /* The loop is in memory, get ready for the release, which plays on past its end */
+            is_looping = FALSE;
+            limit = sample->end + 1;
+        }
+
+        if(end >= limit || free_window == NULL)
+        {
+            continue;
+        }
+
+        if(is_looping)
+        {
+            /* The whole loop has to be in a single window. Only a loop moved
+             * behind the preloaded part by generators gets here. */
+            start = lo;
+            length = limit - lo;
+
+            if(length > 2 * sample->preload)
+            {
+                continue;
+            }
+
+            if(length < sample->preload)
+            {
+                length = sample->preload;
+            }
+        }
+        else
+        {
+            /* Overlapping the part before, unless the voice has lost track */
+            start = (end > lo + sample->preload / 4) ? end - sample->preload / 4 : lo;
+            length = sample->preload;
+        }
+
+        if(length > sample->end + 1 - start)
+        {
+            length = sample->end + 1 - start;
+        }
+
+        request = fluid_ringbuffer_get_inptr(streamer->queue, 0);
+
+        if(request == NULL)
+        {
+            /* Queue full, try again after the next rendering call */
+            break;
+        }
+
+        request->data = sample->data;
+        request->has_data24 = (sample->data24 != NULL);
+        request->window = free_window;
+        request->start = start;
+        request->count = length;
+        request->seq = streamer->next_seq;
+
+        /* 0 means no request */
+        if(++streamer->next_seq == 0)
+        {
+            streamer->next_seq = 1;
+        }
+
+        fluid_ringbuffer_next_inptr(streamer->queue, 1);
+        queued = TRUE;
+
+        free_window->start = start;
+        free_window->count = length;
+        free_window->seq = request->seq;
+        free_window->ready = FALSE;
+    }
+
+    if(queued)
+    {
+        fluid_cond_mutex_lock(streamer->wakeup_m);
+        fluid_cond_signal(streamer->wakeup);
+        fluid_cond_mutex_unlock(streamer->wakeup_m);
+    }
+}
+
+/**
+ * Give back the stream of a voice which has finished and count its last underruns.
+ * Called by the mixer for each finished voice.
+ */
+void
+fluid_sample_streamer_release(fluid_sample_streamer_t *streamer, fluid_rvoice_t *rvoice)
+{
+    if(rvoice->dsp.stream_underruns > 0)
+    {
+        fluid_atomic_int_add(&streamer->underruns, rvoice->dsp.stream_underruns);
+        rvoice->dsp.stream_underruns = 0;
+    }
+
+    if(rvoice->dsp.stream != NULL)
+    {
+        rvoice->dsp.stream->in_use = FALSE;
+        rvoice->dsp.stream = NULL;
+    }
+}
+
+/**
+ * Get the number of times a voice ran out of streamed sample data and had to
+ * be silent.
+ */
+int
+fluid_sample_streamer_get_underruns(fluid_sample_streamer_t *streamer)
+{
+    return fluid_atomic_int_get(&streamer->underruns);
+}
+
+/* Make room for count sample points in a window */
+static int
+fluid_sample_stream_window_alloc(fluid_sample_stream_window_t *window, unsigned int count, int has_data24)
+{
+    if(window->size < count)
+    {
+        FLUID_FREE(window->data);
+        FLUID_FREE(window->data24);
+        window->data24 = NULL;
+        window->size = 0;
+
+        window->data = FLUID_ARRAY(short, count);
+
+        if(window->data == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        window->size = count;
+    }
+
+    if(has_data24 && window->data24 == NULL)
+    {
+        window->data24 = FLUID_ARRAY(char, window->size);
+
+        if(window->data24 == NULL)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/* Streaming thread: copies the requested sample data into the windows in
+ * order. The sample may have been unloaded in the meantime, if the voice has
+ * finished, which fluid_samplecache_copy() checks. */
+static fluid_thread_return_t
+fluid_sample_streamer_thread_func(void *data)
+{
+    fluid_sample_streamer_t *streamer = data;
+    fluid_sample_stream_request_t *request;
+
+    while(TRUE)
+    {
+        fluid_cond_mutex_lock(streamer->wakeup_m);
+
+        while(!fluid_atomic_int_get(&streamer->should_terminate)
+                && fluid_ringbuffer_get_count(streamer->queue) == 0)
+        {
+            fluid_cond_wait(streamer->wakeup, streamer->wakeup_m);
+        }
+
+        fluid_cond_mutex_unlock(streamer->wakeup_m);
+
+        if(fluid_atomic_int_get(&streamer->should_terminate))
+        {
+            break;
+        }
+
+        while((request = fluid_ringbuffer_get_outptr(streamer->queue)) != NULL)
+        {
+            fluid_sample_stream_window_t *window = request->window;
+
+            if(fluid_sample_stream_window_alloc(window, request->count, request->has_data24) != FLUID_OK)
+            {
+                FLUID_LOG(FLUID_ERR, "Out of memory");
+            }
+            else if(fluid_samplecache_copy(request->data, request->start, request->count,
+                                           window->data, request->has_data24 ? window->data24 : NULL) == FLUID_OK)
+            {
+                fluid_atomic_int_set(&window->filled_seq, (int)request->seq);
+            }
+
+            fluid_atomic_int_set(&streamer->done_seq, (int)request->seq);
+            fluid_ringbuffer_next_outptr(streamer->queue);
+        }
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
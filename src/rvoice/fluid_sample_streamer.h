@@ -0,0 +1,68 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+
+#ifndef _FLUID_SAMPLE_STREAMER_H
+#define _FLUID_SAMPLE_STREAMER_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_rvoice.h"
+
+/* Sample points around the phase of a voice which the interpolators may read */
+#define FLUID_SAMPLE_STREAM_MARGIN 8
+
+#define FLUID_SAMPLE_STREAM_WINDOWS 2
+
+typedef struct _fluid_sample_streamer_t fluid_sample_streamer_t;
+
+/* A part of a streamed sample, copied into memory for one voice */
+typedef struct
+{
+    short *data;                  /**< Written by the streaming thread, read by the voice once ready */
+    char *data24;                 /**< Same for the least significant byte of 24 bit samples */
+    unsigned int size;            /**< Used by the streaming thread only: sample points data can hold */
+    fluid_atomic_int_t filled_seq; /**< Atomic: request which the data has been copied for */
+    unsigned int start;           /**< First sample point of the part */
+    unsigned int count;           /**< Number of sample points in the part */
+    unsigned int seq;             /**< Sequence number of the request filling the window, 0 if unused */
+    int ready;                    /**< The data of the request has arrived, the voice may read it */
+} fluid_sample_stream_window_t;
+
+/* The stream buffers of a voice playing a streamed sample */
+struct _fluid_sample_stream_t
+{
+    int in_use;
+    fluid_sample_stream_window_t window[FLUID_SAMPLE_STREAM_WINDOWS];
+};
+
+fluid_sample_streamer_t *new_fluid_sample_streamer(int polyphony);
+void delete_fluid_sample_streamer(fluid_sample_streamer_t *streamer);
+int fluid_sample_streamer_set_polyphony(fluid_sample_streamer_t *streamer, int polyphony);
+
+void fluid_sample_streamer_update(fluid_sample_streamer_t *streamer,
+                                  fluid_rvoice_t **rvoices, int count);
+void fluid_sample_streamer_release(fluid_sample_streamer_t *streamer, fluid_rvoice_t *rvoice);
+int fluid_sample_streamer_get_underruns(fluid_sample_streamer_t *streamer);
+
+int fluid_sample_stream_get_data(const fluid_rvoice_dsp_t *dsp, int is_looping,
+                                 short **data, char **data24,
+                                 unsigned int *start, unsigned int *end);
+
+#endif /* _FLUID_SAMPLE_STREAMER_H */
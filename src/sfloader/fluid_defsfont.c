@@ -27,21 +27,51 @@
 #include "fluid_sys.h"
 #include "fluid_synth.h"
 #include "fluid_samplecache.h"
+#include "fluid_sample_streamer.h"
 
 /* EMU8k/10k hardware applies this factor to initial attenuation generator values set at preset and
  * instrument level in a soundfont. We apply this factor when loading the generator values to stay
  * compatible as most existing soundfonts expect exactly this (strange, non-standard) behaviour. */
 #define EMU_ATTENUATION_FACTOR (0.4f)
 
+/* The samples loaded by fluid_defsfont_load_all_sampledata(), shared by all loading threads */
+typedef struct
+{
+    fluid_defsfont_t *defsfont;
+    SFData *sfdata;
+    fluid_sample_t **samples;
+    int count;
+    int individual;
+    fluid_atomic_int_t next;    /* Index of the next sample to be loaded by any thread */
+    fluid_atomic_int_t failed;  /* Set to TRUE if loading a sample failed */
+} fluid_defsfont_loading_t;
+
 /* Dynamic sample loading functions */
 static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static void unload_sample(fluid_sample_t *sample);
+static void queue_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample);
+static void wake_sample_loader(fluid_defsfont_t *defsfont);
 static int dynamic_samples_preset_notify(fluid_preset_t *preset, int reason, int chan);
 static int dynamic_samples_sample_notify(fluid_sample_t *sample, int reason);
+static int dynamic_samples_preset_is_loading(fluid_preset_t *preset);
+static void load_sample(fluid_defsfont_t *defsfont, SFData *sffile, fluid_sample_t *sample);
+static int start_sample_loader(fluid_defsfont_t *defsfont);
+static void stop_sample_loader(fluid_defsfont_t *defsfont);
+static void process_loaded_samples(fluid_defsfont_t *defsfont);
+static void drop_queued_samples(fluid_defsfont_t *defsfont, fluid_ringbuffer_t *queue);
+static fluid_thread_return_t sample_loader_run(void *data);
+static void load_all_samples(fluid_defsfont_loading_t *loading);
+static fluid_thread_return_t load_all_samples_run(void *data);
 static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone);
 static fluid_inst_t *find_inst_by_idx(fluid_defsfont_t *defsfont, int idx);
 
+/* Key of a preset in the preset index of a defsfont */
+static FLUID_INLINE unsigned int fluid_defsfont_preset_index_key(unsigned int bank, unsigned int num)
+{
+    return (bank << 16) | num;
+}
+
 
 /***************************************************************
  *
@@ -161,6 +191,17 @@ void fluid_defpreset_preset_delete(fluid_preset_t *preset)
     if(defsfont)
     {
         defsfont->preset = fluid_list_remove(defsfont->preset, defpreset);
+
+        if(defsfont->preset_index != NULL)
+        {
+            void *key = FLUID_UINT_TO_POINTER(fluid_defsfont_preset_index_key(
+                                                 fluid_preset_get_banknum(preset), fluid_preset_get_num(preset)));
+
+            if(fluid_hashtable_lookup(defsfont->preset_index, key) == preset)
+            {
+                fluid_hashtable_remove(defsfont->preset_index, key);
+            }
+        }
     }
 
     delete_fluid_defpreset(defpreset);
@@ -211,8 +252,36 @@ fluid_defsfont_t *new_fluid_defsfont(fluid_settings_t *settings)
 
     FLUID_MEMSET(defsfont, 0, sizeof(*defsfont));
 
+    defsfont->preset_index = new_fluid_hashtable(fluid_direct_hash, fluid_direct_equal);
+
+    if(defsfont->preset_index == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(defsfont);
+        return NULL;
+    }
+
     fluid_settings_getint(settings, "synth.lock-memory", &defsfont->mlock);
+    fluid_settings_getint(settings, "synth.mmap-sample-data", &defsfont->mmap);
     fluid_settings_getint(settings, "synth.dynamic-sample-loading", &defsfont->dynamic_samples);
+    fluid_settings_getint(settings, "synth.sample-streaming", &defsfont->stream);
+    fluid_settings_getint(settings, "synth.sample-streaming-preload", &defsfont->stream_preload);
+    fluid_settings_getint(settings, "synth.sample-loading-threads", &defsfont->loader_threads);
+
+    if(defsfont->loader_threads == 0)
+    {
+        fluid_settings_getint(settings, "synth.cpu-cores", &defsfont->loader_threads);
+    }
+
+    if(fluid_settings_dupstr(settings, "synth.sample-cache-dir", &defsfont->sample_cache_dir) == FLUID_OK
+            && defsfont->sample_cache_dir != NULL && defsfont->sample_cache_dir[0] == '\0')
+    {
+        FLUID_FREE(defsfont->sample_cache_dir);
+        defsfont->sample_cache_dir = NULL;
+    }
+
+    defsfont->async_samples = defsfont->dynamic_samples
+                              && !fluid_settings_str_equal(settings, "synth.dynamic-sample-loading-policy", "sync");
 
     return defsfont;
 }
@@ -239,14 +308,28 @@ int delete_fluid_defsfont(fluid_defsfont_t *defsfont)
         }
     }
 
+    /* Samples still queued are dropped, loaded ones are unloaded again */
+    stop_sample_loader(defsfont);
+
     if(defsfont->filename != NULL)
     {
         FLUID_FREE(defsfont->filename);
     }
 
+    FLUID_FREE(defsfont->sample_cache_dir);
+
     for(list = defsfont->sample; list; list = fluid_list_next(list))
     {
-        delete_fluid_sample((fluid_sample_t *) fluid_list_get(list));
+        sample = (fluid_sample_t *) fluid_list_get(list);
+
+        /* Release the data of individually loaded samples. With dynamic sample
+         * loading, this has already been done when their presets were unselected. */
+        if(!defsfont->dynamic_samples && sample->data != NULL && sample->data != defsfont->sampledata)
+        {
+            fluid_samplecache_unload(sample->data);
+        }
+
+        delete_fluid_sample(sample);
     }
 
     if(defsfont->sample)
@@ -259,6 +342,10 @@ int delete_fluid_defsfont(fluid_defsfont_t *defsfont)
         fluid_samplecache_unload(defsfont->sampledata);
     }
 
+    /* the index is of no use anymore, but would only be updated by the deletion of each preset */
+    delete_fluid_hashtable(defsfont->preset_index);
+    defsfont->preset_index = NULL;
+
     for(list = defsfont->preset; list; list = fluid_list_next(list))
     {
         preset = (fluid_preset_t *)fluid_list_get(list);
@@ -293,6 +380,7 @@ int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, f
 {
     int num_samples;
     unsigned int source_end = sample->source_end;
+    unsigned int preload = 0;
 
     /* For uncompressed samples we want to include the 46 zero sample word area following each sample
      * in the Soundfont. Otherwise samples with loopend > end, which we have decided not to correct, would
@@ -309,15 +397,46 @@ int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, f
         }
     }
 
+    /* Streamed samples only keep their beginning in memory, the rest is
+     * copied by the sample streamer ahead of the voices playing them */
+    if(defsfont->stream)
+    {
+        unsigned int loopend = sample->loopend;
+
+        if(!(sample->sampletype & FLUID_SAMPLETYPE_OGG_VORBIS))
+        {
+            loopend = (sample->source_loopend > sample->source_start) ? sample->source_loopend - sample->source_start : 0;
+        }
+
+        preload = (unsigned int)((double)defsfont->stream_preload * sample->samplerate / 1000.0) + 1;
+
+        /* So does the loop, which voices play over and over */
+        if(loopend + FLUID_SAMPLE_STREAM_MARGIN + 1 > preload)
+        {
+            preload = loopend + FLUID_SAMPLE_STREAM_MARGIN + 1;
+        }
+    }
+
     num_samples = fluid_samplecache_load(
                       sfdata, sample->source_start, source_end, sample->sampletype,
-                      defsfont->mlock, &sample->data, &sample->data24);
+                      defsfont->mlock, defsfont->mmap || defsfont->stream, preload,
+                      defsfont->sample_cache_dir, &sample->data, &sample->data24);
 
     if(num_samples < 0)
     {
         return FLUID_FAILED;
     }
 
+    /* Samples which have been read are in memory anyway */
+    if(preload < (unsigned int)num_samples && fluid_samplecache_is_mapped(sample->data))
+    {
+        sample->preload = preload;
+    }
+    else
+    {
+        sample->preload = 0;
+    }
+
     if(num_samples == 0)
     {
         sample->start = sample->end = 0;
@@ -342,22 +461,27 @@ int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, f
 }
 
 /* Loads the sample data for all samples from the Soundfont file. For SF2 files, it loads the data in
- * one large block. For SF3 files, each compressed sample gets loaded individually.
+ * one large block. For SF3 files, each compressed sample gets loaded individually. So does each
+ * sample of streamed SF2 files, to keep the beginning of each sample in memory.
+ * The samples are processed by synth.sample-loading-threads threads, including the calling one.
  * Returns FLUID_OK on success, otherwise FLUID_FAILED
  */
 int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata)
 {
     fluid_list_t *list;
-    fluid_sample_t *sample;
+    fluid_defsfont_loading_t loading;
+    fluid_thread_t **threads = NULL;
+    int i, num_threads = 0;
     int sf3_file = (sfdata->version.major == 3);
+    int individual = (sf3_file || defsfont->stream);
 
     /* For SF2 files, we load the sample data in one large block */
-    if(!sf3_file)
+    if(!individual)
     {
         int read_samples;
         int num_samples = sfdata->samplesize / sizeof(short);
 
-        read_samples = fluid_samplecache_load(sfdata, 0, num_samples - 1, 0, defsfont->mlock,
+        read_samples = fluid_samplecache_load(sfdata, 0, num_samples - 1, 0, defsfont->mlock, defsfont->mmap, 0, NULL,
                                               &defsfont->sampledata, &defsfont->sample24data);
 
         if(read_samples != num_samples)
@@ -368,18 +492,97 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
         }
     }
 
-    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    FLUID_MEMSET(&loading, 0, sizeof(loading));
+    loading.defsfont = defsfont;
+    loading.sfdata = sfdata;
+    loading.individual = individual;
+    loading.count = fluid_list_size(defsfont->sample);
+
+    if(loading.count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    loading.samples = FLUID_ARRAY(fluid_sample_t *, loading.count);
+
+    if(loading.samples == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    for(list = defsfont->sample, i = 0; list; list = fluid_list_next(list), i++)
+    {
+        loading.samples[i] = fluid_list_get(list);
+    }
+
+    /* Additional threads, the calling thread loads samples as well */
+    if(defsfont->loader_threads > 1 && loading.count > 1)
+    {
+        num_threads = (defsfont->loader_threads < loading.count ? defsfont->loader_threads : loading.count) - 1;
+        threads = FLUID_ARRAY(fluid_thread_t *, num_threads);
+
+        if(threads == NULL)
+        {
+            FLUID_LOG(FLUID_WARN, "Out of memory, loading samples in a single thread");
+            num_threads = 0;
+        }
+
+        for(i = 0; i < num_threads; i++)
+        {
+            threads[i] = new_fluid_thread("sample-loading", load_all_samples_run, &loading, 0, FALSE);
+
+            /* The remaining threads do the work of this one as well */
+            if(threads[i] == NULL)
+            {
+                num_threads = i;
+                break;
+            }
+        }
+    }
+
+    load_all_samples(&loading);
+
+    for(i = 0; i < num_threads; i++)
     {
-        sample = fluid_list_get(list);
+        fluid_thread_join(threads[i]);
+        delete_fluid_thread(threads[i]);
+    }
+
+    FLUID_FREE(threads);
+    FLUID_FREE(loading.samples);
+
+    return fluid_atomic_int_get(&loading.failed) ? FLUID_FAILED : FLUID_OK;
+}
+
+/* Loads samples of fluid_defsfont_load_all_sampledata() until there are none
+ * left. Called by several threads at once, each sample is loaded by one of them. */
+static void load_all_samples(fluid_defsfont_loading_t *loading)
+{
+    fluid_defsfont_t *defsfont = loading->defsfont;
+    fluid_sample_t *sample;
+    int i;
+
+    while(!fluid_atomic_int_get(&loading->failed))
+    {
+        i = fluid_atomic_int_exchange_and_add(&loading->next, 1);
+
+        if(i >= loading->count)
+        {
+            break;
+        }
 
-        if(sf3_file)
+        sample = loading->samples[i];
+
+        if(loading->individual)
         {
             /* SF3 samples get loaded individually, as most (or all) of them are in Ogg Vorbis format
              * anyway */
-            if(fluid_defsfont_load_sampledata(defsfont, sfdata, sample) == FLUID_FAILED)
+            if(fluid_defsfont_load_sampledata(defsfont, loading->sfdata, sample) == FLUID_FAILED)
             {
                 FLUID_LOG(FLUID_ERR, "Failed to load sample '%s'", sample->name);
-                return FLUID_FAILED;
+                fluid_atomic_int_set(&loading->failed, TRUE);
+                break;
             }
 
             fluid_sample_sanitize_loop(sample, (sample->end + 1) * sizeof(short));
@@ -394,8 +597,13 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
 
         fluid_voice_optimize_sample(sample);
     }
+}
 
-    return FLUID_OK;
+static fluid_thread_return_t load_all_samples_run(void *data)
+{
+    load_all_samples(data);
+
+    return FLUID_THREAD_RETURN_VALUE;
 }
 
 /*
@@ -510,6 +718,11 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
 
     fluid_sffile_close(sfdata);
 
+    if(defsfont->async_samples && start_sample_loader(defsfont) == FLUID_FAILED)
+    {
+        return FLUID_FAILED;
+    }
+
     return FLUID_OK;
 
 err_exit:
@@ -535,6 +748,7 @@ int fluid_defsfont_add_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample
 int fluid_defsfont_add_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *defpreset)
 {
     fluid_preset_t *preset;
+    void *key;
 
     preset = new_fluid_preset(defsfont->sfont,
                               fluid_defpreset_preset_get_name,
@@ -543,20 +757,34 @@ int fluid_defsfont_add_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *def
                               fluid_defpreset_preset_noteon,
                               fluid_defpreset_preset_delete);
 
+    if(preset == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
     if(defsfont->dynamic_samples)
     {
         preset->notify = dynamic_samples_preset_notify;
     }
 
-    if(preset == NULL)
+    if(defsfont->async_samples)
     {
-        return FLUID_FAILED;
+        preset->is_loading = dynamic_samples_preset_is_loading;
     }
 
     fluid_preset_set_data(preset, defpreset);
 
     defsfont->preset = fluid_list_append(defsfont->preset, preset);
 
+    /* fluid_defsfont_get_preset() used to return the first preset of the list, keep it that way */
+    key = FLUID_UINT_TO_POINTER(fluid_defsfont_preset_index_key(fluid_defpreset_get_banknum(defpreset),
+                               fluid_defpreset_get_num(defpreset)));
+
+    if(fluid_hashtable_lookup(defsfont->preset_index, key) == NULL)
+    {
+        fluid_hashtable_insert(defsfont->preset_index, key, preset);
+    }
+
     return FLUID_OK;
 }
 
@@ -565,20 +793,14 @@ int fluid_defsfont_add_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *def
  */
 fluid_preset_t *fluid_defsfont_get_preset(fluid_defsfont_t *defsfont, int bank, int num)
 {
-    fluid_preset_t *preset;
-    fluid_list_t *list;
-
-    for(list = defsfont->preset; list != NULL; list = fluid_list_next(list))
+    /* Bank and preset numbers of Soundfont presets are 16 bit words */
+    if(bank < 0 || bank > 0xFFFF || num < 0 || num > 0xFFFF)
     {
-        preset = (fluid_preset_t *)fluid_list_get(list);
-
-        if((fluid_preset_get_banknum(preset) == bank) && (fluid_preset_get_num(preset) == num))
-        {
-            return preset;
-        }
+        return NULL;
     }
 
-    return NULL;
+    return fluid_hashtable_lookup(defsfont->preset_index,
+                                  FLUID_UINT_TO_POINTER(fluid_defsfont_preset_index_key(bank, num)));
 }
 
 /*
@@ -627,6 +849,8 @@ new_fluid_defpreset(fluid_defsfont_t *defsfont)
     defpreset->num = 0;
     defpreset->global_zone = NULL;
     defpreset->zone = NULL;
+    defpreset->loading = FALSE;
+    defpreset->loading_serial = 0;
     return defpreset;
 }
 
@@ -724,8 +948,10 @@ fluid_defpreset_noteon(fluid_defpreset_t *defpreset, fluid_synth_t *synth, int c
                 /* check if the instrument zone is ignored and the note falls into
                    the key and velocity range of this  instrument zone.
                    An instrument zone must be ignored when its voice is already running
-                   played by a legato passage (see fluid_synth_noteon_monopoly_legato()) */
-                if(fluid_zone_inside_range(&voice_zone->range, key, vel))
+                   played by a legato passage (see fluid_synth_noteon_monopoly_legato()).
+                   Samples still being loaded in the background are skipped as well. */
+                if(fluid_zone_inside_range(&voice_zone->range, key, vel)
+                        && !voice_zone->inst_zone->sample->loading)
                 {
 
                     inst_zone = voice_zone->inst_zone;
@@ -1989,6 +2215,12 @@ fluid_sample_import_sfont(fluid_sample_t *sample, SFSample *sfsample, fluid_defs
     if(defsfont->dynamic_samples)
     {
         sample->notify = dynamic_samples_sample_notify;
+
+        /* lets dynamic_samples_sample_notify() hand the sample to the loader thread */
+        if(defsfont->async_samples)
+        {
+            sample->userdata = defsfont;
+        }
     }
 
     if(fluid_sample_validate(sample, defsfont->samplesize) == FLUID_FAILED)
@@ -2001,12 +2233,27 @@ fluid_sample_import_sfont(fluid_sample_t *sample, SFSample *sfsample, fluid_defs
 
 /* Called if a sample is no longer used by a voice. Used by dynamic sample loading
  * to unload a sample that is not used by any loaded presets anymore but couldn't
- * be unloaded straight away because it was still in use by a voice. */
+ * be unloaded straight away because it was still in use by a voice. This may
+ * happen in the rendering thread, so with background loading the loader thread
+ * unloads the sample instead, the sample cache may be busy with file I/O. */
 static int dynamic_samples_sample_notify(fluid_sample_t *sample, int reason)
 {
-    if(reason == FLUID_SAMPLE_DONE && sample->preset_count == 0)
+    fluid_defsfont_t *defsfont = sample->userdata;
+
+    if(reason == FLUID_SAMPLE_DONE && sample->preset_count == 0 && !sample->loading)
     {
-        unload_sample(sample);
+        if(defsfont != NULL && defsfont->loader != NULL)
+        {
+            if(sample->data != NULL)
+            {
+                queue_sample(defsfont, sample);
+                wake_sample_loader(defsfont);
+            }
+        }
+        else
+        {
+            unload_sample(sample);
+        }
     }
 
     return FLUID_OK;
@@ -2016,24 +2263,73 @@ static int dynamic_samples_sample_notify(fluid_sample_t *sample, int reason)
  * dynamic sample loading to load and unload samples on demand. */
 static int dynamic_samples_preset_notify(fluid_preset_t *preset, int reason, int chan)
 {
-    fluid_defsfont_t *defsfont;
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(preset->sfont);
+
+    process_loaded_samples(defsfont);
 
     if(reason == FLUID_PRESET_SELECTED)
     {
         FLUID_LOG(FLUID_DBG, "Selected preset '%s' on channel %d", fluid_preset_get_name(preset), chan);
-        defsfont = fluid_sfont_get_data(preset->sfont);
         load_preset_samples(defsfont, preset);
     }
     else if(reason == FLUID_PRESET_UNSELECTED)
     {
         FLUID_LOG(FLUID_DBG, "Deselected preset '%s' from channel %d", fluid_preset_get_name(preset), chan);
-        defsfont = fluid_sfont_get_data(preset->sfont);
         unload_preset_samples(defsfont, preset);
     }
 
     return FLUID_OK;
 }
 
+/* Tells the synth whether samples of the preset are still being loaded in the
+ * background. Also takes over the samples loaded since the last call. The result
+ * is kept until samples start or finish loading, since the synth asks for every
+ * deferred note before each block. */
+static int dynamic_samples_preset_is_loading(fluid_preset_t *preset)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(preset->sfont);
+    fluid_defpreset_t *defpreset = fluid_preset_get_data(preset);
+    fluid_preset_zone_t *preset_zone;
+    fluid_inst_zone_t *inst_zone;
+    fluid_sample_t *sample;
+
+    process_loaded_samples(defsfont);
+
+    if(defsfont->loading_count == 0)
+    {
+        return FALSE;
+    }
+
+    if(defpreset->loading_serial != defsfont->loading_serial)
+    {
+        defpreset->loading_serial = defsfont->loading_serial;
+        defpreset->loading = FALSE;
+        preset_zone = fluid_defpreset_get_zone(defpreset);
+
+        while(preset_zone != NULL && !defpreset->loading)
+        {
+            inst_zone = fluid_inst_get_zone(fluid_preset_zone_get_inst(preset_zone));
+
+            while(inst_zone != NULL)
+            {
+                sample = fluid_inst_zone_get_sample(inst_zone);
+
+                if(sample != NULL && sample->loading)
+                {
+                    defpreset->loading = TRUE;
+                    break;
+                }
+
+                inst_zone = fluid_inst_zone_next(inst_zone);
+            }
+
+            preset_zone = fluid_preset_zone_next(preset_zone);
+        }
+    }
+
+    return defpreset->loading;
+}
+
 
 /* Walk through all samples used by the passed in preset and make sure that the
  * sample data is loaded for each sample. Used by dynamic sample loading. */
@@ -2045,6 +2341,7 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
     fluid_inst_zone_t *inst_zone;
     fluid_sample_t *sample;
     SFData *sffile = NULL;
+    int signal = FALSE;
 
     defpreset = fluid_preset_get_data(preset);
     preset_zone = fluid_defpreset_get_zone(defpreset);
@@ -2058,37 +2355,38 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
         {
             sample = fluid_inst_zone_get_sample(inst_zone);
 
-            if((sample != NULL) && (sample->start != sample->end))
+            /* The sample pointers of a sample being loaded are not to be touched */
+            if((sample != NULL) && (sample->loading || sample->start != sample->end))
             {
                 sample->preset_count++;
 
                 /* If this is the first time this sample has been selected,
-                 * load the sampledata */
-                if(sample->preset_count == 1)
+                 * load the sampledata, unless a voice has kept it loaded
+                 * or it is being loaded already */
+                if(sample->preset_count == 1 && !sample->loading && sample->data == NULL)
                 {
-                    /* Make sure we have an open Soundfont file. Do this here
-                     * to avoid having to open the file if no loading is necessary
-                     * for a preset */
-                    if(sffile == NULL)
+                    if(defsfont->async_samples)
                     {
-                        sffile = fluid_sffile_open(defsfont->filename, defsfont->fcbs);
-
+                        queue_sample(defsfont, sample);
+                        signal = TRUE;
+                    }
+                    else
+                    {
+                        /* Make sure we have an open Soundfont file. Do this here
+                         * to avoid having to open the file if no loading is necessary
+                         * for a preset */
                         if(sffile == NULL)
                         {
-                            FLUID_LOG(FLUID_ERR, "Unable to open Soundfont file");
-                            return FLUID_FAILED;
+                            sffile = fluid_sffile_open(defsfont->filename, defsfont->fcbs);
+
+                            if(sffile == NULL)
+                            {
+                                FLUID_LOG(FLUID_ERR, "Unable to open Soundfont file");
+                                return FLUID_FAILED;
+                            }
                         }
-                    }
 
-                    if(fluid_defsfont_load_sampledata(defsfont, sffile, sample) == FLUID_OK)
-                    {
-                        fluid_sample_sanitize_loop(sample, (sample->end + 1) * sizeof(short));
-                        fluid_voice_optimize_sample(sample);
-                    }
-                    else
-                    {
-                        FLUID_LOG(FLUID_ERR, "Unable to load sample '%s', disabling", sample->name);
-                        sample->start = sample->end = 0;
+                        load_sample(defsfont, sffile, sample);
                     }
                 }
             }
@@ -2104,6 +2402,11 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
         fluid_sffile_close(sffile);
     }
 
+    if(signal)
+    {
+        wake_sample_loader(defsfont);
+    }
+
     return FLUID_OK;
 }
 
@@ -2138,8 +2441,10 @@ static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *pre
                  * sounding voice, unload it from the sample cache. If it's
                  * still in use by a voice, dynamic_samples_sample_notify will
                  * take care of unloading the sample as soon as the voice is
-                 * finished with it (but only on the next API call). */
-                if(sample->preset_count == 0 && sample->refcount == 0)
+                 * finished with it (but only on the next API call). If it's
+                 * still being loaded, process_loaded_samples hands it back to
+                 * the loader thread to be unloaded. */
+                if(sample->preset_count == 0 && sample->refcount == 0 && !sample->loading)
                 {
                     unload_sample(sample);
                 }
@@ -2175,6 +2480,258 @@ static void unload_sample(fluid_sample_t *sample)
     }
 }
 
+/* Hand a sample to the loader thread, which loads its data if there is none and
+ * unloads it otherwise. The sample stays marked as loading until
+ * process_loaded_samples() takes it back. */
+static void queue_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    /* The queue has room for all samples, and each sample is queued once at a time */
+    fluid_sample_t **queued = fluid_ringbuffer_get_inptr(defsfont->load_queue, 0);
+
+    *queued = sample;
+    fluid_ringbuffer_next_inptr(defsfont->load_queue, 1);
+
+    sample->loading = TRUE;
+    defsfont->loading_count++;
+    defsfont->loading_serial++;
+}
+
+/* Tell the loader thread that samples have been queued */
+static void wake_sample_loader(fluid_defsfont_t *defsfont)
+{
+    fluid_cond_mutex_lock(defsfont->loader_wakeup_m);
+    fluid_cond_signal(defsfont->loader_wakeup);
+    fluid_cond_mutex_unlock(defsfont->loader_wakeup_m);
+}
+
+/* Load the sample data of a single sample and prepare it for playing. Used by
+ * dynamic sample loading, possibly from the loader thread. */
+static void load_sample(fluid_defsfont_t *defsfont, SFData *sffile, fluid_sample_t *sample)
+{
+    if(sffile != NULL && fluid_defsfont_load_sampledata(defsfont, sffile, sample) == FLUID_OK)
+    {
+        fluid_sample_sanitize_loop(sample, (sample->end + 1) * sizeof(short));
+        fluid_voice_optimize_sample(sample);
+    }
+    else
+    {
+        FLUID_LOG(FLUID_ERR, "Unable to load sample '%s', disabling", sample->name);
+        sample->start = sample->end = 0;
+    }
+}
+
+/* Start the thread loading the samples of selected presets in the background,
+ * so that selecting a preset never waits for file I/O. */
+static int start_sample_loader(fluid_defsfont_t *defsfont)
+{
+    int count = fluid_list_size(defsfont->sample) + 1;
+
+    /* Each sample is queued once at a time at most, so the queues never overflow */
+    defsfont->load_queue = new_fluid_ringbuffer(count, sizeof(fluid_sample_t *));
+    defsfont->loaded_queue = new_fluid_ringbuffer(count, sizeof(fluid_sample_t *));
+    defsfont->loader_wakeup = new_fluid_cond();
+    defsfont->loader_wakeup_m = new_fluid_cond_mutex();
+
+    if(defsfont->load_queue == NULL || defsfont->loaded_queue == NULL
+            || defsfont->loader_wakeup == NULL || defsfont->loader_wakeup_m == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    defsfont->loader = new_fluid_thread("sample-loader", sample_loader_run, defsfont, 0, FALSE);
+
+    if(defsfont->loader == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
+}
+
+/* Stop the loader thread and release what has been loaded in the meantime */
+static void stop_sample_loader(fluid_defsfont_t *defsfont)
+{
+    if(defsfont->loader != NULL)
+    {
+        fluid_cond_mutex_lock(defsfont->loader_wakeup_m);
+        fluid_atomic_int_set(&defsfont->loader_terminate, TRUE);
+        fluid_cond_signal(defsfont->loader_wakeup);
+        fluid_cond_mutex_unlock(defsfont->loader_wakeup_m);
+
+        fluid_thread_join(defsfont->loader);
+        delete_fluid_thread(defsfont->loader);
+        defsfont->loader = NULL;
+    }
+
+    if(defsfont->loaded_queue != NULL)
+    {
+        drop_queued_samples(defsfont, defsfont->loaded_queue);
+        delete_fluid_ringbuffer(defsfont->loaded_queue);
+        defsfont->loaded_queue = NULL;
+    }
+
+    if(defsfont->load_queue != NULL)
+    {
+        drop_queued_samples(defsfont, defsfont->load_queue);
+        delete_fluid_ringbuffer(defsfont->load_queue);
+        defsfont->load_queue = NULL;
+    }
+
+    if(defsfont->loader_wakeup != NULL)
+    {
+        delete_fluid_cond(defsfont->loader_wakeup);
+        defsfont->loader_wakeup = NULL;
+    }
+
+    if(defsfont->loader_wakeup_m != NULL)
+    {
+        delete_fluid_cond_mutex(defsfont->loader_wakeup_m);
+        defsfont->loader_wakeup_m = NULL;
+    }
+}
+
+/* Take over the samples the loader thread has finished with. Called from the
+ * synthesis thread, which owns the loading flag of the samples, and possibly
+ * from the rendering thread. Samples whose presets have all been unselected
+ * meanwhile go back to the loader thread to be unloaded, and the other way
+ * round, rather than waiting for the sample cache here. */
+static void process_loaded_samples(fluid_defsfont_t *defsfont)
+{
+    fluid_sample_t **loaded;
+    fluid_sample_t *sample;
+    int signal = FALSE;
+
+    if(defsfont->loaded_queue == NULL)
+    {
+        return;
+    }
+
+    while((loaded = fluid_ringbuffer_get_outptr(defsfont->loaded_queue)) != NULL)
+    {
+        sample = *loaded;
+        fluid_ringbuffer_next_outptr(defsfont->loaded_queue);
+
+        sample->loading = FALSE;
+        defsfont->loading_count--;
+        defsfont->loading_serial++;
+
+        if(sample->preset_count == 0 && sample->refcount == 0 && sample->data != NULL)
+        {
+            queue_sample(defsfont, sample);
+            signal = TRUE;
+        }
+        else if(sample->preset_count > 0 && sample->data == NULL && sample->start != sample->end)
+        {
+            queue_sample(defsfont, sample);
+            signal = TRUE;
+        }
+    }
+
+    if(signal)
+    {
+        wake_sample_loader(defsfont);
+    }
+}
+
+/* Release the samples left in a queue of the stopped loader thread. The data
+ * of samples no selected preset uses is unloaded. */
+static void drop_queued_samples(fluid_defsfont_t *defsfont, fluid_ringbuffer_t *queue)
+{
+    fluid_sample_t **queued;
+    fluid_sample_t *sample;
+
+    while((queued = fluid_ringbuffer_get_outptr(queue)) != NULL)
+    {
+        sample = *queued;
+        fluid_ringbuffer_next_outptr(queue);
+
+        sample->loading = FALSE;
+        defsfont->loading_count--;
+        defsfont->loading_serial++;
+
+        if(sample->preset_count == 0 && sample->data != NULL)
+        {
+            unload_sample(sample);
+        }
+    }
+}
+
+/* Loader thread: loads the queued samples in order and hands them back to the
+ * synthesis thread. The Soundfont file is kept open while there is work to do. */
+static fluid_thread_return_t sample_loader_run(void *data)
+{
+    fluid_defsfont_t *defsfont = data;
+    fluid_sample_t **queued;
+    fluid_sample_t **loaded;
+    fluid_sample_t *sample;
+    SFData *sffile = NULL;
+
+    while(TRUE)
+    {
+        if(sffile != NULL && fluid_ringbuffer_get_count(defsfont->load_queue) == 0)
+        {
+            fluid_sffile_close(sffile);
+            sffile = NULL;
+        }
+
+        fluid_cond_mutex_lock(defsfont->loader_wakeup_m);
+
+        while(!fluid_atomic_int_get(&defsfont->loader_terminate)
+                && fluid_ringbuffer_get_count(defsfont->load_queue) == 0)
+        {
+            fluid_cond_wait(defsfont->loader_wakeup, defsfont->loader_wakeup_m);
+        }
+
+        fluid_cond_mutex_unlock(defsfont->loader_wakeup_m);
+
+        if(fluid_atomic_int_get(&defsfont->loader_terminate))
+        {
+            break;
+        }
+
+        while((queued = fluid_ringbuffer_get_outptr(defsfont->load_queue)) != NULL)
+        {
+            sample = *queued;
+            fluid_ringbuffer_next_outptr(defsfont->load_queue);
+
+            if(sample->data != NULL)
+            {
+                /* Queued to be unloaded. The pointers are cleared even if the
+                 * cache doesn't know them, so that it isn't queued again. */
+                FLUID_LOG(FLUID_DBG, "Unloading sample '%s'", sample->name);
+                fluid_samplecache_unload(sample->data);
+                sample->data = NULL;
+                sample->data24 = NULL;
+            }
+            else
+            {
+                if(sffile == NULL)
+                {
+                    sffile = fluid_sffile_open(defsfont->filename, defsfont->fcbs);
+
+                    if(sffile == NULL)
+                    {
+                        FLUID_LOG(FLUID_ERR, "Unable to open Soundfont file");
+                    }
+                }
+
+                load_sample(defsfont, sffile, sample);
+            }
+
+            loaded = fluid_ringbuffer_get_inptr(defsfont->loaded_queue, 0);
+            *loaded = sample;
+            fluid_ringbuffer_next_inptr(defsfont->loaded_queue, 1);
+        }
+    }
+
+    if(sffile != NULL)
+    {
+        fluid_sffile_close(sffile);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
 static fluid_inst_t *find_inst_by_idx(fluid_defsfont_t *defsfont, int idx)
 {
     fluid_list_t *list;
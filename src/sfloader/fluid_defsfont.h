@@ -29,8 +29,11 @@
 #include "fluidsynth_priv.h"
 #include "fluid_sffile.h"
 #include "fluid_list.h"
+#include "fluid_hash.h"
 #include "fluid_mod.h"
 #include "fluid_gen.h"
+#include "fluid_sys.h"
+#include "fluid_ringbuffer.h"
 
 
 
@@ -115,9 +118,25 @@ struct _fluid_defsfont_t
     fluid_sfont_t *sfont;      /* pointer to parent sfont */
     fluid_list_t *sample;      /* the samples in this soundfont */
     fluid_list_t *preset;      /* the presets of this soundfont */
+    fluid_hashtable_t *preset_index; /* (bank, program) -> first preset of the preset list with that bank and program */
     fluid_list_t *inst;        /* the instruments of this soundfont */
     int mlock;                 /* Should we try memlock (avoid swapping)? */
+    int mmap;                  /* Should we try to map uncompressed sample data instead of reading it? */
     int dynamic_samples;       /* Enables dynamic sample loading if set */
+    int stream;                /* Stream mapped sample data from the file instead of keeping all of it in memory */
+    int stream_preload;        /* Milliseconds at the start of a streamed sample kept in memory */
+    char *sample_cache_dir;    /* Directory of the on-disk cache of decoded samples, NULL if disabled */
+    int loader_threads;        /* Number of threads loading all samples of the Soundfont */
+    int async_samples;         /* Load the samples of selected presets in the background, with dynamic sample loading */
+    int loading_count;         /* Number of samples being loaded in the background */
+    unsigned int loading_serial; /* Changed whenever samples start or finish loading in the background */
+
+    fluid_ringbuffer_t *load_queue;      /* Samples to be loaded by the loader thread */
+    fluid_ringbuffer_t *loaded_queue;    /* Samples loaded by the loader thread, handed back to the synthesis thread */
+    fluid_cond_t *loader_wakeup;         /* Signalled when samples have been queued */
+    fluid_cond_mutex_t *loader_wakeup_m; /* loader_wakeup mutex companion */
+    fluid_atomic_int_t loader_terminate; /* Set to TRUE when the loader thread should terminate */
+    fluid_thread_t *loader;              /* The loader thread */
 
     fluid_list_t *preset_iter_cur;       /* the current preset in the iteration */
 };
@@ -149,6 +168,8 @@ struct _fluid_defpreset_t
     unsigned int num;                     /* the preset number */
     fluid_preset_zone_t *global_zone;        /* the global zone of the preset */
     fluid_preset_zone_t *zone;               /* the chained list of preset zones */
+    int loading;                          /* cached result of whether samples of the preset are being loaded */
+    unsigned int loading_serial;          /* the loading_serial of the soundfont the cached result is valid for */
 };
 
 fluid_defpreset_t *new_fluid_defpreset(fluid_defsfont_t *defsfont);
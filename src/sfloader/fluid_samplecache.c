@@ -25,6 +25,17 @@
  *
  * This is a wrapper around fluid_sffile_read_sample_data that attempts to cache the read
  * data across all FluidSynth instances in a global (process-wide) list.
+ *
+ * Uncompressed sample data may alternatively be memory mapped directly from the
+ * Soundfont file, instead of being read into allocated memory. The mapping of a
+ * file is shared by all cache entries of that file. As the mapping is read-only,
+ * its pages are shared with the page cache, and thereby with all other processes
+ * using the same file.
+ *
+ * Compressed sample data can't be mapped from the Soundfont file. If a cache
+ * directory is given, it is decoded once and stored there instead, in a file
+ * named after a hash of the cache key. Subsequent loads, also by other
+ * processes, map the decoded data from that file.
  */
 
 #include "fluid_samplecache.h"
@@ -33,6 +44,17 @@
 #include "fluid_list.h"
 
 
+typedef struct _fluid_samplecache_mapping_t fluid_samplecache_mapping_t;
+
+struct _fluid_samplecache_mapping_t
+{
+    char *filename;
+    time_t modification_time;
+
+    fluid_mapped_file_t *file;
+    int num_references;
+};
+
 typedef struct _fluid_samplecache_entry_t fluid_samplecache_entry_t;
 
 struct _fluid_samplecache_entry_t
@@ -55,15 +77,45 @@ struct _fluid_samplecache_entry_t
 
     int num_references;
     int mlocked;
+    unsigned int mlock_count; /* Number of sample words locked, only the preloaded part of mapped data */
+
+    /* The file mapping sample_data points into, NULL if the sample data was read */
+    fluid_samplecache_mapping_t *mapping;
 };
 
+/* Header of a file in the on-disk cache. It is followed by the cache key, padded
+ * to a multiple of 8 bytes, the 16-bit sample words and, optionally, the lower
+ * 8 bits of the 24-bit sample data. All in native byte order. */
+typedef struct
+{
+    char magic[8];
+    unsigned int byte_order;
+    unsigned int key_length;
+    unsigned int sample_count;
+    unsigned int has_data24;
+} fluid_samplecache_file_header_t;
+
+#define SAMPLECACHE_FILE_MAGIC "FLUIDSMP"
+#define SAMPLECACHE_FILE_BYTE_ORDER 0x01020304
+#define SAMPLECACHE_FILE_KEY_PADDING(_len) ((8 - ((_len) & 7)) & 7)
+
 static fluid_list_t *samplecache_list = NULL;
+static fluid_list_t *samplecache_mappings = NULL;
 static fluid_mutex_t samplecache_mutex = FLUID_MUTEX_INIT;
 
-static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf, unsigned int sample_start, unsigned int sample_end, int sample_type);
+static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf, unsigned int sample_start, unsigned int sample_end, int sample_type, int try_mmap, unsigned int preload, const char *cache_dir);
 static fluid_samplecache_entry_t *get_samplecache_entry(SFData *sf, unsigned int sample_start, unsigned int sample_end, int sample_type);
 static void delete_samplecache_entry(fluid_samplecache_entry_t *entry);
 
+static int map_sample_data(fluid_samplecache_entry_t *entry, SFData *sf, unsigned int sample_start, unsigned int sample_end, unsigned int preload);
+static char *get_cache_key(fluid_samplecache_entry_t *entry);
+static char *get_cache_filename(const char *cache_dir, const char *key);
+static int map_cached_sample_data(fluid_samplecache_entry_t *entry, const char *cache_dir, unsigned int preload);
+static void store_cached_sample_data(fluid_samplecache_entry_t *entry, const char *cache_dir);
+static fluid_samplecache_entry_t *find_samplecache_entry_by_data(const short *sample_data);
+static fluid_samplecache_mapping_t *get_samplecache_mapping(const char *filename, time_t modification_time);
+static void release_samplecache_mapping(fluid_samplecache_mapping_t *mapping);
+
 static int fluid_get_file_modification_time(char *filename, time_t *modification_time);
 
 
@@ -71,9 +123,11 @@ static int fluid_get_file_modification_time(char *filename, time_t *modification
 
 int fluid_samplecache_load(SFData *sf,
                            unsigned int sample_start, unsigned int sample_end, int sample_type,
-                           int try_mlock, short **sample_data, char **sample_data24)
+                           int try_mlock, int try_mmap, unsigned int preload,
+                           const char *cache_dir,
+                           short **sample_data, char **sample_data24)
 {
-    fluid_samplecache_entry_t *entry;
+    fluid_samplecache_entry_t *entry, *other;
     int ret;
 
     fluid_mutex_lock(samplecache_mutex);
@@ -82,7 +136,7 @@ int fluid_samplecache_load(SFData *sf,
 
     if(entry == NULL)
     {
-        entry = new_samplecache_entry(sf, sample_start, sample_end, sample_type);
+        entry = new_samplecache_entry(sf, sample_start, sample_end, sample_type, try_mmap, preload, cache_dir);
 
         if(entry == NULL)
         {
@@ -90,27 +144,52 @@ int fluid_samplecache_load(SFData *sf,
             goto unlock_exit;
         }
 
-        samplecache_list = fluid_list_prepend(samplecache_list, entry);
+        /* Another thread may have loaded the same sample data in the meantime */
+        other = get_samplecache_entry(sf, sample_start, sample_end, sample_type);
+
+        if(other != NULL)
+        {
+            delete_samplecache_entry(entry);
+            entry = other;
+        }
+        else
+        {
+            samplecache_list = fluid_list_prepend(samplecache_list, entry);
+        }
     }
 
-    if(try_mlock && !entry->mlocked)
+    /* The preloaded part of streamed sample data is pinned in any case, the
+     * synthesis thread reads it directly */
+    if((try_mlock || (entry->mapping != NULL && preload > 0)) && !entry->mlocked)
     {
+        /* Of mapped sample data, only the preloaded part is meant to stay in memory */
+        unsigned int count = entry->sample_count;
+
+        if(entry->mapping != NULL && preload > 0 && preload < count)
+        {
+            count = preload;
+        }
+
         /* Lock the memory to disable paging. It's okay if this fails. It
          * probably means that the user doesn't have the required permission. */
-        if(fluid_mlock(entry->sample_data, entry->sample_count * sizeof(short)) == 0)
+        if(fluid_mlock(entry->sample_data, count * sizeof(short)) == 0)
         {
             if(entry->sample_data24 != NULL)
             {
-                entry->mlocked = (fluid_mlock(entry->sample_data24, entry->sample_count) == 0);
+                entry->mlocked = (fluid_mlock(entry->sample_data24, count) == 0);
             }
             else
             {
                 entry->mlocked = TRUE;
             }
 
-            if(!entry->mlocked)
+            if(entry->mlocked)
+            {
+                entry->mlock_count = count;
+            }
+            else
             {
-                fluid_munlock(entry->sample_data, entry->sample_count * sizeof(short));
+                fluid_munlock(entry->sample_data, count * sizeof(short));
                 FLUID_LOG(FLUID_WARN, "Failed to pin the sample data to RAM; swapping is possible.");
             }
         }
@@ -148,11 +227,11 @@ int fluid_samplecache_unload(const short *sample_data)
             {
                 if(entry->mlocked)
                 {
-                    fluid_munlock(entry->sample_data, entry->sample_count * sizeof(short));
+                    fluid_munlock(entry->sample_data, entry->mlock_count * sizeof(short));
 
                     if(entry->sample_data24 != NULL)
                     {
-                        fluid_munlock(entry->sample_data24, entry->sample_count);
+                        fluid_munlock(entry->sample_data24, entry->mlock_count);
                     }
                 }
 
@@ -176,11 +255,62 @@ unlock_exit:
 }
 
 
+int fluid_samplecache_is_mapped(const short *sample_data)
+{
+    fluid_samplecache_entry_t *entry;
+    int ret;
+
+    fluid_mutex_lock(samplecache_mutex);
+
+    entry = find_samplecache_entry_by_data(sample_data);
+    ret = (entry != NULL && entry->mapping != NULL);
+
+    fluid_mutex_unlock(samplecache_mutex);
+    return ret;
+}
+
+/*
+ * Copy count sample points from start on out of loaded sample data, which may
+ * have to be read from disk if it is mapped. Fails if the sample data has
+ * been unloaded in the meantime.
+ */
+int fluid_samplecache_copy(const short *sample_data, unsigned int start, unsigned int count,
+                           short *data, char *data24)
+{
+    fluid_samplecache_entry_t *entry;
+    int ret = FLUID_FAILED;
+
+    fluid_mutex_lock(samplecache_mutex);
+
+    entry = find_samplecache_entry_by_data(sample_data);
+
+    if(entry != NULL && start + count <= entry->sample_count)
+    {
+        FLUID_MEMCPY(data, &entry->sample_data[start], count * sizeof(short));
+
+        if(data24 != NULL && entry->sample_data24 != NULL)
+        {
+            FLUID_MEMCPY(data24, &entry->sample_data24[start], count);
+        }
+
+        ret = FLUID_OK;
+    }
+
+    fluid_mutex_unlock(samplecache_mutex);
+    return ret;
+}
+
 /* Private functions */
+
+/* Called with samplecache_mutex locked, which is temporarily unlocked while the
+ * sample data is read. The caller has to check for a concurrently created entry. */
 static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf,
         unsigned int sample_start,
         unsigned int sample_end,
-        int sample_type)
+        int sample_type,
+        int try_mmap,
+        unsigned int preload,
+        const char *cache_dir)
 {
     fluid_samplecache_entry_t *entry;
 
@@ -216,14 +346,53 @@ static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf,
     entry->sample_end = sample_end;
     entry->sample_type = sample_type;
 
+    /* Compressed samples have to be decoded, so they can't be mapped */
+    if(try_mmap && !(sample_type & FLUID_SAMPLETYPE_OGG_VORBIS)
+            && map_sample_data(entry, sf, sample_start, sample_end, preload) == FLUID_OK)
+    {
+        return entry;
+    }
+
+    /* Compressed samples may have been decoded before */
+    if(cache_dir != NULL && (sample_type & FLUID_SAMPLETYPE_OGG_VORBIS)
+            && map_cached_sample_data(entry, cache_dir, preload) == FLUID_OK)
+    {
+        return entry;
+    }
+
+    /* Reading and decoding may take a while. Other threads loading samples
+     * shouldn't have to wait for it, so the lock is released meanwhile. */
+    fluid_mutex_unlock(samplecache_mutex);
+
     entry->sample_count = fluid_sffile_read_sample_data(sf, sample_start, sample_end, sample_type,
                           &entry->sample_data, &entry->sample_data24);
 
+    if(entry->sample_count > 0 && cache_dir != NULL && (sample_type & FLUID_SAMPLETYPE_OGG_VORBIS))
+    {
+        store_cached_sample_data(entry, cache_dir);
+    }
+
+    fluid_mutex_lock(samplecache_mutex);
+
     if(entry->sample_count < 0)
     {
         goto error_exit;
     }
 
+    /* Use the mapping of the stored data right away, so that it is shared with
+     * other processes already */
+    if(cache_dir != NULL && (sample_type & FLUID_SAMPLETYPE_OGG_VORBIS) && entry->sample_count > 0)
+    {
+        short *sample_data = entry->sample_data;
+        char *sample_data24 = entry->sample_data24;
+
+        if(map_cached_sample_data(entry, cache_dir, preload) == FLUID_OK)
+        {
+            FLUID_FREE(sample_data);
+            FLUID_FREE(sample_data24);
+        }
+    }
+
     return entry;
 
 error_exit:
@@ -236,11 +405,364 @@ static void delete_samplecache_entry(fluid_samplecache_entry_t *entry)
     fluid_return_if_fail(entry != NULL);
 
     FLUID_FREE(entry->filename);
-    FLUID_FREE(entry->sample_data);
-    FLUID_FREE(entry->sample_data24);
+
+    if(entry->mapping != NULL)
+    {
+        release_samplecache_mapping(entry->mapping);
+    }
+    else
+    {
+        FLUID_FREE(entry->sample_data);
+        FLUID_FREE(entry->sample_data24);
+    }
+
     FLUID_FREE(entry);
 }
 
+/* Let the sample data of the entry point into a mapping of the Soundfont file.
+ * Only the first preload sample words are paged in ahead of time, all of them
+ * if preload is 0.
+ * Returns FLUID_FAILED if the data can't be mapped, the caller is expected to
+ * fall back to reading it in that case. */
+static int map_sample_data(fluid_samplecache_entry_t *entry, SFData *sf,
+                           unsigned int sample_start, unsigned int sample_end,
+                           unsigned int preload)
+{
+    fluid_samplecache_mapping_t *mapping;
+    const char *contents;
+    size_t length;
+    unsigned int num_samples = (sample_end + 1) - sample_start;
+
+    /* The file is accessed by its name, so this only works with the default
+     * file callbacks. On big endian machines the samples would need to be
+     * byte swapped. */
+    if(sf->fcbs->fopen != default_fopen || FLUID_IS_BIG_ENDIAN
+            || (sf->samplepos % sizeof(short)) != 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* Same limits as fluid_sffile_read_wav(), which tolerates the sample word
+     * following the sample data chunk, as long as it is in the file */
+    if(sample_end < sample_start || sample_end * sizeof(short) > sf->samplesize)
+    {
+        return FLUID_FAILED;
+    }
+
+    mapping = get_samplecache_mapping(entry->filename, entry->modification_time);
+
+    if(mapping == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "Unable to map Soundfont file '%s', reading sample data instead", entry->filename);
+        return FLUID_FAILED;
+    }
+
+    contents = fluid_mapped_file_get_contents(mapping->file);
+    length = fluid_mapped_file_get_length(mapping->file);
+
+    if((size_t)sf->samplepos + (sample_end + 1) * sizeof(short) > length)
+    {
+        release_samplecache_mapping(mapping);
+        return FLUID_FAILED;
+    }
+
+    entry->mapping = mapping;
+    entry->sample_data = (short *)&contents[sf->samplepos] + sample_start;
+    entry->sample_data24 = NULL;
+    entry->sample_count = num_samples;
+
+    if(preload == 0 || preload > num_samples)
+    {
+        preload = num_samples;
+    }
+
+    /* As in fluid_sffile_read_wav(), broken 24-bit sample data is simply ignored */
+    if(sf->sample24pos)
+    {
+        if(sample_end < sf->sample24size && (size_t)sf->sample24pos + sf->sample24size <= length)
+        {
+            entry->sample_data24 = (char *)&contents[sf->sample24pos] + sample_start;
+            fluid_madvise_willneed(entry->sample_data24, preload);
+        }
+        else
+        {
+            FLUID_LOG(FLUID_WARN, "Ignoring 24-bit sample data, sound quality might suffer");
+        }
+    }
+
+    fluid_madvise_willneed(entry->sample_data, preload * sizeof(short));
+
+    return FLUID_OK;
+}
+
+/* Get the cache key of the entry for the on-disk cache. The caller has to free it. */
+static char *get_cache_key(fluid_samplecache_entry_t *entry)
+{
+    size_t size = FLUID_STRLEN(entry->filename) + 9 * 24;
+    char *key = FLUID_MALLOC(size);
+
+    if(key == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_SNPRINTF(key, size, "%s\n%ld\n%u\n%u\n%u\n%u\n%u\n%u\n%d",
+                   entry->filename, (long)entry->modification_time,
+                   entry->sf_samplepos, entry->sf_samplesize,
+                   entry->sf_sample24pos, entry->sf_sample24size,
+                   entry->sample_start, entry->sample_end, entry->sample_type);
+
+    return key;
+}
+
+/* Get the name of the file in the cache directory storing the sample data of
+ * the given key. The caller has to free it. */
+static char *get_cache_filename(const char *cache_dir, const char *key)
+{
+    /* Two independent 32-bit string hashes, FNV-1a and djb2 */
+    uint32_t fnv = 2166136261u, djb = 5381;
+    const unsigned char *p;
+    size_t size = FLUID_STRLEN(cache_dir) + 32;
+    char *filename = FLUID_MALLOC(size);
+
+    if(filename == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    for(p = (const unsigned char *)key; *p; p++)
+    {
+        fnv = (fnv ^ *p) * 16777619u;
+        djb = djb * 33 + *p;
+    }
+
+    FLUID_SNPRINTF(filename, size, "%s%c%08x%08x.fsd", cache_dir, G_DIR_SEPARATOR,
+                   (unsigned int)fnv, (unsigned int)djb);
+
+    return filename;
+}
+
+/* Let the sample data of the entry point into a mapping of its file in the
+ * on-disk cache. Only the first preload sample words are paged in ahead of
+ * time, all of them if preload is 0.
+ * Returns FLUID_FAILED if there is no valid file for the entry. */
+static int map_cached_sample_data(fluid_samplecache_entry_t *entry, const char *cache_dir,
+                                  unsigned int preload)
+{
+    fluid_samplecache_file_header_t header;
+    fluid_samplecache_mapping_t *mapping = NULL;
+    const char *contents;
+    size_t length, offset;
+    time_t mtime;
+    char *key, *filename = NULL;
+    int ret = FLUID_FAILED;
+
+    key = get_cache_key(entry);
+
+    if(key == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    filename = get_cache_filename(cache_dir, key);
+
+    if(filename == NULL || fluid_get_file_modification_time(filename, &mtime) == FLUID_FAILED)
+    {
+        goto exit;
+    }
+
+    mapping = get_samplecache_mapping(filename, mtime);
+
+    if(mapping == NULL)
+    {
+        goto exit;
+    }
+
+    contents = fluid_mapped_file_get_contents(mapping->file);
+    length = fluid_mapped_file_get_length(mapping->file);
+
+    if(length < sizeof(header))
+    {
+        goto exit;
+    }
+
+    FLUID_MEMCPY(&header, contents, sizeof(header));
+    offset = sizeof(header) + header.key_length + SAMPLECACHE_FILE_KEY_PADDING(header.key_length);
+
+    if(FLUID_MEMCMP(header.magic, SAMPLECACHE_FILE_MAGIC, sizeof(header.magic)) != 0
+            || header.byte_order != SAMPLECACHE_FILE_BYTE_ORDER
+            || header.key_length != FLUID_STRLEN(key)
+            || header.sample_count == 0
+            || length != offset + header.sample_count * (sizeof(short) + (header.has_data24 ? 1 : 0))
+            || FLUID_MEMCMP(contents + sizeof(header), key, header.key_length) != 0)
+    {
+        FLUID_LOG(FLUID_DBG, "Ignoring invalid sample cache file '%s'", filename);
+        goto exit;
+    }
+
+    entry->mapping = mapping;
+    mapping = NULL;
+    entry->sample_count = header.sample_count;
+    entry->sample_data = (short *)&contents[offset];
+    entry->sample_data24 = header.has_data24 ? (char *)&contents[offset + header.sample_count * sizeof(short)] : NULL;
+
+    if(preload == 0 || preload > header.sample_count)
+    {
+        preload = header.sample_count;
+    }
+
+    fluid_madvise_willneed(entry->sample_data, preload * sizeof(short));
+
+    if(entry->sample_data24 != NULL)
+    {
+        fluid_madvise_willneed(entry->sample_data24, preload);
+    }
+
+    ret = FLUID_OK;
+
+exit:
+    if(mapping != NULL)
+    {
+        release_samplecache_mapping(mapping);
+    }
+
+    FLUID_FREE(filename);
+    FLUID_FREE(key);
+    return ret;
+}
+
+/* Store the sample data of the entry in the on-disk cache. Failing to do so
+ * is not an error, the data just has to be decoded again next time. */
+static void store_cached_sample_data(fluid_samplecache_entry_t *entry, const char *cache_dir)
+{
+#ifdef FLUID_HAVE_FILE_SET_CONTENTS
+    fluid_samplecache_file_header_t header;
+    size_t offset, length;
+    char *key, *filename = NULL, *contents = NULL;
+
+    key = get_cache_key(entry);
+
+    if(key == NULL)
+    {
+        return;
+    }
+
+    filename = get_cache_filename(cache_dir, key);
+
+    if(filename == NULL)
+    {
+        goto exit;
+    }
+
+    FLUID_MEMSET(&header, 0, sizeof(header));
+    FLUID_MEMCPY(header.magic, SAMPLECACHE_FILE_MAGIC, sizeof(header.magic));
+    header.byte_order = SAMPLECACHE_FILE_BYTE_ORDER;
+    header.key_length = FLUID_STRLEN(key);
+    header.sample_count = entry->sample_count;
+    header.has_data24 = (entry->sample_data24 != NULL);
+
+    offset = sizeof(header) + header.key_length + SAMPLECACHE_FILE_KEY_PADDING(header.key_length);
+    length = offset + header.sample_count * (sizeof(short) + (header.has_data24 ? 1 : 0));
+    contents = FLUID_MALLOC(length);
+
+    if(contents == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto exit;
+    }
+
+    FLUID_MEMSET(contents, 0, offset);
+    FLUID_MEMCPY(contents, &header, sizeof(header));
+    FLUID_MEMCPY(contents + sizeof(header), key, header.key_length);
+    FLUID_MEMCPY(contents + offset, entry->sample_data, header.sample_count * sizeof(short));
+
+    if(header.has_data24)
+    {
+        FLUID_MEMCPY(contents + offset + header.sample_count * sizeof(short),
+                     entry->sample_data24, header.sample_count);
+    }
+
+    /* The file is replaced atomically, so that concurrent readers either see the old or the new file */
+    if(fluid_mkdir_with_parents(cache_dir) != 0 || !fluid_file_set_contents(filename, contents, length))
+    {
+        FLUID_LOG(FLUID_WARN, "Unable to store decoded sample data in '%s'", filename);
+    }
+
+exit:
+    FLUID_FREE(contents);
+    FLUID_FREE(filename);
+    FLUID_FREE(key);
+#endif
+}
+
+/* Get a reference to the mapping of the given file, mapping it if necessary */
+static fluid_samplecache_mapping_t *get_samplecache_mapping(const char *filename, time_t modification_time)
+{
+    fluid_list_t *list;
+    fluid_samplecache_mapping_t *mapping;
+
+    for(list = samplecache_mappings; list; list = fluid_list_next(list))
+    {
+        mapping = (fluid_samplecache_mapping_t *)fluid_list_get(list);
+
+        if((FLUID_STRCMP(filename, mapping->filename) == 0) &&
+                (modification_time == mapping->modification_time))
+        {
+            mapping->num_references++;
+            return mapping;
+        }
+    }
+
+    mapping = FLUID_NEW(fluid_samplecache_mapping_t);
+
+    if(mapping == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(mapping, 0, sizeof(*mapping));
+
+    mapping->filename = FLUID_STRDUP(filename);
+
+    if(mapping->filename == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(mapping);
+        return NULL;
+    }
+
+    mapping->file = new_fluid_mapped_file(filename);
+
+    if(mapping->file == NULL)
+    {
+        FLUID_FREE(mapping->filename);
+        FLUID_FREE(mapping);
+        return NULL;
+    }
+
+    mapping->modification_time = modification_time;
+    mapping->num_references = 1;
+    samplecache_mappings = fluid_list_prepend(samplecache_mappings, mapping);
+
+    return mapping;
+}
+
+static void release_samplecache_mapping(fluid_samplecache_mapping_t *mapping)
+{
+    if(--mapping->num_references > 0)
+    {
+        return;
+    }
+
+    samplecache_mappings = fluid_list_remove(samplecache_mappings, mapping);
+    delete_fluid_mapped_file(mapping->file);
+    FLUID_FREE(mapping->filename);
+    FLUID_FREE(mapping);
+}
+
 static fluid_samplecache_entry_t *get_samplecache_entry(SFData *sf,
         unsigned int sample_start,
         unsigned int sample_end,
@@ -281,6 +803,24 @@ static fluid_samplecache_entry_t *get_samplecache_entry(SFData *sf,
     return NULL;
 }
 
+static fluid_samplecache_entry_t *find_samplecache_entry_by_data(const short *sample_data)
+{
+    fluid_list_t *entry_list;
+    fluid_samplecache_entry_t *entry;
+
+    for(entry_list = samplecache_list; entry_list; entry_list = fluid_list_next(entry_list))
+    {
+        entry = (fluid_samplecache_entry_t *)fluid_list_get(entry_list);
+
+        if(sample_data == entry->sample_data)
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
 static int fluid_get_file_modification_time(char *filename, time_t *modification_time)
 {
     fluid_stat_buf_t buf;
@@ -27,8 +27,15 @@
 
 int fluid_samplecache_load(SFData *sf,
                            unsigned int sample_start, unsigned int sample_end, int sample_type,
-                           int try_mlock, short **data, char **data24);
+                           int try_mlock, int try_mmap, unsigned int preload,
+                           const char *cache_dir,
+                           short **data, char **data24);
 
 int fluid_samplecache_unload(const short *sample_data);
 
+int fluid_samplecache_is_mapped(const short *sample_data);
+
+int fluid_samplecache_copy(const short *sample_data, unsigned int start, unsigned int count,
+                           short *data, char *data24);
+
 #endif /* _FLUID_SAMPLECACHE_H */
@@ -320,6 +320,7 @@ SFData *fluid_sffile_open(const char *fname, const fluid_file_callbacks_t *fcbs)
 
     FLUID_MEMSET(sf, 0, sizeof(SFData));
 
+    fluid_mutex_init(sf->mutex);
     sf->fcbs = fcbs;
 
     if((sf->sffd = fcbs->fopen(fname)) == NULL)
@@ -398,6 +399,9 @@ int fluid_sffile_parse_presets(SFData *sf)
  *               24-bit sample data on success or NULL if no 24-bit data is present in file
  *
  * @return The number of sample words in returned buffers or -1 on failure
+ *
+ * May be called by several threads at once. Only the reading from the file is
+ * serialized, decompression runs in parallel.
  */
 int fluid_sffile_read_sample_data(SFData *sf, unsigned int sample_start, unsigned int sample_end,
                                   int sample_type, short **data, char **data24)
@@ -410,7 +414,9 @@ int fluid_sffile_read_sample_data(SFData *sf, unsigned int sample_start, unsigne
     }
     else
     {
+        fluid_mutex_lock(sf->mutex);
         num_samples = fluid_sffile_read_wav(sf, sample_start, sample_end, data, data24);
+        fluid_mutex_unlock(sf->mutex);
     }
 
     return num_samples;
@@ -477,6 +483,7 @@ void fluid_sffile_close(SFData *sf)
 
     delete_fluid_list(sf->sample);
 
+    fluid_mutex_destroy(sf->mutex);
     FLUID_FREE(sf);
 }
 
@@ -2337,15 +2344,14 @@ error_exit:
 /* Ogg Vorbis loading and decompression */
 #if LIBSNDFILE_SUPPORT
 
-/* Virtual file access rountines to allow loading individually compressed
- * samples from the Soundfont sample data chunk using the file callbacks
- * passing in during opening of the file */
+/* Virtual file access rountines to allow decompressing individually compressed
+ * samples, after their data has been read from the Soundfont sample data chunk
+ * using the file callbacks passed in during opening of the file */
 typedef struct _sfvio_data_t
 {
-    SFData *sffile;
-    sf_count_t start;  /* start byte offset of compressed data */
-    sf_count_t end;    /* end byte offset of compressed data */
-    sf_count_t offset; /* current virtual file offset from start byte offset */
+    const char *buffer; /* compressed data */
+    sf_count_t length;  /* length of compressed data */
+    sf_count_t offset;  /* current virtual file offset from start of compressed data */
 
 } sfvio_data_t;
 
@@ -2353,13 +2359,12 @@ static sf_count_t sfvio_get_filelen(void *user_data)
 {
     sfvio_data_t *data = user_data;
 
-    return (data->end + 1) - data->start;
+    return data->length;
 }
 
 static sf_count_t sfvio_seek(sf_count_t offset, int whence, void *user_data)
 {
     sfvio_data_t *data = user_data;
-    SFData *sf = data->sffile;
     sf_count_t new_offset;
 
     switch(whence)
@@ -2380,7 +2385,7 @@ static sf_count_t sfvio_seek(sf_count_t offset, int whence, void *user_data)
         goto fail; /* proper error handling not possible?? */
     }
 
-    if(sf->fcbs->fseek(sf->sffd, sf->samplepos + data->start + new_offset, SEEK_SET) != FLUID_FAILED)
+    if(new_offset >= 0 && new_offset <= data->length)
     {
         data->offset = new_offset;
     }
@@ -2392,7 +2397,6 @@ fail:
 static sf_count_t sfvio_read(void *ptr, sf_count_t count, void *user_data)
 {
     sfvio_data_t *data = user_data;
-    SFData *sf = data->sffile;
     sf_count_t remain;
 
     remain = sfvio_get_filelen(user_data) - data->offset;
@@ -2407,12 +2411,7 @@ static sf_count_t sfvio_read(void *ptr, sf_count_t count, void *user_data)
         return count;
     }
 
-    if(sf->fcbs->fread(ptr, count, sf->sffd) == FLUID_FAILED)
-    {
-        FLUID_LOG(FLUID_ERR, "Failed to read compressed sample data");
-        return 0;
-    }
-
+    FLUID_MEMCPY(ptr, data->buffer + data->offset, count);
     data->offset += count;
 
     return count;
@@ -2432,8 +2431,9 @@ static sf_count_t sfvio_tell(void *user_data)
  * Note that this function takes byte indices for start and end source data. The sample headers in SF3
  * files use byte indices, so those pointers can be passed directly to this function.
  *
- * This function uses a virtual file structure in order to read the Ogg Vorbis
- * data from arbitrary locations in the source file.
+ * This function reads the Ogg Vorbis data in one go, with the file locked, and
+ * decompresses it from memory using a virtual file structure. Decompression
+ * thus doesn't block other threads reading samples from the same file.
  */
 static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigned int end_byte, short **data)
 {
@@ -2448,26 +2448,50 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
         sfvio_tell
     };
     sfvio_data_t sfdata;
+    char *compressed_data;
     short *wav_data = NULL;
+    int ret;
 
-    if((start_byte > sf->samplesize) || (end_byte > sf->samplesize))
+    if((start_byte > sf->samplesize) || (end_byte > sf->samplesize) || (end_byte < start_byte))
     {
         FLUID_LOG(FLUID_ERR, "Ogg Vorbis data offsets exceed sample data chunk");
         return -1;
     }
 
     // Initialize file position indicator and SF_INFO structure
-    sfdata.sffile = sf;
-    sfdata.start = start_byte;
-    sfdata.end = end_byte;
+    sfdata.length = (end_byte + 1) - start_byte;
     sfdata.offset = 0;
 
     memset(&sfinfo, 0, sizeof(sfinfo));
 
-    /* Seek to beginning of Ogg Vorbis data in Soundfont */
+    compressed_data = FLUID_ARRAY(char, sfdata.length);
+
+    if(compressed_data == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return -1;
+    }
+
+    sfdata.buffer = compressed_data;
+
+    /* Read the Ogg Vorbis data from the Soundfont */
+    fluid_mutex_lock(sf->mutex);
+
     if(sf->fcbs->fseek(sf->sffd, sf->samplepos + start_byte, SEEK_SET) == FLUID_FAILED)
     {
         FLUID_LOG(FLUID_ERR, "Failed to seek to compressd sample position");
+        ret = FLUID_FAILED;
+    }
+    else if((ret = sf->fcbs->fread(compressed_data, sfdata.length, sf->sffd)) == FLUID_FAILED)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to read compressed sample data");
+    }
+
+    fluid_mutex_unlock(sf->mutex);
+
+    if(ret == FLUID_FAILED)
+    {
+        FLUID_FREE(compressed_data);
         return -1;
     }
 
@@ -2477,6 +2501,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
     if(!sndfile)
     {
         FLUID_LOG(FLUID_ERR, sf_strerror(sndfile));
+        FLUID_FREE(compressed_data);
         return -1;
     }
 
@@ -2486,6 +2511,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
         FLUID_LOG(FLUID_DBG, "Empty decompressed sample");
         *data = NULL;
         sf_close(sndfile);
+        FLUID_FREE(compressed_data);
         return 0;
     }
 
@@ -2508,6 +2534,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
     }
 
     sf_close(sndfile);
+    FLUID_FREE(compressed_data);
 
     *data = wav_data;
 
@@ -2516,6 +2543,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
 error_exit:
     FLUID_FREE(wav_data);
     sf_close(sndfile);
+    FLUID_FREE(compressed_data);
     return -1;
 }
 #else
@@ -30,6 +30,7 @@
 #include "fluid_mod.h"
 #include "fluidsynth.h"
 #include "fluidsynth_priv.h"
+#include "fluid_sys.h"
 
 
 /* Sound Font structure defines */
@@ -159,6 +160,7 @@ struct _SFData
     char *fname; /* file name */
     FILE *sffd; /* loaded sfont file descriptor */
     const fluid_file_callbacks_t *fcbs; /* file callbacks used to read this file */
+    fluid_mutex_t mutex; /* serializes access to sffd while samples are read by several threads */
 
     fluid_list_t *info; /* linked list of info strings (1st byte is ID) */
     fluid_list_t *preset; /* linked list of preset info */
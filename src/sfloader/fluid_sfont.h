@@ -27,6 +27,8 @@
 int fluid_sample_validate(fluid_sample_t *sample, unsigned int max_end);
 int fluid_sample_sanitize_loop(fluid_sample_t *sample, unsigned int max_end);
 
+void *default_fopen(const char *path);
+
 /*
  * Utility macros to access soundfonts, presets, and samples
  */
@@ -47,6 +49,9 @@ int fluid_sample_sanitize_loop(fluid_sample_t *sample, unsigned int max_end);
 #define fluid_preset_notify(_preset,_reason,_chan) \
   { if ((_preset) && (_preset)->notify) { (*(_preset)->notify)(_preset,_reason,_chan); }}
 
+#define fluid_preset_is_loading(_preset) \
+  ((_preset)->is_loading != NULL && (*(_preset)->is_loading)(_preset))
+
 
 #define fluid_sample_incr_ref(_sample) { (_sample)->refcount++; }
 
@@ -138,6 +143,16 @@ struct _fluid_preset_t
      * bad for realtime audio output (memory allocations and other OS calls).
      */
     int (*notify)(fluid_preset_t *preset, int reason, int chan);
+
+    /**
+     * Optional method telling whether sample data of the preset is still being
+     * loaded in the background. No notes should be started on the preset meanwhile.
+     * @param preset Virtual SoundFont preset
+     * @return TRUE if sample data is being loaded, FALSE otherwise
+     *
+     * Called from within synthesis context, like the notify method.
+     */
+    int (*is_loading)(fluid_preset_t *preset);
 };
 
 /**
@@ -169,12 +184,14 @@ struct _fluid_sample_t
     int auto_free;                /**< TRUE if _fluid_sample_t::data and _fluid_sample_t::data24 should be freed upon sample destruction */
     short *data;                  /**< Pointer to the sample's 16 bit PCM data */
     char *data24;                 /**< If not NULL, pointer to the least significant byte counterparts of each sample data point in order to create 24 bit audio samples */
+    unsigned int preload;         /**< If not 0, the sample data is streamed and only this many sample points at the start are kept in memory */
 
     int amplitude_that_reaches_noise_floor_is_valid;      /**< Indicates if \a amplitude_that_reaches_noise_floor is valid (TRUE), set to FALSE initially to calculate. */
     double amplitude_that_reaches_noise_floor;            /**< The amplitude at which the sample's loop will be below the noise floor.  For voice off optimization, calculated automatically. */
 
     unsigned int refcount;        /**< Count of voices using this sample */
     int preset_count;             /**< Count of selected presets using this sample (used for dynamic sample loading) */
+    int loading;                  /**< TRUE while the sample data is loaded in the background (used for dynamic sample loading) */
 
     /**
      * Implement this function to receive notification when sample is no longer used.
@@ -56,6 +56,8 @@ new_fluid_channel(fluid_synth_t *synth, int num)
     chan->channum = num;
     chan->preset = NULL;
     chan->tuning = NULL;
+    chan->voices = NULL;
+    FLUID_MEMSET(chan->key_voices, 0, sizeof(chan->key_voices));
 
     fluid_channel_init(chan);
     fluid_channel_init_ctrl(chan, 0);
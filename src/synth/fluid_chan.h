@@ -141,6 +141,12 @@ struct _fluid_channel_t
      * flag indicating whether the NRPN value is absolute or not.
      */
     char gen_abs[GEN_LAST];
+
+    /* The voices assigned to this channel, all of them and those of each key,
+     * so that MIDI events only visit the voices they affect. They are kept
+     * by fluid_voice_update_channel_lists(). */
+    fluid_voice_t *voices;
+    fluid_voice_t *key_voices[128];
 };
 
 fluid_channel_t *new_fluid_channel(fluid_synth_t *synth, int num);
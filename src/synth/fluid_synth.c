@@ -53,13 +53,29 @@ extern int feenableexcept(int excepts);
     FLUID_API_RETURN(fail_value); \
   } \
 
+/* With synth.lock-free-events the MIDI channel message is queued instead of
+ * locking the API. It is processed later, so only success can be reported. */
+#define FLUID_API_QUEUE_EVENT(type, param1, param2) \
+  if (fluid_synth_queue_event(synth, type, chan, param1, param2)) { \
+    return FLUID_OK; \
+  }
+
 static void fluid_synth_init(void);
 static void fluid_synth_api_enter(fluid_synth_t *synth);
 static void fluid_synth_api_exit(fluid_synth_t *synth);
+static int fluid_synth_queue_event(fluid_synth_t *synth, int type, int chan,
+                                   int param1, int param2);
+static void fluid_synth_process_event_queues_LOCAL(fluid_synth_t *synth);
+static void fluid_synth_try_process_event_queues(fluid_synth_t *synth);
 
 static int fluid_synth_noteon_LOCAL(fluid_synth_t *synth, int chan, int key,
                                     int vel);
 static int fluid_synth_noteoff_LOCAL(fluid_synth_t *synth, int chan, int key);
+static int fluid_synth_defer_note_LOCAL(fluid_synth_t *synth, int chan, int key, int vel);
+static int fluid_synth_cancel_deferred_notes_LOCAL(fluid_synth_t *synth, int chan, int key);
+static int fluid_synth_release_deferred_notes_LOCAL(fluid_synth_t *synth, int chan, int key);
+static void fluid_synth_damp_deferred_notes_LOCAL(fluid_synth_t *synth, int chan, int status);
+static void fluid_synth_start_deferred_notes_LOCAL(fluid_synth_t *synth);
 static int fluid_synth_cc_LOCAL(fluid_synth_t *synth, int channum, int num);
 static int fluid_synth_sysex_midi_tuning(fluid_synth_t *synth, const char *data,
         int len, char *response,
@@ -87,8 +103,10 @@ fluid_synth_get_preset_by_sfont_name(fluid_synth_t *synth, const char *sfontname
 static void fluid_synth_update_presets(fluid_synth_t *synth);
 static void fluid_synth_update_gain_LOCAL(fluid_synth_t *synth);
 static int fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony);
+static int fluid_synth_new_voices(fluid_synth_t *synth, int first, int last);
 static void init_dither(void);
-static FLUID_INLINE int roundi(float x);
+static void fluid_synth_pack_float(int len, const fluid_real_t *lin, const fluid_real_t *rin,
+                                   float *lout, int lincr, float *rout, int rincr);
 static int fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount);
 
 static fluid_voice_t *fluid_synth_free_voice_by_kill_LOCAL(fluid_synth_t *synth);
@@ -211,6 +229,11 @@ void fluid_synth_settings(fluid_settings_t *settings)
 
     fluid_settings_register_int(settings, "synth.ladspa.active", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_int(settings, "synth.lock-memory", 1, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.mmap-sample-data", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-streaming", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-streaming-preload", 500, 10, 60000, 0);
+    fluid_settings_register_str(settings, "synth.sample-cache-dir", "", 0);
+    fluid_settings_register_int(settings, "synth.sample-loading-threads", 0, 0, 256, 0);
     fluid_settings_register_str(settings, "midi.portname", "", 0);
 
 #ifdef DEFAULT_SOUNDFONT
@@ -226,10 +249,14 @@ void fluid_synth_settings(fluid_settings_t *settings)
     fluid_settings_register_num(settings, "synth.sample-rate", 44100.0f, 8000.0f, 96000.0f, 0);
     fluid_settings_register_int(settings, "synth.device-id", 0, 0, 126, 0);
     fluid_settings_register_int(settings, "synth.cpu-cores", 1, 1, 256, 0);
+    fluid_settings_register_int(settings, "synth.pipelined-fx", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.block-size", FLUID_BUFSIZE, FLUID_BUFSIZE_MIN, FLUID_BUFSIZE_MAX, 0);
+    fluid_settings_register_int(settings, "synth.parameter-ramp", 0, 0, 65535, 0);
 
     fluid_settings_register_int(settings, "synth.min-note-length", 10, 0, 65535, 0);
 
     fluid_settings_register_int(settings, "synth.threadsafe-api", 1, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.lock-free-events", 0, 0, 1, FLUID_HINT_TOGGLED);
 
     fluid_settings_register_num(settings, "synth.overflow.percussion", 4000, -10000, 10000, 0);
     fluid_settings_register_num(settings, "synth.overflow.sustained", -1000, -10000, 10000, 0);
@@ -246,6 +273,10 @@ void fluid_synth_settings(fluid_settings_t *settings)
     fluid_settings_add_option(settings, "synth.midi-bank-select", "mma");
 
     fluid_settings_register_int(settings, "synth.dynamic-sample-loading", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_str(settings, "synth.dynamic-sample-loading-policy", "sync", 0);
+    fluid_settings_add_option(settings, "synth.dynamic-sample-loading-policy", "sync");
+    fluid_settings_add_option(settings, "synth.dynamic-sample-loading-policy", "defer");
+    fluid_settings_add_option(settings, "synth.dynamic-sample-loading-policy", "drop");
 }
 
 /**
@@ -604,6 +635,9 @@ new_fluid_synth(fluid_settings_t *settings)
     char *important_channels;
     int i, nbuf, prio_level = 0;
     int with_ladspa = 0;
+    int lock_free_events = 0;
+    int pipelined_fx = 0;
+    int sample_streaming = 0;
 
     /* initialize all the conversion tables and other stuff */
     if(fluid_atomic_int_compare_and_exchange(&fluid_synth_initialized, 0, 1))
@@ -641,6 +675,8 @@ new_fluid_synth(fluid_settings_t *settings)
     fluid_settings_getnum_float(settings, "synth.gain", &synth->gain);
     fluid_settings_getint(settings, "synth.device-id", &synth->device_id);
     fluid_settings_getint(settings, "synth.cpu-cores", &synth->cores);
+    fluid_settings_getint(settings, "synth.block-size", &synth->block_size);
+    fluid_settings_getint(settings, "synth.parameter-ramp", &synth->param_ramp);
 
     fluid_settings_getnum_float(settings, "synth.overflow.percussion", &synth->overflow.percussion);
     fluid_settings_getnum_float(settings, "synth.overflow.released", &synth->overflow.released);
@@ -704,6 +740,22 @@ new_fluid_synth(fluid_settings_t *settings)
                   "I'll increase the number of channels to the next multiple.");
     }
 
+    /* the mixer buffers hold a whole number of blocks */
+    if((synth->block_size & (synth->block_size - 1)) != 0)
+    {
+        int n = FLUID_BUFSIZE_MIN;
+
+        while(n * 2 <= synth->block_size)
+        {
+            n *= 2;
+        }
+
+        synth->block_size = n;
+        fluid_settings_setint(settings, "synth.block-size", synth->block_size);
+        FLUID_LOG(FLUID_WARN, "Requested block size is not a power of two. "
+                  "I'll decrease it to the next power of two.");
+    }
+
     if(synth->audio_channels < 1)
     {
         FLUID_LOG(FLUID_WARN, "Requested number of audio channels is smaller than 1. "
@@ -776,13 +828,65 @@ new_fluid_synth(fluid_settings_t *settings)
     /* Allocate event queue for rvoice mixer */
     /* In an overflow situation, a new voice takes about 50 spaces in the queue! */
     synth->eventhandler = new_fluid_rvoice_eventhandler(synth->polyphony * 64,
-                          synth->polyphony, nbuf, synth->effects_channels, synth->sample_rate, synth->cores - 1, prio_level);
+                          synth->polyphony, nbuf, synth->effects_channels, synth->sample_rate, synth->block_size,
+                          synth->cores - 1, prio_level);
 
     if(synth->eventhandler == NULL)
     {
         goto error_recovery;
     }
 
+    fluid_settings_getint(settings, "synth.pipelined-fx", &pipelined_fx);
+    fluid_rvoice_mixer_set_pipelined_fx(synth->eventhandler->mixer, pipelined_fx);
+
+    fluid_settings_getint(settings, "synth.sample-streaming", &sample_streaming);
+
+    if(fluid_rvoice_mixer_set_sample_streaming(synth->eventhandler->mixer, sample_streaming,
+            synth->polyphony) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    synth->preset_cache = new_fluid_hashtable(fluid_direct_hash, fluid_direct_equal);
+
+    if(synth->preset_cache == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    synth->preset_cache_enabled = TRUE;
+
+    fluid_settings_getint(settings, "synth.lock-free-events", &lock_free_events);
+
+    if(lock_free_events && !synth->use_mutex)
+    {
+        FLUID_LOG(FLUID_WARN, "synth.lock-free-events requires synth.threadsafe-api, ignoring it");
+    }
+    else if(lock_free_events)
+    {
+        synth->event_queues = FLUID_ARRAY(fluid_synth_event_queue_t, FLUID_SYNTH_EVENT_PRODUCERS);
+
+        if(synth->event_queues == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
+
+        FLUID_MEMSET(synth->event_queues, 0, FLUID_SYNTH_EVENT_PRODUCERS * sizeof(fluid_synth_event_queue_t));
+
+        for(i = 0; i < FLUID_SYNTH_EVENT_PRODUCERS; i++)
+        {
+            synth->event_queues[i].queue = new_fluid_ringbuffer(FLUID_SYNTH_EVENT_QUEUE_LEN,
+                                           sizeof(fluid_synth_queued_event_t));
+
+            if(synth->event_queues[i].queue == NULL)
+            {
+                goto error_recovery;
+            }
+        }
+    }
+
     /* Setup the list of default modulators.
      * Needs to happen after eventhandler has been set up, as fluid_synth_enter_api is called in the process */
     synth->default_mod = NULL;
@@ -860,14 +964,9 @@ new_fluid_synth(fluid_settings_t *settings)
         goto error_recovery;
     }
 
-    for(i = 0; i < synth->nvoice; i++)
+    if(fluid_synth_new_voices(synth, 0, synth->nvoice) != FLUID_OK)
     {
-        synth->voice[i] = new_fluid_voice(synth->eventhandler, synth->sample_rate);
-
-        if(synth->voice[i] == NULL)
-        {
-            goto error_recovery;
-        }
+        goto error_recovery;
     }
 
     /* sets a default basic channel */
@@ -885,7 +984,7 @@ new_fluid_synth(fluid_settings_t *settings)
     fluid_synth_set_reverb_on(synth, synth->with_reverb);
     fluid_synth_set_chorus_on(synth, synth->with_chorus);
 
-    synth->cur = FLUID_BUFSIZE;
+    synth->cur = synth->block_size;
     synth->curmax = 0;
     synth->dither_index = 0;
 
@@ -942,6 +1041,17 @@ new_fluid_synth(fluid_settings_t *settings)
         synth->bank_select = FLUID_BANK_STYLE_MMA;
     }
 
+    synth->loading_policy = FLUID_SYNTH_LOADING_SYNC;
+
+    if(fluid_settings_str_equal(settings, "synth.dynamic-sample-loading-policy", "defer"))
+    {
+        synth->loading_policy = FLUID_SYNTH_LOADING_DEFER;
+    }
+    else if(fluid_settings_str_equal(settings, "synth.dynamic-sample-loading-policy", "drop"))
+    {
+        synth->loading_policy = FLUID_SYNTH_LOADING_DROP;
+    }
+
     fluid_synth_process_event_queue(synth);
 
     /* FIXME */
@@ -976,6 +1086,12 @@ delete_fluid_synth(fluid_synth_t *synth)
 
     fluid_profiling_print();
 
+    /* apply the voice updates which haven't been rendered yet, they hold sample references */
+    if(synth->eventhandler != NULL)
+    {
+        fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
+    }
+
     /* turn off all voices, needed to unload SoundFont data */
     if(synth->voice != NULL)
     {
@@ -1026,6 +1142,17 @@ delete_fluid_synth(fluid_synth_t *synth)
     }
 
     delete_fluid_list(synth->sfont);
+    delete_fluid_hashtable(synth->preset_cache);
+
+    if(synth->event_queues != NULL)
+    {
+        for(i = 0; i < FLUID_SYNTH_EVENT_PRODUCERS; i++)
+        {
+            delete_fluid_ringbuffer(synth->event_queues[i].queue);
+        }
+
+        FLUID_FREE(synth->event_queues);
+    }
 
     /* delete all the SoundFont loaders */
 
@@ -1058,6 +1185,13 @@ delete_fluid_synth(fluid_synth_t *synth)
         FLUID_FREE(synth->voice);
     }
 
+    for(list = synth->rvoice_arenas; list; list = fluid_list_next(list))
+    {
+        delete_fluid_rvoice_arena(fluid_list_get(list));
+    }
+
+    delete_fluid_list(synth->rvoice_arenas);
+
 
     /* free the tunings, if any */
     if(synth->tuning != NULL)
@@ -1131,6 +1265,7 @@ fluid_synth_noteon(fluid_synth_t *synth, int chan, int key, int vel)
     int result;
     fluid_return_val_if_fail(key >= 0 && key <= 127, FLUID_FAILED);
     fluid_return_val_if_fail(vel >= 0 && vel <= 127, FLUID_FAILED);
+    FLUID_API_QUEUE_EVENT(FLUID_SYNTH_EVENT_NOTEON, key, vel);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
     /* Allowed only on MIDI channel enabled */
@@ -1169,6 +1304,18 @@ fluid_synth_noteon_LOCAL(fluid_synth_t *synth, int chan, int key, int vel)
         return FLUID_FAILED;
     }
 
+    /* the samples of the preset are still being loaded in the background */
+    if(fluid_preset_is_loading(channel->preset))
+    {
+        if(synth->loading_policy == FLUID_SYNTH_LOADING_DEFER)
+        {
+            return fluid_synth_defer_note_LOCAL(synth, chan, key, vel);
+        }
+
+        FLUID_LOG(FLUID_DBG, "Dropping note %d on channel %d, its preset is still loading", key, chan);
+        return FLUID_FAILED;
+    }
+
     if(fluid_channel_is_playing_mono(channel)) /* channel is mono or legato CC is On) */
     {
         /* play the noteOn in monophonic */
@@ -1214,6 +1361,7 @@ fluid_synth_noteoff(fluid_synth_t *synth, int chan, int key)
 {
     int result;
     fluid_return_val_if_fail(key >= 0 && key <= 127, FLUID_FAILED);
+    FLUID_API_QUEUE_EVENT(FLUID_SYNTH_EVENT_NOTEOFF, key, 0);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
     /* Allowed only on MIDI channel enabled */
@@ -1230,6 +1378,9 @@ fluid_synth_noteoff_LOCAL(fluid_synth_t *synth, int chan, int key)
     int status;
     fluid_channel_t *channel = synth->channel[chan];
 
+    /* a note still waiting for its samples is never started, unless a pedal holds it */
+    int cancelled = fluid_synth_release_deferred_notes_LOCAL(synth, chan, key);
+
     if(fluid_channel_is_playing_mono(channel)) /* channel is mono or legato CC is On) */
     {
         /* play the noteOff in monophonic */
@@ -1250,7 +1401,208 @@ fluid_synth_noteoff_LOCAL(fluid_synth_t *synth, int chan, int key)
     /* Changes the state (Valid/Invalid) of the most recent note played in a
        staccato manner */
     fluid_channel_invalid_prev_note_staccato(channel);
-    return status;
+    return cancelled ? FLUID_OK : status;
+}
+
+/*
+ * Defers a note on a preset whose samples are still being loaded, see
+ * synth.dynamic-sample-loading-policy. fluid_synth_start_deferred_notes_LOCAL()
+ * starts it as soon as the samples are there, unless a note off comes first
+ * while no pedal holds it.
+ */
+static int
+fluid_synth_defer_note_LOCAL(fluid_synth_t *synth, int chan, int key, int vel)
+{
+    fluid_synth_deferred_note_t *note;
+    int count;
+
+    /* a repeated note replaces the waiting one */
+    fluid_synth_cancel_deferred_notes_LOCAL(synth, chan, key);
+    count = fluid_atomic_int_get(&synth->deferred_note_count);
+
+    if(count == FLUID_SYNTH_DEFERRED_NOTES)
+    {
+        FLUID_LOG(FLUID_WARN, "Too many notes waiting for samples to be loaded, dropping note %d on channel %d", key, chan);
+        return FLUID_FAILED;
+    }
+
+    note = &synth->deferred_notes[count];
+    note->chan = chan;
+    note->key = key;
+    note->vel = vel;
+    note->preset = synth->channel[chan]->preset;
+    note->id = synth->noteid++;
+    note->status = FLUID_VOICE_ON;
+    fluid_atomic_int_set(&synth->deferred_note_count, count + 1);
+
+    return FLUID_OK;
+}
+
+/*
+ * Removes deferred notes of a channel (chan=-1 selects all channels) and key
+ * (key=-1 selects all keys). Returns the number of removed notes.
+ */
+static int
+fluid_synth_cancel_deferred_notes_LOCAL(fluid_synth_t *synth, int chan, int key)
+{
+    fluid_synth_deferred_note_t *note;
+    int i, kept = 0;
+    int count = fluid_atomic_int_get(&synth->deferred_note_count);
+
+    for(i = 0; i < count; i++)
+    {
+        note = &synth->deferred_notes[i];
+
+        if(((-1 == chan) || (chan == note->chan)) && ((-1 == key) || (key == note->key)))
+        {
+            continue;
+        }
+
+        synth->deferred_notes[kept++] = *note;
+    }
+
+    if(kept != count)
+    {
+        fluid_atomic_int_set(&synth->deferred_note_count, kept);
+    }
+
+    return count - kept;
+}
+
+/*
+ * Applies a note off to the deferred notes of a channel and key. Like
+ * fluid_voice_noteoff(), a note is kept as long as the sustain or sostenuto
+ * pedal holds it, the others are removed. Returns the number of notes.
+ */
+static int
+fluid_synth_release_deferred_notes_LOCAL(fluid_synth_t *synth, int chan, int key)
+{
+    fluid_channel_t *channel = synth->channel[chan];
+    fluid_synth_deferred_note_t *note;
+    int i, released = 0;
+    int count = fluid_atomic_int_get(&synth->deferred_note_count);
+
+    for(i = 0; i < count; i++)
+    {
+        note = &synth->deferred_notes[i];
+
+        if(note->chan != chan || note->key != key || note->status != FLUID_VOICE_ON)
+        {
+            continue;
+        }
+
+        /* Sostenuto depressed after note */
+        if(fluid_channel_sostenuto(channel) && channel->sostenuto_orderid > note->id)
+        {
+            note->status = FLUID_VOICE_HELD_BY_SOSTENUTO;
+        }
+        else if(fluid_channel_sustained(channel))
+        {
+            note->status = FLUID_VOICE_SUSTAINED;
+        }
+        else
+        {
+            note->status = FLUID_VOICE_OFF;
+        }
+
+        released++;
+    }
+
+    if(released > 0)
+    {
+        fluid_synth_damp_deferred_notes_LOCAL(synth, chan, FLUID_VOICE_OFF);
+    }
+
+    return released;
+}
+
+/*
+ * Removes the deferred notes of a channel which are in the given state, used
+ * when the pedal holding them is released or no pedal holds them at all.
+ */
+static void
+fluid_synth_damp_deferred_notes_LOCAL(fluid_synth_t *synth, int chan, int status)
+{
+    fluid_synth_deferred_note_t *note;
+    int i, kept = 0;
+    int count = fluid_atomic_int_get(&synth->deferred_note_count);
+
+    for(i = 0; i < count; i++)
+    {
+        note = &synth->deferred_notes[i];
+
+        if(note->chan == chan && note->status == status)
+        {
+            continue;
+        }
+
+        synth->deferred_notes[kept++] = *note;
+    }
+
+    if(kept != count)
+    {
+        fluid_atomic_int_set(&synth->deferred_note_count, kept);
+    }
+}
+
+/*
+ * Starts the deferred notes whose presets have finished loading, in the order
+ * they have been played. Notes whose channel has got another preset meanwhile
+ * are dropped, they were meant for the preset they have been played on. Notes
+ * released under a pedal are started and released again, so that the pedal
+ * holds their voices.
+ */
+static void
+fluid_synth_start_deferred_notes_LOCAL(fluid_synth_t *synth)
+{
+    fluid_synth_deferred_note_t note, start[FLUID_SYNTH_DEFERRED_NOTES];
+    fluid_voice_t *voice;
+    int i, kept = 0, started = 0;
+    int count = fluid_atomic_int_get(&synth->deferred_note_count);
+
+    for(i = 0; i < count; i++)
+    {
+        note = synth->deferred_notes[i];
+
+        if(note.preset != synth->channel[note.chan]->preset)
+        {
+            FLUID_LOG(FLUID_DBG, "Preset changed while loading, dropping note %d on channel %d", note.key, note.chan);
+        }
+        else if(fluid_preset_is_loading(note.preset))
+        {
+            synth->deferred_notes[kept++] = note;
+        }
+        else
+        {
+            start[started++] = note;
+        }
+    }
+
+    /* starting the notes may change the list of deferred notes */
+    fluid_atomic_int_set(&synth->deferred_note_count, kept);
+
+    for(i = 0; i < started; i++)
+    {
+        note = start[i];
+
+        if(fluid_synth_noteon_LOCAL(synth, note.chan, note.key, note.vel) != FLUID_OK
+                || note.status == FLUID_VOICE_ON)
+        {
+            continue;
+        }
+
+        /* the voices take the id of the note, so that the sostenuto pedal
+           holds them if it has been pressed after the note */
+        for(voice = synth->channel[note.chan]->key_voices[note.key]; voice != NULL; voice = voice->key_next)
+        {
+            if(fluid_voice_is_on(voice) && fluid_voice_get_id(voice) == synth->storeid)
+            {
+                voice->id = note.id;
+            }
+        }
+
+        fluid_synth_noteoff_LOCAL(synth, note.chan, note.key);
+    }
 }
 
 /* Damps voices on a channel (turn notes off), if they're sustained by
@@ -1260,13 +1612,10 @@ fluid_synth_damp_voices_by_sustain_LOCAL(fluid_synth_t *synth, int chan)
 {
     fluid_channel_t *channel = synth->channel[chan];
     fluid_voice_t *voice;
-    int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = channel->voices; voice != NULL; voice = voice->channel_next)
     {
-        voice = synth->voice[i];
-
-        if((fluid_voice_get_channel(voice) == chan) && fluid_voice_is_sustained(voice))
+        if(fluid_voice_is_sustained(voice))
         {
             if(voice->key == channel->key_mono_sustained)
             {
@@ -1290,13 +1639,10 @@ fluid_synth_damp_voices_by_sostenuto_LOCAL(fluid_synth_t *synth, int chan)
 {
     fluid_channel_t *channel = synth->channel[chan];
     fluid_voice_t *voice;
-    int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = channel->voices; voice != NULL; voice = voice->channel_next)
     {
-        voice = synth->voice[i];
-
-        if((fluid_voice_get_channel(voice) == chan) && fluid_voice_is_sostenuto(voice))
+        if(fluid_voice_is_sostenuto(voice))
         {
             if(voice->key == channel->key_mono_sustained)
             {
@@ -1450,6 +1796,7 @@ fluid_synth_cc(fluid_synth_t *synth, int chan, int num, int val)
     fluid_channel_t *channel;
     fluid_return_val_if_fail(num >= 0 && num <= 127, FLUID_FAILED);
     fluid_return_val_if_fail(val >= 0 && val <= 127, FLUID_FAILED);
+    FLUID_API_QUEUE_EVENT(FLUID_SYNTH_EVENT_CC, num, val);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
     channel = synth->channel[chan];
@@ -1595,6 +1942,7 @@ fluid_synth_cc_LOCAL(fluid_synth_t *synth, int channum, int num)
         if(value < 64)  /* Sustain is released */
         {
             fluid_synth_damp_voices_by_sustain_LOCAL(synth, channum);
+            fluid_synth_damp_deferred_notes_LOCAL(synth, channum, FLUID_VOICE_SUSTAINED);
         }
 
         break;
@@ -1605,6 +1953,7 @@ fluid_synth_cc_LOCAL(fluid_synth_t *synth, int channum, int num)
         if(value < 64)  /* Sostenuto is released */
         {
             fluid_synth_damp_voices_by_sostenuto_LOCAL(synth, channum);
+            fluid_synth_damp_deferred_notes_LOCAL(synth, channum, FLUID_VOICE_HELD_BY_SOSTENUTO);
         }
         else /* Sostenuto is depressed */
             /* Update sostenuto order id when pedaling on Sostenuto */
@@ -2184,6 +2533,8 @@ fluid_synth_all_notes_off_LOCAL(fluid_synth_t *synth, int chan)
         }
     }
 
+    fluid_synth_cancel_deferred_notes_LOCAL(synth, chan, -1);
+
     return FLUID_OK;
 }
 
@@ -2233,6 +2584,8 @@ fluid_synth_all_sounds_off_LOCAL(fluid_synth_t *synth, int chan)
         }
     }
 
+    fluid_synth_cancel_deferred_notes_LOCAL(synth, chan, -1);
+
     return FLUID_OK;
 }
 
@@ -2316,16 +2669,10 @@ static int
 fluid_synth_modulate_voices_LOCAL(fluid_synth_t *synth, int chan, int is_cc, int ctrl)
 {
     fluid_voice_t *voice;
-    int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = synth->channel[chan]->voices; voice != NULL; voice = voice->channel_next)
     {
-        voice = synth->voice[i];
-
-        if(fluid_voice_get_channel(voice) == chan)
-        {
-            fluid_voice_modulate(voice, is_cc, ctrl);
-        }
+        fluid_voice_modulate(voice, is_cc, ctrl);
     }
 
     return FLUID_OK;
@@ -2341,16 +2688,10 @@ static int
 fluid_synth_modulate_voices_all_LOCAL(fluid_synth_t *synth, int chan)
 {
     fluid_voice_t *voice;
-    int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = synth->channel[chan]->voices; voice != NULL; voice = voice->channel_next)
     {
-        voice = synth->voice[i];
-
-        if(fluid_voice_get_channel(voice) == chan)
-        {
-            fluid_voice_modulate_all(voice);
-        }
+        fluid_voice_modulate_all(voice);
     }
 
     return FLUID_OK;
@@ -2369,6 +2710,7 @@ fluid_synth_channel_pressure(fluid_synth_t *synth, int chan, int val)
     int result;
     fluid_return_val_if_fail(val >= 0 && val <= 127, FLUID_FAILED);
 
+    FLUID_API_QUEUE_EVENT(FLUID_SYNTH_EVENT_CHANNEL_PRESSURE, val, 0);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
     /* Allowed only on MIDI channel enabled */
@@ -2408,6 +2750,7 @@ fluid_synth_key_pressure(fluid_synth_t *synth, int chan, int key, int val)
     fluid_return_val_if_fail(key >= 0 && key <= 127, FLUID_FAILED);
     fluid_return_val_if_fail(val >= 0 && val <= 127, FLUID_FAILED);
 
+    FLUID_API_QUEUE_EVENT(FLUID_SYNTH_EVENT_KEY_PRESSURE, key, val);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
     /* Allowed only on MIDI channel enabled */
@@ -2429,21 +2772,15 @@ static int
 fluid_synth_update_key_pressure_LOCAL(fluid_synth_t *synth, int chan, int key)
 {
     fluid_voice_t *voice;
-    int i;
     int result = FLUID_OK;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = synth->channel[chan]->key_voices[key]; voice != NULL; voice = voice->key_next)
     {
-        voice = synth->voice[i];
+        result = fluid_voice_modulate(voice, 0, FLUID_MOD_KEYPRESSURE);
 
-        if(voice->chan == chan && voice->key == key)
+        if(result != FLUID_OK)
         {
-            result = fluid_voice_modulate(voice, 0, FLUID_MOD_KEYPRESSURE);
-
-            if(result != FLUID_OK)
-            {
-                return result;
-            }
+            return result;
         }
     }
 
@@ -2462,6 +2799,7 @@ fluid_synth_pitch_bend(fluid_synth_t *synth, int chan, int val)
 {
     int result;
     fluid_return_val_if_fail(val >= 0 && val <= 16383, FLUID_FAILED);
+    FLUID_API_QUEUE_EVENT(FLUID_SYNTH_EVENT_PITCH_BEND, val, 0);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
     /* Allowed only on MIDI channel enabled */
@@ -2640,6 +2978,34 @@ fluid_synth_get_preset_by_sfont_name(fluid_synth_t *synth, const char *sfontname
     return NULL;
 }
 
+/* Forget all presets found by fluid_synth_find_preset(). Must be called
+ * whenever the SoundFont stack or a bank offset changes.
+ *
+ * Lookups are only cached while all SoundFonts come from the default loader.
+ * Other SoundFonts may get new presets or free them without the synth knowing
+ * about it, which would leave them shadowed or dangling in the cache.
+ */
+static void
+fluid_synth_clear_preset_cache(fluid_synth_t *synth)
+{
+    fluid_list_t *list;
+    fluid_sfont_t *sfont;
+
+    fluid_hashtable_remove_all(synth->preset_cache);
+    synth->preset_cache_enabled = TRUE;
+
+    for(list = synth->sfont; list; list = fluid_list_next(list))
+    {
+        sfont = fluid_list_get(list);
+
+        if(sfont->get_preset != fluid_defsfont_sfont_get_preset)
+        {
+            synth->preset_cache_enabled = FALSE;
+            break;
+        }
+    }
+}
+
 /* Find a preset by bank and program numbers.
  * Returns preset pointer or NULL.
  */
@@ -2650,6 +3016,22 @@ fluid_synth_find_preset(fluid_synth_t *synth, int banknum,
     fluid_preset_t *preset;
     fluid_sfont_t *sfont;
     fluid_list_t *list;
+    void *key = NULL;
+
+    /* Bank select gives 14 bit bank numbers, bank offsets aside */
+    int cacheable = synth->preset_cache_enabled
+                    && (banknum >= 0 && banknum <= 0xFFFF && prognum >= 0 && prognum <= 0xFF);
+
+    if(cacheable)
+    {
+        key = FLUID_UINT_TO_POINTER(((unsigned int)banknum << 8) | (unsigned int)prognum);
+        preset = fluid_hashtable_lookup(synth->preset_cache, key);
+
+        if(preset != NULL)
+        {
+            return preset;
+        }
+    }
 
     for(list = synth->sfont; list; list = fluid_list_next(list))
     {
@@ -2659,6 +3041,11 @@ fluid_synth_find_preset(fluid_synth_t *synth, int banknum,
 
         if(preset)
         {
+            if(cacheable)
+            {
+                fluid_hashtable_insert(synth->preset_cache, key, preset);
+            }
+
             return preset;
         }
     }
@@ -2686,6 +3073,7 @@ fluid_synth_program_change(fluid_synth_t *synth, int chan, int prognum)
     int subst_bank, subst_prog, banknum = 0, result = FLUID_FAILED;
 
     fluid_return_val_if_fail(prognum >= 0 && prognum <= 128, FLUID_FAILED);
+    FLUID_API_QUEUE_EVENT(FLUID_SYNTH_EVENT_PROGRAM_CHANGE, prognum, 0);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
     /* Allowed only on MIDI channel enabled */
@@ -3118,41 +3506,87 @@ fluid_synth_set_polyphony(fluid_synth_t *synth, int polyphony)
     FLUID_API_RETURN(result);
 }
 
-/* Called by synthesis thread to update the polyphony value */
+/*
+ * Creates the voices first to last - 1. Their rvoices are allocated in one
+ * arena, the ones used first side by side and the overflow rvoices behind
+ * them, so that the mixer doesn't stride over the voices to get at them.
+ */
 static int
-fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
+fluid_synth_new_voices(fluid_synth_t *synth, int first, int last)
 {
-    fluid_voice_t *voice;
-    int i;
+    fluid_rvoice_arena_t *arena;
+    int i, count = last - first;
 
-    if(new_polyphony > synth->nvoice)
+    for(i = first; i < last; i++)
     {
-        /* Create more voices */
-        fluid_voice_t **new_voices = FLUID_REALLOC(synth->voice,
-                                     sizeof(fluid_voice_t *) * new_polyphony);
-
-        if(new_voices == NULL)
-        {
-            return FLUID_FAILED;
-        }
+        synth->voice[i] = NULL;
+    }
 
-        synth->voice = new_voices;
+    arena = new_fluid_rvoice_arena(2 * count);
 
-        for(i = synth->nvoice; i < new_polyphony; i++)
+    if(arena == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    synth->rvoice_arenas = fluid_list_prepend(synth->rvoice_arenas, arena);
+
+    for(i = first; i < last; i++)
+    {
+        synth->voice[i] = new_fluid_voice(synth->eventhandler, synth->sample_rate,
+                                          synth->block_size, synth->param_ramp,
+                                          fluid_rvoice_arena_get(arena, i - first),
+                                          fluid_rvoice_arena_get(arena, count + i - first));
+
+        if(synth->voice[i] == NULL)
         {
-            synth->voice[i] = new_fluid_voice(synth->eventhandler, synth->sample_rate);
+            return FLUID_FAILED;
+        }
+    }
 
-            if(synth->voice[i] == NULL)
-            {
-                return FLUID_FAILED;
-            }
+    return FLUID_OK;
+}
+
+/* Called by synthesis thread to update the polyphony value */
+static int
+fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
+{
+    fluid_voice_t *voice;
+    int i;
+
+    if(new_polyphony > synth->nvoice)
+    {
+        /* Create more voices */
+        fluid_voice_t **new_voices = FLUID_REALLOC(synth->voice,
+                                     sizeof(fluid_voice_t *) * new_polyphony);
+
+        if(new_voices == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        synth->voice = new_voices;
+
+        if(fluid_synth_new_voices(synth, synth->nvoice, new_polyphony) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
 
+        for(i = synth->nvoice; i < new_polyphony; i++)
+        {
             fluid_voice_set_custom_filter(synth->voice[i], synth->custom_filter_type, synth->custom_filter_flags);
         }
 
         synth->nvoice = new_polyphony;
     }
 
+    /* voices above the old limit are candidates for stealing again */
+    for(i = synth->polyphony; i < new_polyphony; i++)
+    {
+        fluid_voice_update_overflow_class(synth->voice[i]);
+        fluid_voice_update_channel_lists(synth->voice[i]);
+    }
+
     synth->polyphony = new_polyphony;
 
     /* turn off any voices above the new limit */
@@ -3164,6 +3598,10 @@ fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
         {
             fluid_voice_off(voice);
         }
+
+        /* not a candidate for stealing anymore, nor affected by MIDI events */
+        fluid_voice_remove_overflow_class(voice);
+        fluid_voice_remove_channel_lists(voice);
     }
 
     fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_polyphony,
@@ -3223,12 +3661,13 @@ fluid_synth_get_active_voice_count(fluid_synth_t *synth)
  * @param synth FluidSynth instance
  * @return Internal buffer size in audio frames.
  *
- * Audio is synthesized this number of frames at a time.  Defaults to 64 frames.
+ * Audio is synthesized this number of frames at a time.  Defaults to 64 frames,
+ * see synth.block-size.
  */
 int
 fluid_synth_get_internal_bufsize(fluid_synth_t *synth)
 {
-    return FLUID_BUFSIZE;
+    return synth->block_size;
 }
 
 /**
@@ -3322,9 +3761,9 @@ fluid_synth_nwrite_float(fluid_synth_t *synth, int len,
     count = 0;
     num = synth->cur;
 
-    if(synth->cur < FLUID_BUFSIZE)
+    if(synth->cur < synth->block_size)
     {
-        available = FLUID_BUFSIZE - synth->cur;
+        available = synth->block_size - synth->cur;
         fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
         fluid_rvoice_mixer_get_fx_bufs(synth->eventhandler->mixer, &fx_left_in, &fx_right_in);
 
@@ -3398,7 +3837,7 @@ fluid_synth_nwrite_float(fluid_synth_t *synth, int len,
         fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
         fluid_rvoice_mixer_get_fx_bufs(synth->eventhandler->mixer, &fx_left_in, &fx_right_in);
 
-        num = (FLUID_BUFSIZE > len - count) ? len - count : FLUID_BUFSIZE;
+        num = (synth->block_size > len - count) ? len - count : synth->block_size;
 #ifdef WITH_FLOAT
         bytes = num * sizeof(float);
 #endif
@@ -3560,6 +3999,155 @@ fluid_synth_process(fluid_synth_t *synth, int len, int nfx, float *fx[],
     }
 }
 
+/* Count of frames rendered before, which fluid_synth_process() still has to output */
+static int
+fluid_synth_get_buffered_frames(fluid_synth_t *synth, int nout)
+{
+    /* fluid_synth_nwrite_float() keeps the rest of a single block only */
+    int end = (nout == 2) ? synth->curmax : synth->block_size;
+
+    return (synth->cur < end) ? end - synth->cur : 0;
+}
+
+/* Handles a MIDI event, so that the voices it starts set in delay samples into
+ * the next block. The API is held, so that the event isn't queued instead. */
+static void
+fluid_synth_handle_midi_event_delayed(fluid_synth_t *synth, fluid_midi_event_t *event, int delay)
+{
+    fluid_synth_api_enter(synth);
+    synth->start_delay = (delay > 0) ? delay : 0;
+    fluid_synth_handle_midi_event(synth, event);
+    synth->start_delay = 0;
+    fluid_synth_api_exit(synth);
+}
+
+/**
+ * Synthesize floating point audio to stereo audio channels like
+ * fluid_synth_process(), handling timestamped MIDI events on the way.
+ *
+ * Events passed to fluid_synth_handle_midi_event() take effect at the start of
+ * the next internal block of synth.block-size frames. The note-ons of the events
+ * passed here set in at their very frame instead, without having to shrink the
+ * period size. This is what audio plugin hosts like JACK or LV2 expect.
+ *
+ * @param synth FluidSynth instance
+ * @param len Count of audio frames to synthesize
+ * @param nevents Count of events in \c events and \c frames
+ * @param events Array of MIDI events to handle, as with fluid_synth_handle_midi_event()
+ * @param frames Array of the frames at which \c events occur, in ascending order
+ * and in the range <code>0 <= frames[i] < len</code>
+ * @param nfx Count of arrays in \c fx, see fluid_synth_process()
+ * @param fx Array of buffers to store effects audio to, see fluid_synth_process()
+ * @param nout Count of arrays in \c out, see fluid_synth_process()
+ * @param out Array of buffers to store (dry) audio to, see fluid_synth_process()
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise. Events which fail
+ * to be handled are skipped.
+ *
+ * @note Other events than note-ons, note-offs included, take effect at the start
+ * of the block containing their frame. Events at frames which were rendered by
+ * a previous call already take effect as early as possible.
+ *
+ * @note Should only be called from synthesis thread.
+ */
+int
+fluid_synth_process_events(fluid_synth_t *synth, int len, int nevents,
+                           fluid_midi_event_t *events[], const int frames[],
+                           int nfx, float *fx[], int nout, float *out[])
+{
+    float **bufs;
+    int i, e, n, done, available;
+    int result = FLUID_OK;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(nevents == 0 || (events != NULL && frames != NULL), FLUID_FAILED);
+
+    /* fx and out, advanced to the frames rendered next */
+    bufs = FLUID_ARRAY(float *, nfx + nout + 1);
+
+    if(bufs == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory.");
+        return FLUID_FAILED;
+    }
+
+    for(done = 0, e = 0; done < len && result == FLUID_OK; done += n)
+    {
+        available = fluid_synth_get_buffered_frames(synth, nout);
+
+        if(available > 0)
+        {
+            /* the events in here are late, they have to wait for the next block */
+            n = (available < len - done) ? available : len - done;
+        }
+        else
+        {
+            /* the next block starts at frame done */
+            for(; e < nevents && frames[e] < done + synth->block_size; e++)
+            {
+                fluid_synth_handle_midi_event_delayed(synth, events[e], frames[e] - done);
+            }
+
+            /* render all blocks up to the one of the next event at once */
+            n = len - done;
+
+            if(e < nevents && frames[e] - done < n)
+            {
+                n = (frames[e] - done) / synth->block_size * synth->block_size;
+            }
+        }
+
+        for(i = 0; i < nfx; i++)
+        {
+            bufs[i] = fx[i] + done;
+        }
+
+        for(i = 0; i < nout; i++)
+        {
+            bufs[nfx + i] = out[i] + done;
+        }
+
+        result = fluid_synth_process(synth, n, nfx, bufs, nout, bufs + nfx);
+    }
+
+    /* events behind the rendered frames */
+    for(; e < nevents; e++)
+    {
+        fluid_synth_handle_midi_event_delayed(synth, events[e], 0);
+    }
+
+    FLUID_FREE(bufs);
+    return result;
+}
+
+/* Converts len frames to single precision audio */
+static void
+fluid_synth_pack_float(int len, const fluid_real_t *lin, const fluid_real_t *rin,
+                       float *lout, int lincr, float *rout, int rincr)
+{
+    int i;
+
+    if(lincr == 2 && rincr == 2 && rout == lout + 1)
+    {
+        /* interleaved stereo */
+        #pragma omp simd
+        for(i = 0; i < len; i++)
+        {
+            lout[2 * i] = (float) lin[i];
+            lout[2 * i + 1] = (float) rin[i];
+        }
+    }
+    else
+    {
+        #pragma omp simd
+        for(i = 0; i < len; i++)
+        {
+            lout[i * lincr] = (float) lin[i];
+            rout[i * rincr] = (float) rin[i];
+        }
+    }
+}
+
 /**
  * Synthesize a block of floating point audio samples to audio buffers.
  * @param synth FluidSynth instance
@@ -3583,7 +4171,7 @@ fluid_synth_write_float(fluid_synth_t *synth, int len,
                         void *lout, int loff, int lincr,
                         void *rout, int roff, int rincr)
 {
-    int i, j, k, l;
+    int i, l, n;
     float *left_out = (float *) lout;
     float *right_out = (float *) rout;
     fluid_real_t *left_in;
@@ -3597,20 +4185,30 @@ fluid_synth_write_float(fluid_synth_t *synth, int len,
     l = synth->cur;
     fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
 
-    for(i = 0, j = loff, k = roff; i < len; i++, l++, j += lincr, k += rincr)
+    for(i = 0; i < len; i += n)
     {
         /* fill up the buffers as needed */
         if(l >= synth->curmax)
         {
-            int blocksleft = (len - i + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
-            synth->curmax = FLUID_BUFSIZE * fluid_synth_render_blocks(synth, blocksleft);
+            int blocksleft = (len - i + synth->block_size - 1) / synth->block_size;
+            synth->curmax = synth->block_size * fluid_synth_render_blocks(synth, blocksleft);
             fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
 
             l = 0;
         }
 
-        left_out[j] = (float) left_in[0 * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + l];
-        right_out[k] = (float) right_in[0 * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + l];
+        /* all frames rendered so far at once */
+        n = synth->curmax - l;
+
+        if(n > len - i)
+        {
+            n = len - i;
+        }
+
+        fluid_synth_pack_float(n, &left_in[0 * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + l],
+                               &right_in[0 * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + l],
+                               &left_out[loff + i * lincr], lincr, &right_out[roff + i * rincr], rincr);
+        l += n;
     }
 
     synth->cur = l;
@@ -3652,17 +4250,78 @@ init_dither(void)
     }
 }
 
-/* A portable replacement for roundf(), seems it may actually be faster too! */
-static FLUID_INLINE int
-roundi(float x)
+/* Rounds a scaled and dithered sample half away from zero to 16 bit, with
+ * digital clipping. Clipping before truncating gives the same result as
+ * clipping the rounded value, but lets the compiler vectorize the loops
+ * below, as the float to int conversion can't overflow. */
+static FLUID_INLINE signed short
+fluid_synth_round_s16(float x)
+{
+    x += (x >= 0.0f) ? 0.5f : -0.5f;
+    x = (x > 32767.0f) ? 32767.0f : x;
+    x = (x < -32768.0f) ? -32768.0f : x;
+
+    return (signed short)(int)x;
+}
+
+/* Converts len frames to dithered 16 bit audio, using the dither table from
+ * index di on, which must not wrap around within len. */
+static void
+fluid_synth_dither_frames(int len, const fluid_real_t *lin, const fluid_real_t *rin, int di,
+                          signed short *lout, int lincr, signed short *rout, int rincr)
 {
-    if(x >= 0.0f)
+    const float *ldither = &rand_table[0][di];
+    const float *rdither = &rand_table[1][di];
+    int i;
+
+    if(lincr == 2 && rincr == 2 && rout == lout + 1)
     {
-        return (int)(x + 0.5f);
+        /* interleaved stereo */
+        #pragma omp simd
+        for(i = 0; i < len; i++)
+        {
+            lout[2 * i] = fluid_synth_round_s16(lin[i] * 32766.0f + ldither[i]);
+            lout[2 * i + 1] = fluid_synth_round_s16(rin[i] * 32766.0f + rdither[i]);
+        }
     }
     else
     {
-        return (int)(x - 0.5f);
+        #pragma omp simd
+        for(i = 0; i < len; i++)
+        {
+            lout[i * lincr] = fluid_synth_round_s16(lin[i] * 32766.0f + ldither[i]);
+            rout[i * rincr] = fluid_synth_round_s16(rin[i] * 32766.0f + rdither[i]);
+        }
+    }
+}
+
+/* Same as fluid_synth_dither_frames(), for single precision input */
+static void
+fluid_synth_dither_float_frames(int len, const float *lin, const float *rin, int di,
+                                signed short *lout, int lincr, signed short *rout, int rincr)
+{
+    const float *ldither = &rand_table[0][di];
+    const float *rdither = &rand_table[1][di];
+    int i;
+
+    if(lincr == 2 && rincr == 2 && rout == lout + 1)
+    {
+        /* interleaved stereo */
+        #pragma omp simd
+        for(i = 0; i < len; i++)
+        {
+            lout[2 * i] = fluid_synth_round_s16(lin[i] * 32766.0f + ldither[i]);
+            lout[2 * i + 1] = fluid_synth_round_s16(rin[i] * 32766.0f + rdither[i]);
+        }
+    }
+    else
+    {
+        #pragma omp simd
+        for(i = 0; i < len; i++)
+        {
+            lout[i * lincr] = fluid_synth_round_s16(lin[i] * 32766.0f + ldither[i]);
+            rout[i * rincr] = fluid_synth_round_s16(rin[i] * 32766.0f + rdither[i]);
+        }
     }
 }
 
@@ -3691,13 +4350,11 @@ fluid_synth_write_s16(fluid_synth_t *synth, int len,
                       void *lout, int loff, int lincr,
                       void *rout, int roff, int rincr)
 {
-    int i, j, k, cur;
+    int i, n, cur;
     signed short *left_out = (signed short *) lout;
     signed short *right_out = (signed short *) rout;
     fluid_real_t *left_in;
     fluid_real_t *right_in;
-    fluid_real_t left_sample;
-    fluid_real_t right_sample;
     double time = fluid_utime();
     int di;
     float cpu_load;
@@ -3710,51 +4367,41 @@ fluid_synth_write_s16(fluid_synth_t *synth, int len,
     cur = synth->cur;
     di = synth->dither_index;
 
-    for(i = 0, j = loff, k = roff; i < len; i++, cur++, j += lincr, k += rincr)
+    for(i = 0; i < len; i += n)
     {
-
         /* fill up the buffers as needed */
         if(cur >= synth->curmax)
         {
-            int blocksleft = (len - i + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
-            synth->curmax = FLUID_BUFSIZE * fluid_synth_render_blocks(synth, blocksleft);
+            int blocksleft = (len - i + synth->block_size - 1) / synth->block_size;
+            synth->curmax = synth->block_size * fluid_synth_render_blocks(synth, blocksleft);
             fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
             cur = 0;
         }
 
-        left_sample = roundi(left_in[0 * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + cur] * 32766.0f + rand_table[0][di]);
-        right_sample = roundi(right_in[0 * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + cur] * 32766.0f + rand_table[1][di]);
-
-        di++;
+        /* all frames rendered so far at once, up to the end of the dither table */
+        n = synth->curmax - cur;
 
-        if(di >= DITHER_SIZE)
+        if(n > len - i)
         {
-            di = 0;
+            n = len - i;
         }
 
-        /* digital clipping */
-        if(left_sample > 32767.0f)
+        if(n > DITHER_SIZE - di)
         {
-            left_sample = 32767.0f;
+            n = DITHER_SIZE - di;
         }
 
-        if(left_sample < -32768.0f)
-        {
-            left_sample = -32768.0f;
-        }
+        fluid_synth_dither_frames(n, &left_in[0 * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + cur],
+                                  &right_in[0 * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + cur], di,
+                                  &left_out[loff + i * lincr], lincr, &right_out[roff + i * rincr], rincr);
 
-        if(right_sample > 32767.0f)
-        {
-            right_sample = 32767.0f;
-        }
+        cur += n;
+        di += n;
 
-        if(right_sample < -32768.0f)
+        if(di >= DITHER_SIZE)
         {
-            right_sample = -32768.0f;
+            di = 0;
         }
-
-        left_out[j] = (signed short) left_sample;
-        right_out[k] = (signed short) right_sample;
     }
 
     synth->cur = cur;
@@ -3792,50 +4439,31 @@ fluid_synth_dither_s16(int *dither_index, int len, float *lin, float *rin,
                        void *lout, int loff, int lincr,
                        void *rout, int roff, int rincr)
 {
-    int i, j, k;
+    int i, n;
     signed short *left_out = (signed short *) lout;
     signed short *right_out = (signed short *) rout;
-    fluid_real_t left_sample;
-    fluid_real_t right_sample;
     int di = *dither_index;
     fluid_profile_ref_var(prof_ref);
 
-    for(i = 0, j = loff, k = roff; i < len; i++, j += lincr, k += rincr)
+    for(i = 0; i < len; i += n)
     {
+        /* up to the end of the dither table at once */
+        n = DITHER_SIZE - di;
 
-        left_sample = roundi(lin[i] * 32766.0f + rand_table[0][di]);
-        right_sample = roundi(rin[i] * 32766.0f + rand_table[1][di]);
-
-        di++;
-
-        if(di >= DITHER_SIZE)
-        {
-            di = 0;
-        }
-
-        /* digital clipping */
-        if(left_sample > 32767.0f)
+        if(n > len - i)
         {
-            left_sample = 32767.0f;
+            n = len - i;
         }
 
-        if(left_sample < -32768.0f)
-        {
-            left_sample = -32768.0f;
-        }
+        fluid_synth_dither_float_frames(n, &lin[i], &rin[i], di,
+                                        &left_out[loff + i * lincr], lincr, &right_out[roff + i * rincr], rincr);
 
-        if(right_sample > 32767.0f)
-        {
-            right_sample = 32767.0f;
-        }
+        di += n;
 
-        if(right_sample < -32768.0f)
+        if(di >= DITHER_SIZE)
         {
-            right_sample = -32768.0f;
+            di = 0;
         }
-
-        left_out[j] = (signed short) left_sample;
-        right_out[k] = (signed short) right_sample;
     }
 
     *dither_index = di;	/* keep dither buffer continous */
@@ -3880,7 +4508,7 @@ void fluid_synth_process_event_queue(fluid_synth_t *synth)
 
 
 /**
- * Process blocks (FLUID_BUFSIZE) of audio.
+ * Process blocks (synth.block-size) of audio.
  * Must be called from renderer thread only!
  * @return number of blocks rendered. Might (often) return less than requested
  */
@@ -3895,6 +4523,7 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
 
     fluid_check_fpe("??? Just starting up ???");
 
+    fluid_synth_try_process_event_queues(synth);
     fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
 
     /* do not render more blocks than we can store internally */
@@ -3908,7 +4537,10 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
     for(i = 0; i < blockcount; i++)
     {
         fluid_sample_timer_process(synth);
-        fluid_synth_add_ticks(synth, FLUID_BUFSIZE);
+        fluid_synth_add_ticks(synth, synth->block_size);
+
+        /* Events sent by the sample timers have ended up in the queue of this thread */
+        fluid_synth_try_process_event_queues(synth);
 
         /* If events have been queued waiting for fluid_rvoice_eventhandler_dispatch_all()
          * (should only happen with parallel render) stop processing and go for rendering
@@ -3939,7 +4571,7 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
     fluid_check_fpe("??? Remainder of synth_one_block ???");
     fluid_profile(FLUID_PROF_ONE_BLOCK, prof_ref,
                   fluid_rvoice_mixer_get_active_voices(synth->eventhandler->mixer),
-                  blockcount * FLUID_BUFSIZE);
+                  blockcount * synth->block_size);
     return blockcount;
 }
 
@@ -4045,43 +4677,20 @@ static void fluid_synth_handle_overflow(void *data, const char *name, double val
 static fluid_voice_t *
 fluid_synth_free_voice_by_kill_LOCAL(fluid_synth_t *synth)
 {
-    int i;
-    float best_prio = OVERFLOW_PRIO_CANNOT_KILL - 1;
-    float this_voice_prio;
     fluid_voice_t *voice;
-    int best_voice_index = -1;
     unsigned int ticks = fluid_synth_get_ticks(synth);
 
-    for(i = 0; i < synth->polyphony; i++)
-    {
-
-        voice = synth->voice[i];
-
-        /* safeguard against an available voice. */
-        if(_AVAILABLE(voice))
-        {
-            return voice;
-        }
-
-        this_voice_prio = fluid_voice_get_overflow_prio(voice, &synth->overflow,
-                          ticks);
-
-        /* check if this voice has less priority than the previous candidate. */
-        if(this_voice_prio < best_prio)
-        {
-            best_voice_index = i;
-            best_prio = this_voice_prio;
-        }
-    }
+    /* Only playing voices are filed in the overflow lists. The caller made
+     * sure that none of the voices is available. */
+    voice = fluid_voice_get_overflow_victim(&synth->overflow, ticks);
 
-    if(best_voice_index < 0)
+    if(voice == NULL)
     {
         return NULL;
     }
 
-    voice = synth->voice[best_voice_index];
-    FLUID_LOG(FLUID_DBG, "Killing voice %d, index %d, chan %d, key %d ",
-              fluid_voice_get_id(voice), best_voice_index, fluid_voice_get_channel(voice), fluid_voice_get_key(voice));
+    FLUID_LOG(FLUID_DBG, "Killing voice %d, chan %d, key %d ",
+              fluid_voice_get_id(voice), fluid_voice_get_channel(voice), fluid_voice_get_key(voice));
     fluid_voice_off(voice);
 
     return voice;
@@ -4220,7 +4829,7 @@ fluid_synth_kill_by_exclusive_class_LOCAL(fluid_synth_t *synth,
         fluid_voice_t *new_voice)
 {
     int excl_class = fluid_voice_gen_value(new_voice, GEN_EXCLUSIVECLASS);
-    int i;
+    fluid_voice_t *existing_voice;
 
     /* Excl. class 0: No exclusive class */
     if(excl_class == 0)
@@ -4229,16 +4838,15 @@ fluid_synth_kill_by_exclusive_class_LOCAL(fluid_synth_t *synth,
     }
 
     /* Kill all notes on the same channel with the same exclusive class */
-    for(i = 0; i < synth->polyphony; i++)
+    for(existing_voice = new_voice->channel->voices; existing_voice != NULL;
+            existing_voice = existing_voice->channel_next)
     {
-        fluid_voice_t *existing_voice = synth->voice[i];
         int existing_excl_class = fluid_voice_gen_value(existing_voice, GEN_EXCLUSIVECLASS);
 
-        /* If voice is playing, on the same channel, has same exclusive
-         * class and is not part of the same noteon event (voice group), then kill it */
+        /* If voice is playing, has same exclusive class and is not part of
+         * the same noteon event (voice group), then kill it */
 
         if(fluid_voice_is_playing(existing_voice)
-                && fluid_voice_get_channel(existing_voice) == fluid_voice_get_channel(new_voice)
                 && existing_excl_class == excl_class
                 && fluid_voice_get_id(existing_voice) != fluid_voice_get_id(new_voice))
         {
@@ -4348,6 +4956,7 @@ fluid_synth_sfload(fluid_synth_t *synth, const char *filename, int reset_presets
                 synth->sfont_id = sfont->id = sfont_id;
 
                 synth->sfont = fluid_list_prepend(synth->sfont, sfont);   /* prepend to list */
+                fluid_synth_clear_preset_cache(synth);
 
                 /* reset the presets for all channels if requested */
                 if(reset_presets)
@@ -4388,6 +4997,7 @@ fluid_synth_sfunload(fluid_synth_t *synth, int id, int reset_presets)
         if(fluid_sfont_get_id(sfont) == id)
         {
             synth->sfont = fluid_list_remove(synth->sfont, sfont);
+            fluid_synth_clear_preset_cache(synth);
             break;
         }
     }
@@ -4510,6 +5120,7 @@ fluid_synth_sfreload(fluid_synth_t *synth, int id)
             sfont->refcount++;
 
             synth->sfont = fluid_list_insert_at(synth->sfont, index, sfont);  /* insert the sfont at the same index */
+            fluid_synth_clear_preset_cache(synth);
 
             /* reset the presets for all channels */
             fluid_synth_update_presets(synth);
@@ -4546,6 +5157,7 @@ fluid_synth_add_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont)
     {
         synth->sfont_id = sfont->id = sfont_id;
         synth->sfont = fluid_list_prepend(synth->sfont, sfont);        /* prepend to list */
+        fluid_synth_clear_preset_cache(synth);
 
         /* reset the presets for all channels */
         fluid_synth_program_reset(synth);
@@ -4585,6 +5197,7 @@ fluid_synth_remove_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont)
         if(sfont_tmp == sfont)
         {
             synth->sfont = fluid_list_remove(synth->sfont, sfont_tmp);
+            fluid_synth_clear_preset_cache(synth);
             ret = FLUID_OK;
             break;
         }
@@ -5246,7 +5859,6 @@ void
 fluid_synth_release_voice_on_same_note_LOCAL(fluid_synth_t *synth, int chan,
         int key)
 {
-    int i;
     fluid_voice_t *voice;
 
     /* storeid is a parameter for fluid_voice_init() */
@@ -5259,13 +5871,9 @@ fluid_synth_release_voice_on_same_note_LOCAL(fluid_synth_t *synth, int chan,
         return;
     }
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = synth->channel[chan]->key_voices[key]; voice != NULL; voice = voice->key_next)
     {
-        voice = synth->voice[i];
-
         if(fluid_voice_is_playing(voice)
-                && (fluid_voice_get_channel(voice) == chan)
-                && (fluid_voice_get_key(voice) == key)
                 && (fluid_voice_get_id(voice) != synth->noteid))
         {
             /* Id of voices that was sustained by sostenuto */
@@ -5395,6 +6003,24 @@ fluid_synth_get_cpu_load(fluid_synth_t *synth)
     return fluid_atomic_float_get(&synth->cpu_load);
 }
 
+/**
+ * Get the number of times a voice ran out of streamed sample data.
+ *
+ * With synth.sample-streaming enabled, a voice which reaches sample data that
+ * hasn't been read from disk yet is silent until the data has arrived. Each
+ * time this happens counts as an underrun. A growing count means that
+ * synth.sample-streaming-preload is too short for the disk or the audio period.
+ *
+ * @param synth FluidSynth instance
+ * @return Number of underruns since the synth was created, 0 if sample streaming is off
+ */
+int
+fluid_synth_get_stream_underruns(fluid_synth_t *synth)
+{
+    fluid_return_val_if_fail(synth != NULL, 0);
+    return fluid_rvoice_mixer_get_stream_underruns(synth->eventhandler->mixer);
+}
+
 /* Get tuning for a given bank:program */
 static fluid_tuning_t *
 fluid_synth_get_tuning(fluid_synth_t *synth, int bank, int prog)
@@ -5510,13 +6136,10 @@ static void
 fluid_synth_update_voice_tuning_LOCAL(fluid_synth_t *synth, fluid_channel_t *channel)
 {
     fluid_voice_t *voice;
-    int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = channel->voices; voice != NULL; voice = voice->channel_next)
     {
-        voice = synth->voice[i];
-
-        if(fluid_voice_is_on(voice) && (voice->channel == channel))
+        if(fluid_voice_is_on(voice))
         {
             fluid_voice_calculate_gen_pitch(voice);
             fluid_voice_update_param(voice, GEN_PITCH);
@@ -5983,18 +6606,12 @@ fluid_synth_set_gen_LOCAL(fluid_synth_t *synth, int chan, int param, float value
                           int absolute)
 {
     fluid_voice_t *voice;
-    int i;
 
     fluid_channel_set_gen(synth->channel[chan], param, value, absolute);
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = synth->channel[chan]->voices; voice != NULL; voice = voice->channel_next)
     {
-        voice = synth->voice[i];
-
-        if(fluid_voice_get_channel(voice) == chan)
-        {
-            fluid_voice_set_param(voice, param, value, absolute);
-        }
+        fluid_voice_set_param(voice, param, value, absolute);
     }
 }
 
@@ -6165,6 +6782,7 @@ fluid_synth_set_bank_offset(fluid_synth_t *synth, int sfont_id, int offset)
         if(fluid_sfont_get_id(sfont) == sfont_id)
         {
             sfont->bankofs = offset;
+            fluid_synth_clear_preset_cache(synth);
             break;
         }
     }
@@ -6228,10 +6846,31 @@ fluid_synth_api_enter(fluid_synth_t *synth)
     }
 
     synth->public_api_count++;
+
+    /* notes deferred before must take effect before this call as well */
+    if(synth->public_api_count == 1 && fluid_atomic_int_get(&synth->deferred_note_count) > 0)
+    {
+        fluid_synth_start_deferred_notes_LOCAL(synth);
+    }
+
+    if(synth->public_api_count == 1 && synth->event_queues != NULL)
+    {
+        fluid_atomic_pointer_set(&synth->api_owner, fluid_thread_get_id());
+
+        /* events queued before must take effect before this call */
+        fluid_synth_process_event_queues_LOCAL(synth);
+    }
 }
 
 void fluid_synth_api_exit(fluid_synth_t *synth)
 {
+    if(synth->public_api_count == 1 && synth->event_queues != NULL)
+    {
+        /* process the events queued while this thread was holding the lock */
+        fluid_synth_process_event_queues_LOCAL(synth);
+        fluid_atomic_pointer_set(&synth->api_owner, FLUID_THREAD_ID_NULL);
+    }
+
     synth->public_api_count--;
 
     if(!synth->public_api_count)
@@ -6246,6 +6885,165 @@ void fluid_synth_api_exit(fluid_synth_t *synth)
 
 }
 
+/*
+ * Queues a MIDI channel message sent by the calling thread, if synth.lock-free-events
+ * is enabled. Each thread gets its own single producer, single consumer queue,
+ * so no lock is needed. The queues are processed by the thread holding the API
+ * lock, see fluid_synth_api_enter() and fluid_synth_try_process_event_queues().
+ *
+ * Returns TRUE if the message has been queued, FALSE if it must be processed
+ * right away: if queueing is disabled, if the calling thread holds the lock
+ * already, if all queues have been claimed by other threads or if the queue is
+ * full. In the latter case fluid_synth_api_enter() processes the queue before
+ * the message, so the order of the messages is maintained.
+ */
+static int
+fluid_synth_queue_event(fluid_synth_t *synth, int type, int chan, int param1, int param2)
+{
+    fluid_thread_id_t self;
+    fluid_thread_id_t owner;
+    fluid_ringbuffer_t *queue = NULL;
+    fluid_synth_queued_event_t *event;
+    int i;
+
+    if(synth == NULL || synth->event_queues == NULL
+            || chan < 0 || chan >= synth->midi_channels)
+    {
+        return FALSE;
+    }
+
+    self = fluid_thread_get_id();
+
+    if(fluid_atomic_pointer_get(&synth->api_owner) == self)
+    {
+        return FALSE;
+    }
+
+    /* Queues are claimed in order and never given back, so the queue of this
+     * thread is always found before any unclaimed one. */
+    for(i = 0; i < FLUID_SYNTH_EVENT_PRODUCERS; i++)
+    {
+        owner = fluid_atomic_pointer_get(&synth->event_queues[i].owner);
+
+        if(owner == self
+                || (owner == FLUID_THREAD_ID_NULL
+                    && fluid_atomic_pointer_compare_and_exchange(&synth->event_queues[i].owner, FLUID_THREAD_ID_NULL, self)))
+        {
+            queue = synth->event_queues[i].queue;
+            break;
+        }
+    }
+
+    if(queue == NULL)
+    {
+        return FALSE;
+    }
+
+    event = fluid_ringbuffer_get_inptr(queue, 0);
+
+    if(event == NULL)
+    {
+        return FALSE;
+    }
+
+    event->type = type;
+    event->chan = chan;
+    event->param1 = param1;
+    event->param2 = param2;
+    fluid_ringbuffer_next_inptr(queue, 1);
+
+    return TRUE;
+}
+
+/*
+ * Processes the messages of all event queues. Must be called by the thread
+ * holding the API lock, so the messages are simply passed to the public API
+ * functions.
+ */
+static void
+fluid_synth_process_event_queues_LOCAL(fluid_synth_t *synth)
+{
+    fluid_ringbuffer_t *queue;
+    fluid_synth_queued_event_t *event;
+    int i, count;
+
+    for(i = 0; i < FLUID_SYNTH_EVENT_PRODUCERS; i++)
+    {
+        queue = synth->event_queues[i].queue;
+
+        /* don't chase a producer which keeps on sending */
+        for(count = fluid_ringbuffer_get_count(queue); count > 0; count--)
+        {
+            event = fluid_ringbuffer_get_outptr(queue);
+
+            switch(event->type)
+            {
+            case FLUID_SYNTH_EVENT_NOTEON:
+                fluid_synth_noteon(synth, event->chan, event->param1, event->param2);
+                break;
+
+            case FLUID_SYNTH_EVENT_NOTEOFF:
+                fluid_synth_noteoff(synth, event->chan, event->param1);
+                break;
+
+            case FLUID_SYNTH_EVENT_CC:
+                fluid_synth_cc(synth, event->chan, event->param1, event->param2);
+                break;
+
+            case FLUID_SYNTH_EVENT_PITCH_BEND:
+                fluid_synth_pitch_bend(synth, event->chan, event->param1);
+                break;
+
+            case FLUID_SYNTH_EVENT_CHANNEL_PRESSURE:
+                fluid_synth_channel_pressure(synth, event->chan, event->param1);
+                break;
+
+            case FLUID_SYNTH_EVENT_KEY_PRESSURE:
+                fluid_synth_key_pressure(synth, event->chan, event->param1, event->param2);
+                break;
+
+            case FLUID_SYNTH_EVENT_PROGRAM_CHANGE:
+                fluid_synth_program_change(synth, event->chan, event->param1);
+                break;
+
+            default:
+                break;
+            }
+
+            fluid_ringbuffer_next_outptr(queue);
+        }
+    }
+}
+
+/*
+ * Called by the rendering thread before each block to process the queued
+ * events and to start deferred notes. It never waits for the API lock: if
+ * another thread holds it, that thread takes care of both when it enters or
+ * leaves the API.
+ */
+static void
+fluid_synth_try_process_event_queues(fluid_synth_t *synth)
+{
+    int i;
+    int pending = fluid_atomic_int_get(&synth->deferred_note_count) > 0;
+
+    for(i = 0; !pending && synth->event_queues != NULL && i < FLUID_SYNTH_EVENT_PRODUCERS; i++)
+    {
+        pending = fluid_ringbuffer_get_count(synth->event_queues[i].queue) > 0;
+    }
+
+    if(!pending || !fluid_rec_mutex_trylock(synth->mutex))
+    {
+        return;
+    }
+
+    /* entering and leaving the API processes the queues */
+    fluid_synth_api_enter(synth);
+    fluid_synth_api_exit(synth);
+
+    fluid_rec_mutex_unlock(synth->mutex);
+}
+
 /**
  * Set midi channel type
  * @param synth FluidSynth instance
@@ -30,12 +30,14 @@
 
 #include "fluid_sys.h"
 #include "fluid_list.h"
+#include "fluid_hash.h"
 #include "fluid_rev.h"
 #include "fluid_voice.h"
 #include "fluid_chorus.h"
 #include "fluid_ladspa.h"
 #include "fluid_midi_router.h"
 #include "fluid_rvoice_event.h"
+#include "fluid_ringbuffer.h"
 
 /***************************************************************
  *
@@ -57,6 +59,11 @@
 #define FLUID_CHORUS_DEFAULT_DEPTH 8.0f                         /**< Default chorus depth */
 #define FLUID_CHORUS_DEFAULT_TYPE FLUID_CHORUS_MOD_SINE         /**< Default chorus waveform type */
 
+#define FLUID_SYNTH_EVENT_PRODUCERS 8       /**< Max. number of threads with an own event queue (synth.lock-free-events) */
+#define FLUID_SYNTH_EVENT_QUEUE_LEN 1024    /**< Number of events each of these queues can hold */
+
+#define FLUID_SYNTH_DEFERRED_NOTES 128      /**< Max. number of notes waiting for their samples to be loaded */
+
 /***************************************************************
  *
  *                         ENUM
@@ -73,6 +80,17 @@ enum fluid_midi_bank_select
     FLUID_BANK_STYLE_MMA  /**< MMA style bank = 128*MSB+LSB */
 };
 
+/**
+ * What happens to notes played on presets whose samples are still being loaded,
+ * see synth.dynamic-sample-loading-policy.
+ */
+enum fluid_synth_loading_policy
+{
+    FLUID_SYNTH_LOADING_SYNC,   /**< Samples are loaded while selecting the preset, so there are no such notes */
+    FLUID_SYNTH_LOADING_DEFER,  /**< Notes are started as soon as the samples have been loaded */
+    FLUID_SYNTH_LOADING_DROP    /**< Notes are ignored */
+};
+
 enum fluid_synth_status
 {
     FLUID_SYNTH_CLEAN,
@@ -81,6 +99,50 @@ enum fluid_synth_status
     FLUID_SYNTH_STOPPED
 };
 
+/**
+ * MIDI channel messages which can be queued by fluid_synth_queue_event().
+ */
+enum fluid_synth_queued_event_type
+{
+    FLUID_SYNTH_EVENT_NOTEON,
+    FLUID_SYNTH_EVENT_NOTEOFF,
+    FLUID_SYNTH_EVENT_CC,
+    FLUID_SYNTH_EVENT_PITCH_BEND,
+    FLUID_SYNTH_EVENT_CHANNEL_PRESSURE,
+    FLUID_SYNTH_EVENT_KEY_PRESSURE,
+    FLUID_SYNTH_EVENT_PROGRAM_CHANGE
+};
+
+typedef struct
+{
+    int type;       /**< #fluid_synth_queued_event_type */
+    int chan;
+    int param1;
+    int param2;
+} fluid_synth_queued_event_t;
+
+/*
+ * Single producer, single consumer event queue of a thread calling the public API.
+ */
+typedef struct
+{
+    fluid_thread_id_t owner;    /**< the producer thread, FLUID_THREAD_ID_NULL if not claimed yet */
+    fluid_ringbuffer_t *queue;  /**< queue of fluid_synth_queued_event_t */
+} fluid_synth_event_queue_t;
+
+/*
+ * Note on waiting for the samples of its preset to be loaded.
+ */
+typedef struct
+{
+    int chan;
+    int key;
+    int vel;
+    fluid_preset_t *preset; /* the preset the note has been played on */
+    unsigned int id;        /* the voice id reserved for the note, so that the sostenuto pedal knows its age */
+    int status;             /* FLUID_VOICE_ON, or the pedal holding the note after a note off */
+} fluid_synth_deferred_note_t;
+
 #define SYNTH_REVERB_CHANNEL 0
 #define SYNTH_CHORUS_CHANNEL 1
 
@@ -96,6 +158,9 @@ enum fluid_synth_status
  * cpu_load - atomic, set by rendering thread only
  * cur, curmax, dither_index - used by rendering thread only
  * ladspa_fx - same instance copied in rendering thread. Synchronising handled internally.
+ * event_queues - lock-free, filled by the thread owning the queue, emptied by the thread
+ *   holding the mutex
+ * deferred_note_count - atomic, so that the rendering thread can check it without the mutex
  *
  */
 
@@ -104,6 +169,8 @@ struct _fluid_synth_t
     fluid_rec_mutex_t mutex;           /**< Lock for public API */
     int use_mutex;                     /**< Use mutex for all public API functions? */
     int public_api_count;              /**< How many times the mutex is currently locked */
+    fluid_thread_id_t api_owner;       /**< Thread holding the mutex, only tracked with event_queues */
+    fluid_synth_event_queue_t *event_queues; /**< FLUID_SYNTH_EVENT_PRODUCERS event queues, NULL unless synth.lock-free-events */
 
     fluid_settings_t *settings;        /**< the synthesizer settings */
     int device_id;                     /**< Device ID used for SYSEX messages */
@@ -114,6 +181,9 @@ struct _fluid_synth_t
     double sample_rate;                /**< The sample rate */
     int midi_channels;                 /**< the number of MIDI channels (>= 16) */
     int bank_select;                   /**< the style of Bank Select MIDI messages */
+    int loading_policy;                /**< #fluid_synth_loading_policy for notes on presets still loading samples */
+    fluid_synth_deferred_note_t deferred_notes[FLUID_SYNTH_DEFERRED_NOTES]; /**< Notes waiting for their samples */
+    fluid_atomic_int_t deferred_note_count; /**< Number of deferred_notes */
     int audio_channels;                /**< the number of audio channels (1 channel=left+right) */
     int audio_groups;                  /**< the number of (stereo) 'sub'groups from the synth.
 					  Typically equal to audio_channels. */
@@ -126,12 +196,16 @@ struct _fluid_synth_t
     fluid_list_t *loaders;             /**< the SoundFont loaders */
     fluid_list_t *sfont;          /**< List of fluid_sfont_info_t for each loaded SoundFont (remains until SoundFont is unloaded) */
     int sfont_id;             /**< Incrementing ID assigned to each loaded SoundFont */
+    fluid_hashtable_t *preset_cache; /**< (bank, program) -> preset found by fluid_synth_find_preset(), cleared whenever the SoundFont stack changes */
+    int preset_cache_enabled;        /**< TRUE if all SoundFonts of the stack come from the default loader, whose presets never change */
 
     float gain;                        /**< master gain */
     fluid_channel_t **channel;         /**< the channels */
     int nvoice;                        /**< the length of the synthesis process array (max polyphony allowed) */
     fluid_voice_t **voice;             /**< the synthesis voices */
+    fluid_list_t *rvoice_arenas;       /**< fluid_rvoice_arena_t holding the rvoices of the voices, one per allocation of voices */
     int active_voice_count;            /**< count of active voices */
+    int start_delay;                   /**< offset into the next block of the voices started now, see fluid_synth_process_events() */
     unsigned int noteid;               /**< the id is incremented for every new note. it's used for noteoff's  */
     unsigned int storeid;
     int fromkey_portamento;			 /**< fromkey portamento */
@@ -150,6 +224,8 @@ struct _fluid_synth_t
 
     int cur;                           /**< the current sample in the audio buffers to be output */
     int curmax;                        /**< current amount of samples present in the audio buffers */
+    int block_size;                    /**< number of samples rendered at a time (synth.block-size) */
+    int param_ramp;                    /**< samples over which pan, sends and filter cutoff follow a change (synth.parameter-ramp) */
     int dither_index;		     /**< current index in random dither value buffer: fluid_synth_(write_s16|dither_s16) */
 
     fluid_atomic_float_t cpu_load;                    /**< CPU load in percent (CPU time required / audio synthesized time * 100) */
@@ -176,7 +176,7 @@ static void fluid_voice_swap_rvoice(fluid_voice_t *voice)
     voice->can_access_overflow_rvoice = ctemp;
 }
 
-static void fluid_voice_initialize_rvoice(fluid_voice_t *voice, fluid_real_t output_rate)
+static void fluid_voice_initialize_rvoice(fluid_voice_t *voice, fluid_real_t output_rate, int param_ramp)
 {
     fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
 
@@ -205,13 +205,17 @@ static void fluid_voice_initialize_rvoice(fluid_voice_t *voice, fluid_real_t out
 
     param[0].real = output_rate;
     fluid_rvoice_set_output_rate(voice->rvoice, param);
+
+    voice->rvoice->dsp.block_size = voice->block_size;
+    voice->rvoice->buffers.ramp_length = param_ramp;
 }
 
 /*
  * new_fluid_voice
  */
 fluid_voice_t *
-new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate)
+new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate, int block_size, int param_ramp,
+                fluid_rvoice_t *rvoice, fluid_rvoice_t *overflow_rvoice)
 {
     fluid_voice_t *voice;
     voice = FLUID_NEW(fluid_voice_t);
@@ -225,15 +229,9 @@ new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate)
     voice->can_access_rvoice = TRUE;
     voice->can_access_overflow_rvoice = TRUE;
 
-    voice->rvoice = FLUID_NEW(fluid_rvoice_t);
-    voice->overflow_rvoice = FLUID_NEW(fluid_rvoice_t);
-
-    if(voice->rvoice == NULL || voice->overflow_rvoice == NULL)
-    {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        delete_fluid_voice(voice);
-        return NULL;
-    }
+    /* owned by the caller, see fluid_rvoice_arena_t */
+    voice->rvoice = rvoice;
+    voice->overflow_rvoice = overflow_rvoice;
 
     voice->status = FLUID_VOICE_CLEAN;
     voice->chan = NO_CHANNEL;
@@ -243,11 +241,22 @@ new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate)
     voice->channel = NULL;
     voice->sample = NULL;
     voice->output_rate = output_rate;
+    voice->block_size = block_size;
+    voice->overflow_class = FLUID_VOICE_OVERFLOW_NONE;
+    voice->overflow_prev = NULL;
+    voice->overflow_next = NULL;
+    voice->listed_channel = NULL;
+    voice->listed_key = 0;
+    voice->channel_prev = NULL;
+    voice->channel_next = NULL;
+    voice->key_prev = NULL;
+    voice->key_next = NULL;
 
     /* Initialize both the rvoice and overflow_rvoice */
-    fluid_voice_initialize_rvoice(voice, output_rate);
+    fluid_voice_initialize_rvoice(voice, output_rate, param_ramp);
+    fluid_voice_swap_rvoice(voice);
+    fluid_voice_initialize_rvoice(voice, output_rate, param_ramp);
     fluid_voice_swap_rvoice(voice);
-    fluid_voice_initialize_rvoice(voice, output_rate);
 
     return voice;
 }
@@ -265,8 +274,6 @@ delete_fluid_voice(fluid_voice_t *voice)
         FLUID_LOG(FLUID_WARN, "Deleting voice %u which has locked rvoices!", voice->id);
     }
 
-    FLUID_FREE(voice->overflow_rvoice);
-    FLUID_FREE(voice->rvoice);
     FLUID_FREE(voice);
 }
 
@@ -310,13 +317,18 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
         fluid_voice_off(voice);
     }
 
+    /* The start time changes, the voice is filed again by fluid_voice_start() */
+    fluid_voice_remove_overflow_class(voice);
+
     voice->zone_range = inst_zone_range; /* Instrument zone range for legato */
     voice->id = id;
     voice->chan = fluid_channel_get_num(channel);
     voice->key = (unsigned char) key;
     voice->vel = (unsigned char) vel;
     voice->channel = channel;
+    fluid_voice_update_channel_lists(voice);
     voice->mod_count = 0;
+    FLUID_MEMSET(voice->mod_dest_first, -1, sizeof(voice->mod_dest_first));
     voice->start_time = start_time;
     voice->has_noteoff = 0;
     UPDATE_RVOICE0(fluid_rvoice_reset);
@@ -451,11 +463,18 @@ void fluid_voice_start(fluid_voice_t *voice)
 
     fluid_voice_calculate_runtime_synthesis_parameters(voice);
 
+    /* a note handled by fluid_synth_process_events() sets in within the next block */
+    if(voice->channel->synth->start_delay > 0)
+    {
+        UPDATE_RVOICE_I1(fluid_rvoice_set_start_delay, voice->channel->synth->start_delay);
+    }
+
 #ifdef WITH_PROFILING
     voice->ref = fluid_profile_ref();
 #endif
 
     voice->status = FLUID_VOICE_ON;
+    fluid_voice_update_overflow_class(voice);
 
     /* Increment voice count */
     voice->channel->synth->active_voice_count++;
@@ -719,11 +738,11 @@ calculate_hold_decay_buffers(fluid_voice_t *voice, int gen_base,
     }
 
     seconds = fluid_tc2sec(timecents);
-    /* Each DSP loop processes FLUID_BUFSIZE samples. */
+    /* Each DSP loop processes block_size samples. */
 
     /* round to next full number of buffers */
     buffers = (int)(((fluid_real_t)voice->output_rate * seconds)
-                    / (fluid_real_t)FLUID_BUFSIZE
+                    / (fluid_real_t)voice->block_size
                     + 0.5);
 
     return buffers;
@@ -901,22 +920,22 @@ fluid_voice_update_param(fluid_voice_t *voice, int gen)
         break;
 
     case GEN_MODLFOFREQ:
-        /* - the frequency is converted into a delta value, per buffer of FLUID_BUFSIZE samples
+        /* - the frequency is converted into a delta value, per buffer of block_size samples
          * - the delay into a sample delay
          */
         fluid_clip(x, -16000.0f, 4500.0f);
-        x = (4.0f * FLUID_BUFSIZE * fluid_act2hz(x) / voice->output_rate);
+        x = (4.0f * voice->block_size * fluid_act2hz(x) / voice->output_rate);
         UPDATE_RVOICE_ENVLFO_R1(fluid_lfo_set_incr, modlfo, x);
         break;
 
     case GEN_VIBLFOFREQ:
         /* vib lfo
          *
-         * - the frequency is converted into a delta value, per buffer of FLUID_BUFSIZE samples
+         * - the frequency is converted into a delta value, per buffer of block_size samples
          * - the delay into a sample delay
          */
         fluid_clip(x, -16000.0f, 4500.0f);
-        x = 4.0f * FLUID_BUFSIZE * fluid_act2hz(x) / voice->output_rate;
+        x = 4.0f * voice->block_size * fluid_act2hz(x) / voice->output_rate;
         UPDATE_RVOICE_ENVLFO_R1(fluid_lfo_set_incr, viblfo, x);
         break;
 
@@ -1058,9 +1077,9 @@ fluid_voice_update_param(fluid_voice_t *voice, int gen)
         break;
 
         /* Conversion functions differ in range limit */
-#define NUM_BUFFERS_DELAY(_v)   (unsigned int) (voice->output_rate * fluid_tc2sec_delay(_v) / FLUID_BUFSIZE)
-#define NUM_BUFFERS_ATTACK(_v)  (unsigned int) (voice->output_rate * fluid_tc2sec_attack(_v) / FLUID_BUFSIZE)
-#define NUM_BUFFERS_RELEASE(_v) (unsigned int) (voice->output_rate * fluid_tc2sec_release(_v) / FLUID_BUFSIZE)
+#define NUM_BUFFERS_DELAY(_v)   (unsigned int) (voice->output_rate * fluid_tc2sec_delay(_v) / voice->block_size)
+#define NUM_BUFFERS_ATTACK(_v)  (unsigned int) (voice->output_rate * fluid_tc2sec_attack(_v) / voice->block_size)
+#define NUM_BUFFERS_RELEASE(_v) (unsigned int) (voice->output_rate * fluid_tc2sec_release(_v) / voice->block_size)
 
     /* volume envelope
      *
@@ -1148,6 +1167,24 @@ fluid_voice_update_param(fluid_voice_t *voice, int gen)
     } /* switch gen */
 }
 
+/*
+ * Sums up the values of all the modulators with destination 'gen', in
+ * the order they were added.
+ */
+static fluid_real_t
+fluid_voice_get_mod_value(fluid_voice_t *voice, int gen)
+{
+    fluid_real_t modval = 0.0;
+    int k;
+
+    for(k = voice->mod_dest_first[gen]; k >= 0; k = voice->mod_dest_next[k])
+    {
+        modval += fluid_mod_get_value(&voice->mod[k], voice->channel, voice);
+    }
+
+    return modval;
+}
+
 /**
  * Recalculate voice parameters for a given control.
  * @param voice the synthesis voice
@@ -1168,7 +1205,8 @@ fluid_voice_update_param(fluid_voice_t *voice, int gen)
  *
  * - For every changed generator, calculate its new value. This is the
  * sum of its original value plus the values of al the attached
- * modulators.
+ * modulators. The attached modulators are chained by
+ * fluid_voice_add_mod(), so only those are visited.
  *
  * - For every changed generator, convert its value to the correct
  * unit of the corresponding DSP parameter
@@ -1178,7 +1216,6 @@ int fluid_voice_modulate(fluid_voice_t *voice, int cc, int ctrl)
     int i, k;
     fluid_mod_t *mod;
     int gen;
-    fluid_real_t modval;
 
     /*    printf("Chan=%d, CC=%d, Src=%d, Val=%d\n", voice->channel->channum, cc, ctrl, val); */
 
@@ -1193,19 +1230,25 @@ int fluid_voice_modulate(fluid_voice_t *voice, int cc, int ctrl)
         {
 
             gen = fluid_mod_get_dest(mod);
-            modval = 0.0;
 
-            /* step 2: for every changed modulator, calculate the modulation
-             * value of its associated generator */
-            for(k = 0; k < voice->mod_count; k++)
+            /* skip the generator if an earlier modulator with the same
+             * source did already update it */
+            for(k = voice->mod_dest_first[gen]; k != i; k = voice->mod_dest_next[k])
             {
-                if(fluid_mod_has_dest(&voice->mod[k], gen))
+                if(fluid_mod_has_source(&voice->mod[k], cc, ctrl))
                 {
-                    modval += fluid_mod_get_value(&voice->mod[k], voice->channel, voice);
+                    break;
                 }
             }
 
-            fluid_gen_set_mod(&voice->gen[gen], modval);
+            if(k != i)
+            {
+                continue;
+            }
+
+            /* step 2: for every changed modulator, calculate the modulation
+             * value of its associated generator */
+            fluid_gen_set_mod(&voice->gen[gen], fluid_voice_get_mod_value(voice, gen));
 
             /* step 3: now that we have the new value of the generator,
              * recalculate the parameter values that are derived from the
@@ -1224,37 +1267,18 @@ int fluid_voice_modulate(fluid_voice_t *voice, int cc, int ctrl)
  */
 int fluid_voice_modulate_all(fluid_voice_t *voice)
 {
-    fluid_mod_t *mod;
-    int i, k, gen;
-    fluid_real_t modval;
-
-    /* Loop through all the modulators.
-
-       FIXME: we should loop through the set of generators instead of
-       the set of modulators. We risk to call 'fluid_voice_update_param'
-       several times for the same generator if several modulators have
-       that generator as destination. It's not an error, just a wast of
-       energy (think polution, global warming, unhappy musicians,
-       ...) */
+    int gen;
 
-    for(i = 0; i < voice->mod_count; i++)
+    /* Loop through the generators which are the destination of at least
+     * one modulator, so that each one is updated only once. */
+    for(gen = 0; gen < GEN_LAST; gen++)
     {
-
-        mod = &voice->mod[i];
-        gen = fluid_mod_get_dest(mod);
-        modval = 0.0;
-
-        /* Accumulate the modulation values of all the modulators with
-         * destination generator 'gen' */
-        for(k = 0; k < voice->mod_count; k++)
+        if(voice->mod_dest_first[gen] < 0)
         {
-            if(fluid_mod_has_dest(&voice->mod[k], gen))
-            {
-                modval += fluid_mod_get_value(&voice->mod[k], voice->channel, voice);
-            }
+            continue;
         }
 
-        fluid_gen_set_mod(&voice->gen[gen], modval);
+        fluid_gen_set_mod(&voice->gen[gen], fluid_voice_get_mod_value(voice, gen));
 
         /* Update the parameter values that are depend on the generator
          * 'gen' */
@@ -1289,7 +1313,7 @@ void fluid_voice_update_portamento(fluid_voice_t *voice, int fromkey, int tokey)
     unsigned int countinc = (unsigned int)(((fluid_real_t)voice->output_rate *
                                             0.001f *
                                             (fluid_real_t)fluid_channel_portamentotime(channel))  /
-                                           (fluid_real_t)FLUID_BUFSIZE  + 0.5);
+                                           (fluid_real_t)voice->block_size  + 0.5);
 
     /* Send portamento parameters to the voice dsp */
     UPDATE_RVOICE_GENERIC_IR(fluid_rvoice_set_portamento, voice->rvoice, countinc, pitchoffset);
@@ -1310,6 +1334,7 @@ void fluid_voice_update_multi_retrigger_attack(fluid_voice_t *voice,
 {
     voice->key = tokey;  /* new note */
     voice->vel = vel; /* new velocity */
+    fluid_voice_update_channel_lists(voice);
     /* Updates generators dependent of velocity */
     /* Modulates GEN_ATTENUATION (and others ) before calling
        fluid_rvoice_multi_retrigger_attack().*/
@@ -1343,6 +1368,7 @@ fluid_voice_release(fluid_voice_t *voice)
     unsigned int at_tick = fluid_channel_get_min_note_length_ticks(voice->channel);
     UPDATE_RVOICE_I1(fluid_rvoice_noteoff, at_tick);
     voice->has_noteoff = 1; // voice is marked as noteoff occured
+    fluid_voice_update_overflow_class(voice);
 }
 
 /*
@@ -1366,11 +1392,13 @@ fluid_voice_noteoff(fluid_voice_t *voice)
     {
         // Sostenuto depressed after note
         voice->status = FLUID_VOICE_HELD_BY_SOSTENUTO;
+        fluid_voice_update_overflow_class(voice);
     }
     /* Or sustain a note under Sustain pedal */
     else if(fluid_channel_sustained(channel))
     {
         voice->status = FLUID_VOICE_SUSTAINED;
+        fluid_voice_update_overflow_class(voice);
     }
     /* Or force the voice to release stage */
     else
@@ -1456,12 +1484,14 @@ fluid_voice_stop(fluid_voice_t *voice)
     fluid_profile(FLUID_PROF_VOICE_RELEASE, voice->ref, 0, 0);
 
     voice->chan = NO_CHANNEL;
+    fluid_voice_remove_channel_lists(voice);
 
     if(voice->can_access_rvoice)
     {
         fluid_voice_sample_unref(&voice->rvoice->dsp.sample);
     }
 
+    fluid_voice_remove_overflow_class(voice);
     voice->status = FLUID_VOICE_OFF;
     voice->has_noteoff = 1;
 
@@ -1541,7 +1571,23 @@ fluid_voice_add_mod(fluid_voice_t *voice, fluid_mod_t *mod, int mode)
        checking, if the same modulator already exists. */
     if(voice->mod_count < FLUID_NUM_MOD)
     {
-        fluid_mod_clone(&voice->mod[voice->mod_count++], mod);
+        int dest = mod->dest;
+
+        i = voice->mod_count++;
+        fluid_mod_clone(&voice->mod[i], mod);
+
+        /* append it to the modulators with the same destination */
+        if(voice->mod_dest_first[dest] < 0)
+        {
+            voice->mod_dest_first[dest] = i;
+        }
+        else
+        {
+            voice->mod_dest_next[(int)voice->mod_dest_last[dest]] = i;
+        }
+
+        voice->mod_dest_last[dest] = i;
+        voice->mod_dest_next[i] = -1;
     }
     else
     {
@@ -1979,9 +2025,317 @@ fluid_voice_get_overflow_prio(fluid_voice_t *voice,
     return this_voice_prio;
 }
 
+/*
+ * Returns the overflow class a voice belongs to according to its current state.
+ */
+static int
+fluid_voice_get_overflow_class(const fluid_voice_t *voice)
+{
+    if(!fluid_voice_is_playing(voice))
+    {
+        return FLUID_VOICE_OVERFLOW_NONE;
+    }
+
+    if(voice->has_noteoff)
+    {
+        return FLUID_VOICE_OVERFLOW_RELEASED;
+    }
+
+    if(fluid_voice_is_sustained(voice) || fluid_voice_is_sostenuto(voice))
+    {
+        return FLUID_VOICE_OVERFLOW_SUSTAINED;
+    }
+
+    return FLUID_VOICE_OVERFLOW_ON;
+}
+
+/*
+ * Removes the voice from the list of its overflow class.
+ */
+void
+fluid_voice_remove_overflow_class(fluid_voice_t *voice)
+{
+    fluid_overflow_prio_t *score;
+    int c = voice->overflow_class;
+
+    if(c == FLUID_VOICE_OVERFLOW_NONE)
+    {
+        return;
+    }
+
+    score = &voice->channel->synth->overflow;
+
+    if(voice->overflow_prev != NULL)
+    {
+        voice->overflow_prev->overflow_next = voice->overflow_next;
+    }
+    else
+    {
+        score->voices_head[c] = voice->overflow_next;
+    }
+
+    if(voice->overflow_next != NULL)
+    {
+        voice->overflow_next->overflow_prev = voice->overflow_prev;
+    }
+    else
+    {
+        score->voices_tail[c] = voice->overflow_prev;
+    }
+
+    voice->overflow_prev = NULL;
+    voice->overflow_next = NULL;
+    voice->overflow_class = FLUID_VOICE_OVERFLOW_NONE;
+}
+
+/*
+ * Files the voice into the list of the overflow class matching its current
+ * state. Must be called whenever the status or the noteoff flag of a voice
+ * changes.
+ *
+ * The lists are kept sorted by start time. Newly started voices are simply
+ * appended, voices changing their class are usually among the youngest ones
+ * of the new class, so the insertion point is searched from the tail.
+ */
+void
+fluid_voice_update_overflow_class(fluid_voice_t *voice)
+{
+    fluid_overflow_prio_t *score;
+    fluid_voice_t *prev;
+    int c = fluid_voice_get_overflow_class(voice);
+
+    if(c == voice->overflow_class)
+    {
+        return;
+    }
+
+    fluid_voice_remove_overflow_class(voice);
+
+    if(c == FLUID_VOICE_OVERFLOW_NONE)
+    {
+        return;
+    }
+
+    score = &voice->channel->synth->overflow;
+
+    /* signed difference to survive the wrap around of the tick counter */
+    for(prev = score->voices_tail[c];
+            prev != NULL && (int)(prev->start_time - voice->start_time) > 0;
+            prev = prev->overflow_prev)
+    {
+    }
+
+    voice->overflow_prev = prev;
+
+    if(prev != NULL)
+    {
+        voice->overflow_next = prev->overflow_next;
+        prev->overflow_next = voice;
+    }
+    else
+    {
+        voice->overflow_next = score->voices_head[c];
+        score->voices_head[c] = voice;
+    }
+
+    if(voice->overflow_next != NULL)
+    {
+        voice->overflow_next->overflow_prev = voice;
+    }
+    else
+    {
+        score->voices_tail[c] = voice;
+    }
+
+    voice->overflow_class = c;
+}
+
+/*
+ * Selects the voice with the lowest overflow priority.
+ *
+ * The priorities are not computed for every playing voice. Within an
+ * overflow class the score only varies by the channel (percussion,
+ * important), the volume and the age. The first two are bounded, and
+ * for a non-negative age score the age term grows monotonically towards
+ * the younger voices. So the lists (oldest first) can be left as soon as
+ * the lower bound of the remaining voices exceeds the best priority found.
+ *
+ * Returns NULL if no voice can be killed.
+ */
+fluid_voice_t *
+fluid_voice_get_overflow_victim(fluid_overflow_prio_t *score,
+                                unsigned int cur_time)
+{
+    static const int order[FLUID_VOICE_OVERFLOW_LAST] =
+    {
+        FLUID_VOICE_OVERFLOW_RELEASED,
+        FLUID_VOICE_OVERFLOW_SUSTAINED,
+        FLUID_VOICE_OVERFLOW_ON
+    };
+
+    float best_prio = OVERFLOW_PRIO_CANNOT_KILL - 1;
+    float this_voice_prio;
+    float class_bound, bound;
+    fluid_voice_t *best_voice = NULL;
+    fluid_voice_t *voice;
+    unsigned int age;
+    int i;
+
+    for(i = 0; i < FLUID_VOICE_OVERFLOW_LAST; i++)
+    {
+        int c = order[i];
+
+        /* lowest class score a voice in this list may get */
+        class_bound = (c == FLUID_VOICE_OVERFLOW_RELEASED) ? score->released
+                      : (c == FLUID_VOICE_OVERFLOW_SUSTAINED) ? score->sustained : 0;
+
+        if(score->percussion < class_bound)
+        {
+            class_bound = score->percussion;
+        }
+
+        if(score->important < 0)
+        {
+            class_bound += score->important;
+        }
+
+        /* the attenuation is clamped to at least 0.1 */
+        if(score->volume < 0)
+        {
+            class_bound += score->volume / 0.1f;
+        }
+
+        for(voice = score->voices_head[c]; voice != NULL; voice = voice->overflow_next)
+        {
+            bound = class_bound;
+
+            if(score->age)
+            {
+                age = (score->age > 0) ? cur_time - voice->start_time : 1;
+
+                if(age < 1)
+                {
+                    age = 1;
+                }
+
+                bound += (score->age * voice->output_rate) / age;
+            }
+
+            /* Neither this voice nor any younger one can beat the current candidate. */
+            if(bound > best_prio)
+            {
+                break;
+            }
+
+            this_voice_prio = fluid_voice_get_overflow_prio(voice, score, cur_time);
+
+            if(this_voice_prio < best_prio)
+            {
+                best_voice = voice;
+                best_prio = this_voice_prio;
+            }
+        }
+    }
+
+    return best_voice;
+}
+
 
 void fluid_voice_set_custom_filter(fluid_voice_t *voice, enum fluid_iir_filter_type type, enum fluid_iir_filter_flags flags)
 {
     UPDATE_RVOICE_GENERIC_I2(fluid_iir_filter_init, &voice->rvoice->resonant_custom_filter, type, flags);
 }
 
+/*
+ * Removes the voice from the voice lists of its channel.
+ */
+void
+fluid_voice_remove_channel_lists(fluid_voice_t *voice)
+{
+    fluid_channel_t *channel = voice->listed_channel;
+
+    if(channel == NULL)
+    {
+        return;
+    }
+
+    if(voice->channel_prev != NULL)
+    {
+        voice->channel_prev->channel_next = voice->channel_next;
+    }
+    else
+    {
+        channel->voices = voice->channel_next;
+    }
+
+    if(voice->channel_next != NULL)
+    {
+        voice->channel_next->channel_prev = voice->channel_prev;
+    }
+
+    if(voice->key_prev != NULL)
+    {
+        voice->key_prev->key_next = voice->key_next;
+    }
+    else
+    {
+        channel->key_voices[voice->listed_key] = voice->key_next;
+    }
+
+    if(voice->key_next != NULL)
+    {
+        voice->key_next->key_prev = voice->key_prev;
+    }
+
+    voice->channel_prev = NULL;
+    voice->channel_next = NULL;
+    voice->key_prev = NULL;
+    voice->key_next = NULL;
+    voice->listed_channel = NULL;
+}
+
+/*
+ * Files the voice into the list of all voices of its channel and into the one
+ * of its key, so that channel and key events don't have to scan all voices of
+ * the synth. A voice stays listed from fluid_voice_init() until it is stopped.
+ * Must be called whenever the channel or the key of a voice changes.
+ */
+void
+fluid_voice_update_channel_lists(fluid_voice_t *voice)
+{
+    fluid_channel_t *channel = (voice->chan == NO_CHANNEL) ? NULL : voice->channel;
+
+    if(channel == voice->listed_channel
+            && (channel == NULL || voice->key == voice->listed_key))
+    {
+        return;
+    }
+
+    fluid_voice_remove_channel_lists(voice);
+
+    if(channel == NULL)
+    {
+        return;
+    }
+
+    voice->channel_next = channel->voices;
+
+    if(voice->channel_next != NULL)
+    {
+        voice->channel_next->channel_prev = voice;
+    }
+
+    channel->voices = voice;
+
+    voice->key_next = channel->key_voices[voice->key];
+
+    if(voice->key_next != NULL)
+    {
+        voice->key_next->key_prev = voice;
+    }
+
+    channel->key_voices[voice->key] = voice;
+
+    voice->listed_channel = channel;
+    voice->listed_key = voice->key;
+}
@@ -36,6 +36,17 @@
 
 typedef struct _fluid_overflow_prio_t fluid_overflow_prio_t;
 
+/* Classes the playing voices are sorted into for voice stealing, see
+ * fluid_voice_update_overflow_class(). */
+enum fluid_voice_overflow_class
+{
+    FLUID_VOICE_OVERFLOW_NONE = -1, /* voice is not playing */
+    FLUID_VOICE_OVERFLOW_RELEASED,  /* noteoff has been received */
+    FLUID_VOICE_OVERFLOW_SUSTAINED, /* held by sustain or sostenuto pedal */
+    FLUID_VOICE_OVERFLOW_ON,        /* still held by the key */
+    FLUID_VOICE_OVERFLOW_LAST
+};
+
 struct _fluid_overflow_prio_t
 {
     float percussion; /**< Is this voice on the drum channel? Then add this score */
@@ -46,6 +57,10 @@ struct _fluid_overflow_prio_t
     float important; /**< This score will be added to all important channels */
     char *important_channels; /**< "important" flags indexed by MIDI channel number */
     int num_important_channels; /**< Number of elements in the important_channels array */
+
+    /* Playing voices of each overflow class, ordered by start time (oldest first) */
+    fluid_voice_t *voices_head[FLUID_VOICE_OVERFLOW_LAST];
+    fluid_voice_t *voices_tail[FLUID_VOICE_OVERFLOW_LAST];
 };
 
 enum fluid_voice_status
@@ -77,10 +92,15 @@ struct _fluid_voice_t
     unsigned int start_time;
     int mod_count;
     fluid_mod_t mod[FLUID_NUM_MOD];
+    /* modulators with the same destination, chained in the order of mod[], -1 ends */
+    signed char mod_dest_first[GEN_LAST];
+    signed char mod_dest_last[GEN_LAST];
+    signed char mod_dest_next[FLUID_NUM_MOD];
     fluid_gen_t gen[GEN_LAST];
 
     /* basic parameters */
     fluid_real_t output_rate;        /* the sample rate of the synthesizer (dupe in rvoice) */
+    int block_size;                  /* samples synthesized per block (dupe in rvoice) */
 
     /* basic parameters */
     fluid_real_t pitch;              /* the pitch in midicents (dupe in rvoice) */
@@ -109,6 +129,19 @@ struct _fluid_voice_t
     char can_access_overflow_rvoice; /* False if overflow_rvoice is being rendered in separate thread */
     char has_noteoff; /* Flag set when noteoff has been sent */
 
+    /* voice stealing: list of the voices in the same overflow class */
+    signed char overflow_class;
+    fluid_voice_t *overflow_prev;
+    fluid_voice_t *overflow_next;
+
+    /* lists of the voices on the same channel and on the same key of it */
+    fluid_channel_t *listed_channel; /* channel whose lists the voice is in, NULL if none */
+    unsigned char listed_key;
+    fluid_voice_t *channel_prev;
+    fluid_voice_t *channel_next;
+    fluid_voice_t *key_prev;
+    fluid_voice_t *key_next;
+
 #ifdef WITH_PROFILING
     /* for debugging */
     double ref;
@@ -116,7 +149,8 @@ struct _fluid_voice_t
 };
 
 
-fluid_voice_t *new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate);
+fluid_voice_t *new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate, int block_size, int param_ramp,
+                               fluid_rvoice_t *rvoice, fluid_rvoice_t *overflow_rvoice);
 void delete_fluid_voice(fluid_voice_t *voice);
 
 void fluid_voice_start(fluid_voice_t *voice);
@@ -163,6 +197,12 @@ int fluid_voice_kill_excl(fluid_voice_t *voice);
 float fluid_voice_get_overflow_prio(fluid_voice_t *voice,
                                     fluid_overflow_prio_t *score,
                                     unsigned int cur_time);
+fluid_voice_t *fluid_voice_get_overflow_victim(fluid_overflow_prio_t *score,
+        unsigned int cur_time);
+void fluid_voice_update_overflow_class(fluid_voice_t *voice);
+void fluid_voice_remove_overflow_class(fluid_voice_t *voice);
+void fluid_voice_update_channel_lists(fluid_voice_t *voice);
+void fluid_voice_remove_channel_lists(fluid_voice_t *voice);
 
 #define OVERFLOW_PRIO_CANNOT_KILL 999999.
 
@@ -392,6 +392,23 @@ void fluid_msleep(unsigned int msecs)
     g_usleep(msecs * 1000);
 }
 
+/**
+ * Advise the kernel that the given range of mapped memory will be
+ * accessed soon, so that it can be paged in ahead of time.
+ * @param p Start of the memory range, need not be page aligned
+ * @param n Length of the memory range in bytes
+ */
+void fluid_madvise_willneed(const void *p, size_t n)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(MADV_WILLNEED) && !defined(__OS2__)
+    uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)p & ~(page_size - 1);
+
+    /* Only a hint, errors don't matter */
+    madvise((void *)start, n + ((uintptr_t)p - start), MADV_WILLNEED);
+#endif
+}
+
 /**
  * Get time in milliseconds to be used in relative timing operations.
  * @return Unix time in milliseconds.
@@ -154,6 +154,7 @@ typedef GRecMutex fluid_rec_mutex_t;
 #define fluid_rec_mutex_destroy(_m)   g_rec_mutex_clear(&(_m))
 #define fluid_rec_mutex_lock(_m)      g_rec_mutex_lock(&(_m))
 #define fluid_rec_mutex_unlock(_m)    g_rec_mutex_unlock(&(_m))
+#define fluid_rec_mutex_trylock(_m)   g_rec_mutex_trylock(&(_m))
 
 /* Dynamically allocated mutex suitable for fluid_cond_t use */
 typedef GMutex    fluid_cond_mutex_t;
@@ -229,6 +230,7 @@ typedef GStaticRecMutex fluid_rec_mutex_t;
 #define fluid_rec_mutex_destroy(_m)   g_static_rec_mutex_free(&(_m))
 #define fluid_rec_mutex_lock(_m)      g_static_rec_mutex_lock(&(_m))
 #define fluid_rec_mutex_unlock(_m)    g_static_rec_mutex_unlock(&(_m))
+#define fluid_rec_mutex_trylock(_m)   g_static_rec_mutex_trylock(&(_m))
 
 #define fluid_rec_mutex_init(_m)      do { \
   if (!g_thread_supported ()) g_thread_init (NULL); \
@@ -379,6 +381,25 @@ typedef GStatBuf fluid_stat_buf_t;
 #endif
 #define fluid_stat(_filename, _statbuf)   g_stat((_filename), (_statbuf))
 
+/* Memory mapped files (read-only) */
+typedef GMappedFile fluid_mapped_file_t;
+#define new_fluid_mapped_file(_filename)        g_mapped_file_new((_filename), FALSE, NULL)
+#if GLIB_CHECK_VERSION(2, 22, 0)
+#define delete_fluid_mapped_file(_file)         g_mapped_file_unref(_file)
+#else
+#define delete_fluid_mapped_file(_file)         g_mapped_file_free(_file)
+#endif
+#define fluid_mapped_file_get_contents(_file)   g_mapped_file_get_contents(_file)
+#define fluid_mapped_file_get_length(_file)     g_mapped_file_get_length(_file)
+
+/* Replacing the contents of a file atomically */
+#if GLIB_CHECK_VERSION(2, 8, 0)
+#define FLUID_HAVE_FILE_SET_CONTENTS 1
+#define fluid_file_set_contents(_filename, _contents, _length) \
+    g_file_set_contents((_filename), (_contents), (_length), NULL)
+#define fluid_mkdir_with_parents(_path)         g_mkdir_with_parents((_path), 0755)
+#endif
+
 
 /* Profiling */
 #if WITH_PROFILING
@@ -588,6 +609,8 @@ enum
 #define fluid_munlock(_p,_n)
 #endif
 
+void fluid_madvise_willneed(const void *p, size_t n);
+
 
 /**
 
@@ -232,8 +232,10 @@ typedef void (*fluid_rvoice_function_t)(void *obj, const fluid_rvoice_param_t pa
  *                      CONSTANTS
  */
 
-#define FLUID_BUFSIZE                64         /**< FluidSynth internal buffer size (in samples) */
-#define FLUID_MIXER_MAX_BUFFERS_DEFAULT (8192/FLUID_BUFSIZE) /**< Number of buffers that can be processed in one rendering run */
+#define FLUID_BUFSIZE                64         /**< FluidSynth default internal buffer size (in samples), see synth.block-size */
+#define FLUID_BUFSIZE_MIN            16         /**< Smallest internal buffer size (in samples) */
+#define FLUID_BUFSIZE_MAX            1024       /**< Largest internal buffer size (in samples) */
+#define FLUID_MIXER_MAX_BUFFERS_DEFAULT (8192/FLUID_BUFSIZE) /**< Number of buffers of #FLUID_BUFSIZE that can be processed in one rendering run */
 #define FLUID_MAX_EVENTS_PER_BUFSIZE 1024       /**< Maximum queued MIDI events per #FLUID_BUFSIZE */
 #define FLUID_MAX_RETURN_EVENTS      1024       /**< Maximum queued synthesis thread return events */
 #define FLUID_MAX_EVENT_QUEUES       16         /**< Maximum number of unique threads queuing events */
@@ -260,6 +262,7 @@ typedef FILE  *fluid_file;
 #define FLUID_FTELL(_f)              ftell(_f)
 #define FLUID_MEMCPY(_dst,_src,_n)   memcpy(_dst,_src,_n)
 #define FLUID_MEMSET(_s,_c,_n)       memset(_s,_c,_n)
+#define FLUID_MEMCMP(_s,_t,_n)       memcmp(_s,_t,_n)
 #define FLUID_STRLEN(_s)             strlen(_s)
 #define FLUID_STRCMP(_s,_t)          strcmp(_s,_t)
 #define FLUID_STRNCMP(_s,_t,_n)      strncmp(_s,_t,_n)
@@ -0,0 +1,496 @@
+
+/*
+ * Throughput benchmark of the synthesis core.
+ *
+ * Renders a fixed number of sustained voices for every combination of the
+ * given voice counts, interpolation methods, cpu-cores, with and without
+ * the IIR filter and with and without reverb and chorus. The results are
+ * written to stdout as JSON.
+ *
+ * The SoundFont is generated in memory, so no external files are needed.
+ *
+ * Usage: bench_synth [-s seconds] [-b block-size] [-v voices,...] [-i interp,...] [-c cores,...]
+ */
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluidsynth_priv.h"
+
+#include <stdio.h>
+#include <math.h>
+
+#define SAMPLE_RATE 44100
+#define MAX_LIST 16
+
+/* the looped waveform of the generated SoundFont */
+#define WAVE_PERIOD 441
+#define WAVE_PERIODS 10
+#define WAVE_LEN (WAVE_PERIOD * WAVE_PERIODS)
+#define WAVE_ROOT_KEY 43 /* 100 Hz are close to G2 */
+
+/* SoundFont generator numbers */
+#define SF_GEN_INITIAL_FILTER_FC 8
+#define SF_GEN_INITIAL_FILTER_Q 9
+#define SF_GEN_INSTRUMENT 41
+#define SF_GEN_SAMPLE_ID 53
+#define SF_GEN_SAMPLE_MODES 54
+
+#define SF2_MEM_NAME "&bench.sf2"
+
+/*
+ * In-memory SoundFont
+ */
+
+typedef struct
+{
+    unsigned char *data;
+    long size;
+    long alloc;
+} buffer_t;
+
+typedef struct
+{
+    const buffer_t *buf;
+    long pos;
+} mem_file_t;
+
+static buffer_t sf2;
+
+static void put_bytes(buffer_t *buf, const void *data, long len)
+{
+    if(buf->size + len > buf->alloc)
+    {
+        buf->alloc = 2 * (buf->size + len);
+        buf->data = realloc(buf->data, buf->alloc);
+        TEST_ASSERT(buf->data != NULL);
+    }
+
+    if(data != NULL)
+    {
+        memcpy(buf->data + buf->size, data, len);
+    }
+    else
+    {
+        memset(buf->data + buf->size, 0, len);
+    }
+
+    buf->size += len;
+}
+
+static void put_u8(buffer_t *buf, unsigned int val)
+{
+    unsigned char b = val & 0xff;
+    put_bytes(buf, &b, 1);
+}
+
+static void put_u16(buffer_t *buf, unsigned int val)
+{
+    unsigned char b[2] = { val & 0xff, (val >> 8) & 0xff };
+    put_bytes(buf, b, 2);
+}
+
+static void put_u32(buffer_t *buf, unsigned int val)
+{
+    put_u16(buf, val & 0xffff);
+    put_u16(buf, val >> 16);
+}
+
+static void put_name(buffer_t *buf, const char *name, int len)
+{
+    char str[20] = { 0 };
+    strncpy(str, name, sizeof(str) - 1);
+    put_bytes(buf, str, len);
+}
+
+/* starts a chunk, returns the position of its size field */
+static long begin_chunk(buffer_t *buf, const char *id, const char *list_type)
+{
+    long pos;
+
+    put_bytes(buf, id, 4);
+    pos = buf->size;
+    put_u32(buf, 0);
+
+    if(list_type != NULL)
+    {
+        put_bytes(buf, list_type, 4);
+    }
+
+    return pos;
+}
+
+static void end_chunk(buffer_t *buf, long pos)
+{
+    unsigned int size = buf->size - pos - 4;
+
+    buf->data[pos] = size & 0xff;
+    buf->data[pos + 1] = (size >> 8) & 0xff;
+    buf->data[pos + 2] = (size >> 16) & 0xff;
+    buf->data[pos + 3] = (size >> 24) & 0xff;
+}
+
+static void put_gen(buffer_t *buf, unsigned int gen, int amount)
+{
+    put_u16(buf, gen);
+    put_u16(buf, amount & 0xffff);
+}
+
+/*
+ * Builds a SoundFont with a single looped sample and two presets:
+ * 0:0 plays the sample unfiltered, 0:1 through a resonant lowpass.
+ */
+static void build_sf2(buffer_t *buf)
+{
+    long riff, list, chunk;
+    int i;
+
+    riff = begin_chunk(buf, "RIFF", "sfbk");
+
+    list = begin_chunk(buf, "LIST", "INFO");
+    chunk = begin_chunk(buf, "ifil", NULL);
+    put_u16(buf, 2);
+    put_u16(buf, 1);
+    end_chunk(buf, chunk);
+    chunk = begin_chunk(buf, "isng", NULL);
+    put_name(buf, "EMU8000", 8);
+    end_chunk(buf, chunk);
+    chunk = begin_chunk(buf, "INAM", NULL);
+    put_name(buf, "bench", 6);
+    end_chunk(buf, chunk);
+    end_chunk(buf, list);
+
+    /* a sawtooth like wave with a few harmonics, followed by 46 zero samples */
+    list = begin_chunk(buf, "LIST", "sdta");
+    chunk = begin_chunk(buf, "smpl", NULL);
+
+    for(i = 0; i < WAVE_LEN; i++)
+    {
+        double phase = 2 * M_PI * (i % WAVE_PERIOD) / WAVE_PERIOD;
+        double val = sin(phase) + sin(2 * phase) / 2 + sin(3 * phase) / 3 + sin(4 * phase) / 4;
+        put_u16(buf, (unsigned int)(int)(val * 12000) & 0xffff);
+    }
+
+    put_bytes(buf, NULL, 46 * 2);
+    end_chunk(buf, chunk);
+    end_chunk(buf, list);
+
+    list = begin_chunk(buf, "LIST", "pdta");
+
+    chunk = begin_chunk(buf, "phdr", NULL);
+
+    for(i = 0; i < 3; i++)
+    {
+        put_name(buf, i < 2 ? (i ? "filtered" : "plain") : "EOP", 20);
+        put_u16(buf, i < 2 ? i : 0); /* preset */
+        put_u16(buf, 0); /* bank */
+        put_u16(buf, i); /* bag index */
+        put_u32(buf, 0);
+        put_u32(buf, 0);
+        put_u32(buf, 0);
+    }
+
+    end_chunk(buf, chunk);
+
+    chunk = begin_chunk(buf, "pbag", NULL);
+
+    for(i = 0; i < 3; i++)
+    {
+        put_u16(buf, i); /* generator index */
+        put_u16(buf, 0); /* modulator index */
+    }
+
+    end_chunk(buf, chunk);
+
+    chunk = begin_chunk(buf, "pmod", NULL);
+    put_bytes(buf, NULL, 10);
+    end_chunk(buf, chunk);
+
+    chunk = begin_chunk(buf, "pgen", NULL);
+    put_gen(buf, SF_GEN_INSTRUMENT, 0);
+    put_gen(buf, SF_GEN_INSTRUMENT, 1);
+    put_gen(buf, 0, 0);
+    end_chunk(buf, chunk);
+
+    chunk = begin_chunk(buf, "inst", NULL);
+    put_name(buf, "plain", 20);
+    put_u16(buf, 0);
+    put_name(buf, "filtered", 20);
+    put_u16(buf, 1);
+    put_name(buf, "EOI", 20);
+    put_u16(buf, 2);
+    end_chunk(buf, chunk);
+
+    chunk = begin_chunk(buf, "ibag", NULL);
+    put_u16(buf, 0);
+    put_u16(buf, 0);
+    put_u16(buf, 2);
+    put_u16(buf, 0);
+    put_u16(buf, 6);
+    put_u16(buf, 0);
+    end_chunk(buf, chunk);
+
+    chunk = begin_chunk(buf, "imod", NULL);
+    put_bytes(buf, NULL, 10);
+    end_chunk(buf, chunk);
+
+    chunk = begin_chunk(buf, "igen", NULL);
+    put_gen(buf, SF_GEN_SAMPLE_MODES, 1);
+    put_gen(buf, SF_GEN_SAMPLE_ID, 0);
+    put_gen(buf, SF_GEN_INITIAL_FILTER_FC, 9000); /* ~1.5 kHz */
+    put_gen(buf, SF_GEN_INITIAL_FILTER_Q, 100); /* 10 dB */
+    put_gen(buf, SF_GEN_SAMPLE_MODES, 1);
+    put_gen(buf, SF_GEN_SAMPLE_ID, 0);
+    put_gen(buf, 0, 0);
+    end_chunk(buf, chunk);
+
+    chunk = begin_chunk(buf, "shdr", NULL);
+    put_name(buf, "wave", 20);
+    put_u32(buf, 0);
+    put_u32(buf, WAVE_LEN);
+    put_u32(buf, WAVE_PERIOD);
+    put_u32(buf, WAVE_LEN - WAVE_PERIOD);
+    put_u32(buf, SAMPLE_RATE);
+    put_u8(buf, WAVE_ROOT_KEY);
+    put_u8(buf, 0); /* pitch correction */
+    put_u16(buf, 0);
+    put_u16(buf, 1); /* mono sample */
+    put_name(buf, "EOS", 20);
+    put_bytes(buf, NULL, 26);
+    end_chunk(buf, chunk);
+
+    end_chunk(buf, list);
+    end_chunk(buf, riff);
+}
+
+static void *mem_open(const char *filename)
+{
+    mem_file_t *file;
+
+    if(FLUID_STRCMP(filename, SF2_MEM_NAME) != 0)
+    {
+        return NULL;
+    }
+
+    file = FLUID_NEW(mem_file_t);
+    TEST_ASSERT(file != NULL);
+    file->buf = &sf2;
+    file->pos = 0;
+    return file;
+}
+
+static int mem_read(void *buf, int count, void *handle)
+{
+    mem_file_t *file = handle;
+
+    if(count < 0 || file->pos + count > file->buf->size)
+    {
+        return FLUID_FAILED;
+    }
+
+    memcpy(buf, file->buf->data + file->pos, count);
+    file->pos += count;
+    return FLUID_OK;
+}
+
+static int mem_seek(void *handle, long offset, int origin)
+{
+    mem_file_t *file = handle;
+    long pos = (origin == SEEK_SET) ? offset
+               : (origin == SEEK_CUR) ? file->pos + offset : file->buf->size + offset;
+
+    if(pos < 0 || pos > file->buf->size)
+    {
+        return FLUID_FAILED;
+    }
+
+    file->pos = pos;
+    return FLUID_OK;
+}
+
+static long mem_tell(void *handle)
+{
+    return ((mem_file_t *) handle)->pos;
+}
+
+static int mem_close(void *handle)
+{
+    FLUID_FREE(handle);
+    return FLUID_OK;
+}
+
+/*
+ * Benchmark
+ */
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static int parse_list(const char *arg, int *list)
+{
+    int n = 0;
+
+    while(n < MAX_LIST && *arg)
+    {
+        list[n++] = atoi(arg);
+        arg = strchr(arg, ',');
+
+        if(arg == NULL)
+        {
+            break;
+        }
+
+        arg++;
+    }
+
+    return n;
+}
+
+static void quiet_log(int level, char *message, void *data)
+{
+}
+
+static void run(int voices, int interp, int filter, int fx, int cores, int block_size, double seconds, int first)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sfloader_t *loader;
+    float left[FLUID_BUFSIZE_MAX], right[FLUID_BUFSIZE_MAX];
+    int i, sfont_id, blocks = (int)(seconds * SAMPLE_RATE / block_size);
+    double *times, start, total = 0, ns, realtime;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(blocks > 0);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", SAMPLE_RATE));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", voices));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", cores));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.block-size", block_size));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", fx));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", fx));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    loader = new_fluid_defsfloader(settings);
+    TEST_ASSERT(loader != NULL);
+    TEST_SUCCESS(fluid_sfloader_set_callbacks(loader, mem_open, mem_read, mem_seek, mem_tell, mem_close));
+    fluid_synth_add_sfloader(synth, loader);
+    sfont_id = fluid_synth_sfload(synth, SF2_MEM_NAME, 1);
+    TEST_ASSERT(sfont_id != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, -1, interp));
+
+    /* select explicitly, so that the drum channel plays the same preset */
+    for(i = 0; i < 16; i++)
+    {
+        TEST_SUCCESS(fluid_synth_program_select(synth, i, sfont_id, 0, filter));
+    }
+
+    /* velocity 127 leaves the filter cutoff alone */
+    for(i = 0; i < voices; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, i % 16, 36 + (i / 16 + 7 * i) % 60, 127));
+    }
+
+    /* warm up */
+    for(i = 0; i < 16; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, block_size, left, 0, 1, right, 0, 1));
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == voices);
+
+    times = FLUID_ARRAY(double, blocks);
+    TEST_ASSERT(times != NULL);
+
+    for(i = 0; i < blocks; i++)
+    {
+        start = fluid_utime();
+        fluid_synth_write_float(synth, block_size, left, 0, 1, right, 0, 1);
+        times[i] = fluid_utime() - start;
+        total += times[i];
+    }
+
+    qsort(times, blocks, sizeof(*times), compare_double);
+
+    ns = 1000.0 * total / ((double) blocks * block_size * voices);
+    realtime = (double) blocks * block_size / SAMPLE_RATE / (total / 1000000.0);
+
+    printf("%s\n    {\"voices\": %d, \"interpolation\": %d, \"filter\": %s, \"reverb\": %s, \"chorus\": %s, \"cpu_cores\": %d, "
+           "\"ns_per_sample_per_voice\": %.3f, \"voices_per_core\": %.1f, \"block_p50_us\": %.3f, \"block_p99_us\": %.3f}",
+           first ? "" : ",",
+           voices, interp, filter ? "true" : "false", fx ? "true" : "false", fx ? "true" : "false", cores,
+           ns, voices * realtime / cores, times[blocks / 2], times[(blocks * 99) / 100]);
+    fflush(stdout);
+
+    FLUID_FREE(times);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(int argc, char **argv)
+{
+    int voices[MAX_LIST] = { 16, 64, 256 }, n_voices = 3;
+    int interps[MAX_LIST] = { FLUID_INTERP_NONE, FLUID_INTERP_LINEAR, FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER }, n_interps = 4;
+    int cores[MAX_LIST] = { 1, 2 }, n_cores = 2;
+    double seconds = 1.0;
+    int block_size = FLUID_BUFSIZE;
+    int v, i, c, filter, fx, first = TRUE;
+
+    for(i = 1; i + 1 < argc; i += 2)
+    {
+        if(FLUID_STRCMP(argv[i], "-s") == 0)
+        {
+            seconds = atof(argv[i + 1]);
+        }
+        else if(FLUID_STRCMP(argv[i], "-b") == 0)
+        {
+            block_size = atoi(argv[i + 1]);
+        }
+        else if(FLUID_STRCMP(argv[i], "-v") == 0)
+        {
+            n_voices = parse_list(argv[i + 1], voices);
+        }
+        else if(FLUID_STRCMP(argv[i], "-i") == 0)
+        {
+            n_interps = parse_list(argv[i + 1], interps);
+        }
+        else if(FLUID_STRCMP(argv[i], "-c") == 0)
+        {
+            n_cores = parse_list(argv[i + 1], cores);
+        }
+    }
+
+    /* the in-memory soundfont has no drum kit and no modification time, keep stdout clean JSON */
+    fluid_set_log_function(FLUID_WARN, quiet_log, NULL);
+    build_sf2(&sf2);
+
+    printf("{\n  \"sample_rate\": %d,\n  \"block_size\": %d,\n  \"seconds\": %g,\n  \"results\": [", SAMPLE_RATE, block_size, seconds);
+
+    for(v = 0; v < n_voices; v++)
+    {
+        for(i = 0; i < n_interps; i++)
+        {
+            for(c = 0; c < n_cores; c++)
+            {
+                for(filter = 0; filter <= 1; filter++)
+                {
+                    for(fx = 0; fx <= 1; fx++)
+                    {
+                        run(voices[v], interps[i], filter, fx, cores[c], block_size, seconds, first);
+                        first = FALSE;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("\n  ]\n}\n");
+
+    free(sf2.data);
+
+    return EXIT_SUCCESS;
+}
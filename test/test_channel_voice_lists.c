@@ -0,0 +1,312 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_chan.h"
+#include "synth/fluid_voice.h"
+#include "utils/fluidsynth_priv.h"
+
+#define POLYPHONY 64
+
+static float buf[2 * FLUID_BUFSIZE];
+static fluid_real_t mod_before[POLYPHONY];
+
+// verifies that the voice lists of each channel and key hold exactly the voices
+// assigned to them, which used to be found by scanning all voices
+static void verify_channel_lists(fluid_synth_t *synth)
+{
+    int i, chan, key, assigned = 0, listed = 0;
+    fluid_voice_t *voice;
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        voice = synth->voice[i];
+
+        if(voice->chan != NO_CHANNEL)
+        {
+            TEST_ASSERT(voice->listed_channel == synth->channel[voice->chan]);
+            TEST_ASSERT(voice->listed_key == voice->key);
+            assigned++;
+        }
+        else
+        {
+            TEST_ASSERT(voice->listed_channel == NULL);
+        }
+    }
+
+    for(i = synth->polyphony; i < synth->nvoice; i++)
+    {
+        TEST_ASSERT(synth->voice[i]->listed_channel == NULL);
+    }
+
+    for(chan = 0; chan < synth->midi_channels; chan++)
+    {
+        fluid_channel_t *channel = synth->channel[chan];
+        int key_listed = 0;
+
+        for(voice = channel->voices; voice != NULL; voice = voice->channel_next)
+        {
+            TEST_ASSERT(voice->chan == chan);
+            TEST_ASSERT(voice->channel_prev == NULL || voice->channel_prev->channel_next == voice);
+            TEST_ASSERT(voice->channel_prev != NULL || channel->voices == voice);
+            listed++;
+        }
+
+        for(key = 0; key < 128; key++)
+        {
+            for(voice = channel->key_voices[key]; voice != NULL; voice = voice->key_next)
+            {
+                TEST_ASSERT(voice->chan == chan);
+                TEST_ASSERT(voice->key == key);
+                TEST_ASSERT(voice->key_prev == NULL || voice->key_prev->key_next == voice);
+                key_listed++;
+            }
+        }
+
+        // every voice of the channel is in the list of its key as well
+        for(voice = channel->voices; voice != NULL; voice = voice->channel_next)
+        {
+            key_listed--;
+        }
+
+        TEST_ASSERT(key_listed == 0);
+    }
+
+    TEST_ASSERT(listed == assigned);
+}
+
+typedef int (*voice_state_func_t)(const fluid_voice_t *voice);
+
+// counts the playing voices of a channel and key which are in the given state
+static int count_voices(fluid_synth_t *synth, int chan, int key, voice_state_func_t state)
+{
+    int i, count = 0;
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        fluid_voice_t *voice = synth->voice[i];
+
+        if(fluid_voice_is_playing(voice) && voice->chan == chan && voice->key == key && state(voice))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static int is_released(const fluid_voice_t *voice)
+{
+    return voice->has_noteoff;
+}
+
+static void remember_mod(fluid_synth_t *synth, int gen)
+{
+    int i;
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        mod_before[i] = synth->voice[i]->gen[gen].mod;
+    }
+}
+
+// checks that exactly the voices of the channel, and of the key unless it is -1, got a new modulation
+static void verify_mod_changed(fluid_synth_t *synth, int gen, int chan, int key)
+{
+    int i, changed = 0;
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        fluid_voice_t *voice = synth->voice[i];
+        int addressed = voice->chan == chan && (key == -1 || voice->key == key);
+
+        if(!fluid_voice_is_playing(voice))
+        {
+            continue;
+        }
+
+        TEST_ASSERT((voice->gen[gen].mod != mod_before[i]) == addressed);
+        changed += addressed;
+    }
+
+    TEST_ASSERT(changed > 0);
+}
+
+static void noteon(fluid_synth_t *synth, int chan, int key)
+{
+    TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 100));
+    TEST_ASSERT(count_voices(synth, chan, key, fluid_voice_is_on) > 0);
+    verify_channel_lists(synth);
+}
+
+static void noteoff(fluid_synth_t *synth, int chan, int key)
+{
+    TEST_SUCCESS(fluid_synth_noteoff(synth, chan, key));
+    verify_channel_lists(synth);
+}
+
+// a noteoff releases the voices of its channel and key only
+static void test_noteoff(fluid_synth_t *synth)
+{
+    noteon(synth, 0, 60);
+    noteon(synth, 0, 62);
+    noteon(synth, 1, 60);
+
+    noteoff(synth, 0, 60);
+    TEST_ASSERT(count_voices(synth, 0, 60, fluid_voice_is_on) == 0);
+    TEST_ASSERT(count_voices(synth, 0, 62, fluid_voice_is_on) > 0);
+    TEST_ASSERT(count_voices(synth, 1, 60, fluid_voice_is_on) > 0);
+}
+
+// key pressure and controllers modulate the voices of their key and channel only
+static void test_modulation(fluid_synth_t *synth)
+{
+    remember_mod(synth, GEN_ATTENUATION);
+    TEST_SUCCESS(fluid_synth_key_pressure(synth, 0, 62, 127));
+    verify_mod_changed(synth, GEN_ATTENUATION, 0, 62);
+
+    remember_mod(synth, GEN_VIBLFOTOPITCH);
+    TEST_SUCCESS(fluid_synth_cc(synth, 1, MODULATION_MSB, 127));
+    verify_mod_changed(synth, GEN_VIBLFOTOPITCH, 1, -1);
+}
+
+// the sustain pedal holds the released voices of its channel only
+static void test_sustain(fluid_synth_t *synth)
+{
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, SUSTAIN_SWITCH, 127));
+    noteoff(synth, 0, 62);
+    noteoff(synth, 1, 60);
+
+    TEST_ASSERT(count_voices(synth, 0, 62, fluid_voice_is_sustained) > 0);
+    TEST_ASSERT(count_voices(synth, 0, 62, is_released) == 0);
+    TEST_ASSERT(count_voices(synth, 1, 60, fluid_voice_is_sustained) == 0);
+
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, SUSTAIN_SWITCH, 0));
+    verify_channel_lists(synth);
+    TEST_ASSERT(count_voices(synth, 0, 62, is_released) > 0);
+}
+
+// the sostenuto pedal holds the voices which were on when it was pressed only
+static void test_sostenuto(fluid_synth_t *synth)
+{
+    noteon(synth, 1, 64);
+    noteon(synth, 0, 64);
+    TEST_SUCCESS(fluid_synth_cc(synth, 1, SOSTENUTO_SWITCH, 127));
+    noteon(synth, 1, 67);
+
+    noteoff(synth, 1, 64);
+    noteoff(synth, 1, 67);
+    noteoff(synth, 0, 64);
+
+    TEST_ASSERT(count_voices(synth, 1, 64, fluid_voice_is_sostenuto) > 0);
+    TEST_ASSERT(count_voices(synth, 1, 64, is_released) == 0);
+    TEST_ASSERT(count_voices(synth, 1, 67, fluid_voice_is_sostenuto) == 0);
+    TEST_ASSERT(count_voices(synth, 0, 64, fluid_voice_is_sostenuto) == 0);
+
+    TEST_SUCCESS(fluid_synth_cc(synth, 1, SOSTENUTO_SWITCH, 0));
+    verify_channel_lists(synth);
+    TEST_ASSERT(count_voices(synth, 1, 64, is_released) > 0);
+}
+
+// legato playing moves the voices to the list of the new key and back
+static void test_legato(fluid_synth_t *synth)
+{
+    int on;
+
+    TEST_SUCCESS(fluid_synth_cc(synth, 2, LEGATO_SWITCH, 127));
+    TEST_SUCCESS(fluid_synth_set_legato_mode(synth, 2, FLUID_CHANNEL_LEGATO_MODE_MULTI_RETRIGGER));
+
+    noteon(synth, 2, 60);
+    on = count_voices(synth, 2, 60, fluid_voice_is_on);
+
+    noteon(synth, 2, 65);
+    TEST_ASSERT(synth->channel[2]->key_voices[60] == NULL);
+    TEST_ASSERT(count_voices(synth, 2, 65, fluid_voice_is_on) == on);
+
+    // releasing the new key plays the held one again
+    noteoff(synth, 2, 65);
+    TEST_ASSERT(synth->channel[2]->key_voices[65] == NULL);
+    TEST_ASSERT(count_voices(synth, 2, 60, fluid_voice_is_on) == on);
+
+    noteoff(synth, 2, 60);
+    TEST_ASSERT(count_voices(synth, 2, 60, fluid_voice_is_on) == 0);
+}
+
+static int is_killed_by_exclusive_class(const fluid_voice_t *voice)
+{
+    return voice->gen[GEN_VOLENVRELEASE].val == -200;
+}
+
+// an exclusive class kills the voices of its channel only
+static void test_exclusive_class(fluid_synth_t *synth)
+{
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 3, GEN_EXCLUSIVECLASS, 1));
+    noteon(synth, 3, 60);
+    noteon(synth, 4, 60);
+    TEST_ASSERT(count_voices(synth, 3, 60, is_killed_by_exclusive_class) == 0);
+
+    noteon(synth, 3, 72);
+    TEST_ASSERT(count_voices(synth, 3, 60, is_killed_by_exclusive_class) > 0);
+    TEST_ASSERT(count_voices(synth, 3, 72, is_killed_by_exclusive_class) == 0);
+    TEST_ASSERT(count_voices(synth, 4, 60, is_killed_by_exclusive_class) == 0);
+}
+
+// this test makes sure that the per channel and per key voice lists lead the
+// channel and key events to exactly the voices they address
+int main(void)
+{
+    int i;
+    fluid_mod_t *mod;
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    // key pressure attenuates the voices
+    mod = new_fluid_mod();
+    TEST_ASSERT(mod != NULL);
+    fluid_mod_set_source1(mod, FLUID_MOD_KEYPRESSURE, FLUID_MOD_GC | FLUID_MOD_LINEAR | FLUID_MOD_UNIPOLAR | FLUID_MOD_POSITIVE);
+    fluid_mod_set_source2(mod, FLUID_MOD_NONE, 0);
+    fluid_mod_set_dest(mod, GEN_ATTENUATION);
+    fluid_mod_set_amount(mod, 100);
+    TEST_SUCCESS(fluid_synth_add_default_mod(synth, mod, FLUID_SYNTH_ADD));
+    delete_fluid_mod(mod);
+
+    test_noteoff(synth);
+    test_modulation(synth);
+    test_sustain(synth);
+    test_sostenuto(synth);
+    test_legato(synth);
+    test_exclusive_class(synth);
+
+    // shrinking and growing the polyphony must keep the lists in sync
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, 4));
+    verify_channel_lists(synth);
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, POLYPHONY));
+    verify_channel_lists(synth);
+
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+
+    for(i = 0; i < 100; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+    }
+
+    // the finished voices are picked up by the next API call
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+    verify_channel_lists(synth);
+
+    for(i = 0; i < synth->midi_channels; i++)
+    {
+        TEST_ASSERT(synth->channel[i]->voices == NULL);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "rvoice/fluid_chorus.h"
+#include "utils/fluidsynth_priv.h"
+
+#define SAMPLE_RATE 96000.0f
+// several LFO periods at the highest speed, and several wraps of the delay line
+#define FRAMES 48000
+// not a multiple of FLUID_BUFSIZE, so that the chunks are split in various ways
+#define CALL_SIZE (FLUID_BUFSIZE * 5 / 2 + 3)
+
+static fluid_real_t in[FRAMES];
+static fluid_real_t left_block[FRAMES], right_block[FRAMES];
+static fluid_real_t left_single[FRAMES], right_single[FRAMES];
+
+static void compare_chunked_to_single(int nr, fluid_real_t speed, fluid_real_t depth_ms, int type, int mix)
+{
+    int i, n, loud = 0;
+    fluid_chorus_t *block = new_fluid_chorus(SAMPLE_RATE);
+    fluid_chorus_t *single = new_fluid_chorus(SAMPLE_RATE);
+
+    TEST_ASSERT(block != NULL);
+    TEST_ASSERT(single != NULL);
+
+    fluid_chorus_set(block, FLUID_CHORUS_SET_ALL, nr, 1.5f, speed, depth_ms, type);
+    fluid_chorus_set(single, FLUID_CHORUS_SET_ALL, nr, 1.5f, speed, depth_ms, type);
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        left_block[i] = left_single[i] = 0.25f;
+        right_block[i] = right_single[i] = -0.25f;
+    }
+
+    for(i = 0; i < FRAMES; i += n)
+    {
+        n = (FRAMES - i < CALL_SIZE) ? FRAMES - i : CALL_SIZE;
+
+        if(mix)
+        {
+            fluid_chorus_processmix(block, &in[i], &left_block[i], &right_block[i], n);
+        }
+        else
+        {
+            fluid_chorus_processreplace(block, &in[i], &left_block[i], &right_block[i], n);
+        }
+    }
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        if(mix)
+        {
+            fluid_chorus_processmix(single, &in[i], &left_single[i], &right_single[i], 1);
+        }
+        else
+        {
+            fluid_chorus_processreplace(single, &in[i], &left_single[i], &right_single[i], 1);
+        }
+    }
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(left_block[i] == left_single[i]);
+        TEST_ASSERT(right_block[i] == right_single[i]);
+        loud |= (left_block[i] != (mix ? 0.25f : 0.0f));
+    }
+
+    TEST_ASSERT(loud);
+
+    delete_fluid_chorus(single);
+    delete_fluid_chorus(block);
+}
+
+// this test makes sure that the chorus gives the same result no matter how many samples are processed at once
+int main(void)
+{
+    int i;
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        in[i] = (fluid_real_t)((i * 7919) % 2000 - 1000) / 1000.0f;
+    }
+
+    compare_chunked_to_single(FLUID_CHORUS_DEFAULT_N, FLUID_CHORUS_DEFAULT_SPEED, FLUID_CHORUS_DEFAULT_DEPTH,
+                              FLUID_CHORUS_MOD_SINE, TRUE);
+
+    // the maximum number of chorus blocks at the highest speed and depth
+    compare_chunked_to_single(99, 5.0f, 21.0f, FLUID_CHORUS_MOD_SINE, TRUE);
+    compare_chunked_to_single(99, 5.0f, 21.0f, FLUID_CHORUS_MOD_TRIANGLE, FALSE);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_iir_filter.h"
+#include "utils/fluid_conv.h"
+#include "utils/fluidsynth_priv.h"
+
+#include <fenv.h>
+#include <math.h>
+
+#define FILTERS (FLUID_IIR_FILTER_BATCH + 2)
+#define BLOCKS 200
+// not a multiple of FLUID_BUFSIZE, so that the lanes are processed in a full and a partial chunk
+#define BLOCK_SIZE (FLUID_BUFSIZE * 3 / 2)
+#define SAMPLE_RATE 44100.0f
+
+static fluid_iir_filter_t batch_filters[FILTERS], scalar_filters[FILTERS];
+static fluid_real_t batch_bufs[FILTERS][BLOCK_SIZE], scalar_bufs[FILTERS][BLOCK_SIZE];
+
+static void init_filter(fluid_iir_filter_t *filter, int type, int flags, fluid_real_t fres, fluid_real_t q)
+{
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+
+    FLUID_MEMSET(filter, 0, sizeof(*filter));
+
+    param[0].i = type;
+    param[1].i = flags;
+    fluid_iir_filter_init(filter, param);
+
+    param[0].real = fres;
+    fluid_iir_filter_set_fres(filter, param);
+
+    param[0].real = q;
+    fluid_iir_filter_set_q(filter, param);
+}
+
+// leaves infinities on the stack, which must not make it into the unused lanes of a batch
+static void dirty_stack(void)
+{
+    volatile fluid_real_t junk[FLUID_BUFSIZE * FLUID_IIR_FILTER_BATCH * 4];
+    int i;
+
+    for(i = 0; i < (int)(sizeof(junk) / sizeof(junk[0])); i++)
+    {
+        junk[i] = HUGE_VAL;
+    }
+}
+
+// this test makes sure that filtering several voices side by side gives the same result as filtering them one by one
+int main(void)
+{
+    int i, b, f;
+
+    // the filters convert cents to Hz by means of the tables
+    fluid_conversion_config();
+
+    init_filter(&batch_filters[0], FLUID_IIR_LOWPASS, 0, 9000, 100);
+    init_filter(&batch_filters[1], FLUID_IIR_HIGHPASS, 0, 3000, 200);
+    init_filter(&batch_filters[2], FLUID_IIR_LOWPASS, FLUID_IIR_Q_LINEAR, 7000, 5);
+    init_filter(&batch_filters[3], FLUID_IIR_DISABLED, 0, 5000, 0);
+    init_filter(&batch_filters[4], FLUID_IIR_LOWPASS, FLUID_IIR_Q_ZERO_OFF, 5000, 0);
+    init_filter(&batch_filters[5], FLUID_IIR_LOWPASS, 0, 13500, 960);
+    FLUID_MEMCPY(scalar_filters, batch_filters, sizeof(batch_filters));
+
+    for(b = 0; b < BLOCKS; b++)
+    {
+        fluid_iir_filter_t *filters[FILTERS];
+        fluid_real_t *bufs[FILTERS];
+
+        for(f = 0; f < FILTERS; f++)
+        {
+            // sweep the cutoff with occasional jumps of several octaves, which compensate the filter history
+            fluid_real_t fres_mod = (b % 50 < 25) ? (b % 25) * 40.0f : ((b / 10) % 2) * -4800.0f;
+
+            fluid_iir_filter_calc(&batch_filters[f], SAMPLE_RATE, fres_mod * (f + 1) / FILTERS, BLOCK_SIZE, 0);
+            fluid_iir_filter_calc(&scalar_filters[f], SAMPLE_RATE, fres_mod * (f + 1) / FILTERS, BLOCK_SIZE, 0);
+
+            for(i = 0; i < BLOCK_SIZE; i++)
+            {
+                batch_bufs[f][i] = scalar_bufs[f][i] = ((b * BLOCK_SIZE + i) * (f + 3) % 97) / 48.5f - 1.0f;
+            }
+
+            filters[f] = &batch_filters[f];
+            bufs[f] = batch_bufs[f];
+
+            fluid_iir_filter_apply(&scalar_filters[f], scalar_bufs[f], BLOCK_SIZE);
+        }
+
+        // leave the last filters out every now and then, so that the batch is partially filled
+        dirty_stack();
+        feclearexcept(FE_ALL_EXCEPT);
+        fluid_iir_filter_apply_batch(filters, bufs, FLUID_IIR_FILTER_BATCH - b % 3, BLOCK_SIZE);
+        fluid_iir_filter_apply_batch(&filters[FLUID_IIR_FILTER_BATCH - b % 3], &bufs[FLUID_IIR_FILTER_BATCH - b % 3],
+                                     FILTERS - FLUID_IIR_FILTER_BATCH + b % 3, BLOCK_SIZE);
+        TEST_ASSERT(!fetestexcept(FE_OVERFLOW | FE_INVALID));
+
+        for(f = 0; f < FILTERS; f++)
+        {
+            for(i = 0; i < BLOCK_SIZE; i++)
+            {
+                TEST_ASSERT(batch_bufs[f][i] == scalar_bufs[f][i]);
+            }
+
+            TEST_ASSERT(batch_filters[f].hist1 == scalar_filters[f].hist1);
+            TEST_ASSERT(batch_filters[f].hist2 == scalar_filters[f].hist2);
+            TEST_ASSERT(batch_filters[f].b02 == scalar_filters[f].b02);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
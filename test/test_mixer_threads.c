@@ -0,0 +1,148 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluidsynth_priv.h"
+
+#include <math.h>
+
+#define RENDER_FRAMES 256
+#define RENDER_PERIODS 64
+#define AUDIO_GROUPS 4
+#define FX_CHANNELS 2
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings, int cores, int pipelined_fx)
+{
+    int i;
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", cores));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.pipelined-fx", pipelined_fx));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 256));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    // mix voices of different cost, so that the mixer threads get unequal work
+    for(i = 0; i < 16; i++)
+    {
+        static const int interp[] = { FLUID_INTERP_NONE, FLUID_INTERP_LINEAR, FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER };
+        TEST_SUCCESS(fluid_synth_set_interp_method(synth, i, interp[i % 4]));
+    }
+
+    return synth;
+}
+
+static void play(fluid_synth_t *synth, int period)
+{
+    int i;
+
+    for(i = 0; i < 16; i++)
+    {
+        int key = 36 + (period * 7 + i * 5) % 60;
+
+        if(period % 4 == 0)
+        {
+            fluid_synth_noteon(synth, i, key, 100);
+        }
+        else if(period % 4 == 3)
+        {
+            fluid_synth_noteoff(synth, i, key);
+        }
+    }
+}
+
+static void compare(float bufs1[][RENDER_FRAMES], float bufs4[][RENDER_FRAMES], int count)
+{
+    int i, j;
+
+    // voices are summed in a different order, allow for rounding errors
+    for(i = 0; i < count; i++)
+    {
+        for(j = 0; j < RENDER_FRAMES; j++)
+        {
+            TEST_ASSERT(fabs(bufs1[i][j] - bufs4[i][j]) < 1e-5);
+        }
+    }
+}
+
+// this test makes sure that rendering with extra mixer threads gives the same result as rendering single threaded
+int main(void)
+{
+    int i;
+    float left1[AUDIO_GROUPS][RENDER_FRAMES], right1[AUDIO_GROUPS][RENDER_FRAMES];
+    float left4[AUDIO_GROUPS][RENDER_FRAMES], right4[AUDIO_GROUPS][RENDER_FRAMES];
+    float fx_left1[FX_CHANNELS][RENDER_FRAMES], fx_right1[FX_CHANNELS][RENDER_FRAMES];
+    float fx_left4[FX_CHANNELS][RENDER_FRAMES], fx_right4[FX_CHANNELS][RENDER_FRAMES];
+    float *l1[AUDIO_GROUPS], *r1[AUDIO_GROUPS], *l4[AUDIO_GROUPS], *r4[AUDIO_GROUPS];
+    float *fxl1[FX_CHANNELS], *fxr1[FX_CHANNELS], *fxl4[FX_CHANNELS], *fxr4[FX_CHANNELS];
+    fluid_synth_t *synth1, *synth4, *reference, *pipelined;
+
+    fluid_settings_t *settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+
+    // render to several audio groups, so that each thread writes to a subset of the buffers only
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.audio-groups", AUDIO_GROUPS));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.audio-channels", AUDIO_GROUPS));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.effects-channels", FX_CHANNELS));
+
+    synth1 = create_synth(settings, 1, 0);
+    synth4 = create_synth(settings, 4, 0);
+    reference = create_synth(settings, 1, 0);
+    pipelined = create_synth(settings, 4, 1);
+
+    for(i = 0; i < AUDIO_GROUPS; i++)
+    {
+        l1[i] = left1[i];
+        r1[i] = right1[i];
+        l4[i] = left4[i];
+        r4[i] = right4[i];
+    }
+
+    for(i = 0; i < FX_CHANNELS; i++)
+    {
+        fxl1[i] = fx_left1[i];
+        fxr1[i] = fx_right1[i];
+        fxl4[i] = fx_left4[i];
+        fxr4[i] = fx_right4[i];
+    }
+
+    for(i = 0; i < RENDER_PERIODS; i++)
+    {
+        play(synth1, i);
+        play(synth4, i);
+
+        TEST_SUCCESS(fluid_synth_nwrite_float(synth1, RENDER_FRAMES, l1, r1, fxl1, fxr1));
+        TEST_SUCCESS(fluid_synth_nwrite_float(synth4, RENDER_FRAMES, l4, r4, fxl4, fxr4));
+
+        compare(left1, left4, AUDIO_GROUPS);
+        compare(right1, right4, AUDIO_GROUPS);
+        compare(fx_left1, fx_left4, FX_CHANNELS);
+        compare(fx_right1, fx_right4, FX_CHANNELS);
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth4) == fluid_synth_get_active_voice_count(synth1));
+
+    // with pipelined effects, the reverb and chorus of a block run while the next block is rendered,
+    // which requires several blocks per render call
+    for(i = 0; i < RENDER_PERIODS; i++)
+    {
+        play(reference, i);
+        play(pipelined, i);
+
+        TEST_SUCCESS(fluid_synth_write_float(reference, RENDER_FRAMES, left1[0], 0, 1, right1[0], 0, 1));
+        TEST_SUCCESS(fluid_synth_write_float(pipelined, RENDER_FRAMES, left4[0], 0, 1, right4[0], 0, 1));
+
+        compare(left1, left4, 1);
+        compare(right1, right4, 1);
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(pipelined) == fluid_synth_get_active_voice_count(reference));
+
+    delete_fluid_synth(pipelined);
+    delete_fluid_synth(reference);
+    delete_fluid_synth(synth4);
+    delete_fluid_synth(synth1);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
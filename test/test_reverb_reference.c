@@ -0,0 +1,318 @@
+#include <math.h>
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluidsynth_priv.h"
+#include "rvoice/fluid_rev.h"
+
+#define FRAMES 20000
+
+/* relative to the peak of the reference output */
+#define TOLERANCE 1e-6
+
+/*
+ * The reference is the sample by sample Freeverb model the reverb used to be,
+ * kept here so that the lane-wise rewrite can be checked against it.
+ */
+#define REF_DC_OFFSET 1e-8
+#define REF_COMBS 8
+#define REF_ALLPASSES 4
+#define REF_STEREOSPREAD 23
+
+static const int ref_combtuning[REF_COMBS] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+static const int ref_allpasstuning[REF_ALLPASSES] = { 556, 441, 341, 225 };
+
+typedef struct
+{
+    fluid_real_t *buffer;
+    int bufsize;
+    int bufidx;
+    fluid_real_t filterstore;
+} ref_delay_t;
+
+typedef struct
+{
+    fluid_real_t roomsize, damp, wet1, wet2;
+    ref_delay_t combL[REF_COMBS], combR[REF_COMBS];
+    ref_delay_t allpassL[REF_ALLPASSES], allpassR[REF_ALLPASSES];
+} ref_revmodel_t;
+
+static void ref_delay_alloc(ref_delay_t *delay, int size)
+{
+    delay->buffer = FLUID_ARRAY(fluid_real_t, size);
+    delay->bufsize = size;
+    TEST_ASSERT(delay->buffer != NULL);
+}
+
+static void ref_delay_clear(ref_delay_t *delay)
+{
+    int i;
+
+    for(i = 0; i < delay->bufsize; i++)
+    {
+        delay->buffer[i] = REF_DC_OFFSET;
+    }
+
+    delay->bufidx = 0;
+    delay->filterstore = 0;
+}
+
+static void ref_revmodel_reset(ref_revmodel_t *rev)
+{
+    int i;
+
+    for(i = 0; i < REF_COMBS; i++)
+    {
+        ref_delay_clear(&rev->combL[i]);
+        ref_delay_clear(&rev->combR[i]);
+    }
+
+    for(i = 0; i < REF_ALLPASSES; i++)
+    {
+        ref_delay_clear(&rev->allpassL[i]);
+        ref_delay_clear(&rev->allpassR[i]);
+    }
+}
+
+static void ref_revmodel_free(ref_revmodel_t *rev)
+{
+    int i;
+
+    for(i = 0; i < REF_COMBS; i++)
+    {
+        FLUID_FREE(rev->combL[i].buffer);
+        FLUID_FREE(rev->combR[i].buffer);
+    }
+
+    for(i = 0; i < REF_ALLPASSES; i++)
+    {
+        FLUID_FREE(rev->allpassL[i].buffer);
+        FLUID_FREE(rev->allpassR[i].buffer);
+    }
+}
+
+static void ref_revmodel_init(ref_revmodel_t *rev, fluid_real_t sample_rate)
+{
+    float srfactor = sample_rate / 44100.0f;
+    int i;
+
+    for(i = 0; i < REF_COMBS; i++)
+    {
+        ref_delay_alloc(&rev->combL[i], ref_combtuning[i] * srfactor);
+        ref_delay_alloc(&rev->combR[i], (ref_combtuning[i] + REF_STEREOSPREAD) * srfactor);
+    }
+
+    for(i = 0; i < REF_ALLPASSES; i++)
+    {
+        ref_delay_alloc(&rev->allpassL[i], ref_allpasstuning[i] * srfactor);
+        ref_delay_alloc(&rev->allpassR[i], (ref_allpasstuning[i] + REF_STEREOSPREAD) * srfactor);
+    }
+
+    ref_revmodel_reset(rev);
+}
+
+static void ref_revmodel_set(ref_revmodel_t *rev, fluid_real_t roomsize, fluid_real_t damping,
+                             fluid_real_t width, fluid_real_t level)
+{
+    fluid_real_t wet;
+
+    fluid_clip(roomsize, 0.0f, 1.0f);
+    fluid_clip(level, 0.0f, 1.0f);
+
+    rev->roomsize = roomsize * 0.28f + 0.7f;
+    rev->damp = damping * 1.0f;
+
+    wet = (level * 3.0f) / (1.0f + width * 0.2f);
+    rev->wet1 = wet * (width / 2.0f + 0.5f);
+    rev->wet2 = wet * ((1.0f - width) / 2.0f);
+}
+
+static fluid_real_t ref_comb_process(ref_revmodel_t *rev, ref_delay_t *comb, fluid_real_t input)
+{
+    fluid_real_t tmp = comb->buffer[comb->bufidx];
+
+    comb->filterstore = tmp * (1 - rev->damp) + comb->filterstore * rev->damp;
+    comb->buffer[comb->bufidx] = input + comb->filterstore * rev->roomsize;
+
+    if(++comb->bufidx >= comb->bufsize)
+    {
+        comb->bufidx = 0;
+    }
+
+    return tmp;
+}
+
+static fluid_real_t ref_allpass_process(ref_delay_t *allpass, fluid_real_t input)
+{
+    fluid_real_t bufout = allpass->buffer[allpass->bufidx];
+
+    allpass->buffer[allpass->bufidx] = input + bufout * 0.5f;
+
+    if(++allpass->bufidx >= allpass->bufsize)
+    {
+        allpass->bufidx = 0;
+    }
+
+    return bufout - input;
+}
+
+static void ref_revmodel_process(ref_revmodel_t *rev, const fluid_real_t *in,
+                                 fluid_real_t *left_out, fluid_real_t *right_out, int count, int mix)
+{
+    int i, k;
+
+    for(k = 0; k < count; k++)
+    {
+        fluid_real_t outL = 0, outR = 0;
+        fluid_real_t input = (2.0f * in[k] + REF_DC_OFFSET) * 0.015f;
+
+        for(i = 0; i < REF_COMBS; i++)
+        {
+            outL += ref_comb_process(rev, &rev->combL[i], input);
+            outR += ref_comb_process(rev, &rev->combR[i], input);
+        }
+
+        for(i = 0; i < REF_ALLPASSES; i++)
+        {
+            outL = ref_allpass_process(&rev->allpassL[i], outL);
+            outR = ref_allpass_process(&rev->allpassR[i], outR);
+        }
+
+        outL -= REF_DC_OFFSET;
+        outR -= REF_DC_OFFSET;
+
+        if(!mix)
+        {
+            left_out[k] = right_out[k] = 0;
+        }
+
+        left_out[k] += outL * rev->wet1 + outR * rev->wet2;
+        right_out[k] += outR * rev->wet1 + outL * rev->wet2;
+    }
+}
+
+static fluid_real_t in_buf[FRAMES];
+static fluid_real_t left[FRAMES], right[FRAMES], ref_left[FRAMES], ref_right[FRAMES];
+
+static void fill_input(unsigned int seed)
+{
+    int k;
+
+    /* bursts of noise with silence in between, so that the tails ring out on their own */
+    for(k = 0; k < FRAMES; k++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        in_buf[k] = ((k / 3000) % 2) ? 0.0 : ((fluid_real_t)(seed >> 8) / (1 << 23) - 1.0);
+    }
+}
+
+/* renders FRAMES through both models in calls of varying size, replacing or mixing */
+static void render(fluid_revmodel_t *rev, ref_revmodel_t *ref, int mix)
+{
+    static const int call_sizes[] = { 1, 7, FLUID_BUFSIZE, 100, 333, 13 };
+    int k = 0, c = 0;
+    fluid_real_t peak = 0;
+
+    for(k = 0; k < FRAMES; k++)
+    {
+        left[k] = ref_left[k] = 0.25 * in_buf[k];
+        right[k] = ref_right[k] = -0.25 * in_buf[k];
+    }
+
+    for(k = 0; k < FRAMES; c++)
+    {
+        int n = call_sizes[c % (sizeof(call_sizes) / sizeof(call_sizes[0]))];
+
+        if(k + n > FRAMES)
+        {
+            n = FRAMES - k;
+        }
+
+        if(mix)
+        {
+            fluid_revmodel_processmix(rev, &in_buf[k], &left[k], &right[k], n);
+        }
+        else
+        {
+            fluid_revmodel_processreplace(rev, &in_buf[k], &left[k], &right[k], n);
+        }
+
+        ref_revmodel_process(ref, &in_buf[k], &ref_left[k], &ref_right[k], n, mix);
+        k += n;
+    }
+
+    for(k = 0; k < FRAMES; k++)
+    {
+        if(fabs(ref_left[k]) > peak)
+        {
+            peak = fabs(ref_left[k]);
+        }
+
+        if(fabs(ref_right[k]) > peak)
+        {
+            peak = fabs(ref_right[k]);
+        }
+    }
+
+    TEST_ASSERT(peak > 0);
+
+    for(k = 0; k < FRAMES; k++)
+    {
+        TEST_ASSERT(fabs(left[k] - ref_left[k]) <= TOLERANCE * peak);
+        TEST_ASSERT(fabs(right[k] - ref_right[k]) <= TOLERANCE * peak);
+    }
+}
+
+// this test makes sure that the reverb still sounds like the Freeverb model it was derived from
+int main(void)
+{
+    /* at 8000 Hz the shortest allpass is shorter than FLUID_BUFSIZE, which limits the chunks */
+    static const fluid_real_t sample_rates[] = { 44100, 48000, 96000, 22050, 8000 };
+    static const fluid_real_t params[][4] =
+    {
+        /* roomsize, damping, width, level */
+        { 0.2, 0.0, 0.5, 0.9 },
+        { 1.0, 0.3, 1.0, 1.0 },
+        { 0.6, 1.0, 0.0, 0.4 },
+        { 0.8, 0.5, 10.0, 0.7 }
+    };
+    unsigned int s, p;
+    int mix;
+
+    for(s = 0; s < sizeof(sample_rates) / sizeof(sample_rates[0]); s++)
+    {
+        for(p = 0; p < sizeof(params) / sizeof(params[0]); p++)
+        {
+            for(mix = 0; mix <= 1; mix++)
+            {
+                fluid_revmodel_t *rev = new_fluid_revmodel(sample_rates[s]);
+                ref_revmodel_t ref;
+
+                TEST_ASSERT(rev != NULL);
+                ref_revmodel_init(&ref, sample_rates[s]);
+
+                fluid_revmodel_set(rev, FLUID_REVMODEL_SET_ALL, params[p][0], params[p][1], params[p][2], params[p][3]);
+                ref_revmodel_set(&ref, params[p][0], params[p][1], params[p][2], params[p][3]);
+
+                fill_input(s * 100 + p * 10 + mix);
+                render(rev, &ref, mix);
+
+                /* once more from a clean state */
+                fluid_revmodel_reset(rev);
+                ref_revmodel_reset(&ref);
+                render(rev, &ref, !mix);
+
+                /* and after switching to the next sample rate */
+                fluid_revmodel_samplerate_change(rev, sample_rates[(s + 1) % (sizeof(sample_rates) / sizeof(sample_rates[0]))]);
+                ref_revmodel_free(&ref);
+                ref_revmodel_init(&ref, sample_rates[(s + 1) % (sizeof(sample_rates) / sizeof(sample_rates[0]))]);
+                render(rev, &ref, mix);
+
+                ref_revmodel_free(&ref);
+                delete_fluid_revmodel(rev);
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
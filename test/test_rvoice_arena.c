@@ -0,0 +1,63 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "rvoice/fluid_rvoice.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluidsynth_priv.h"
+
+// the rvoices of the voices first to last - 1 are packed side by side, each
+// one at a cache line, followed by the overflow rvoices
+static void verify_rvoices(fluid_synth_t *synth, int first, int last)
+{
+    int i;
+    size_t stride = (char *)synth->voice[first + 1]->rvoice - (char *)synth->voice[first]->rvoice;
+
+    TEST_ASSERT(stride >= sizeof(fluid_rvoice_t));
+    TEST_ASSERT(stride < sizeof(fluid_rvoice_t) + FLUID_DEFAULT_ALIGNMENT);
+
+    for(i = first; i < last; i++)
+    {
+        fluid_voice_t *voice = synth->voice[i];
+
+        TEST_ASSERT((uintptr_t)voice->rvoice % FLUID_DEFAULT_ALIGNMENT == 0);
+        TEST_ASSERT((uintptr_t)voice->overflow_rvoice % FLUID_DEFAULT_ALIGNMENT == 0);
+        TEST_ASSERT((char *)voice->rvoice == (char *)synth->voice[first]->rvoice + (i - first) * stride);
+        TEST_ASSERT((char *)voice->overflow_rvoice == (char *)voice->rvoice + (last - first) * stride);
+    }
+}
+
+// this test makes sure that the rvoices are allocated in cache aligned arenas,
+// also when the polyphony is raised later on
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    float buf[2 * FLUID_BUFSIZE];
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 16));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    verify_rvoices(synth, 0, 16);
+
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, 40));
+    TEST_ASSERT(synth->nvoice == 40);
+    verify_rvoices(synth, 0, 16);
+    verify_rvoices(synth, 16, 40);
+
+    // enough notes to use the new voices and to steal some, so that overflow rvoices are used
+    for(i = 0; i < 60; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, i % 16, 36 + i, 100));
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_rvoice.h"
+#include "utils/fluidsynth_priv.h"
+
+#define SAMPLE_LENGTH 2000
+#define FRAMES 3000
+// more than FLUID_BUFSIZE, so that the runs are split into chunks
+#define BLOCK_SIZE (FLUID_BUFSIZE * 3 + 11)
+
+typedef int (*interpolate_func_t)(fluid_rvoice_dsp_t *voice, fluid_real_t *FLUID_RESTRICT dsp_buf, int is_looping);
+
+static short sample_data[SAMPLE_LENGTH];
+static char sample_data24[SAMPLE_LENGTH];
+
+static void init_voice(fluid_rvoice_dsp_t *voice, fluid_sample_t *sample, int loopstart, int loopend,
+                       fluid_real_t phase_incr, int block_size)
+{
+    FLUID_MEMSET(voice, 0, sizeof(*voice));
+
+    voice->sample = sample;
+    voice->start = 0;
+    voice->end = SAMPLE_LENGTH - 1;
+    voice->loopstart = loopstart;
+    voice->loopend = loopend;
+    voice->block_size = block_size;
+    voice->phase_incr = phase_incr;
+    voice->amp = 0.5;
+    voice->amp_incr = 3.3e-5;
+    fluid_phase_set_int(voice->phase, 0);
+}
+
+// renders FRAMES samples, returns the number of samples rendered before the end of the sample
+static int render(interpolate_func_t interpolate, fluid_rvoice_dsp_t *voice, int looping, fluid_real_t *buf)
+{
+    static fluid_real_t block[BLOCK_SIZE];
+    int n, count = 0;
+
+    while(count < FRAMES)
+    {
+        n = interpolate(voice, block, looping);
+        TEST_ASSERT(n >= 0 && n <= voice->block_size);
+
+        if(count + n > FRAMES)
+        {
+            n = FRAMES - count;
+        }
+
+        FLUID_MEMCPY(&buf[count], block, n * sizeof(*block));
+        count += n;
+
+        if(n < voice->block_size)
+        {
+            break;
+        }
+    }
+
+    return count;
+}
+
+// this test makes sure that the vectorized runs of the interpolators give the same
+// result as rendering one sample at a time, which leaves no room for them
+int main(void)
+{
+    static const interpolate_func_t interpolate[] =
+    {
+        fluid_rvoice_dsp_interpolate_none,
+        fluid_rvoice_dsp_interpolate_linear,
+        fluid_rvoice_dsp_interpolate_4th_order,
+        fluid_rvoice_dsp_interpolate_7th_order
+    };
+
+    // slow and fast playback, the fastest ones span more source samples than the scratch buffer
+    static const fluid_real_t phase_incrs[] = { 0.37, 1.0, 1.7, 3.3, 5.5 };
+
+    // long loops and loops shorter than a block, which wrap several times per block
+    static const int loops[][2] = { { 100, 1900 }, { 700, 709 }, { 1990, 2000 } };
+
+    static fluid_real_t block_buf[FRAMES], sample_buf[FRAMES];
+    fluid_sample_t sample;
+    fluid_rvoice_dsp_t block_voice, sample_voice;
+    unsigned int f, p, l;
+    int i, bits, looping;
+
+    fluid_rvoice_dsp_config();
+
+    for(i = 0; i < SAMPLE_LENGTH; i++)
+    {
+        sample_data[i] = (short)((i * 7919) % 65536 - 32768) / ((i % 5) + 1);
+        sample_data24[i] = (char)(i * 31);
+    }
+
+    FLUID_MEMSET(&sample, 0, sizeof(sample));
+    sample.data = sample_data;
+
+    for(bits = 16; bits <= 24; bits += 8)
+    {
+        sample.data24 = (bits == 24) ? sample_data24 : NULL;
+
+        for(f = 0; f < FLUID_N_ELEMENTS(interpolate); f++)
+        {
+            for(p = 0; p < FLUID_N_ELEMENTS(phase_incrs); p++)
+            {
+                for(l = 0; l < FLUID_N_ELEMENTS(loops); l++)
+                {
+                    for(looping = 0; looping <= 1; looping++)
+                    {
+                        int block_count, sample_count;
+
+                        init_voice(&block_voice, &sample, loops[l][0], loops[l][1], phase_incrs[p], BLOCK_SIZE);
+                        init_voice(&sample_voice, &sample, loops[l][0], loops[l][1], phase_incrs[p], 1);
+
+                        block_count = render(interpolate[f], &block_voice, looping, block_buf);
+                        sample_count = render(interpolate[f], &sample_voice, looping, sample_buf);
+
+                        TEST_ASSERT(block_count == sample_count);
+                        TEST_ASSERT(block_count == FRAMES || !looping);
+                        TEST_ASSERT(block_voice.has_looped == sample_voice.has_looped);
+                        TEST_ASSERT(block_voice.has_looped || !looping || phase_incrs[p] * FRAMES < loops[l][1]);
+
+                        for(i = 0; i < block_count; i++)
+                        {
+                            TEST_ASSERT(block_buf[i] == sample_buf[i]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
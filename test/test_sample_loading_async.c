@@ -0,0 +1,285 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "midi/fluid_midi.h"
+#include "synth/fluid_voice.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluidsynth_priv.h"
+
+// the Soundfont file can only be opened by other threads once the gate is open
+static fluid_atomic_int_t gate_open;
+static fluid_thread_id_t main_thread;
+
+static void *gated_open(const char *filename)
+{
+    if(fluid_thread_get_id() != main_thread)
+    {
+        while(!fluid_atomic_int_get(&gate_open))
+        {
+            fluid_msleep(1);
+        }
+    }
+
+    return fopen(filename, "rb");
+}
+
+static int gated_read(void *buf, int count, void *handle)
+{
+    return fread(buf, count, 1, handle) == 1 ? FLUID_OK : FLUID_FAILED;
+}
+
+static int gated_seek(void *handle, long offset, int origin)
+{
+    return fseek(handle, offset, origin) == 0 ? FLUID_OK : FLUID_FAILED;
+}
+
+static long gated_tell(void *handle)
+{
+    return ftell(handle);
+}
+
+static int gated_close(void *handle)
+{
+    return fclose(handle) == 0 ? FLUID_OK : FLUID_FAILED;
+}
+
+static void render_until_loaded(fluid_synth_t *synth, fluid_preset_t *preset)
+{
+    float buf[2 * 64];
+    int i;
+
+    for(i = 0; i < 10000 && fluid_preset_is_loading(preset); i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, 64, buf, 0, 2, buf, 1, 2));
+        fluid_msleep(1);
+    }
+
+    TEST_ASSERT(!fluid_preset_is_loading(preset));
+
+    // once more, to start the deferred notes
+    TEST_SUCCESS(fluid_synth_write_float(synth, 64, buf, 0, 2, buf, 1, 2));
+}
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings, const char *policy)
+{
+    fluid_synth_t *synth;
+    fluid_sfloader_t *loader;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.dynamic-sample-loading-policy", policy));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    loader = new_fluid_defsfloader(settings);
+    TEST_ASSERT(loader != NULL);
+    TEST_SUCCESS(fluid_sfloader_set_callbacks(loader, gated_open, gated_read, gated_seek, gated_tell, gated_close));
+    fluid_synth_add_sfloader(synth, loader);
+
+    // selects the first preset on all channels, which has to wait for the gate
+    fluid_atomic_int_set(&gate_open, FALSE);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    return synth;
+}
+
+// notes played while the samples are loading are started once they are there
+static void test_defer(fluid_settings_t *settings)
+{
+    fluid_voice_t *voices[16];
+    fluid_synth_t *synth = create_synth(settings, "defer");
+    fluid_preset_t *preset = fluid_synth_get_channel_preset(synth, 0);
+    int i, count;
+
+    TEST_ASSERT(preset != NULL);
+    TEST_ASSERT(fluid_preset_is_loading(preset));
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 62, 100));
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 62));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 64, 100));
+    TEST_SUCCESS(fluid_synth_all_notes_off(synth, 1));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    fluid_atomic_int_set(&gate_open, TRUE);
+    render_until_loaded(synth, preset);
+
+    // only the note which hasn't been released
+    count = fluid_synth_get_active_voice_count(synth);
+    TEST_ASSERT(count > 0);
+    fluid_synth_get_voicelist(synth, voices, 16, -1);
+
+    for(i = 0; i < count && i < 16; i++)
+    {
+        TEST_ASSERT(fluid_voice_get_channel(voices[i]) == 0);
+        TEST_ASSERT(fluid_voice_get_key(voices[i]) == 60);
+    }
+
+    delete_fluid_synth(synth);
+}
+
+// notes played while the samples are loading are ignored
+static void test_drop(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = create_synth(settings, "drop");
+    fluid_preset_t *preset = fluid_synth_get_channel_preset(synth, 0);
+
+    TEST_ASSERT(preset != NULL);
+    TEST_ASSERT(fluid_preset_is_loading(preset));
+
+    TEST_ASSERT(fluid_synth_noteon(synth, 0, 60, 100) == FLUID_FAILED);
+
+    // unselecting and selecting the preset again while loading doesn't load twice
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 1));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_ASSERT(fluid_preset_is_loading(preset));
+
+    fluid_atomic_int_set(&gate_open, TRUE);
+    render_until_loaded(synth, preset);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    delete_fluid_synth(synth);
+}
+
+// notes played while the samples are loading are dropped if the channel gets
+// another preset meanwhile, and the samples of the unselected preset are unloaded
+// by the loader thread
+static void test_preset_change(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = create_synth(settings, "defer");
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont(synth, 0));
+    fluid_preset_t *preset;
+    fluid_list_t *list;
+    int i, chan, pending;
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+
+    for(chan = 0; chan < fluid_synth_count_midi_channels(synth); chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, 1));
+    }
+
+    preset = fluid_synth_get_channel_preset(synth, 0);
+    TEST_ASSERT(preset != NULL);
+
+    fluid_atomic_int_set(&gate_open, TRUE);
+    render_until_loaded(synth, preset);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    // the samples of the first preset are unloaded in the background as well
+    for(i = 0, pending = TRUE; i < 10000 && pending; i++)
+    {
+        pending = FALSE;
+        TEST_ASSERT(!fluid_preset_is_loading(preset));
+
+        for(list = defsfont->sample; list; list = fluid_list_next(list))
+        {
+            fluid_sample_t *sample = fluid_list_get(list);
+
+            pending |= sample->loading || (sample->preset_count == 0 && sample->data != NULL);
+        }
+
+        fluid_msleep(1);
+    }
+
+    TEST_ASSERT(!pending);
+
+    delete_fluid_synth(synth);
+}
+
+typedef int (*voice_state_func_t)(const fluid_voice_t *voice);
+
+// counts the voices of a channel and key which are in the given state
+static int count_voices(fluid_synth_t *synth, int chan, int key, voice_state_func_t state)
+{
+    fluid_voice_t *voices[64];
+    int i, count = 0;
+
+    fluid_synth_get_voicelist(synth, voices, 64, -1);
+
+    for(i = 0; i < 64 && voices[i] != NULL; i++)
+    {
+        if(fluid_voice_get_channel(voices[i]) == chan && fluid_voice_get_key(voices[i]) == key && state(voices[i]))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static int is_released(const fluid_voice_t *voice)
+{
+    return voice->has_noteoff;
+}
+
+// notes played and released under the sustain or sostenuto pedal while the samples
+// are loading are held by the pedal once they are started, until it is released
+static void test_pedals(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = create_synth(settings, "defer");
+    fluid_preset_t *preset = fluid_synth_get_channel_preset(synth, 0);
+
+    TEST_ASSERT(preset != NULL);
+    TEST_ASSERT(fluid_preset_is_loading(preset));
+
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, SUSTAIN_SWITCH, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+
+    // the sostenuto pedal only holds the note played before it has been pressed
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 62, 100));
+    TEST_SUCCESS(fluid_synth_cc(synth, 1, SOSTENUTO_SWITCH, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 64, 100));
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 1, 62));
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 1, 64));
+
+    // a note whose pedal is released before the samples are there is gone
+    TEST_SUCCESS(fluid_synth_cc(synth, 2, SUSTAIN_SWITCH, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 2, 65, 100));
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 2, 65));
+    TEST_SUCCESS(fluid_synth_cc(synth, 2, SUSTAIN_SWITCH, 0));
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    fluid_atomic_int_set(&gate_open, TRUE);
+    render_until_loaded(synth, preset);
+
+    TEST_ASSERT(count_voices(synth, 0, 60, fluid_voice_is_sustained) > 0);
+    TEST_ASSERT(count_voices(synth, 1, 62, fluid_voice_is_sostenuto) > 0);
+    TEST_ASSERT(count_voices(synth, 1, 64, fluid_voice_is_playing) == 0);
+    TEST_ASSERT(count_voices(synth, 2, 65, fluid_voice_is_playing) == 0);
+    TEST_ASSERT(count_voices(synth, 0, 60, is_released) == 0);
+    TEST_ASSERT(count_voices(synth, 1, 62, is_released) == 0);
+
+    // releasing the pedals releases the notes
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, SUSTAIN_SWITCH, 0));
+    TEST_SUCCESS(fluid_synth_cc(synth, 1, SOSTENUTO_SWITCH, 0));
+    TEST_ASSERT(count_voices(synth, 0, 60, is_released) > 0);
+    TEST_ASSERT(count_voices(synth, 1, 62, is_released) > 0);
+
+    delete_fluid_synth(synth);
+}
+
+// this test makes sure that samples are loaded by a background thread with
+// synth.dynamic-sample-loading-policy defer and drop
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+
+    main_thread = fluid_thread_get_id();
+
+    test_defer(settings);
+    test_drop(settings);
+    test_preset_change(settings);
+    test_pedals(settings);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
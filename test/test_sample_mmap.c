@@ -0,0 +1,73 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "utils/fluidsynth_priv.h"
+
+enum { FRAMES = 1024 };
+
+static void render(fluid_synth_t *synth, float *buf)
+{
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 9, 38, 127));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+}
+
+// this test makes sure that memory mapped sample data sounds the same as sample data
+// that was read into memory, and that mappings shared by several synths stay valid
+// as long as they are used
+int main(void)
+{
+    int dynamic, i;
+    float buf_read[FRAMES * 2], buf_mmap[FRAMES * 2], buf_mmap2[FRAMES * 2];
+
+    for(dynamic = 0; dynamic <= 1; dynamic++)
+    {
+        fluid_synth_t *synth_read, *synth_mmap, *synth_mmap2;
+        fluid_settings_t *settings = new_fluid_settings();
+        TEST_ASSERT(settings != NULL);
+
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", dynamic));
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+
+        synth_read = new_fluid_synth(settings);
+        TEST_ASSERT(synth_read != NULL);
+        TEST_SUCCESS(fluid_synth_sfload(synth_read, TEST_SOUNDFONT, 1));
+
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.mmap-sample-data", 1));
+
+        synth_mmap = new_fluid_synth(settings);
+        synth_mmap2 = new_fluid_synth(settings);
+        TEST_ASSERT(synth_mmap != NULL);
+        TEST_ASSERT(synth_mmap2 != NULL);
+
+        // the read sample data is cached already, so unload it first to really get mapped data
+        delete_fluid_synth(synth_read);
+
+        TEST_SUCCESS(fluid_synth_sfload(synth_mmap, TEST_SOUNDFONT, 1));
+        TEST_SUCCESS(fluid_synth_sfload(synth_mmap2, TEST_SOUNDFONT, 1));
+
+        render(synth_mmap, buf_mmap);
+        render(synth_mmap2, buf_mmap2);
+
+        // delete one of the synths sharing the mapping and render again with the other one
+        delete_fluid_synth(synth_mmap);
+        TEST_SUCCESS(fluid_synth_write_float(synth_mmap2, FRAMES, buf_mmap2, 0, 2, buf_mmap2, 1, 2));
+        delete_fluid_synth(synth_mmap2);
+
+        // now compare against sample data that was read
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.mmap-sample-data", 0));
+        synth_read = new_fluid_synth(settings);
+        TEST_ASSERT(synth_read != NULL);
+        TEST_SUCCESS(fluid_synth_sfload(synth_read, TEST_SOUNDFONT, 1));
+        render(synth_read, buf_read);
+        delete_fluid_synth(synth_read);
+
+        for(i = 0; i < FRAMES * 2; i++)
+        {
+            TEST_ASSERT(buf_read[i] == buf_mmap[i]);
+        }
+
+        delete_fluid_settings(settings);
+    }
+
+    return EXIT_SUCCESS;
+}
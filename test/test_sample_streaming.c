@@ -0,0 +1,378 @@
+#include <string.h>
+
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "synth/fluid_synth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "rvoice/fluid_rvoice.h"
+#include "rvoice/fluid_sample_streamer.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluidsynth_priv.h"
+
+enum { FRAMES = FLUID_BUFSIZE, CALLS = 256 };
+enum { PRELOAD = 1000, STREAM_PRELOAD = 2048 };
+
+// unloop the instruments, so that the voices play on past the preloaded beginning of their samples
+static void unloop(fluid_synth_t *synth)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont(synth, 0));
+    fluid_list_t *list;
+
+    for(list = defsfont->preset; list; list = fluid_list_next(list))
+    {
+        fluid_preset_zone_t *preset_zone = fluid_defpreset_get_zone(fluid_preset_get_data(fluid_list_get(list)));
+
+        for(; preset_zone; preset_zone = fluid_preset_zone_next(preset_zone))
+        {
+            fluid_inst_t *inst = fluid_preset_zone_get_inst(preset_zone);
+            fluid_inst_zone_t *inst_zone;
+
+            if(inst->global_zone != NULL)
+            {
+                inst->global_zone->gen[GEN_SAMPLEMODE].val = FLUID_UNLOOPED;
+            }
+
+            for(inst_zone = inst->zone; inst_zone; inst_zone = inst_zone->next)
+            {
+                inst_zone->gen[GEN_SAMPLEMODE].val = FLUID_UNLOOPED;
+            }
+        }
+    }
+}
+
+static void render(fluid_synth_t *synth, float *buf)
+{
+    int i;
+
+    unloop(synth);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 9, 38, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 9, 42, 127));
+
+    // several rendering calls, so that the streamer sees the voices proceed
+    for(i = 0; i < CALLS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 2 * FRAMES * i, 2, buf, 2 * FRAMES * i + 1, 2));
+
+        // give the streaming thread the time to keep up
+        fluid_msleep(1);
+    }
+}
+
+// shorten the preloaded part of the streamed samples, which covers their loop
+static void shorten_preload(fluid_synth_t *synth)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont(synth, 0));
+    fluid_list_t *list;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+
+        if(sample->preload > STREAM_PRELOAD)
+        {
+            sample->preload = STREAM_PRELOAD;
+        }
+    }
+}
+
+static fluid_sample_t *get_longest_streamed_sample(fluid_synth_t *synth)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont(synth, 0));
+    fluid_sample_t *longest = NULL;
+    fluid_list_t *list;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+
+        if(sample->preload != 0 && (longest == NULL || sample->end > longest->end))
+        {
+            longest = sample;
+        }
+    }
+
+    TEST_ASSERT(longest != NULL);
+    return longest;
+}
+
+static void set_position(fluid_rvoice_t *rvoice, unsigned int index)
+{
+    fluid_phase_set_int(rvoice->dsp.phase, index);
+}
+
+static fluid_sample_stream_window_t *find_window(fluid_rvoice_t *rvoice, unsigned int start)
+{
+    int i;
+
+    for(i = 0; i < FLUID_SAMPLE_STREAM_WINDOWS; i++)
+    {
+        fluid_sample_stream_window_t *window = &rvoice->dsp.stream->window[i];
+
+        if(window->seq != 0 && window->start == start)
+        {
+            return window;
+        }
+    }
+
+    return NULL;
+}
+
+static void wait_ready(fluid_sample_streamer_t *streamer, fluid_rvoice_t **rvoices,
+                       fluid_sample_stream_window_t *window)
+{
+    int i;
+
+    for(i = 0; i < 1000 && !window->ready; i++)
+    {
+        fluid_msleep(1);
+        fluid_sample_streamer_update(streamer, rvoices, 1);
+    }
+
+    TEST_ASSERT(window->ready);
+}
+
+// the streamer copies the sample data ahead of the voices into their windows
+static void test_streamer(fluid_sample_t *streamed)
+{
+    fluid_sample_t sample = *streamed; // shares the sample data
+    fluid_rvoice_t rvoice;
+    fluid_rvoice_t *rvoices[1];
+    fluid_sample_stream_window_t *window;
+    short *data;
+    char *data24;
+    unsigned int start, end, lo;
+    fluid_sample_streamer_t *streamer = new_fluid_sample_streamer(4); // room for the requests in flight
+
+    TEST_ASSERT(streamer != NULL);
+    TEST_ASSERT(sample.end + 1 >= 4 * PRELOAD);
+    sample.preload = PRELOAD;
+
+    FLUID_MEMSET(&rvoice, 0, sizeof(rvoice));
+    rvoice.dsp.sample = &sample;
+    rvoice.dsp.samplemode = FLUID_UNLOOPED;
+    rvoice.dsp.end = sample.end;
+    rvoice.dsp.phase_incr = 1;
+    rvoice.dsp.block_size = FLUID_BUFSIZE;
+    rvoices[0] = &rvoice;
+
+    // within the preloaded part, the voice reads the sample data itself
+    set_position(&rvoice, 10);
+    TEST_ASSERT(fluid_sample_stream_get_data(&rvoice.dsp, FALSE, &data, &data24, &start, &end));
+    TEST_ASSERT(data == sample.data);
+    TEST_ASSERT(start == 0 && end == PRELOAD);
+
+    // the first window overlaps the end of the preloaded part by a quarter
+    fluid_sample_streamer_update(streamer, rvoices, 1);
+    TEST_ASSERT(rvoice.dsp.stream != NULL);
+    window = find_window(&rvoice, PRELOAD - PRELOAD / 4);
+    TEST_ASSERT(window != NULL);
+    TEST_ASSERT(window->count == PRELOAD);
+
+    // and so does the second one the end of the first one
+    fluid_sample_streamer_update(streamer, rvoices, 1);
+    TEST_ASSERT(find_window(&rvoice, 2 * PRELOAD - 2 * PRELOAD / 4) != NULL);
+
+    // close to the end of the preloaded part, the voice reads the first window once it has arrived
+    set_position(&rvoice, PRELOAD - 10);
+    wait_ready(streamer, rvoices, window);
+    TEST_ASSERT(fluid_sample_stream_get_data(&rvoice.dsp, FALSE, &data, &data24, &start, &end));
+    TEST_ASSERT(data == window->data);
+    TEST_ASSERT(start == window->start && end == window->start + window->count);
+    TEST_ASSERT(memcmp(data, &sample.data[start], window->count * sizeof(short)) == 0);
+
+    // once the voice has left the first window behind, it is reused for the part after the second
+    set_position(&rvoice, 2 * PRELOAD - PRELOAD / 4 + FLUID_SAMPLE_STREAM_MARGIN);
+    fluid_sample_streamer_update(streamer, rvoices, 1);
+    TEST_ASSERT(find_window(&rvoice, 3 * PRELOAD - 3 * PRELOAD / 4) != NULL);
+
+    // a voice which got ahead of its windows has no sample data to read
+    set_position(&rvoice, 3 * PRELOAD + PRELOAD / 2);
+    TEST_ASSERT(!fluid_sample_stream_get_data(&rvoice.dsp, FALSE, &data, &data24, &start, &end));
+
+    // and gets a window right where it is
+    fluid_sample_streamer_update(streamer, rvoices, 1);
+    lo = 3 * PRELOAD + PRELOAD / 2 - FLUID_SAMPLE_STREAM_MARGIN;
+    window = find_window(&rvoice, lo);
+    TEST_ASSERT(window != NULL);
+
+    // a loop behind the preloaded part is held by a single window
+    rvoice.dsp.samplemode = FLUID_LOOP_DURING_RELEASE;
+    rvoice.dsp.loopstart = 2 * PRELOAD;
+    rvoice.dsp.loopend = 2 * PRELOAD + 300;
+    set_position(&rvoice, 2 * PRELOAD + 100);
+    fluid_sample_streamer_update(streamer, rvoices, 1);
+    window = find_window(&rvoice, 2 * PRELOAD - FLUID_SAMPLE_STREAM_MARGIN);
+    TEST_ASSERT(window != NULL);
+    TEST_ASSERT(window->count == PRELOAD);
+
+    wait_ready(streamer, rvoices, window);
+    TEST_ASSERT(fluid_sample_stream_get_data(&rvoice.dsp, TRUE, &data, &data24, &start, &end));
+    TEST_ASSERT(data == window->data);
+
+    // a finished voice passes on its underruns and gives up its stream
+    rvoice.dsp.stream_underruns = 2;
+    fluid_sample_streamer_release(streamer, &rvoice);
+    TEST_ASSERT(rvoice.dsp.stream == NULL);
+    TEST_ASSERT(fluid_sample_streamer_get_underruns(streamer) == 2);
+
+    // a loop too long for a single window is not streamed
+    rvoice.dsp.loopend = 2 * PRELOAD + 3 * PRELOAD;
+    fluid_sample_streamer_update(streamer, rvoices, 1);
+    TEST_ASSERT(rvoice.dsp.stream != NULL);
+    TEST_ASSERT(rvoice.dsp.stream->window[0].seq == 0);
+    TEST_ASSERT(rvoice.dsp.stream->window[1].seq == 0);
+
+    delete_fluid_sample_streamer(streamer);
+}
+
+// a voice starting behind the preloaded part is silent until its sample data has arrived
+static void test_underrun(fluid_settings_t *settings)
+{
+    static float buf[2 * FLUID_BUFSIZE];
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    int i, k, loud = 0;
+
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    shorten_preload(synth);
+
+    unloop(synth);
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 9, GEN_STARTADDROFS, STREAM_PRELOAD + 1000));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 9, 42, 127));
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+
+    for(k = 0; k < 2 * FLUID_BUFSIZE; k++)
+    {
+        TEST_ASSERT(buf[k] == 0.0f);
+    }
+
+    TEST_ASSERT(fluid_synth_get_stream_underruns(synth) > 0);
+
+    for(i = 0; i < 1000 && !loud; i++)
+    {
+        fluid_msleep(1);
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+
+        for(k = 0; k < 2 * FLUID_BUFSIZE; k++)
+        {
+            loud |= (buf[k] != 0.0f);
+        }
+    }
+
+    TEST_ASSERT(loud);
+
+    delete_fluid_synth(synth);
+}
+
+// streamed samples keep only their beginning and their loop in memory
+static void check_preload(fluid_synth_t *synth, int preload_ms)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont(synth, 0));
+    fluid_list_t *list;
+    int streamed = 0;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+        unsigned int preload = preload_ms * sample->samplerate / 1000 + 1;
+
+        if(sample->data == NULL)
+        {
+            continue;
+        }
+
+        if(sample->loopend + FLUID_SAMPLE_STREAM_MARGIN + 1 > preload)
+        {
+            preload = sample->loopend + FLUID_SAMPLE_STREAM_MARGIN + 1;
+        }
+
+        if(sample->end + 1 > preload)
+        {
+            TEST_ASSERT(sample->preload == preload);
+            streamed++;
+        }
+        else
+        {
+            TEST_ASSERT(sample->preload == 0);
+        }
+    }
+
+    TEST_ASSERT(streamed > 0);
+}
+
+// this test makes sure that streamed sample data sounds the same as sample data
+// that was read into memory
+int main(void)
+{
+    int dynamic, i, loud;
+    static float buf_read[FRAMES * CALLS * 2], buf_stream[FRAMES * CALLS * 2];
+
+    for(dynamic = 0; dynamic <= 1; dynamic++)
+    {
+        fluid_synth_t *synth_read, *synth_stream;
+        fluid_settings_t *settings = new_fluid_settings();
+        TEST_ASSERT(settings != NULL);
+        loud = 0;
+
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+
+        // nothing but the voices, so that silence is silent
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+        // individually loaded like streamed samples, which play on into the zero words after them when unlooped
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+
+        synth_read = new_fluid_synth(settings);
+        TEST_ASSERT(synth_read != NULL);
+        TEST_SUCCESS(fluid_synth_sfload(synth_read, TEST_SOUNDFONT, 1));
+        render(synth_read, buf_read);
+        TEST_ASSERT(fluid_synth_get_stream_underruns(synth_read) == 0);
+
+        // the read sample data is cached already, so unload it first to really get mapped data
+        delete_fluid_synth(synth_read);
+
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", dynamic));
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-streaming", 1));
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-streaming-preload", 10));
+
+        synth_stream = new_fluid_synth(settings);
+        TEST_ASSERT(synth_stream != NULL);
+        TEST_SUCCESS(fluid_synth_sfload(synth_stream, TEST_SOUNDFONT, 1));
+        check_preload(synth_stream, 10);
+
+        if(!dynamic)
+        {
+            test_streamer(get_longest_streamed_sample(synth_stream));
+        }
+
+        shorten_preload(synth_stream);
+        render(synth_stream, buf_stream);
+        TEST_ASSERT(fluid_synth_get_stream_underruns(synth_stream) == 0);
+
+        // unloading releases the individually loaded samples
+        TEST_SUCCESS(fluid_synth_sfunload(synth_stream, 1, 1));
+        delete_fluid_synth(synth_stream);
+
+        for(i = 0; i < FRAMES * CALLS * 2; i++)
+        {
+            TEST_ASSERT(buf_read[i] == buf_stream[i]);
+            loud |= (buf_read[i] != 0.0f);
+        }
+
+        TEST_ASSERT(loud);
+
+        if(dynamic)
+        {
+            test_underrun(settings);
+        }
+
+        delete_fluid_settings(settings);
+    }
+
+    return EXIT_SUCCESS;
+}
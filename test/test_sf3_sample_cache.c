@@ -0,0 +1,82 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluidsynth_priv.h"
+
+enum { FRAMES = 1024, BLOCKS = 8 };
+
+#define SAMPLE_CACHE_DIR "sf3_sample_cache"
+
+// renders a few notes with the decoded sample data, which is either in memory
+// or mapped from the on-disk cache
+static void render(const char *cache_dir, int mapped, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_defsfont_t *defsfont;
+    fluid_list_t *list;
+    int i, loaded = 0;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.sample-cache-dir", cache_dir));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT_SF3, 1));
+
+    defsfont = fluid_sfont_get_data(fluid_synth_get_sfont(synth, 0));
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+
+        if(sample->data != NULL)
+        {
+            TEST_ASSERT(fluid_samplecache_is_mapped(sample->data) == mapped);
+            loaded++;
+        }
+    }
+
+    TEST_ASSERT(loaded > 0);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 67, 127));
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 2 * FRAMES * i, 2, buf, 2 * FRAMES * i + 1, 2));
+    }
+
+    // deleting the synth releases the sample data, so that the next one loads it again
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+// this test makes sure that decoded SF3 samples stored in synth.sample-cache-dir
+// sound the same as samples decoded into memory
+int main(void)
+{
+    int i, loud = 0;
+    static float buf_decoded[FRAMES * BLOCKS * 2], buf_stored[FRAMES * BLOCKS * 2], buf_cached[FRAMES * BLOCKS * 2];
+
+    render("", FALSE, buf_decoded);
+
+    // decodes and stores the samples, unless a previous run did already
+    render(SAMPLE_CACHE_DIR, TRUE, buf_stored);
+
+    // maps the stored samples
+    render(SAMPLE_CACHE_DIR, TRUE, buf_cached);
+
+    for(i = 0; i < FRAMES * BLOCKS * 2; i++)
+    {
+        TEST_ASSERT(buf_decoded[i] == buf_stored[i]);
+        TEST_ASSERT(buf_decoded[i] == buf_cached[i]);
+        loud |= (buf_decoded[i] != 0.0f);
+    }
+
+    TEST_ASSERT(loud);
+
+    return EXIT_SUCCESS;
+}
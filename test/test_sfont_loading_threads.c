@@ -0,0 +1,113 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluidsynth_priv.h"
+
+static fluid_list_t *get_samples(fluid_synth_t *synth)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont(synth, 0));
+
+    return defsfont->sample;
+}
+
+static fluid_synth_t *load(fluid_settings_t *settings, const char *filename, int threads)
+{
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-loading-threads", threads));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, filename, 1));
+
+    return synth;
+}
+
+// the samples loaded by several threads are the same as the ones loaded by a single thread
+static void compare(const char *filename, int stream)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_list_t *list;
+    fluid_sample_t *samples;
+    short **data;
+    int i, count, loaded = 0;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-streaming", stream));
+
+    // keep a copy of the samples loaded by several threads, the synth has to be
+    // deleted to really load them again
+    synth = load(settings, filename, 4);
+    count = fluid_list_size(get_samples(synth));
+    samples = FLUID_ARRAY(fluid_sample_t, count);
+    data = FLUID_ARRAY(short *, count);
+    TEST_ASSERT(samples != NULL && data != NULL);
+
+    for(list = get_samples(synth), i = 0; list; list = fluid_list_next(list), i++)
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+
+        samples[i] = *sample;
+        data[i] = NULL;
+
+        if(sample->data != NULL && sample->start != sample->end)
+        {
+            unsigned int size = (sample->end - sample->start + 1) * sizeof(short);
+
+            data[i] = FLUID_MALLOC(size);
+            TEST_ASSERT(data[i] != NULL);
+            FLUID_MEMCPY(data[i], sample->data + sample->start, size);
+        }
+    }
+
+    delete_fluid_synth(synth);
+
+    synth = load(settings, filename, 1);
+    TEST_ASSERT(fluid_list_size(get_samples(synth)) == count);
+
+    for(list = get_samples(synth), i = 0; list; list = fluid_list_next(list), i++)
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+
+        TEST_ASSERT(FLUID_STRCMP(sample->name, samples[i].name) == 0);
+        TEST_ASSERT(sample->start == samples[i].start);
+        TEST_ASSERT(sample->end == samples[i].end);
+        TEST_ASSERT(sample->loopstart == samples[i].loopstart);
+        TEST_ASSERT(sample->loopend == samples[i].loopend);
+        TEST_ASSERT(sample->preload == samples[i].preload);
+        TEST_ASSERT(sample->amplitude_that_reaches_noise_floor_is_valid == samples[i].amplitude_that_reaches_noise_floor_is_valid);
+        TEST_ASSERT(sample->amplitude_that_reaches_noise_floor == samples[i].amplitude_that_reaches_noise_floor);
+        TEST_ASSERT((sample->data == NULL) == (samples[i].data == NULL));
+
+        if(data[i] != NULL)
+        {
+            TEST_ASSERT(FLUID_MEMCMP(sample->data + sample->start, data[i],
+                                     (sample->end - sample->start + 1) * sizeof(short)) == 0);
+            FLUID_FREE(data[i]);
+            loaded++;
+        }
+    }
+
+    TEST_ASSERT(loaded > 0);
+
+    FLUID_FREE(data);
+    FLUID_FREE(samples);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+// this test makes sure that loading the samples with synth.sample-loading-threads
+// gives the same result as loading them in a single thread
+int main(void)
+{
+    compare(TEST_SOUNDFONT, FALSE);
+    compare(TEST_SOUNDFONT, TRUE);
+
+#if LIBSNDFILE_HASVORBIS
+    compare(TEST_SOUNDFONT_SF3, FALSE);
+#endif
+
+    return EXIT_SUCCESS;
+}
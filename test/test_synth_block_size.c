@@ -0,0 +1,74 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "rvoice/fluid_rvoice.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluidsynth_priv.h"
+
+// not a multiple of any block size, so that the last block is only partially consumed
+#define FRAMES (3 * FLUID_BUFSIZE_MAX + 17)
+
+static float left[FRAMES], right[FRAMES];
+
+static void render_with_block_size(int requested, int expected)
+{
+    int i, block_size, loud = 0;
+    int ticks;
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.block-size", requested));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    // invalid sizes are corrected, and the correction is visible in the settings
+    TEST_SUCCESS(fluid_settings_getint(settings, "synth.block-size", &block_size));
+    TEST_ASSERT(block_size == expected);
+    TEST_ASSERT(fluid_synth_get_internal_bufsize(synth) == expected);
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        TEST_ASSERT(synth->voice[i]->block_size == expected);
+        TEST_ASSERT(synth->voice[i]->rvoice->dsp.block_size == expected);
+        TEST_ASSERT(synth->voice[i]->overflow_rvoice->dsp.block_size == expected);
+    }
+
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(left[i] == left[i] && right[i] == right[i]);
+        loud |= (left[i] != 0.0f);
+    }
+
+    TEST_ASSERT(loud);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    // the synth runs a whole number of blocks ahead of the frames written
+    ticks = fluid_atomic_int_get(&synth->ticks_since_start);
+    TEST_ASSERT(ticks == (FRAMES + expected - 1) / expected * expected);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+// this test makes sure that the synth renders correctly with any supported synth.block-size
+int main(void)
+{
+    render_with_block_size(FLUID_BUFSIZE, FLUID_BUFSIZE);
+    render_with_block_size(FLUID_BUFSIZE_MIN, FLUID_BUFSIZE_MIN);
+    render_with_block_size(256, 256);
+    render_with_block_size(FLUID_BUFSIZE_MAX, FLUID_BUFSIZE_MAX);
+
+    // not a power of two
+    render_with_block_size(100, 64);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluidsynth_priv.h"
+
+#define PRODUCERS 3
+#define MESSAGES 5000
+
+static fluid_synth_t *synth;
+
+// sends more messages than a queue can hold, ending with a well known controller value
+static fluid_thread_return_t producer(void *data)
+{
+    int i, chan = FLUID_POINTER_TO_INT(data);
+
+    for(i = 0; i < MESSAGES; i++)
+    {
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 7, i % 128));
+        TEST_SUCCESS(fluid_synth_pitch_bend(synth, chan, i % 16384));
+    }
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, chan, 60, 100));
+    TEST_SUCCESS(fluid_synth_cc(synth, chan, 7, chan));
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+// this test makes sure that MIDI messages queued by synth.lock-free-events are processed in order
+int main(void)
+{
+    int i, val;
+    float buf[2 * FLUID_BUFSIZE];
+    fluid_thread_t *threads[PRODUCERS];
+    fluid_settings_t *settings = new_fluid_settings();
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-free-events", 1));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(synth->event_queues != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    // a message queued by this thread takes effect before any later API call of it
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 10, 33));
+    TEST_ASSERT(synth->event_queues[0].owner == fluid_thread_get_id());
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 0, 10, &val));
+    TEST_ASSERT(val == 33);
+
+    // invalid messages are still rejected right away
+    TEST_ASSERT(fluid_synth_noteon(synth, 0, 128, 100) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_noteon(synth, synth->midi_channels, 60, 100) == FLUID_FAILED);
+
+    for(i = 0; i < PRODUCERS; i++)
+    {
+        threads[i] = new_fluid_thread("producer", producer, FLUID_INT_TO_POINTER(i + 1), 0, FALSE);
+        TEST_ASSERT(threads[i] != NULL);
+    }
+
+    // render concurrently, which processes the queues
+    for(i = 0; i < 200; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+    }
+
+    for(i = 0; i < PRODUCERS; i++)
+    {
+        TEST_SUCCESS(fluid_thread_join(threads[i]));
+        delete_fluid_thread(threads[i]);
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+
+    for(i = 1; i <= PRODUCERS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_get_cc(synth, i, 7, &val));
+        TEST_ASSERT(val == i);
+        TEST_SUCCESS(fluid_synth_get_pitch_bend(synth, i, &val));
+        TEST_ASSERT(val == (MESSAGES - 1) % 16384);
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluidsynth_priv.h"
+
+static int get_sfont_id(fluid_synth_t *synth, int chan)
+{
+    fluid_preset_t *preset = fluid_synth_get_channel_preset(synth, chan);
+    return (preset == NULL) ? FLUID_FAILED : fluid_sfont_get_id(fluid_preset_get_sfont(preset));
+}
+
+// a custom SoundFont whose only preset comes and goes without the synth knowing
+static fluid_preset_t *custom_preset;
+static int custom_has_preset;
+
+static const char *custom_get_name(fluid_sfont_t *sfont)
+{
+    return "custom";
+}
+
+static fluid_preset_t *custom_get_preset(fluid_sfont_t *sfont, int bank, int prenum)
+{
+    return (custom_has_preset && bank == 0 && prenum == 0) ? custom_preset : NULL;
+}
+
+static const char *custom_preset_get_name(fluid_preset_t *preset)
+{
+    return "custom";
+}
+
+static int custom_preset_get_zero(fluid_preset_t *preset)
+{
+    return 0;
+}
+
+static int custom_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int chan, int key, int vel)
+{
+    return FLUID_OK;
+}
+
+// both are deleted by the test itself
+static int custom_free(fluid_sfont_t *sfont)
+{
+    return 0;
+}
+
+static void custom_preset_free(fluid_preset_t *preset)
+{
+}
+
+// this test makes sure that preset lookups by program change follow changes of the SoundFont stack
+int main(void)
+{
+    int id1, id2;
+    fluid_sfont_t *custom_sfont;
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_SUCCESS(id1 = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_ASSERT(get_sfont_id(synth, 0) == id1);
+
+    // a custom SoundFont on top of the stack which gets a preset later on isn't shadowed
+    custom_sfont = new_fluid_sfont(custom_get_name, custom_get_preset, NULL, NULL, custom_free);
+    TEST_ASSERT(custom_sfont != NULL);
+    custom_preset = new_fluid_preset(custom_sfont, custom_preset_get_name, custom_preset_get_zero,
+                                     custom_preset_get_zero, custom_preset_noteon, custom_preset_free);
+    TEST_ASSERT(custom_preset != NULL);
+    TEST_SUCCESS(fluid_synth_add_sfont(synth, custom_sfont));
+
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_ASSERT(get_sfont_id(synth, 0) == id1);
+
+    custom_has_preset = TRUE;
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_ASSERT(fluid_synth_get_channel_preset(synth, 0) == custom_preset);
+
+    // nor is its preset returned once it is gone
+    custom_has_preset = FALSE;
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_ASSERT(get_sfont_id(synth, 0) == id1);
+
+    fluid_synth_remove_sfont(synth, custom_sfont);
+    delete_fluid_preset(custom_preset);
+    delete_fluid_sfont(custom_sfont);
+
+    // the SoundFont loaded last takes precedence
+    TEST_SUCCESS(id2 = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_ASSERT(get_sfont_id(synth, 0) == id2);
+
+    // unless its presets are moved to another bank
+    TEST_SUCCESS(fluid_synth_set_bank_offset(synth, id2, 1));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_ASSERT(get_sfont_id(synth, 0) == id1);
+
+    TEST_SUCCESS(fluid_synth_bank_select(synth, 0, 1));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_ASSERT(get_sfont_id(synth, 0) == id2);
+
+    // looking up a preset of an unloaded SoundFont must not return a stale one
+    TEST_SUCCESS(fluid_synth_sfunload(synth, id2, 0));
+    TEST_SUCCESS(fluid_synth_bank_select(synth, 0, 0));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_ASSERT(get_sfont_id(synth, 0) == id1);
+
+    TEST_SUCCESS(fluid_synth_sfunload(synth, id1, 0));
+    fluid_synth_program_change(synth, 0, 0);
+    TEST_ASSERT(fluid_synth_get_channel_preset(synth, 0) == NULL);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluidsynth_priv.h"
+
+#define SAMPLE_RATE 44100
+// whole blocks, so that both synths are at the same position within a block later on
+#define NOTE_FRAMES (700 * FLUID_BUFSIZE)
+// long enough for the reverb tail of the default room size to die away
+#define IDLE_FRAMES (7000 * FLUID_BUFSIZE)
+// not a multiple of the block size, so that the note starts within a block
+#define OFFSET 17
+#define FRAMES (8 * FLUID_BUFSIZE)
+
+static float left[IDLE_FRAMES], right[IDLE_FRAMES];
+static float left_fresh[FRAMES], right_fresh[FRAMES];
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    return synth;
+}
+
+// this test makes sure that idle effects units are skipped and resume properly on new input
+int main(void)
+{
+    int i, loud = 0;
+    fluid_synth_t *synth, *fresh;
+    fluid_settings_t *settings = new_fluid_settings();
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", SAMPLE_RATE));
+    // the phase of the chorus keeps running while it's skipped, only compare the reverb
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = create_synth(settings);
+    fresh = create_synth(settings);
+
+    // play a note and let both the note and the reverb tail die away
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_write_float(synth, NOTE_FRAMES, left, 0, 1, right, 0, 1));
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+    TEST_SUCCESS(fluid_synth_write_float(synth, IDLE_FRAMES, left, 0, 1, right, 0, 1));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    for(i = 0; i < NOTE_FRAMES; i++)
+    {
+        loud |= (left[i] != 0.0f || right[i] != 0.0f);
+    }
+
+    // the reverb has still been running at the beginning
+    TEST_ASSERT(loud);
+
+    // the skipped reverb leaves true silence behind
+    for(i = IDLE_FRAMES - SAMPLE_RATE; i < IDLE_FRAMES; i++)
+    {
+        TEST_ASSERT(left[i] == 0.0f && right[i] == 0.0f);
+    }
+
+    // a new note sounds just like on a synth which has never been used
+    TEST_SUCCESS(fluid_synth_write_float(synth, OFFSET, left, 0, 1, right, 0, 1));
+    TEST_SUCCESS(fluid_synth_write_float(fresh, OFFSET, left_fresh, 0, 1, right_fresh, 0, 1));
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(fresh, 0, 60, 127));
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+    TEST_SUCCESS(fluid_synth_write_float(fresh, FRAMES, left_fresh, 0, 1, right_fresh, 0, 1));
+
+    loud = 0;
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(fabs(left[i] - left_fresh[i]) < 1e-6 && fabs(right[i] - right_fresh[i]) < 1e-6);
+        loud |= (left[i] != 0.0f);
+    }
+
+    TEST_ASSERT(loud);
+
+    delete_fluid_synth(fresh);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
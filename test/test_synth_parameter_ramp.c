@@ -0,0 +1,129 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "utils/fluidsynth_priv.h"
+
+enum { BLOCK_SIZE = 64, RAMP = 200, FRAMES = 16 * BLOCK_SIZE, CHANGE = 8 * BLOCK_SIZE };
+
+// longer than the whole filter envelope, which must not be smeared by it
+enum { FILTER_RAMP = 4000, FILTER_FRAMES = 128 * BLOCK_SIZE, FILTER_CHANGE = 64 * BLOCK_SIZE };
+
+// renders a note which gets much quieter in the middle
+static void render(int ramp, float *left, float *right)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.block-size", BLOCK_SIZE));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.parameter-ramp", ramp));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_write_float(synth, CHANGE, left, 0, 1, right, 0, 1));
+    fluid_synth_set_gain(synth, 0.02f);
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES - CHANGE, left, CHANGE, 1, right, CHANGE, 1));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+// renders a note whose cutoff follows a fast modulation envelope, and gets
+// lowered in the middle
+static void render_filter(int ramp, float *out)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.block-size", BLOCK_SIZE));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.parameter-ramp", ramp));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    // the envelope opens the lowered filter at once, and closes it within a few thousand samples
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_FILTERFC, -8000));
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_FILTERQ, 100));
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_MODENVTOFILTERFC, 6000));
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_MODENVDECAY, 9000));
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_MODENVSUSTAIN, 1000));
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FILTER_CHANGE, out, 0, 1, out, 0, 1));
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_FILTERFC, -9000));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FILTER_FRAMES - FILTER_CHANGE, out, FILTER_CHANGE, 1, out, FILTER_CHANGE, 1));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+// the cutoff follows the modulation envelope within a block, whatever the ramp,
+// and only a change of the cutoff itself glides
+static void test_filter(void)
+{
+    static float out_step[FILTER_FRAMES], out_ramp[FILTER_FRAMES];
+    int i, gliding = 0;
+
+    render_filter(0, out_step);
+    render_filter(FILTER_RAMP, out_ramp);
+
+    for(i = 0; i < FILTER_CHANGE; i++)
+    {
+        TEST_ASSERT(out_step[i] == out_ramp[i]);
+    }
+
+    for(i = FILTER_CHANGE; i < FILTER_FRAMES; i++)
+    {
+        gliding |= (out_step[i] != out_ramp[i]);
+    }
+
+    TEST_ASSERT(gliding);
+}
+
+// this test makes sure that with synth.parameter-ramp the output amps of a voice
+// glide to a new value over the given number of samples, instead of jumping at the
+// next block, and so does the filter cutoff
+int main(void)
+{
+    static float left_step[FRAMES], right_step[FRAMES], left_ramp[FRAMES], right_ramp[FRAMES];
+    int i, gliding = 0;
+
+    test_filter();
+
+    render(0, left_step, right_step);
+    render(RAMP, left_ramp, right_ramp);
+
+    // the note sets in the same, before the change
+    for(i = 0; i < CHANGE; i++)
+    {
+        TEST_ASSERT(left_step[i] == left_ramp[i]);
+        TEST_ASSERT(right_step[i] == right_ramp[i]);
+    }
+
+    // with ramp the voice fades, instead of getting quiet right away
+    for(i = CHANGE; i < CHANGE + RAMP; i++)
+    {
+        gliding |= (left_ramp[i] != left_step[i]);
+        TEST_ASSERT(fabs(left_ramp[i]) >= fabs(left_step[i]));
+        TEST_ASSERT(fabs(right_ramp[i]) >= fabs(right_step[i]));
+    }
+
+    TEST_ASSERT(gliding);
+
+    // and once the ramp is done, it sounds the same
+    for(i = CHANGE + RAMP; i < FRAMES; i++)
+    {
+        TEST_ASSERT(left_step[i] == left_ramp[i]);
+        TEST_ASSERT(right_step[i] == right_ramp[i]);
+    }
+
+    return EXIT_SUCCESS;
+}
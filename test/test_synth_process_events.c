@@ -0,0 +1,99 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "utils/fluidsynth_priv.h"
+
+enum { FRAMES = 1024 };
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    return synth;
+}
+
+static int first_sound(const float *left, const float *right, int len)
+{
+    int i;
+
+    for(i = 0; i < len; i++)
+    {
+        if(left[i] != 0.0f || right[i] != 0.0f)
+        {
+            return i;
+        }
+    }
+
+    return len;
+}
+
+// renders a note-on at the given frame, after rendering skip frames, and returns
+// the frame the note sets in at
+static int render_noteon(fluid_settings_t *settings, int skip, int frame)
+{
+    static float left[FRAMES], right[FRAMES];
+    float *out[2];
+    fluid_midi_event_t *event = new_fluid_midi_event();
+    fluid_synth_t *synth = create_synth(settings);
+    int onset;
+
+    TEST_ASSERT(event != NULL);
+    fluid_midi_event_set_type(event, 0x90);
+    fluid_midi_event_set_channel(event, 0);
+    fluid_midi_event_set_key(event, 60);
+    fluid_midi_event_set_velocity(event, 127);
+
+    out[0] = left;
+    out[1] = right;
+
+    if(skip > 0)
+    {
+        TEST_SUCCESS(fluid_synth_process_events(synth, skip, 0, NULL, NULL, 0, NULL, 2, out));
+    }
+
+    FLUID_MEMSET(left, 0, sizeof(left));
+    FLUID_MEMSET(right, 0, sizeof(right));
+    TEST_SUCCESS(fluid_synth_process_events(synth, FRAMES, 1, &event, &frame, 0, NULL, 2, out));
+    onset = first_sound(left, right, FRAMES);
+    TEST_ASSERT(onset < FRAMES);
+
+    delete_fluid_midi_event(event);
+    delete_fluid_synth(synth);
+
+    return onset;
+}
+
+// this test makes sure that notes passed to fluid_synth_process_events() set
+// in at their frame rather than at the start of a block
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    int i, latency;
+    static const int frames[] = { 1, 37, 63, 64, 101, 300, 777 };
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    // the sample may start quietly, so the onset is only known relative to a
+    // note at the start of a block
+    latency = render_noteon(settings, 0, 0);
+    TEST_ASSERT(latency < 16);
+
+    for(i = 0; i < (int)(sizeof(frames) / sizeof(frames[0])); i++)
+    {
+        TEST_ASSERT(render_noteon(settings, 0, frames[i]) == frames[i] + latency);
+
+        // frames left over from a previous call don't change the timing
+        TEST_ASSERT(render_noteon(settings, 100, frames[i] + 28) == frames[i] + 28 + latency);
+    }
+
+    // a note at frames which were rendered already sets in with the next block
+    TEST_ASSERT(render_noteon(settings, 100, 10) == 28 + latency);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "synth/fluid_synth.h"
+#include "utils/fluidsynth_priv.h"
+
+// more than the dither table, so that it wraps around
+enum { FRAMES = 50000 };
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    // loud enough to clip
+    fluid_synth_set_gain(synth, 10.0f);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 64, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 67, 127));
+
+    return synth;
+}
+
+// this test makes sure that the dithered 16 bit output of fluid_synth_write_s16()
+// and fluid_synth_dither_s16() doesn't depend on how the frames are split up and
+// laid out
+int main(void)
+{
+    static short interleaved[2 * FRAMES], left[FRAMES], right[FRAMES];
+    static float left_float[FRAMES], right_float[FRAMES];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int i, n, dither_index, clipped = 0;
+
+    TEST_ASSERT(settings != NULL);
+
+    // interleaved, in chunks which aren't a multiple of the block size
+    synth = create_synth(settings);
+
+    for(i = 0; i < FRAMES; i += n)
+    {
+        n = (FRAMES - i < 1000) ? FRAMES - i : 1000;
+        TEST_SUCCESS(fluid_synth_write_s16(synth, n, interleaved, 2 * i, 2, interleaved, 2 * i + 1, 2));
+    }
+
+    delete_fluid_synth(synth);
+
+    // planar, in different chunks
+    synth = create_synth(settings);
+
+    for(i = 0; i < FRAMES; i += n)
+    {
+        n = (FRAMES - i < 777) ? FRAMES - i : 777;
+        TEST_SUCCESS(fluid_synth_write_s16(synth, n, left, i, 1, right, i, 1));
+    }
+
+    delete_fluid_synth(synth);
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(interleaved[2 * i] == left[i]);
+        TEST_ASSERT(interleaved[2 * i + 1] == right[i]);
+        clipped |= (left[i] == 32767 || left[i] == -32768);
+    }
+
+    TEST_ASSERT(clipped);
+
+    // the same for fluid_synth_dither_s16(), whose single precision input
+    // may round differently in a few places
+    synth = create_synth(settings);
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left_float, 0, 1, right_float, 0, 1));
+    delete_fluid_synth(synth);
+
+    dither_index = 0;
+    fluid_synth_dither_s16(&dither_index, FRAMES, left_float, right_float, interleaved, 0, 2, interleaved, 1, 2);
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(interleaved[2 * i] - left[i] <= 1 && interleaved[2 * i] - left[i] >= -1);
+        TEST_ASSERT(interleaved[2 * i + 1] - right[i] <= 1 && interleaved[2 * i + 1] - right[i] >= -1);
+    }
+
+    dither_index = 0;
+
+    for(i = 0; i < FRAMES; i += n)
+    {
+        n = (FRAMES - i < 4093) ? FRAMES - i : 4093;
+        fluid_synth_dither_s16(&dither_index, n, &left_float[i], &right_float[i], left, i, 1, right, i, 1);
+    }
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(interleaved[2 * i] == left[i]);
+        TEST_ASSERT(interleaved[2 * i + 1] == right[i]);
+    }
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "synth/fluid_mod.h"
+#include "utils/fluidsynth_priv.h"
+
+#define MAX_VOICES 64
+
+// the modulation value of each generator is the sum of the values of all the
+// modulators with that destination, in the order they were added
+static void verify_modulation(fluid_synth_t *synth)
+{
+    fluid_voice_t *voices[MAX_VOICES];
+    int i, k, gen, count = 0;
+
+    fluid_synth_get_voicelist(synth, voices, MAX_VOICES, -1);
+
+    for(i = 0; i < MAX_VOICES && voices[i] != NULL; i++)
+    {
+        fluid_voice_t *voice = voices[i];
+
+        for(gen = 0; gen < GEN_LAST; gen++)
+        {
+            fluid_real_t modval = 0.0;
+
+            for(k = 0; k < voice->mod_count; k++)
+            {
+                if(fluid_mod_has_dest(&voice->mod[k], gen))
+                {
+                    modval += fluid_mod_get_value(&voice->mod[k], voice->channel, voice);
+                }
+            }
+
+            TEST_ASSERT(voice->gen[gen].mod == modval);
+        }
+
+        count++;
+    }
+
+    TEST_ASSERT(count > 0);
+}
+
+// this test makes sure that updating only the generators which depend on a changed
+// controller gives the same modulation values as recalculating all of them
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_mod_t *mod = new_fluid_mod();
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(mod != NULL);
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    // the mod wheel also attenuates, next to velocity, volume and expression
+    fluid_mod_set_source1(mod, 1, FLUID_MOD_CC | FLUID_MOD_UNIPOLAR | FLUID_MOD_LINEAR | FLUID_MOD_POSITIVE);
+    fluid_mod_set_source2(mod, FLUID_MOD_VELOCITY, FLUID_MOD_GC | FLUID_MOD_UNIPOLAR | FLUID_MOD_LINEAR | FLUID_MOD_POSITIVE);
+    fluid_mod_set_dest(mod, GEN_ATTENUATION);
+    fluid_mod_set_amount(mod, 200.0);
+    TEST_SUCCESS(fluid_synth_add_default_mod(synth, mod, FLUID_SYNTH_ADD));
+
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 64, 80));
+    verify_modulation(synth);
+
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 1, 90));
+    verify_modulation(synth);
+
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 7, 50));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 11, 70));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 10, 20));
+    verify_modulation(synth);
+
+    TEST_SUCCESS(fluid_synth_pitch_bend(synth, 0, 1000));
+    TEST_SUCCESS(fluid_synth_channel_pressure(synth, 0, 60));
+    TEST_SUCCESS(fluid_synth_key_pressure(synth, 0, 60, 30));
+    verify_modulation(synth);
+
+    // all controllers off updates all of them
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 121, 0));
+    verify_modulation(synth);
+
+    delete_fluid_mod(mod);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "utils/fluidsynth_priv.h"
+
+#define POLYPHONY 16
+#define NOTES 400
+
+static float buf[2 * 5 * FLUID_BUFSIZE];
+
+// verifies that exactly the playing voices are filed in the overflow lists, sorted by start time
+static void verify_overflow_lists(fluid_synth_t *synth)
+{
+    int i, c, playing = 0, listed = 0;
+    fluid_voice_t *voice;
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        voice = synth->voice[i];
+        TEST_ASSERT((voice->overflow_class != FLUID_VOICE_OVERFLOW_NONE) == fluid_voice_is_playing(voice));
+        playing += fluid_voice_is_playing(voice);
+    }
+
+    for(c = 0; c < FLUID_VOICE_OVERFLOW_LAST; c++)
+    {
+        for(voice = synth->overflow.voices_head[c]; voice != NULL; voice = voice->overflow_next)
+        {
+            TEST_ASSERT(voice->overflow_class == c);
+            TEST_ASSERT(voice->overflow_prev == NULL || voice->overflow_prev->start_time <= voice->start_time);
+            TEST_ASSERT(voice->overflow_next != NULL || synth->overflow.voices_tail[c] == voice);
+            listed++;
+        }
+    }
+
+    TEST_ASSERT(listed == playing);
+}
+
+// verifies that the selected voice has the lowest overflow priority of all voices
+static void verify_overflow_victim(fluid_synth_t *synth)
+{
+    int i;
+    float prio, best_prio = OVERFLOW_PRIO_CANNOT_KILL - 1;
+    unsigned int ticks = fluid_atomic_int_get(&synth->ticks_since_start);
+    fluid_voice_t *victim = fluid_voice_get_overflow_victim(&synth->overflow, ticks);
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        if(_AVAILABLE(synth->voice[i]))
+        {
+            return;
+        }
+
+        prio = fluid_voice_get_overflow_prio(synth->voice[i], &synth->overflow, ticks);
+
+        if(prio < best_prio)
+        {
+            best_prio = prio;
+        }
+    }
+
+    TEST_ASSERT(victim != NULL);
+    TEST_ASSERT(fluid_voice_get_overflow_prio(victim, &synth->overflow, ticks) == best_prio);
+}
+
+// this test makes sure that voice stealing picks the voice with the lowest overflow priority
+int main(void)
+{
+    int i, key;
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.overflow.important-channels", "2"));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    for(i = 0; i < NOTES; i++)
+    {
+        int chan = i % 3 == 2 ? 9 : i % 2;
+        key = 36 + (i * 7) % 48;
+
+        // press and release the sustain pedal every now and then
+        if(i % 37 == 0)
+        {
+            TEST_SUCCESS(fluid_synth_cc(synth, 0, 64, (i / 37) % 2 ? 0 : 127));
+        }
+
+        verify_overflow_victim(synth);
+        fluid_synth_noteon(synth, chan, key, 30 + (i * 13) % 97);
+        verify_overflow_lists(synth);
+
+        if(i % 4 != 0)
+        {
+            fluid_synth_noteoff(synth, chan, 36 + ((i - 3) * 7) % 48);
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE * (1 + i % 5), buf, 0, 2, buf, 1, 2));
+        verify_overflow_lists(synth);
+
+        // shrinking and growing the polyphony must keep the lists in sync
+        if(i == NOTES / 2)
+        {
+            TEST_SUCCESS(fluid_synth_set_polyphony(synth, POLYPHONY / 2));
+            verify_overflow_lists(synth);
+            TEST_SUCCESS(fluid_synth_set_polyphony(synth, POLYPHONY));
+            verify_overflow_lists(synth);
+        }
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}